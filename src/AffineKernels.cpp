@@ -0,0 +1,262 @@
+// AffineKernels.cpp
+#include "AffineKernels.hpp"
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace AffineKernels {
+
+namespace {
+
+const float kIdentity[kFloatsPerTransform] = { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f };
+
+// ---------------------------------------------------------------------------
+// scalar
+
+void composeScalar(const TrsArrays &trs, size_t begin, size_t end, float *out) {
+    for(size_t i = begin; i < end; ++i) {
+        const float x = trs.qx[i], y = trs.qy[i], z = trs.qz[i], w = trs.qw[i];
+        const float sx = trs.sx[i], sy = trs.sy[i], sz = trs.sz[i];
+        float *m = out + i * kFloatsPerTransform;
+        m[0] = (1.f - 2.f * (y * y + z * z)) * sx;
+        m[1] = 2.f * (x * y + w * z) * sx;
+        m[2] = 2.f * (x * z - w * y) * sx;
+        m[3] = 2.f * (x * y - w * z) * sy;
+        m[4] = (1.f - 2.f * (x * x + z * z)) * sy;
+        m[5] = 2.f * (y * z + w * x) * sy;
+        m[6] = 2.f * (x * z + w * y) * sz;
+        m[7] = 2.f * (y * z - w * x) * sz;
+        m[8] = (1.f - 2.f * (x * x + y * y)) * sz;
+        m[9] = trs.tx[i];
+        m[10] = trs.ty[i];
+        m[11] = trs.tz[i];
+    }
+}
+
+void concatenateScalar(float *world, const int *parent, const float *local, size_t begin, size_t end) {
+    for(size_t i = begin; i < end; ++i) {
+        const float *p = parent[i] >= 0 ? world + size_t(parent[i]) * kFloatsPerTransform : kIdentity;
+        const float *l = local + i * kFloatsPerTransform;
+        float *m = world + i * kFloatsPerTransform;
+        for(int c = 0; c < 4; ++c) {
+            for(int r = 0; r < 3; ++r)
+                m[3 * c + r] = p[r] * l[3 * c] + p[3 + r] * l[3 * c + 1] + p[6 + r] * l[3 * c + 2] + (c == 3 ? p[9 + r] : 0.f);
+        }
+    }
+}
+
+#ifdef SOLAR_X86
+// ---------------------------------------------------------------------------
+// SSE2 (the x86-64 baseline), 4 transforms
+
+// r[e] = element e of the matrices at m[0..3]
+inline void loadTransposed4(const float *const m[4], __m128 r[12]) {
+    for(int g = 0; g < 3; ++g) {
+        __m128 a = _mm_loadu_ps(m[0] + 4 * g), b = _mm_loadu_ps(m[1] + 4 * g);
+        __m128 c = _mm_loadu_ps(m[2] + 4 * g), d = _mm_loadu_ps(m[3] + 4 * g);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        r[4 * g] = a;
+        r[4 * g + 1] = b;
+        r[4 * g + 2] = c;
+        r[4 * g + 3] = d;
+    }
+}
+
+// the 4 consecutive matrices at out from r[e]
+inline void storeTransposed4(float *out, const __m128 r[12]) {
+    for(int g = 0; g < 3; ++g) {
+        __m128 a = r[4 * g], b = r[4 * g + 1], c = r[4 * g + 2], d = r[4 * g + 3];
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(out + 4 * g, a);
+        _mm_storeu_ps(out + kFloatsPerTransform + 4 * g, b);
+        _mm_storeu_ps(out + 2 * kFloatsPerTransform + 4 * g, c);
+        _mm_storeu_ps(out + 3 * kFloatsPerTransform + 4 * g, d);
+    }
+}
+
+void composeSse(const TrsArrays &trs, size_t begin, size_t end, float *out) {
+    const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+    size_t i = begin;
+    for(; i + 4 <= end; i += 4) {
+        const __m128 x = _mm_loadu_ps(trs.qx + i), y = _mm_loadu_ps(trs.qy + i);
+        const __m128 z = _mm_loadu_ps(trs.qz + i), w = _mm_loadu_ps(trs.qw + i);
+        const __m128 sx = _mm_loadu_ps(trs.sx + i), sy = _mm_loadu_ps(trs.sy + i), sz = _mm_loadu_ps(trs.sz + i);
+        const __m128 x2 = _mm_mul_ps(two, x), y2 = _mm_mul_ps(two, y), z2 = _mm_mul_ps(two, z);
+        const __m128 xx = _mm_mul_ps(x2, x), yy = _mm_mul_ps(y2, y), zz = _mm_mul_ps(z2, z);
+        const __m128 xy = _mm_mul_ps(x2, y), xz = _mm_mul_ps(x2, z), yz = _mm_mul_ps(y2, z);
+        const __m128 wx = _mm_mul_ps(x2, w), wy = _mm_mul_ps(y2, w), wz = _mm_mul_ps(z2, w);
+        __m128 r[12];
+        r[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+        r[1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+        r[2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+        r[3] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+        r[4] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+        r[5] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+        r[6] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+        r[7] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+        r[8] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+        r[9] = _mm_loadu_ps(trs.tx + i);
+        r[10] = _mm_loadu_ps(trs.ty + i);
+        r[11] = _mm_loadu_ps(trs.tz + i);
+        storeTransposed4(out + i * kFloatsPerTransform, r);
+    }
+    composeScalar(trs, i, end, out);
+}
+
+void concatenateSse(float *world, const int *parent, const float *local, size_t begin, size_t end) {
+    size_t i = begin;
+    for(; i + 4 <= end; i += 4) {
+        const float *pm[4], *lm[4];
+        for(int k = 0; k < 4; ++k) {
+            pm[k] = parent[i + k] >= 0 ? world + size_t(parent[i + k]) * kFloatsPerTransform : kIdentity;
+            lm[k] = local + (i + k) * kFloatsPerTransform;
+        }
+        __m128 p[12], l[12], m[12];
+        loadTransposed4(pm, p);
+        loadTransposed4(lm, l);
+        for(int c = 0; c < 4; ++c) {
+            for(int r = 0; r < 3; ++r) {
+                __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[r], l[3 * c]), _mm_mul_ps(p[3 + r], l[3 * c + 1])),
+                                      _mm_mul_ps(p[6 + r], l[3 * c + 2]));
+                m[3 * c + r] = c == 3 ? _mm_add_ps(v, p[9 + r]) : v;
+            }
+        }
+        storeTransposed4(world + i * kFloatsPerTransform, m);
+    }
+    concatenateScalar(world, parent, local, i, end);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA, 8 transforms: two 4-wide transposes per group of elements,
+// joined into one register
+
+SOLAR_TARGET("avx2,fma")
+inline void loadTransposed8(const float *const m[8], __m256 r[12]) {
+    for(int g = 0; g < 3; ++g) {
+        __m128 a = _mm_loadu_ps(m[0] + 4 * g), b = _mm_loadu_ps(m[1] + 4 * g);
+        __m128 c = _mm_loadu_ps(m[2] + 4 * g), d = _mm_loadu_ps(m[3] + 4 * g);
+        __m128 e = _mm_loadu_ps(m[4] + 4 * g), f = _mm_loadu_ps(m[5] + 4 * g);
+        __m128 h = _mm_loadu_ps(m[6] + 4 * g), k = _mm_loadu_ps(m[7] + 4 * g);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _MM_TRANSPOSE4_PS(e, f, h, k);
+        r[4 * g] = _mm256_insertf128_ps(_mm256_castps128_ps256(a), e, 1);
+        r[4 * g + 1] = _mm256_insertf128_ps(_mm256_castps128_ps256(b), f, 1);
+        r[4 * g + 2] = _mm256_insertf128_ps(_mm256_castps128_ps256(c), h, 1);
+        r[4 * g + 3] = _mm256_insertf128_ps(_mm256_castps128_ps256(d), k, 1);
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void storeTransposed8(float *out, const __m256 r[12]) {
+    for(int g = 0; g < 3; ++g) {
+        __m128 a = _mm256_castps256_ps128(r[4 * g]), b = _mm256_castps256_ps128(r[4 * g + 1]);
+        __m128 c = _mm256_castps256_ps128(r[4 * g + 2]), d = _mm256_castps256_ps128(r[4 * g + 3]);
+        __m128 e = _mm256_extractf128_ps(r[4 * g], 1), f = _mm256_extractf128_ps(r[4 * g + 1], 1);
+        __m128 h = _mm256_extractf128_ps(r[4 * g + 2], 1), k = _mm256_extractf128_ps(r[4 * g + 3], 1);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _MM_TRANSPOSE4_PS(e, f, h, k);
+        float *o = out + 4 * g;
+        _mm_storeu_ps(o, a);
+        _mm_storeu_ps(o + kFloatsPerTransform, b);
+        _mm_storeu_ps(o + 2 * kFloatsPerTransform, c);
+        _mm_storeu_ps(o + 3 * kFloatsPerTransform, d);
+        _mm_storeu_ps(o + 4 * kFloatsPerTransform, e);
+        _mm_storeu_ps(o + 5 * kFloatsPerTransform, f);
+        _mm_storeu_ps(o + 6 * kFloatsPerTransform, h);
+        _mm_storeu_ps(o + 7 * kFloatsPerTransform, k);
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void composeAvx2(const TrsArrays &trs, size_t begin, size_t end, float *out) {
+    const __m256 one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+    size_t i = begin;
+    for(; i + 8 <= end; i += 8) {
+        const __m256 x = _mm256_loadu_ps(trs.qx + i), y = _mm256_loadu_ps(trs.qy + i);
+        const __m256 z = _mm256_loadu_ps(trs.qz + i), w = _mm256_loadu_ps(trs.qw + i);
+        const __m256 sx = _mm256_loadu_ps(trs.sx + i), sy = _mm256_loadu_ps(trs.sy + i), sz = _mm256_loadu_ps(trs.sz + i);
+        const __m256 x2 = _mm256_mul_ps(two, x), y2 = _mm256_mul_ps(two, y), z2 = _mm256_mul_ps(two, z);
+        const __m256 xx = _mm256_mul_ps(x2, x), yy = _mm256_mul_ps(y2, y), zz = _mm256_mul_ps(z2, z);
+        const __m256 xy = _mm256_mul_ps(x2, y), xz = _mm256_mul_ps(x2, z), yz = _mm256_mul_ps(y2, z);
+        __m256 r[12];
+        r[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+        r[1] = _mm256_mul_ps(_mm256_fmadd_ps(z2, w, xy), sx);
+        r[2] = _mm256_mul_ps(_mm256_fnmadd_ps(y2, w, xz), sx);
+        r[3] = _mm256_mul_ps(_mm256_fnmadd_ps(z2, w, xy), sy);
+        r[4] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+        r[5] = _mm256_mul_ps(_mm256_fmadd_ps(x2, w, yz), sy);
+        r[6] = _mm256_mul_ps(_mm256_fmadd_ps(y2, w, xz), sz);
+        r[7] = _mm256_mul_ps(_mm256_fnmadd_ps(x2, w, yz), sz);
+        r[8] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+        r[9] = _mm256_loadu_ps(trs.tx + i);
+        r[10] = _mm256_loadu_ps(trs.ty + i);
+        r[11] = _mm256_loadu_ps(trs.tz + i);
+        storeTransposed8(out + i * kFloatsPerTransform, r);
+    }
+    composeSse(trs, i, end, out);
+}
+
+SOLAR_TARGET("avx2,fma")
+void concatenateAvx2(float *world, const int *parent, const float *local, size_t begin, size_t end) {
+    size_t i = begin;
+    for(; i + 8 <= end; i += 8) {
+        const float *pm[8], *lm[8];
+        for(int k = 0; k < 8; ++k) {
+            pm[k] = parent[i + k] >= 0 ? world + size_t(parent[i + k]) * kFloatsPerTransform : kIdentity;
+            lm[k] = local + (i + k) * kFloatsPerTransform;
+        }
+        __m256 p[12], l[12], m[12];
+        loadTransposed8(pm, p);
+        loadTransposed8(lm, l);
+        for(int c = 0; c < 4; ++c) {
+            for(int r = 0; r < 3; ++r) {
+                const __m256 v = _mm256_fmadd_ps(p[6 + r], l[3 * c + 2],
+                                 _mm256_fmadd_ps(p[3 + r], l[3 * c + 1], _mm256_mul_ps(p[r], l[3 * c])));
+                m[3 * c + r] = c == 3 ? _mm256_add_ps(v, p[9 + r]) : v;
+            }
+        }
+        storeTransposed8(world + i * kFloatsPerTransform, m);
+    }
+    concatenateSse(world, parent, local, i, end);
+}
+#endif // SOLAR_X86
+
+struct KernelTable {
+    void (*compose)(const TrsArrays &, size_t, size_t, float *);
+    void (*concatenate)(float *, const int *, const float *, size_t, size_t);
+    SimdLevel level;
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_X86
+    if(CpuFeatures::get().level() >= SimdLevel::AVX2) {
+        const KernelTable t = { composeAvx2, concatenateAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+    const KernelTable t = { composeSse, concatenateSse, SimdLevel::SSE };
+    return t;
+#else
+    const KernelTable t = { composeScalar, concatenateScalar, SimdLevel::Scalar };
+    return t;
+#endif
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+void composeTrs(const TrsArrays &trs, size_t begin, size_t end, float *out) {
+    kernels().compose(trs, begin, end, out);
+}
+
+void concatenateParents(float *world, const int *parent, const float *local, size_t begin, size_t end) {
+    kernels().concatenate(world, parent, local, begin, end);
+}
+
+SimdLevel activeLevel() { return kernels().level; }
+
+} // namespace AffineKernels
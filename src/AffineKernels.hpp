@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+#include "CpuFeatures.hpp"
+
+// Batched affine transforms for the renderer and transform hierarchies.
+//
+// A transform is a 3x4 matrix stored column-major like glm::mat4x3 and a GLSL
+// mat4x3: 12 floats, the three columns of the rotation times scale, then the
+// translation. The implied last row is 0 0 0 1, which a mat4 would store and
+// multiply through for nothing.
+//
+// The kernels work on 8 transforms at a time with AVX2 and 4 with SSE: the
+// inputs are read (or transposed) into one register per matrix element, so
+// the arithmetic is the 3x4 one without shuffles, and transposed back on the
+// way out.
+namespace AffineKernels {
+
+const size_t kFloatsPerTransform = 12;
+
+// Translation, rotation (unit quaternion) and scale per transform, one array per component.
+struct TrsArrays {
+    const float *tx, *ty, *tz;
+    const float *qx, *qy, *qz, *qw;
+    const float *sx, *sy, *sz;
+};
+
+// out[i] = T(t[i]) * R(q[i]) * S(s[i]) for i in [begin, end), what
+// glm::translate * glm::mat4_cast * glm::scale gives. out is indexed like the
+// arrays, transform i at out + 12 * i.
+void composeTrs(const TrsArrays &trs, size_t begin, size_t end, float *out);
+
+// world[i] = world[parent[i]] * local[i] for i in [begin, end), world[i] =
+// local[i] for a root (parent -1). Every parent must come before `begin`, as
+// when a breadth-first ordered hierarchy goes one level at a time.
+void concatenateParents(float *world, const int *parent, const float *local, size_t begin, size_t end);
+
+// Level actually used.
+SimdLevel activeLevel();
+
+} // namespace AffineKernels
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// std::allocator that hands out memory aligned to Align bytes, a cache line by
+// default: a SIMD kernel then never has a load split across two lines, and two
+// threads writing neighbouring blocks of an array don't share one.
+template <typename T, size_t Align = 64>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+    template <typename U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+    AlignedAllocator() {}
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+    T *allocate(size_t count) {
+        void *p = nullptr;
+#ifdef _WIN32
+        p = _aligned_malloc(count * sizeof(T), Align);
+#else
+        if(posix_memalign(&p, Align, count * sizeof(T)) != 0)
+            p = nullptr;
+#endif
+        if(!p)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+
+template <typename T, typename U, size_t Align>
+inline bool operator==(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return true; }
+template <typename T, typename U, size_t Align>
+inline bool operator!=(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return false; }
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
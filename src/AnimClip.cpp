@@ -0,0 +1,385 @@
+// AnimClip.cpp
+#include "AnimClip.hpp"
+#include "BodyTable.hpp"
+#include "CpuFeatures.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const char kMagic[4] = { 'S', 'C', 'L', 'P' };
+const uint32_t kMaxStride = 1024; // verification samples between two keys at most
+
+// uniform Catmull-Rom weights of the four keys around f in [0, 1]
+inline void splineWeights(const float f, float w[4]) {
+    const float f2 = f * f, f3 = f2 * f;
+    w[0] = 0.5f * (-f3 + 2.f * f2 - f);
+    w[1] = 0.5f * (3.f * f3 - 5.f * f2 + 2.f);
+    w[2] = 0.5f * (-3.f * f3 + 4.f * f2 + f);
+    w[3] = 0.5f * (f3 - f2);
+}
+
+// Exact channels of every body at time t, channel-major. The spin angle is
+// not wrapped: the quaternion has to stay continuous for the spline.
+void sampleChannels(const BodyTable &bodies, const double t, float *out) {
+    const size_t n = bodies.size();
+    std::vector<double> x(n), y(n), z(n);
+    bodies.offsets(t, x.data(), y.data(), z.data());
+    for(size_t i = 0; i < n; ++i) {
+        const double half = 0.5 * double(bodies.spinSpeed[i]) * t;
+        const float s = float(std::sin(half));
+        out[i] = float(x[i]);
+        out[n + i] = float(y[i]);
+        out[2 * n + i] = float(z[i]);
+        out[3 * n + i] = bodies.spinAxisX[i] * s;
+        out[4 * n + i] = bodies.spinAxisY[i] * s;
+        out[5 * n + i] = bodies.spinAxisZ[i] * s;
+        out[6 * n + i] = float(std::cos(half));
+    }
+}
+
+void splineScalar(size_t begin, size_t end, const float *k0, const float *k1, const float *k2, const float *k3,
+                  const float *f, const float *lo, const float *step, float *out) {
+    for(size_t c = begin; c < end; ++c) {
+        float w[4];
+        splineWeights(f[c], w);
+        out[c] = lo[c] + step[c] * (w[0] * k0[c] + w[1] * k1[c] + w[2] * k2[c] + w[3] * k3[c]);
+    }
+}
+
+#ifdef SOLAR_X86
+// the same, four channels per register
+SOLAR_TARGET("sse2")
+size_t splineSse(size_t count, const float *k0, const float *k1, const float *k2, const float *k3,
+                 const float *f, const float *lo, const float *step, float *out) {
+    const __m128 half = _mm_set1_ps(0.5f), two = _mm_set1_ps(2.f), three = _mm_set1_ps(3.f),
+                 four = _mm_set1_ps(4.f), five = _mm_set1_ps(5.f);
+    size_t c = 0;
+    for(; c + 4 <= count; c += 4) {
+        const __m128 t = _mm_loadu_ps(f + c);
+        const __m128 t2 = _mm_mul_ps(t, t), t3 = _mm_mul_ps(t2, t);
+        const __m128 w0 = _mm_mul_ps(half, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(two, t2), t3), t));
+        const __m128 w1 = _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(three, t3), _mm_mul_ps(five, t2)), two));
+        const __m128 w2 = _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(four, t2), _mm_mul_ps(three, t3)), t));
+        const __m128 w3 = _mm_mul_ps(half, _mm_sub_ps(t3, t2));
+        __m128 sum = _mm_mul_ps(w0, _mm_loadu_ps(k0 + c));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w1, _mm_loadu_ps(k1 + c)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w2, _mm_loadu_ps(k2 + c)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w3, _mm_loadu_ps(k3 + c)));
+        _mm_storeu_ps(out + c, _mm_add_ps(_mm_loadu_ps(lo + c), _mm_mul_ps(_mm_loadu_ps(step + c), sum)));
+    }
+    return c;
+}
+#endif
+
+} // namespace
+
+bool AnimClip::bake(const BodyTable &bodies, const double start, const double duration, const Settings &settings) {
+    const size_t n = bodies.size();
+    if(n == 0 || !(duration > 0.0) || !(settings.sampleRate > 0.0)) {
+        std::cerr << "ERROR: nothing to bake" << std::endl;
+        return false;
+    }
+    for(size_t i = 0; i < n; ++i) {
+        if(bodies.name[i].size() > kMaxNameLength) {
+            std::cerr << "ERROR: body name too long: " << bodies.name[i] << std::endl;
+            return false;
+        }
+    }
+
+    // the exact transforms at every verification sample
+    const double period = 1.0 / settings.sampleRate;
+    const size_t samples = size_t(std::ceil(duration * settings.sampleRate)) + 1;
+    const size_t channels = kChannels * n;
+    std::vector<float> exact(samples * channels);
+    Parallel::parallelFor(0, samples, [&](size_t s) {
+        sampleChannels(bodies, start + double(s) * period, &exact[s * channels]);
+    }, "clip.sample", 16);
+
+    // grids of keys every `stride` samples, from one before the first sample
+    // to two past the last; the keys off the samples are evaluated apart
+    std::vector<uint32_t> strides;
+    for(uint32_t stride = 1; stride <= kMaxStride && (stride == 1 || stride < samples); stride *= 2)
+        strides.push_back(stride);
+    std::vector<std::vector<float> > outside(strides.size()); // keys 0, K and K + 1 of each grid
+    for(size_t g = 0; g < strides.size(); ++g) {
+        const int64_t stride = strides[g], spans = (int64_t(samples) - 1 + stride - 1) / stride;
+        const int64_t at[3] = { -stride, spans * stride, (spans + 1) * stride };
+        outside[g].assign(3 * channels, 0.f);
+        for(int k = 0; k < 3; ++k)
+            sampleChannels(bodies, start + double(at[k]) * period, &outside[g][k * channels]);
+    }
+
+    struct Fit {
+        Channel channel;
+        std::vector<unsigned char> keys;
+        float error;
+    };
+    std::vector<Fit> fits(channels);
+    Parallel::parallelFor(0, channels, [&](size_t c) {
+        const float bound = c < 3 * n ? settings.positionError : settings.rotationError;
+        const auto value = [&](size_t g, int64_t index) {
+            if(index >= 0 && index < int64_t(samples))
+                return exact[size_t(index) * channels + c];
+            const int64_t stride = strides[g];
+            const int k = index < 0 ? 0 : (index == (int64_t(samples) - 1 + stride - 1) / stride * stride ? 1 : 2);
+            return outside[g][k * channels + c];
+        };
+        float lo = exact[c], hi = exact[c];
+        for(size_t s = 0; s < samples; ++s) {
+            lo = std::min(lo, exact[s * channels + c]);
+            hi = std::max(hi, exact[s * channels + c]);
+        }
+        for(size_t g = 0; g < strides.size(); ++g) {
+            for(int k = 0; k < 3; ++k) {
+                lo = std::min(lo, outside[g][k * channels + c]);
+                hi = std::max(hi, outside[g][k * channels + c]);
+            }
+        }
+
+        Fit &fit = fits[c];
+        if(hi - lo <= bound) { // still: one key
+            fit.channel.interval = duration;
+            fit.channel.lo = 0.5f * (lo + hi);
+            fit.channel.step = 0.f;
+            fit.channel.keyCount = 1;
+            fit.channel.bits = 8;
+            fit.keys.assign(1, 0);
+            fit.error = 0.5f * (hi - lo);
+            return;
+        }
+
+        // the fewest bits whose rounding takes half the bound at most, then the
+        // sparsest grid within the bound; 32 bits on every sample always fits
+        std::vector<float> keys;
+        const uint32_t widths[3] = { 8, 16, 32 };
+        for(int w = 0; w < 3; ++w) {
+            const uint32_t bits = widths[w];
+            const float levels = bits < 32 ? float((1u << bits) - 1) : 0.f;
+            const float step = bits < 32 ? (hi - lo) / levels : 1.f, base = bits < 32 ? lo : 0.f;
+            if(bits < 32 && 0.5f * step > 0.5f * bound)
+                continue;
+            for(size_t g = strides.size(); g-- > 0;) {
+                const uint32_t stride = strides[g];
+                const size_t spans = (samples - 1 + stride - 1) / stride;
+                keys.resize(spans + 3);
+                for(size_t k = 0; k < keys.size(); ++k) {
+                    const float v = value(g, (int64_t(k) - 1) * stride);
+                    keys[k] = bits < 32 ? std::min(levels, std::max(0.f, std::floor((v - lo) / step + 0.5f))) : v;
+                }
+                float error = 0.f;
+                for(size_t s = 0; s < samples && error <= bound; ++s) {
+                    const size_t i = std::min(s / stride, spans - 1);
+                    float weights[4];
+                    splineWeights(float(double(s) / stride - double(i)), weights);
+                    const float q = weights[0] * keys[i] + weights[1] * keys[i + 1] + weights[2] * keys[i + 2] + weights[3] * keys[i + 3];
+                    error = std::max(error, std::fabs(base + step * q - exact[s * channels + c]));
+                }
+                if(error > bound && !(bits == 32 && stride == 1))
+                    continue;
+
+                fit.channel.interval = double(stride) * period;
+                fit.channel.lo = base;
+                fit.channel.step = step;
+                fit.channel.keyCount = uint32_t(keys.size());
+                fit.channel.bits = bits;
+                fit.keys.resize(keys.size() * bits / 8);
+                for(size_t k = 0; k < keys.size(); ++k) {
+                    if(bits == 8) {
+                        fit.keys[k] = uint8_t(keys[k]);
+                    } else if(bits == 16) {
+                        const uint16_t q = uint16_t(keys[k]);
+                        std::memcpy(&fit.keys[2 * k], &q, 2);
+                    } else {
+                        std::memcpy(&fit.keys[4 * k], &keys[k], 4);
+                    }
+                }
+                fit.error = error;
+                return;
+            }
+        }
+    }, "clip.fit");
+
+    // the file image: header, names, channels, then the keys
+    const size_t namesBytes = n * (kMaxNameLength + 1);
+    size_t size = sizeof(Header) + namesBytes + channels * sizeof(Channel);
+    for(size_t c = 0; c < channels; ++c) {
+        size = (size + 3) / 4 * 4;
+        fits[c].channel.offset = size;
+        size += fits[c].keys.size();
+    }
+    m_file.close();
+    m_image.assign(size, 0);
+    Header header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.bodyCount = uint32_t(n);
+    header.reserved = 0;
+    header.start = start;
+    header.duration = duration;
+    std::memcpy(&m_image[0], &header, sizeof(Header));
+    for(size_t i = 0; i < n; ++i)
+        std::memcpy(&m_image[sizeof(Header) + i * (kMaxNameLength + 1)], bodies.name[i].c_str(), bodies.name[i].size());
+    m_maxError[0] = m_maxError[1] = 0.f;
+    for(size_t c = 0; c < channels; ++c) {
+        std::memcpy(&m_image[sizeof(Header) + namesBytes + c * sizeof(Channel)], &fits[c].channel, sizeof(Channel));
+        std::memcpy(&m_image[fits[c].channel.offset], fits[c].keys.data(), fits[c].keys.size());
+        float &maxError = m_maxError[c < 3 * n ? 0 : 1];
+        maxError = std::max(maxError, fits[c].error);
+    }
+    return attach(m_image.data(), m_image.size(), "baked clip");
+}
+
+bool AnimClip::save(const std::string &path) const {
+    if(!m_base)
+        return false;
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        std::cerr << "ERROR: Could not write " << path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(m_base), std::streamsize(m_size));
+    return bool(out);
+}
+
+bool AnimClip::open(const std::string &path) {
+    m_image.clear();
+    m_base = nullptr;
+    if(!m_file.open(path))
+        return false;
+    if(!attach(m_file.data(), m_file.size(), path)) {
+        m_file.close();
+        return false;
+    }
+    m_maxError[0] = m_maxError[1] = 0.f; // not known from the file
+    return true;
+}
+
+bool AnimClip::openFromMemory(const void *data, const size_t size, const std::string &name) {
+    m_file.close();
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    m_image.assign(bytes, bytes + size);
+    if(!attach(m_image.data(), m_image.size(), name)) {
+        m_image.clear();
+        return false;
+    }
+    m_maxError[0] = m_maxError[1] = 0.f;
+    return true;
+}
+
+bool AnimClip::attach(const unsigned char *data, const size_t size, const std::string &path) {
+    m_base = nullptr;
+    Header header;
+    if(size < sizeof(Header)) {
+        std::cerr << "ERROR: " << path << " is not an animation clip" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Header));
+    const size_t channels = size_t(header.bodyCount) * kChannels;
+    const size_t tables = sizeof(Header) + header.bodyCount * (kMaxNameLength + 1) + channels * sizeof(Channel);
+    if(std::memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion || tables > size || !(header.duration > 0.0)) {
+        std::cerr << "ERROR: " << path << " is not a valid animation clip" << std::endl;
+        return false;
+    }
+    const Channel *table = reinterpret_cast<const Channel *>(data + sizeof(Header) + header.bodyCount * (kMaxNameLength + 1));
+    for(size_t c = 0; c < channels; ++c) {
+        const Channel &channel = table[c];
+        const bool shape = (channel.bits == 8 || channel.bits == 16 || channel.bits == 32) && channel.offset % 4 == 0 &&
+                           (channel.keyCount == 1 || (channel.keyCount >= 4 && channel.interval > 0.0));
+        if(!shape || channel.offset + uint64_t(channel.keyCount) * channel.bits / 8 > size) {
+            std::cerr << "ERROR: " << path << " is truncated" << std::endl;
+            return false;
+        }
+    }
+    m_base = data;
+    m_size = size;
+    m_names = reinterpret_cast<const char *>(data + sizeof(Header));
+    m_channels = table;
+    m_bodyCount = header.bodyCount;
+    m_start = header.start;
+    m_duration = header.duration;
+    return true;
+}
+
+bool AnimClip::matches(const BodyTable &bodies) const {
+    if(!m_base || bodies.size() != m_bodyCount)
+        return false;
+    for(size_t i = 0; i < m_bodyCount; ++i) {
+        const char *name = m_names + i * (kMaxNameLength + 1);
+        if(bodies.name[i] != std::string(name, std::find(name, name + kMaxNameLength, '\0')))
+            return false;
+    }
+    return true;
+}
+
+size_t AnimClip::keyCount() const {
+    size_t keys = 0;
+    for(size_t c = 0; m_base && c < kChannels * m_bodyCount; ++c)
+        keys += m_channels[c].keyCount;
+    return keys;
+}
+
+inline float AnimClip::key(const Channel &channel, const uint32_t k) const {
+    const unsigned char *keys = m_base + channel.offset;
+    if(channel.bits == 8)
+        return float(keys[k]);
+    if(channel.bits == 16) {
+        uint16_t q;
+        std::memcpy(&q, keys + 2 * k, 2);
+        return float(q);
+    }
+    float v;
+    std::memcpy(&v, keys + 4 * k, 4);
+    return v;
+}
+
+void AnimClip::evaluate(const double t, float *out) {
+    if(!m_base)
+        return;
+    const size_t channels = kChannels * m_bodyCount;
+    m_k0.resize(channels);
+    m_k1.resize(channels);
+    m_k2.resize(channels);
+    m_k3.resize(channels);
+    m_f.resize(channels);
+    m_lo.resize(channels);
+    m_step.resize(channels);
+
+    // the four keys around t, channel by channel
+    const double local = std::min(m_duration, std::max(0.0, t - m_start));
+    for(size_t c = 0; c < channels; ++c) {
+        const Channel &channel = m_channels[c];
+        m_lo[c] = channel.lo;
+        m_step[c] = channel.step;
+        if(channel.keyCount == 1) {
+            m_k0[c] = m_k1[c] = m_k2[c] = m_k3[c] = key(channel, 0);
+            m_f[c] = 0.f;
+            continue;
+        }
+        const double u = local / channel.interval;
+        const uint32_t i = std::min(uint32_t(u), channel.keyCount - 4);
+        m_f[c] = float(u - double(i));
+        m_k0[c] = key(channel, i);
+        m_k1[c] = key(channel, i + 1);
+        m_k2[c] = key(channel, i + 2);
+        m_k3[c] = key(channel, i + 3);
+    }
+
+    // and the splines, all channels at once
+    size_t done = 0;
+#ifdef SOLAR_X86
+    static const bool sse = CpuFeatures::get().level() >= SimdLevel::SSE;
+    if(sse)
+        done = splineSse(channels, m_k0.data(), m_k1.data(), m_k2.data(), m_k3.data(), m_f.data(), m_lo.data(), m_step.data(), out);
+#endif
+    splineScalar(done, channels, m_k0.data(), m_k1.data(), m_k2.data(), m_k3.data(), m_f.data(), m_lo.data(), m_step.data(), out);
+}
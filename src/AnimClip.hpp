@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+class BodyTable;
+
+// Body transforms baked over a time range, for cinematics and kiosk loops
+// that replay the scene without running it.
+//
+// Every body has seven channels: its offset from the parent (x, y, z) and its
+// spin quaternion. Each channel is its own grid of evenly spaced keys,
+// sampled by a uniform Catmull-Rom spline, and baking picks per channel the
+// sparsest grid (a power of two times the verification period) whose spline
+// stays within the channel's error bound at every verification sample: a
+// slow orbit gets a key every few seconds, a still body one key in all.
+// Keys are quantized to 8 or 16 bits over the channel's range when that fits
+// the bound, floats otherwise. evaluate() stages the four keys around t of
+// every channel and runs the spline over the channels with SSE, four at a
+// time.
+//
+// Layout (little endian), used in place from the mapping like Ephemeris:
+//   Header  { char magic[4] = "SCLP"; uint32 version; uint32 bodyCount; uint32 reserved; double start, duration; }
+//   char name[24] x bodyCount
+//   Channel { double interval; float lo, step; uint32 keyCount, bits; uint64 offset; } x 7 bodyCount,
+//           channel c of body b at c * bodyCount + b (x, y, z, qx, qy, qz, qw)
+//   keys, per channel keyCount values of bits / 8 bytes, 4-byte aligned; key k
+//   is at start + (k - 1) interval and the value is lo + step * q (q the float itself for 32 bits)
+class AnimClip {
+public:
+    static const uint32_t kVersion = 1;
+    static const size_t kMaxNameLength = 23;
+    static const int kChannels = 7;
+
+    struct Settings {
+        double sampleRate = 60.0;     // verification samples per second
+        float positionError = 1e-3f;  // scene units
+        float rotationError = 1e-4f;  // per quaternion component
+    };
+
+    // Bakes the scripted orbits and spins of the table over [start, start + duration].
+    bool bake(const BodyTable &bodies, double start, double duration, const Settings &settings);
+
+    bool save(const std::string &path) const;
+    bool open(const std::string &path);
+    // Same from a clip image in memory, copied; name is for the error messages.
+    bool openFromMemory(const void *data, size_t size, const std::string &name);
+    inline bool isOpen() const { return m_base != nullptr; }
+
+    // True when the clip was baked from a table with the same bodies, in the same order.
+    bool matches(const BodyTable &bodies) const;
+
+    // Channels at time t, clamped to the clip: out[c * bodyCount() + b].
+    void evaluate(double t, float *out);
+
+    inline size_t bodyCount() const { return m_bodyCount; }
+    inline double start() const { return m_start; }
+    inline double duration() const { return m_duration; }
+    inline size_t byteSize() const { return m_size; }
+    // Whole clip (header included) per body and second of animation.
+    inline double bytesPerBodySecond() const {
+        return m_bodyCount && m_duration > 0.0 ? double(m_size) / (double(m_bodyCount) * m_duration) : 0.0;
+    }
+    size_t keyCount() const;
+    // Largest difference to the exact transforms over the verification samples of the last bake().
+    inline float maxPositionError() const { return m_maxError[0]; }
+    inline float maxRotationError() const { return m_maxError[1]; }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t bodyCount;
+        uint32_t reserved;
+        double start, duration;
+    };
+
+    struct Channel {
+        double interval;
+        float lo, step;
+        uint32_t keyCount, bits;
+        uint64_t offset;
+    };
+
+    bool attach(const unsigned char *data, size_t size, const std::string &path);
+    float key(const Channel &channel, uint32_t k) const;
+
+    std::vector<unsigned char> m_image; // a baked clip, in the file layout
+    MappedFile m_file;                  // or an opened one
+    const unsigned char *m_base = nullptr;
+    size_t m_size = 0;
+    const char *m_names = nullptr;
+    const Channel *m_channels = nullptr;
+    uint32_t m_bodyCount = 0;
+    double m_start = 0.0, m_duration = 0.0;
+    float m_maxError[2] = { 0.f, 0.f };
+    // evaluate() staging, per channel: the four keys around t and where t is between the middle two
+    std::vector<float> m_k0, m_k1, m_k2, m_k3, m_f, m_lo, m_step;
+};
@@ -0,0 +1,215 @@
+// AnimatedTexture.cpp
+#include "AnimatedTexture.hpp"
+#include "ImageKernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+const size_t kSlotCount = 3; // frames decoded ahead of the one being uploaded
+}
+
+bool AnimatedTexture::init(const std::vector<std::string> &frames, float fps, ImageLoader loader,
+                           int tileSize, size_t uploadBudget) {
+    destroy();
+    if(frames.empty() || fps <= 0.f)
+        return false;
+
+    std::vector<unsigned char> first;
+    if(!loader(frames[0], first, m_width, m_height))
+        return false;
+    // bottom row first as glTexImage2D wants it, or the genSphere UVs show the surface upside down
+    ImageKernels::flipRows(first.data(), size_t(m_width) * 4, m_height);
+
+    m_frames = frames;
+    m_fps = fps;
+    m_loader = loader;
+    m_tileSize = tileSize;
+    m_tilesX = (m_width + tileSize - 1) / tileSize;
+    m_tilesY = (m_height + tileSize - 1) / tileSize;
+    // always let at least one tile through, or a tiny budget would stall the stream
+    m_uploadBudget = std::max(uploadBudget, size_t(tileSize) * tileSize * 4);
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, first.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_slots.resize(kSlotCount);
+    for(size_t i = 0; i < m_slots.size(); ++i) {
+        glGenBuffers(1, &m_slots[i].pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_slots[i].pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size_t(m_width) * m_height * 4, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m_previous.swap(first);
+    m_uploadSlot = m_decodeSlot = 0;
+    m_nextFrame = 1 % int(m_frames.size());
+    m_framesShown = 1;
+    m_stop = false;
+    m_worker = std::thread(&AnimatedTexture::workerLoop, this);
+    return true;
+}
+
+void AnimatedTexture::destroy() {
+    if(m_worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_worker.join();
+    }
+    for(size_t i = 0; i < m_slots.size(); ++i) {
+        if(m_slots[i].state == SlotState::Mapped || m_slots[i].state == SlotState::Decoded) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_slots[i].pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteBuffers(1, &m_slots[i].pbo);
+    }
+    if(!m_slots.empty())
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_slots.clear();
+    if(m_texture)
+        glDeleteTextures(1, &m_texture);
+    m_texture = 0;
+}
+
+void AnimatedTexture::update(float timeInSec) {
+    if(!m_texture)
+        return;
+
+    Slot &slot = m_slots[m_uploadSlot];
+    SlotState state;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        state = slot.state;
+    }
+
+    // start the next frame once it is due; frames are never skipped since each
+    // one only carries the tiles that changed since its predecessor
+    const long long dueFrames = (long long)(timeInSec * m_fps) + 1;
+    if(state == SlotState::Decoded && m_framesShown < dueFrames) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        slot.mapped = nullptr;
+        slot.nextTile = 0;
+        state = SlotState::Uploading;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.state = state;
+    }
+
+    if(state == SlotState::Uploading) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+        size_t budget = m_uploadBudget;
+        while(slot.nextTile < slot.dirtyTiles.size()) {
+            const int tile = slot.dirtyTiles[slot.nextTile];
+            const int x0 = (tile % m_tilesX) * m_tileSize, y0 = (tile / m_tilesX) * m_tileSize;
+            const int w = std::min(m_tileSize, m_width - x0), h = std::min(m_tileSize, m_height - y0);
+            const size_t bytes = size_t(w) * h * 4;
+            if(bytes > budget)
+                break;
+            const size_t offset = (size_t(y0) * m_width + x0) * 4;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<const void *>(offset));
+            budget -= bytes;
+            ++slot.nextTile;
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if(slot.nextTile == slot.dirtyTiles.size()) {
+            ++m_framesShown;
+            m_uploadSlot = (m_uploadSlot + 1) % m_slots.size();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.state = SlotState::Free;
+        }
+    }
+
+    // hand every free buffer back to the worker, orphaned so mapping never waits on the GPU
+    bool mapped = false;
+    for(size_t i = 0; i < m_slots.size(); ++i) {
+        Slot &s = m_slots[i];
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(s.state != SlotState::Free)
+                continue;
+        }
+        const GLsizeiptr size = GLsizeiptr(m_width) * m_height * 4;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void *ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if(!ptr)
+            continue;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s.mapped = static_cast<unsigned char *>(ptr);
+        s.state = SlotState::Mapped;
+        mapped = true;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if(mapped)
+        m_cv.notify_one();
+}
+
+void AnimatedTexture::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+        m_cv.wait(lock, [this]() { return m_stop || m_slots[m_decodeSlot].state == SlotState::Mapped; });
+        if(m_stop)
+            return;
+        Slot &slot = m_slots[m_decodeSlot];
+        const int frame = m_nextFrame;
+
+        // the GL thread leaves a Mapped slot alone, so decode without the lock
+        lock.unlock();
+        decodeInto(slot, frame);
+        lock.lock();
+
+        slot.frame = frame;
+        slot.state = SlotState::Decoded;
+        m_decodeSlot = (m_decodeSlot + 1) % m_slots.size();
+        m_nextFrame = (m_nextFrame + 1) % int(m_frames.size());
+    }
+}
+
+void AnimatedTexture::decodeInto(Slot &slot, int frame) {
+    slot.dirtyTiles.clear();
+
+    std::vector<unsigned char> pixels;
+    int width = 0, height = 0;
+    if(!m_loader(m_frames[frame], pixels, width, height) || width != m_width || height != m_height) {
+        std::cerr << "WARNING: skipping animation frame " << m_frames[frame] << std::endl;
+        return; // no dirty tiles: the previous frame stays on screen
+    }
+    ImageKernels::flipRows(pixels.data(), size_t(width) * 4, height);
+
+    // only the tiles that differ from the previous frame are copied and uploaded
+    const size_t stride = size_t(m_width) * 4;
+    for(int ty = 0; ty < m_tilesY; ++ty) {
+        for(int tx = 0; tx < m_tilesX; ++tx) {
+            const int x0 = tx * m_tileSize, y0 = ty * m_tileSize;
+            const size_t rowBytes = size_t(std::min(m_tileSize, m_width - x0)) * 4;
+            const int rows = std::min(m_tileSize, m_height - y0);
+            bool changed = false;
+            for(int y = 0; y < rows && !changed; ++y) {
+                const size_t offset = (y0 + y) * stride + size_t(x0) * 4;
+                changed = std::memcmp(pixels.data() + offset, m_previous.data() + offset, rowBytes) != 0;
+            }
+            if(!changed)
+                continue;
+            for(int y = 0; y < rows; ++y) {
+                const size_t offset = (y0 + y) * stride + size_t(x0) * 4;
+                std::memcpy(slot.mapped + offset, pixels.data() + offset, rowBytes);
+            }
+            slot.dirtyTiles.push_back(ty * m_tilesX + tx);
+        }
+    }
+    m_previous.swap(pixels);
+}
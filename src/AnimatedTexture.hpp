@@ -0,0 +1,77 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+// Time-varying 2D texture streamed from an image sequence (cloud layer,
+// animated solar surface, ...).
+//
+// A worker thread decodes the frames ahead into a ring of pixel buffer
+// objects mapped by the GL thread, and records which tiles changed since the
+// previous frame. Each update() the GL thread then uploads at most
+// `uploadBudget` bytes of changed tiles with glTexSubImage2D from the PBOs,
+// so the render loop never blocks on decoding or on a full glTexImage2D.
+class AnimatedTexture {
+public:
+    // Decodes an image into tightly packed RGBA8 rows, first row at the top.
+    // Called from the worker thread.
+    typedef std::function<bool(const std::string &, std::vector<unsigned char> &, int &, int &)> ImageLoader;
+
+    AnimatedTexture() = default;
+    ~AnimatedTexture() { destroy(); }
+    AnimatedTexture(const AnimatedTexture &) = delete;
+    AnimatedTexture &operator=(const AnimatedTexture &) = delete;
+
+    // Uploads the first frame synchronously and starts the worker. Every frame
+    // must have the size of the first one.
+    bool init(const std::vector<std::string> &frames, float fps, ImageLoader loader,
+              int tileSize = 64, size_t uploadBudget = 1 << 20);
+    void destroy();
+
+    // Advances the animation to timeInSec and uploads pending tiles. GL thread only.
+    void update(float timeInSec);
+
+    inline GLuint texture() const { return m_texture; }
+    inline bool isValid() const { return m_texture != 0; }
+
+private:
+    enum class SlotState { Free, Mapped, Decoded, Uploading };
+
+    struct Slot {
+        GLuint pbo = 0;
+        SlotState state = SlotState::Free;
+        unsigned char *mapped = nullptr; // valid while Mapped
+        int frame = -1;                  // sequence index held by the slot
+        std::vector<int> dirtyTiles;     // tiles to upload, in row-major tile order
+        size_t nextTile = 0;             // upload progress while Uploading
+    };
+
+    void workerLoop();
+    void decodeInto(Slot &slot, int frame);
+
+    std::vector<std::string> m_frames;
+    float m_fps = 0.f;
+    ImageLoader m_loader;
+    int m_width = 0, m_height = 0;
+    int m_tileSize = 64, m_tilesX = 0, m_tilesY = 0;
+    size_t m_uploadBudget = 0;
+
+    GLuint m_texture = 0;
+    std::vector<Slot> m_slots;
+    size_t m_uploadSlot = 0;  // next slot to upload, frames are consumed in ring order
+    size_t m_decodeSlot = 0;  // next slot the worker fills
+    int m_nextFrame = 1;      // next frame the worker decodes
+    long long m_framesShown = 1; // frames uploaded so far, the first one by init()
+
+    // worker state, guarded by m_mutex
+    std::vector<unsigned char> m_previous; // last decoded frame, to find changed tiles
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop = false;
+};
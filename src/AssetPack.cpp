@@ -0,0 +1,146 @@
+// AssetPack.cpp
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+const char kMagic[4] = { 'S', 'S', 'P', 'K' };
+
+} // namespace
+
+bool AssetPack::open(const std::string &path) {
+    m_entries = nullptr;
+    m_entryCount = 0;
+    m_path = path;
+    if(!m_file.open(path))
+        return false;
+
+    Header header;
+    if(m_file.size() < sizeof(Header)) {
+        m_file.close();
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(Header));
+    if(std::memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion ||
+       sizeof(Header) + size_t(header.entryCount) * sizeof(Entry) > m_file.size()) {
+        std::cerr << "ERROR: " << path << " is not a valid asset pack" << std::endl;
+        m_file.close();
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const Entry *>(m_file.data() + sizeof(Header));
+    m_entryCount = header.entryCount;
+    const uint64_t fileSize = m_file.size();
+    for(uint32_t i = 0; i < m_entryCount; ++i) {
+        // not offset + size, which a corrupt entry can wrap around
+        if(m_entries[i].offset > fileSize || m_entries[i].size > fileSize - m_entries[i].offset) {
+            std::cerr << "ERROR: " << path << " is truncated" << std::endl;
+            m_file.close();
+            m_entries = nullptr;
+            m_entryCount = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+AssetSpan AssetPack::find(const std::string &name) const {
+    // entries are sorted by name by the writer
+    const Entry *end = m_entries + m_entryCount;
+    const Entry *it = std::lower_bound(m_entries, end, name, [](const Entry &e, const std::string &n) {
+        return std::strncmp(e.name, n.c_str(), sizeof(e.name)) < 0;
+    });
+    if(it == end || std::strncmp(it->name, name.c_str(), sizeof(it->name)) != 0)
+        return AssetSpan();
+    return AssetSpan(m_file.data() + it->offset, size_t(it->size));
+}
+
+bool AssetPack::write(const std::string &path, std::vector<std::pair<std::string, std::vector<unsigned char>>> assets) {
+    std::sort(assets.begin(), assets.end(), [](const std::pair<std::string, std::vector<unsigned char>> &a,
+                                               const std::pair<std::string, std::vector<unsigned char>> &b) {
+        return a.first < b.first;
+    });
+
+    Header header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.entryCount = uint32_t(assets.size());
+    header.reserved = 0;
+
+    std::vector<Entry> entries(assets.size());
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(Entry);
+    for(size_t i = 0; i < assets.size(); ++i) {
+        if(assets[i].first.size() > kMaxNameLength) {
+            std::cerr << "ERROR: asset name too long: " << assets[i].first << std::endl;
+            return false;
+        }
+        offset = (offset + kAlignment - 1) / kAlignment * kAlignment;
+        std::memset(entries[i].name, 0, sizeof(entries[i].name));
+        std::memcpy(entries[i].name, assets[i].first.c_str(), assets[i].first.size());
+        entries[i].offset = offset;
+        entries[i].size = assets[i].second.size();
+        offset += assets[i].second.size();
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        std::cerr << "ERROR: Could not write " << path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+    uint64_t written = sizeof(Header) + entries.size() * sizeof(Entry);
+    const char zeros[kAlignment] = {};
+    for(size_t i = 0; i < assets.size(); ++i) {
+        out.write(zeros, std::streamsize(entries[i].offset - written));
+        out.write(reinterpret_cast<const char *>(assets[i].second.data()), std::streamsize(assets[i].second.size()));
+        written = entries[i].offset + entries[i].size;
+    }
+    return bool(out);
+}
+
+std::string AssetPack::executableDirectory(const char *argv0) {
+    std::string exe;
+#if defined(_WIN32)
+    char buffer[MAX_PATH];
+    const DWORD n = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+    if(n > 0 && n < MAX_PATH)
+        exe.assign(buffer, n);
+#elif defined(__APPLE__)
+    char buffer[4096];
+    uint32_t size = sizeof(buffer);
+    if(_NSGetExecutablePath(buffer, &size) == 0)
+        exe = buffer;
+#elif defined(__linux__)
+    char buffer[4096];
+    const ssize_t n = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+    if(n > 0)
+        exe.assign(buffer, size_t(n));
+#endif
+    if(exe.empty() && argv0)
+        exe = argv0;
+
+    const size_t slash = exe.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : exe.substr(0, slash + 1);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Non-owning view over bytes of an asset, usually pointing straight into the
+// mapped pack file.
+struct AssetSpan {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    AssetSpan() = default;
+    AssetSpan(const unsigned char *d, size_t s) : data(d), size(s) {}
+    inline bool empty() const { return size == 0; }
+};
+
+// Single-file asset pack: a header, an index table sorted by name, then the
+// blobs, each aligned to kAlignment bytes. The file is mapped once at startup
+// and every lookup hands out a span into the mapping.
+//
+// Layout (little endian):
+//   Header  { char magic[4] = "SSPK"; uint32 version; uint32 entryCount; uint32 reserved; }
+//   Entry   { char name[48]; uint64 offset; uint64 size; } x entryCount
+//   blobs
+class AssetPack {
+public:
+    static const uint32_t kVersion = 1;
+    static const size_t kAlignment = 64;
+    static const size_t kMaxNameLength = 47;
+
+    bool open(const std::string &path);
+    inline bool isOpen() const { return m_file.isOpen(); }
+    inline const std::string &path() const { return m_path; }
+
+    // Empty span if the pack is closed or has no such entry.
+    AssetSpan find(const std::string &name) const;
+
+    // Writes a pack from (name, bytes) pairs; used by the packAssets tool.
+    static bool write(const std::string &path, std::vector<std::pair<std::string, std::vector<unsigned char>>> assets);
+
+    // Directory holding the running executable (with a trailing separator),
+    // so the pack is found whatever the working directory is.
+    static std::string executableDirectory(const char *argv0);
+
+private:
+    struct Entry {
+        char name[48];
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    MappedFile m_file;
+    std::string m_path;
+    const Entry *m_entries = nullptr;
+    uint32_t m_entryCount = 0;
+};
@@ -0,0 +1,321 @@
+// BarnesHut.cpp
+#include "BarnesHut.hpp"
+#include "GravityKernels.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+const int kBitsPerAxis = 21;        // 63 bit keys
+const size_t kLeafSize = 16;        // bodies below which a cell is not split
+const int kSplitLevel = 2;          // subtrees under the 64 level 2 cells are built in parallel
+const size_t kGroupSize = 64;       // bodies sharing one tree walk in accelerations()
+const size_t kGroupsPerTask = 16;   // target groups handed to one task
+
+// spreads the low 21 bits of v two bits apart
+inline uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+// octant of a key at a tree level, level 0 being the root's children
+inline int digitAt(uint64_t key, int level) {
+    return int(key >> (3 * (kBitsPerAxis - 1 - level))) & 7;
+}
+
+} // namespace
+
+void BarnesHut::build(const float *x, const float *y, const float *z, const float *mu, size_t n) {
+    m_nodes.clear();
+    m_keys.resize(n);
+    m_order.resize(n);
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    m_mu.resize(n);
+    if(n == 0)
+        return;
+
+    // bounding cube
+    float lo[3] = { x[0], y[0], z[0] }, hi[3] = { x[0], y[0], z[0] };
+    for(size_t i = 1; i < n; ++i) {
+        lo[0] = std::min(lo[0], x[i]); hi[0] = std::max(hi[0], x[i]);
+        lo[1] = std::min(lo[1], y[i]); hi[1] = std::max(hi[1], y[i]);
+        lo[2] = std::min(lo[2], z[i]); hi[2] = std::max(hi[2], z[i]);
+    }
+    m_rootWidth = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), std::max(hi[2] - lo[2], 1e-6f)) * 1.0001f;
+    const float scale = float(1 << kBitsPerAxis) / m_rootWidth;
+
+    // keys, then a parallel sort: chunks sorted in parallel, merged pairwise level by level
+    std::vector<std::pair<uint64_t, uint32_t> > sorted(n);
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        const uint64_t cx = std::min<uint64_t>(uint64_t((x[i] - lo[0]) * scale), (1 << kBitsPerAxis) - 1);
+        const uint64_t cy = std::min<uint64_t>(uint64_t((y[i] - lo[1]) * scale), (1 << kBitsPerAxis) - 1);
+        const uint64_t cz = std::min<uint64_t>(uint64_t((z[i] - lo[2]) * scale), (1 << kBitsPerAxis) - 1);
+        sorted[i] = std::make_pair(spreadBits(cx) << 2 | spreadBits(cy) << 1 | spreadBits(cz), uint32_t(i));
+    }, "barnesHut.keys", 1024);
+    const size_t chunks = std::min<size_t>(Parallel::workerCount(), (n + 4095) / 4096);
+    const size_t chunk = (n + chunks - 1) / chunks;
+    Parallel::parallelFor(0, chunks, [&](size_t c) {
+        std::sort(sorted.begin() + std::min(n, c * chunk), sorted.begin() + std::min(n, (c + 1) * chunk));
+    }, "barnesHut.sort");
+    for(size_t width = chunk; width < n; width *= 2) {
+        Parallel::parallelFor(0, (n + 2 * width - 1) / (2 * width), [&](size_t m) {
+            const size_t b = m * 2 * width, mid = std::min(n, b + width), e = std::min(n, b + 2 * width);
+            std::inplace_merge(sorted.begin() + b, sorted.begin() + mid, sorted.begin() + e);
+        }, "barnesHut.merge");
+    }
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        const uint32_t src = sorted[i].second;
+        m_keys[i] = sorted[i].first;
+        m_order[i] = src;
+        m_x[i] = x[src];
+        m_y[i] = y[src];
+        m_z[i] = z[src];
+        m_mu[i] = mu[src];
+    }, "barnesHut.gather", 1024);
+
+    // subtrees of the split level cells in parallel, then the few nodes above them
+    std::vector<Range> groups;
+    for(size_t b = 0; b < n;) {
+        const uint64_t prefix = m_keys[b] >> (3 * (kBitsPerAxis - kSplitLevel));
+        size_t e = b + 1;
+        while(e < n && (m_keys[e] >> (3 * (kBitsPerAxis - kSplitLevel))) == prefix)
+            ++e;
+        Range r = { b, e };
+        groups.push_back(r);
+        b = e;
+    }
+    std::vector<std::vector<Node> > subtrees(groups.size());
+    Parallel::parallelFor(0, groups.size(), [&](size_t g) {
+        buildSubtree(subtrees[g], groups[g].begin, groups[g].end, kSplitLevel);
+    }, "barnesHut.subtrees");
+    m_nodes.reserve(n / kLeafSize * 2 + 64);
+    buildTop(0, n, 0, groups, subtrees);
+}
+
+void BarnesHut::makeLeaf(Node &node, size_t begin, size_t end) const {
+    double m = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for(size_t i = begin; i < end; ++i) {
+        m += m_mu[i];
+        cx += double(m_mu[i]) * m_x[i];
+        cy += double(m_mu[i]) * m_y[i];
+        cz += double(m_mu[i]) * m_z[i];
+    }
+    if(m > 0.0) {
+        cx /= m; cy /= m; cz /= m;
+    } else { // massless bodies: any point of the cell does
+        cx = m_x[begin]; cy = m_y[begin]; cz = m_z[begin];
+    }
+    double q[6] = { 0, 0, 0, 0, 0, 0 };
+    for(size_t i = begin; i < end; ++i) {
+        const double dx = m_x[i] - cx, dy = m_y[i] - cy, dz = m_z[i] - cz, r2 = dx * dx + dy * dy + dz * dz;
+        q[0] += m_mu[i] * (3 * dx * dx - r2);
+        q[1] += m_mu[i] * (3 * dy * dy - r2);
+        q[2] += m_mu[i] * (3 * dz * dz - r2);
+        q[3] += m_mu[i] * 3 * dx * dy;
+        q[4] += m_mu[i] * 3 * dx * dz;
+        q[5] += m_mu[i] * 3 * dy * dz;
+    }
+    node.comX = float(cx); node.comY = float(cy); node.comZ = float(cz);
+    node.mass = float(m);
+    node.qxx = float(q[0]); node.qyy = float(q[1]); node.qzz = float(q[2]);
+    node.qxy = float(q[3]); node.qxz = float(q[4]); node.qyz = float(q[5]);
+    node.first = int32_t(begin);
+    node.count = int32_t(end - begin);
+    node.leaf = 1;
+}
+
+// Moments of an internal node from its children, which directly follow it.
+void BarnesHut::finishNode(std::vector<Node> &nodes, size_t index) {
+    Node &node = nodes[index];
+    double m = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for(size_t c = index + 1; c < size_t(node.skip); c = size_t(nodes[c].skip)) {
+        m += nodes[c].mass;
+        cx += double(nodes[c].mass) * nodes[c].comX;
+        cy += double(nodes[c].mass) * nodes[c].comY;
+        cz += double(nodes[c].mass) * nodes[c].comZ;
+    }
+    if(m > 0.0) {
+        cx /= m; cy /= m; cz /= m;
+    } else {
+        cx = nodes[index + 1].comX; cy = nodes[index + 1].comY; cz = nodes[index + 1].comZ;
+    }
+    // parallel axis theorem for the quadrupoles of the children
+    double q[6] = { 0, 0, 0, 0, 0, 0 };
+    for(size_t c = index + 1; c < size_t(node.skip); c = size_t(nodes[c].skip)) {
+        const Node &child = nodes[c];
+        const double dx = child.comX - cx, dy = child.comY - cy, dz = child.comZ - cz, r2 = dx * dx + dy * dy + dz * dz;
+        q[0] += child.qxx + child.mass * (3 * dx * dx - r2);
+        q[1] += child.qyy + child.mass * (3 * dy * dy - r2);
+        q[2] += child.qzz + child.mass * (3 * dz * dz - r2);
+        q[3] += child.qxy + child.mass * 3 * dx * dy;
+        q[4] += child.qxz + child.mass * 3 * dx * dz;
+        q[5] += child.qyz + child.mass * 3 * dy * dz;
+    }
+    node.comX = float(cx); node.comY = float(cy); node.comZ = float(cz);
+    node.mass = float(m);
+    node.qxx = float(q[0]); node.qyy = float(q[1]); node.qzz = float(q[2]);
+    node.qxy = float(q[3]); node.qxz = float(q[4]); node.qyz = float(q[5]);
+    node.leaf = 0;
+}
+
+void BarnesHut::buildSubtree(std::vector<Node> &nodes, size_t begin, size_t end, int level) const {
+    const size_t index = nodes.size();
+    nodes.push_back(Node());
+    nodes[index].width = m_rootWidth / float(1 << level);
+    if(end - begin <= kLeafSize || level >= kBitsPerAxis) {
+        makeLeaf(nodes[index], begin, end);
+        nodes[index].skip = int32_t(nodes.size());
+        return;
+    }
+    for(size_t b = begin; b < end;) {
+        const int digit = digitAt(m_keys[b], level);
+        size_t e = b + 1;
+        while(e < end && digitAt(m_keys[e], level) == digit)
+            ++e;
+        buildSubtree(nodes, b, e, level + 1);
+        b = e;
+    }
+    nodes[index].first = int32_t(begin);
+    nodes[index].count = int32_t(end - begin);
+    nodes[index].skip = int32_t(nodes.size());
+    finishNode(nodes, index);
+}
+
+void BarnesHut::buildTop(size_t begin, size_t end, int level, const std::vector<Range> &groups,
+                         const std::vector<std::vector<Node> > &subtrees) {
+    if(level == kSplitLevel || end - begin <= kLeafSize) {
+        if(level < kSplitLevel) { // small enough to be a leaf above the split level
+            buildSubtree(m_nodes, begin, end, level);
+            return;
+        }
+        // splice the prebuilt subtree, its links are relative to its own start
+        const size_t g = size_t(std::lower_bound(groups.begin(), groups.end(), begin,
+            [](const Range &r, size_t b) { return r.begin < b; }) - groups.begin());
+        const int32_t offset = int32_t(m_nodes.size());
+        for(size_t i = 0; i < subtrees[g].size(); ++i) {
+            m_nodes.push_back(subtrees[g][i]);
+            m_nodes.back().skip += offset;
+        }
+        return;
+    }
+    const size_t index = m_nodes.size();
+    m_nodes.push_back(Node());
+    m_nodes[index].width = m_rootWidth / float(1 << level);
+    for(size_t b = begin; b < end;) {
+        const int digit = digitAt(m_keys[b], level);
+        size_t e = b + 1;
+        while(e < end && digitAt(m_keys[e], level) == digit)
+            ++e;
+        buildTop(b, e, level + 1, groups, subtrees);
+        b = e;
+    }
+    m_nodes[index].first = int32_t(begin);
+    m_nodes[index].count = int32_t(end - begin);
+    m_nodes[index].skip = int32_t(m_nodes.size());
+    finishNode(m_nodes, index);
+}
+
+uint64_t BarnesHut::accelerations(float theta, float softening2, float *ax, float *ay, float *az) const {
+    // target groups: the largest subtrees with at most kGroupSize bodies
+    std::vector<int32_t> groups;
+    for(size_t i = 0; i < m_nodes.size();) {
+        if(size_t(m_nodes[i].count) <= kGroupSize || m_nodes[i].leaf) {
+            groups.push_back(int32_t(i));
+            i = size_t(m_nodes[i].skip);
+        } else {
+            ++i;
+        }
+    }
+
+    const float theta2 = theta * theta;
+    const Node *nodes = m_nodes.data();
+    const int32_t nodeCount = int32_t(m_nodes.size());
+    std::atomic<uint64_t> interactions(0);
+
+    // The bodies of a group share one walk: a node is far enough for all of
+    // them when w < theta (d - r), r bounding the group around its centre.
+    // The walk only gathers interaction lists, evaluated by the SIMD kernels.
+    Parallel::parallelFor(0, (groups.size() + kGroupsPerTask - 1) / kGroupsPerTask, [&](size_t task) {
+        std::vector<float> bx, by, bz, bm;
+        std::vector<float> nx, ny, nz, nm, qxx, qyy, qzz, qxy, qxz, qyz;
+        float tx[kGroupSize], ty[kGroupSize], tz[kGroupSize], sx[kGroupSize], sy[kGroupSize], sz[kGroupSize];
+        uint64_t count = 0;
+        for(size_t g = task * kGroupsPerTask; g < std::min(groups.size(), (task + 1) * kGroupsPerTask); ++g) {
+            const Node &group = nodes[groups[g]];
+            float lo[3] = { m_x[group.first], m_y[group.first], m_z[group.first] };
+            float hi[3] = { lo[0], lo[1], lo[2] };
+            for(int32_t j = group.first; j < group.first + group.count; ++j) {
+                lo[0] = std::min(lo[0], m_x[j]); hi[0] = std::max(hi[0], m_x[j]);
+                lo[1] = std::min(lo[1], m_y[j]); hi[1] = std::max(hi[1], m_y[j]);
+                lo[2] = std::min(lo[2], m_z[j]); hi[2] = std::max(hi[2], m_z[j]);
+            }
+            const float cx = 0.5f * (lo[0] + hi[0]), cy = 0.5f * (lo[1] + hi[1]), cz = 0.5f * (lo[2] + hi[2]);
+            const float radius = 0.5f * std::sqrt((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1])
+                                                  + (hi[2] - lo[2]) * (hi[2] - lo[2]));
+
+            bx.clear(); by.clear(); bz.clear(); bm.clear();
+            nx.clear(); ny.clear(); nz.clear(); nm.clear();
+            qxx.clear(); qyy.clear(); qzz.clear(); qxy.clear(); qxz.clear(); qyz.clear();
+            for(int32_t i = 0; i < nodeCount;) {
+                const Node &node = nodes[i];
+                const float dx = node.comX - cx, dy = node.comY - cy, dz = node.comZ - cz;
+                const float d = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+                if(d > 0.f && node.width * node.width < theta2 * d * d) {
+                    nx.push_back(node.comX); ny.push_back(node.comY); nz.push_back(node.comZ); nm.push_back(node.mass);
+                    qxx.push_back(node.qxx); qyy.push_back(node.qyy); qzz.push_back(node.qzz);
+                    qxy.push_back(node.qxy); qxz.push_back(node.qxz); qyz.push_back(node.qyz);
+                    i = node.skip;
+                } else if(node.leaf) {
+                    // the group's own leaves land here too, a body gets nothing from itself
+                    bx.insert(bx.end(), m_x.begin() + node.first, m_x.begin() + node.first + node.count);
+                    by.insert(by.end(), m_y.begin() + node.first, m_y.begin() + node.first + node.count);
+                    bz.insert(bz.end(), m_z.begin() + node.first, m_z.begin() + node.first + node.count);
+                    bm.insert(bm.end(), m_mu.begin() + node.first, m_mu.begin() + node.first + node.count);
+                    i = node.skip;
+                } else {
+                    ++i; // open it: the first child follows
+                }
+            }
+            const GravityKernels::Multipoles multipoles = {
+                nx.data(), ny.data(), nz.data(), nm.data(),
+                qxx.data(), qyy.data(), qzz.data(), qxy.data(), qxz.data(), qyz.data(), nx.size()
+            };
+
+            // kGroupSize targets at a time (a leaf of coincident bodies can hold more)
+            for(int32_t begin = group.first; begin < group.first + group.count; begin += int32_t(kGroupSize)) {
+                const size_t targets = std::min<size_t>(kGroupSize, size_t(group.first + group.count - begin));
+                const size_t padded = (targets + GravityKernels::kTargetPadding - 1) / GravityKernels::kTargetPadding
+                                      * GravityKernels::kTargetPadding;
+                for(size_t j = 0; j < padded; ++j) {
+                    const size_t b = begin + std::min(j, targets - 1); // padding repeats the last body
+                    tx[j] = m_x[b]; ty[j] = m_y[b]; tz[j] = m_z[b];
+                    sx[j] = sy[j] = sz[j] = 0.f;
+                }
+                GravityKernels::accumulateBodies(tx, ty, tz, padded, bx.data(), by.data(), bz.data(), bm.data(), bx.size(),
+                                                 softening2, sx, sy, sz);
+                if(multipoles.count)
+                    GravityKernels::accumulateMultipoles(tx, ty, tz, padded, multipoles, softening2, sx, sy, sz);
+                for(size_t j = 0; j < targets; ++j) {
+                    const uint32_t dst = m_order[begin + j];
+                    ax[dst] = sx[j];
+                    ay[dst] = sy[j];
+                    az[dst] = sz[j];
+                }
+            }
+            count += uint64_t(group.count) * (bx.size() + nx.size());
+        }
+        interactions += count;
+    }, "barnesHut.walk");
+    return interactions;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Barnes-Hut gravity for large N (asteroid belts, debris fields).
+//
+// build() sorts the bodies along a Morton curve (keys and sorting done in
+// parallel) and cuts the sorted range into an octree whose nodes are laid out
+// depth-first, one cache line each, with the index just past their subtree:
+// a tree walk is then a forward scan that skips whole subtrees. Subtrees
+// below the first two levels are built in parallel and spliced together.
+//
+// Every node carries its mass, centre of mass and traceless quadrupole
+// moment. accelerations() walks the tree once per group of up to 64 nearby
+// bodies (groups in parallel, in Morton order so neighbouring walks touch the
+// same nodes) and uses a node's multipole expansion when its width w and
+// distance d satisfy w < theta * d for every body of the group, its bodies
+// one by one otherwise; the resulting lists go through the SIMD GravityKernels.
+class BarnesHut {
+public:
+    void build(const float *x, const float *y, const float *z, const float *mu, size_t n);
+
+    // Writes the acceleration of each body of the last build(), in its original order.
+    // Returns the number of body-body and body-node interactions evaluated.
+    uint64_t accelerations(float theta, float softening2, float *ax, float *ay, float *az) const;
+
+    inline size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+    struct Node { // 64 bytes, a cache line
+        float comX, comY, comZ, mass;
+        float width;        // edge of the cubic cell
+        int32_t skip;       // next node once this subtree is done
+        int32_t first, count; // bodies of the subtree in Morton order
+        float qxx, qyy, qzz, qxy, qxz, qyz; // traceless quadrupole around the centre of mass
+        int32_t leaf;
+        float pad;
+    };
+
+    struct Range {
+        size_t begin, end;
+    };
+
+    void buildSubtree(std::vector<Node> &nodes, size_t begin, size_t end, int level) const;
+    void buildTop(size_t begin, size_t end, int level, const std::vector<Range> &groups,
+                  const std::vector<std::vector<Node> > &subtrees);
+    static void finishNode(std::vector<Node> &nodes, size_t index);
+    void makeLeaf(Node &node, size_t begin, size_t end) const;
+
+    float m_rootWidth = 0.f;
+    std::vector<uint64_t> m_keys;   // sorted Morton keys
+    std::vector<uint32_t> m_order;  // sorted position -> original body
+    std::vector<float> m_x, m_y, m_z, m_mu; // bodies in Morton order
+    std::vector<Node> m_nodes;
+};
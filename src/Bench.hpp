@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+// Timing for the bench executables (bench*.cpp): the best of a few runs,
+// each calling f until minSeconds went by, in seconds per call.
+namespace Bench {
+
+template <typename F>
+double seconds(F f, const double minSeconds = 0.2, const int runs = 3) {
+    double best = 1e300;
+    for(int r = 0; r < runs; ++r) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t calls = 0;
+        double elapsed = 0.0;
+        do {
+            f();
+            ++calls;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while(elapsed < minSeconds);
+        best = std::min(best, elapsed / double(calls));
+    }
+    return best;
+}
+
+// Keeps a result alive so the work computing it isn't optimized out: an empty
+// asm the compiler must assume reads it, a volatile store elsewhere.
+template <typename T>
+inline void keep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+    (void)sink;
+#endif
+}
+
+} // namespace Bench
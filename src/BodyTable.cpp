@@ -0,0 +1,438 @@
+// BodyTable.cpp
+#include "BodyTable.hpp"
+#include "Ephemeris.hpp"
+#include "Kepler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <sstream>
+
+#include <glm/ext.hpp>
+
+#include "AffineKernels.hpp"
+#include "CpuFeatures.hpp"
+#include "Parallel.hpp"
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct BodyRow {
+    std::string name, parent, texture;
+    float radius, eccentricity, inclinationDeg, nodeDeg, periapsisDeg, meanAnomalyDeg;
+    double semiMajorAxis, meanMotion;
+    float spinSpeed, tiltDeg, mu;
+    glm::vec3 color;
+    int emissive;
+};
+
+const double kTwoPi = 6.283185307179586;
+
+// bodies per job when composing the model transforms
+const size_t kTransformBlock = 1024;
+// all of them are composed in one batch once more than 1 / kRecomposeRatio changed
+const size_t kRecomposeRatio = 4;
+
+// out[i] = float(v[i] - origin): the subtraction in double, then the narrowing
+void relativeScalar(const double *v, const double origin, const size_t n, float *out) {
+    for(size_t i = 0; i < n; ++i)
+        out[i] = float(v[i] - origin);
+}
+
+#ifdef SOLAR_X86
+// SSE2 is the x86-64 baseline
+void relativeSse(const double *v, const double origin, const size_t n, float *out) {
+    const __m128d o = _mm_set1_pd(origin);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const __m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v + i), o));
+        const __m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v + i + 2), o));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+    relativeScalar(v + i, origin, n - i, out + i);
+}
+
+SOLAR_TARGET("avx2")
+void relativeAvx2(const double *v, const double origin, const size_t n, float *out) {
+    const __m256d o = _mm256_set1_pd(origin);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(v + i), o));
+        const __m128 hi = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(v + i + 4), o));
+        _mm256_storeu_ps(out + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+    }
+    relativeSse(v + i, origin, n - i, out + i);
+}
+#endif // SOLAR_X86
+
+struct KernelTable {
+    void (*relative)(const double *, double, size_t, float *);
+    SimdLevel level;
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_X86
+    const SimdLevel level = CpuFeatures::get().level();
+    if(level >= SimdLevel::AVX2) {
+        const KernelTable t = { relativeAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+    const KernelTable t = { relativeSse, SimdLevel::SSE };
+    return t;
+#else
+    const KernelTable t = { relativeScalar, SimdLevel::Scalar };
+    return t;
+#endif
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+// scene names are lowercase, Horizons ones capitalized
+bool sameName(const std::string &a, const char *b) {
+    size_t i = 0;
+    for(; i < a.size() && b[i]; ++i)
+        if(std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+            return false;
+    return i == a.size() && !b[i];
+}
+
+} // namespace
+
+void BodyTable::resize(size_t n) {
+    name.resize(n);
+    parent.resize(n);
+    semiMajorAxis.resize(n);
+    semiMinorAxis.resize(n);
+    eccentricity.resize(n);
+    meanAnomalyAtEpoch.resize(n);
+    meanMotion.resize(n);
+    periX.resize(n);
+    periY.resize(n);
+    periZ.resize(n);
+    aheadX.resize(n);
+    aheadY.resize(n);
+    aheadZ.resize(n);
+    spinSpeed.resize(n);
+    spinAxisX.resize(n);
+    spinAxisY.resize(n);
+    spinAxisZ.resize(n);
+    radius.resize(n);
+    mu.resize(n);
+    material.resize(n);
+    ephemerisBody.assign(n, -1);
+    ephemerisScale.assign(n, 1.f);
+    m_ephemerisCount = 0;
+    posX.resize(n);
+    posY.resize(n);
+    posZ.resize(n);
+    relX.resize(n);
+    relY.resize(n);
+    relZ.resize(n);
+    spinQX.assign(n, 0.f);
+    spinQY.assign(n, 0.f);
+    spinQZ.assign(n, 0.f);
+    spinQW.assign(n, 1.f);
+    model.resize(n);
+}
+
+bool BodyTable::loadFromText(const char *text, size_t size, std::string &error) {
+    std::vector<BodyRow> rows;
+    std::map<std::string, size_t> rowIndex;
+    std::istringstream in(std::string(text, size));
+    std::string line;
+    for(int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        const size_t comment = line.find('#');
+        if(comment != std::string::npos)
+            line.erase(comment);
+        std::istringstream tokens(line);
+        std::string token, normalized;
+        int fieldCount = 0;
+        for(; tokens >> token; ++fieldCount)
+            normalized += token + ' ';
+        if(fieldCount == 0)
+            continue; // blank line
+
+        std::istringstream fields(normalized);
+        BodyRow r;
+        r.mu = 0.f;
+        bool ok = false;
+        if(fieldCount == 13) {
+            // the older circular format: orbitRadius orbitSpeed orbitPhase (rad)
+            float phase = 0.f;
+            ok = bool(fields >> r.name >> r.parent >> r.radius >> r.semiMajorAxis >> r.meanMotion >> phase >> r.spinSpeed
+                             >> r.tiltDeg >> r.texture >> r.color.r >> r.color.g >> r.color.b >> r.emissive);
+            r.eccentricity = r.inclinationDeg = r.nodeDeg = r.periapsisDeg = 0.f;
+            r.meanAnomalyDeg = glm::degrees(phase);
+        } else if(fieldCount == 17 || fieldCount == 18) {
+            ok = bool(fields >> r.name >> r.parent >> r.radius >> r.semiMajorAxis >> r.eccentricity >> r.inclinationDeg
+                             >> r.nodeDeg >> r.periapsisDeg >> r.meanAnomalyDeg >> r.meanMotion >> r.spinSpeed
+                             >> r.tiltDeg >> r.texture >> r.color.r >> r.color.g >> r.color.b >> r.emissive);
+            if(ok && fieldCount == 18)
+                ok = bool(fields >> r.mu);
+        }
+        if(!ok) {
+            error = "line " + std::to_string(lineNumber) + ": expected 18 fields (17 for a massless body, 13 for a circular orbit)";
+            return false;
+        }
+        if(r.eccentricity < 0.f || r.eccentricity >= 1.f) {
+            error = "line " + std::to_string(lineNumber) + ": eccentricity must be in [0, 1)";
+            return false;
+        }
+        if(rowIndex.count(r.name)) {
+            error = "line " + std::to_string(lineNumber) + ": duplicate body " + r.name;
+            return false;
+        }
+        rowIndex[r.name] = rows.size();
+        rows.push_back(r);
+    }
+
+    // order the rows so that parents precede children (iterative DFS from each row up to its root)
+    std::vector<int> parentRow(rows.size(), -1);
+    for(size_t i = 0; i < rows.size(); ++i) {
+        if(rows[i].parent == "-")
+            continue;
+        std::map<std::string, size_t>::const_iterator it = rowIndex.find(rows[i].parent);
+        if(it == rowIndex.end()) {
+            error = "unknown parent " + rows[i].parent + " of " + rows[i].name;
+            return false;
+        }
+        parentRow[i] = int(it->second);
+    }
+    std::vector<int> order;
+    order.reserve(rows.size());
+    std::vector<char> state(rows.size(), 0); // 0 unvisited, 1 on the current chain, 2 placed
+    for(size_t i = 0; i < rows.size(); ++i) {
+        std::vector<int> chain;
+        for(int r = int(i); r >= 0 && state[r] != 2; r = parentRow[r]) {
+            if(state[r] == 1) {
+                error = "parent cycle through " + rows[r].name;
+                return false;
+            }
+            state[r] = 1;
+            chain.push_back(r);
+        }
+        for(size_t c = chain.size(); c-- > 0;) {
+            state[chain[c]] = 2;
+            order.push_back(chain[c]);
+        }
+    }
+
+    std::vector<int> newIndex(rows.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        newIndex[order[i]] = int(i);
+
+    resize(rows.size());
+    materials.clear();
+    std::map<std::string, int> materialIndex;
+    for(size_t i = 0; i < order.size(); ++i) {
+        const BodyRow &r = rows[order[i]];
+        name[i] = r.name;
+        parent[i] = parentRow[order[i]] < 0 ? -1 : newIndex[parentRow[order[i]]];
+        radius[i] = r.radius;
+        mu[i] = r.mu;
+        semiMajorAxis[i] = r.semiMajorAxis;
+        eccentricity[i] = r.eccentricity;
+        semiMinorAxis[i] = r.semiMajorAxis * std::sqrt(1.0 - double(r.eccentricity) * r.eccentricity);
+        meanAnomalyAtEpoch[i] = glm::radians(double(r.meanAnomalyDeg));
+        meanMotion[i] = r.meanMotion;
+        double p[3], q[3];
+        Kepler::perifocalBasis(glm::radians(double(r.inclinationDeg)), glm::radians(double(r.nodeDeg)),
+                               glm::radians(double(r.periapsisDeg)), p, q);
+        periX[i] = p[0];
+        periY[i] = p[1];
+        periZ[i] = p[2];
+        aheadX[i] = q[0];
+        aheadY[i] = q[1];
+        aheadZ[i] = q[2];
+        spinSpeed[i] = r.spinSpeed;
+        const float tilt = glm::radians(r.tiltDeg);
+        spinAxisX[i] = std::sin(tilt);
+        spinAxisY[i] = std::cos(tilt);
+        spinAxisZ[i] = 0.f;
+
+        // bodies that look the same share a material
+        std::ostringstream key;
+        key << r.texture << ' ' << r.color.r << ' ' << r.color.g << ' ' << r.color.b << ' ' << r.emissive;
+        std::map<std::string, int>::const_iterator it = materialIndex.find(key.str());
+        if(it == materialIndex.end()) {
+            BodyMaterial m;
+            m.texture = r.texture == "-" ? std::string() : r.texture;
+            m.color = r.color;
+            m.emissive = r.emissive != 0;
+            it = materialIndex.insert(std::make_pair(key.str(), int(materials.size()))).first;
+            materials.push_back(m);
+        }
+        material[i] = it->second;
+    }
+    buildTransforms();
+    return true;
+}
+
+void BodyTable::buildTransforms() {
+    transforms.clear();
+    for(size_t i = 0; i < size(); ++i)
+        transforms.add(parent[i]);
+    m_transformTime = -1.0;
+    m_composed = false;
+}
+
+size_t BodyTable::useEphemeris(const Ephemeris *ephemeris, const double epoch, const double daysPerSecond) {
+    m_ephemeris = ephemeris;
+    m_ephemerisEpoch = epoch;
+    m_daysPerSecond = daysPerSecond;
+    m_ephemerisCount = 0;
+    for(size_t i = 0; i < size(); ++i) {
+        ephemerisBody[i] = -1;
+        const int e = ephemeris && parent[i] >= 0 ? ephemeris->find(name[i]) : -1;
+        if(e < 0 || !sameName(name[parent[i]], ephemeris->center(e)) || !(ephemeris->meanDistance(e) > 0.0))
+            continue;
+        ephemerisBody[i] = e;
+        ephemerisScale[i] = float(semiMajorAxis[i] / ephemeris->meanDistance(e));
+        ++m_ephemerisCount;
+    }
+    return m_ephemerisCount;
+}
+
+void BodyTable::offsets(const double timeInSec, double *x, double *y, double *z) const {
+    const size_t n = size();
+
+    // orbit offsets relative to the parent: independent per body, solved in batches
+    if(m_ephemerisCount < n) {
+        const Kepler::OrbitArrays orbits = {
+            meanAnomalyAtEpoch.data(), meanMotion.data(), eccentricity.data(), semiMajorAxis.data(), semiMinorAxis.data(),
+            periX.data(), periY.data(), periZ.data(), aheadX.data(), aheadY.data(), aheadZ.data()
+        };
+        Kepler::propagate(orbits, n, timeInSec, x, y, z);
+    }
+    if(m_ephemerisCount == 0)
+        return;
+
+    // tabulated bodies: ecliptic (X, Y, Z north) to scene (x, y up, z) is (X, Z, Y)
+    const double t = m_ephemerisEpoch + timeInSec * m_daysPerSecond;
+    for(size_t i = 0; i < n; ++i) {
+        if(ephemerisBody[i] < 0)
+            continue;
+        double ex, ey, ez;
+        m_ephemeris->position(ephemerisBody[i], t, ex, ey, ez);
+        x[i] = ex * ephemerisScale[i];
+        y[i] = ez * ephemerisScale[i];
+        z[i] = ey * ephemerisScale[i];
+    }
+}
+
+void BodyTable::state(const int body, const double timeInSec, double position[3], double velocity[3]) const {
+    const size_t i = size_t(body);
+    if(ephemerisBody[i] >= 0) {
+        // central difference over a millisecond of scene time
+        const double h = 1e-3, scale = ephemerisScale[i];
+        const double t = m_ephemerisEpoch + timeInSec * m_daysPerSecond, dt = h * m_daysPerSecond;
+        double e[3], before[3], after[3];
+        m_ephemeris->position(ephemerisBody[i], t, e[0], e[1], e[2]);
+        m_ephemeris->position(ephemerisBody[i], t - dt, before[0], before[1], before[2]);
+        m_ephemeris->position(ephemerisBody[i], t + dt, after[0], after[1], after[2]);
+        const int scene[3] = { 0, 2, 1 }; // ecliptic (X, Y, Z north) to scene (x, y up, z)
+        for(int a = 0; a < 3; ++a) {
+            position[a] = e[scene[a]] * scale;
+            velocity[a] = (after[scene[a]] - before[scene[a]]) * scale / (2.0 * h);
+        }
+        return;
+    }
+
+    const double m = std::fmod(meanAnomalyAtEpoch[i] + meanMotion[i] * timeInSec, kTwoPi);
+    const double e = eccentricity[i], a = semiMajorAxis[i];
+    const double E = Kepler::reference::solve(m, e);
+    const double b = a * std::sqrt(1.0 - e * e);
+    const double u = a * (std::cos(E) - e), v = b * std::sin(E);
+    // dE/dt = n / (1 - e cos E)
+    const double rate = meanMotion[i] / (1.0 - e * std::cos(E));
+    const double du = -a * std::sin(E) * rate, dv = b * std::cos(E) * rate;
+    const double p[3] = { periX[i], periY[i], periZ[i] }, q[3] = { aheadX[i], aheadY[i], aheadZ[i] };
+    for(int k = 0; k < 3; ++k) {
+        position[k] = u * p[k] + v * q[k];
+        velocity[k] = du * p[k] + dv * q[k];
+    }
+}
+
+void BodyTable::update(const double timeInSec) {
+    const size_t n = size();
+    offsets(timeInSec, posX.data(), posY.data(), posZ.data());
+
+    // parents precede children: one forward pass turns offsets into positions
+    for(size_t i = 0; i < n; ++i) {
+        const int p = parent[i];
+        if(p >= 0) {
+            posX[i] += posX[p];
+            posY[i] += posY[p];
+            posZ[i] += posZ[p];
+        }
+    }
+}
+
+size_t BodyTable::updateTransforms(const double timeInSec, const glm::dvec3 &origin) {
+    const size_t n = size();
+    if(n == 0)
+        return 0;
+    // a paused clock doesn't spin, and clip playback sets the spins itself
+    const bool spin = !callerSpins && timeInSec != m_transformTime;
+    if(spin) {
+        for(size_t i = 0; i < n; ++i) {
+            // the angle wraps in double, a float product loses the spin after a few hours
+            const float half = 0.5f * float(std::fmod(double(spinSpeed[i]) * timeInSec, kTwoPi));
+            const float s = std::sin(half);
+            spinQX[i] = spinAxisX[i] * s;
+            spinQY[i] = spinAxisY[i] * s;
+            spinQZ[i] = spinAxisZ[i] * s;
+            spinQW[i] = std::cos(half);
+        }
+    }
+    m_transformTime = timeInSec;
+    const size_t moved = transforms.propagate();
+
+    // the camera moving changes every relative position, else only what moved or turned
+    bool all = !m_composed || callerSpins || origin != m_transformOrigin;
+    m_recompose.clear();
+    if(!all && spin) {
+        for(size_t i = 0; i < n; ++i)
+            if(transforms.changed(int(i)) || spinSpeed[i] != 0.f)
+                m_recompose.push_back(i);
+    } else if(!all) {
+        m_recompose.assign(transforms.changedNodes().begin(), transforms.changedNodes().end());
+    }
+    all = all || m_recompose.size() * kRecomposeRatio > n;
+    m_transformOrigin = origin;
+    m_composed = true;
+
+    // T(relative position) * R(spin) * S(radius)
+    const AffineKernels::TrsArrays trs = {
+        relX.data(), relY.data(), relZ.data(),
+        spinQX.data(), spinQY.data(), spinQZ.data(), spinQW.data(),
+        radius.data(), radius.data(), radius.data()
+    };
+    float *out = &model[0][0][0];
+    if(!all) {
+        for(size_t k = 0; k < m_recompose.size(); ++k) {
+            const size_t i = m_recompose[k];
+            relX[i] = float(transforms.worldX()[i] - origin.x);
+            relY[i] = float(transforms.worldY()[i] - origin.y);
+            relZ[i] = float(transforms.worldZ()[i] - origin.z);
+            AffineKernels::composeTrs(trs, i, i + 1, out);
+        }
+        return moved;
+    }
+
+    kernels().relative(transforms.worldX(), origin.x, n, relX.data());
+    kernels().relative(transforms.worldY(), origin.y, n, relY.data());
+    kernels().relative(transforms.worldZ(), origin.z, n, relZ.data());
+    // a job per block of bodies
+    Parallel::parallelFor(0, (n + kTransformBlock - 1) / kTransformBlock, [&](size_t block) {
+        AffineKernels::composeTrs(trs, block * kTransformBlock, std::min(n, (block + 1) * kTransformBlock), out);
+    }, "bodies.transforms");
+    return moved;
+}
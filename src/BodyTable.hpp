@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AlignedAllocator.hpp"
+#include "TransformHierarchy.hpp"
+
+class Ephemeris;
+
+// Appearance shared by any number of bodies.
+struct BodyMaterial {
+    std::string texture;     // equirectangular texture asset, empty for none
+    glm::vec3 color = glm::vec3(1.f);
+    bool emissive = false;   // lit by nothing, drawn with its flat color (the Sun)
+};
+
+// Every celestial body of the scene, stored as structure-of-arrays.
+//
+// Bodies are topologically ordered: a parent always comes before its
+// children, so update() is a single forward pass where a child reads the
+// already computed position of its parent.
+class BodyTable {
+public:
+    // Parses the whitespace separated text format of bodies.txt, one body per line:
+    //   name parent radius a e inclination node periapsis meanAnomaly meanMotion spinSpeed tiltDeg texture r g b emissive mu
+    // with "-" for "no parent" / "no texture" and '#' starting a comment. A
+    // missing mu means a massless body; rows of the older circular format
+    // (13 fields) are still accepted.
+    bool loadFromText(const char *text, size_t size, std::string &error);
+
+    // Bodies found in the ephemeris, under the same name and with their parent
+    // as center (case aside), follow it instead of their Kepler orbit: scene
+    // time t is ephemeris time epoch + t * daysPerSecond, and distances are
+    // scaled so the mean one matches the body's semi-major axis. The
+    // ephemeris must outlive the table. Returns the number of such bodies.
+    size_t useEphemeris(const Ephemeris *ephemeris, double epoch, double daysPerSecond);
+
+    // Computes the positions at the given time.
+    void update(double timeInSec);
+    // Positions relative to the parents at the given time, what update() starts from.
+    void offsets(double timeInSec, double *x, double *y, double *z) const;
+    // Position and velocity of one body relative to its parent, in double for
+    // mission analysis: Kepler orbits solved exactly, tabulated ones
+    // differentiated numerically.
+    void state(int body, double timeInSec, double position[3], double velocity[3]) const;
+    // Offset of a body from its parent for the next updateTransforms(),
+    // written straight into `transforms`: an unchanged one costs a comparison.
+    inline void setOffset(size_t body, const glm::dvec3 &offset) { transforms.setTranslation(int(body), offset); }
+    // Builds the model transforms for drawing from the offsets set above,
+    // relative to `origin` (the camera): positions are made relative in
+    // double and converted to float in one SIMD pass, so floats only ever
+    // hold small numbers near the viewer, whatever the scale of the scene.
+    // Only the bodies below a changed offset are placed again, and only those
+    // or the spinning ones composed again, unless the camera moved, when all
+    // are composed in one batch by AffineKernels. Returns the number of
+    // bodies whose position changed.
+    size_t updateTransforms(double timeInSec, const glm::dvec3 &origin);
+    // The origin of relX/Y/Z and `model`, as last given to updateTransforms().
+    inline const glm::dvec3 &transformOrigin() const { return m_transformOrigin; }
+
+    inline size_t size() const { return name.size(); }
+    inline int find(const std::string &bodyName) const {
+        for(size_t i = 0; i < name.size(); ++i)
+            if(name[i] == bodyName) return int(i);
+        return -1;
+    }
+
+    // per-body arrays
+    std::vector<std::string> name;
+    std::vector<int> parent;          // -1 for a root
+    // Keplerian orbit around the parent, see Kepler::OrbitArrays
+    std::vector<double> semiMajorAxis, semiMinorAxis;
+    std::vector<float> eccentricity;
+    std::vector<double> meanAnomalyAtEpoch; // rad
+    std::vector<double> meanMotion;         // rad/s
+    std::vector<double> periX, periY, periZ;    // unit vector towards the periapsis
+    std::vector<double> aheadX, aheadY, aheadZ; // unit vector 90 degrees ahead in the orbit plane
+    std::vector<float> spinSpeed;     // rad/s around the spin axis
+    std::vector<float> spinAxisX, spinAxisY, spinAxisZ;
+    std::vector<float> radius;
+    std::vector<float> mu;            // G * mass, only used by the gravity simulation
+    std::vector<int> material;        // index into materials
+    std::vector<int> ephemerisBody;   // index in the ephemeris, -1 for a Kepler orbit
+    std::vector<float> ephemerisScale; // scene units per ephemeris distance unit
+
+    // outputs of update(), world positions
+    std::vector<double> posX, posY, posZ;
+    // Node i is body i's orbit frame, placed at its offset from the parent's;
+    // the spin and size of a body are applied on top when drawing, so they
+    // don't carry over to its moons.
+    TransformHierarchy transforms;
+
+    // outputs of updateTransforms(): positions relative to its origin, spins
+    // as quaternions, and the model transforms (3x4, see AffineKernels)
+    AlignedVector<float> relX, relY, relZ;
+    AlignedVector<float> spinQX, spinQY, spinQZ, spinQW;
+    // updateTransforms() leaves the spins as the caller set them (clip playback)
+    bool callerSpins = false;
+    AlignedVector<glm::mat4x3> model;
+
+    std::vector<BodyMaterial> materials;
+
+private:
+    void resize(size_t n);
+    void buildTransforms();
+
+    const Ephemeris *m_ephemeris = nullptr;
+    double m_ephemerisEpoch = 0.0, m_daysPerSecond = 1.0;
+    size_t m_ephemerisCount = 0;
+    double m_transformTime = -1.0; // time of the spins in `transforms`
+    glm::dvec3 m_transformOrigin = glm::dvec3(0.0); // of `model`
+    bool m_composed = false; // `model` is up to date but for what changed since
+    std::vector<size_t> m_recompose;
+};
@@ -0,0 +1,255 @@
+// CollisionDetector.cpp
+#include "CollisionDetector.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+const float CollisionDetector::kLargeFactor = 8.f;
+
+namespace {
+
+const size_t kCellsPerTask = 512;
+const size_t kBodiesPerTask = 4096;
+const uint64_t kLargeKey = ~0ull; // past every cell, the large bodies sort last
+
+// Exact first touch of two spheres in relative motion dp + dv t, |.| = reach, within [0, dt].
+inline bool timeOfImpact(const double dp[3], const double dv[3], double reach, double dt, double &t) {
+    const double c = dp[0] * dp[0] + dp[1] * dp[1] + dp[2] * dp[2] - reach * reach;
+    if(c <= 0.0) {
+        t = 0.0; // already touching
+        return true;
+    }
+    const double b = dp[0] * dv[0] + dp[1] * dv[1] + dp[2] * dv[2];
+    if(b >= 0.0)
+        return false; // moving apart
+    const double a = dv[0] * dv[0] + dv[1] * dv[1] + dv[2] * dv[2];
+    const double disc = b * b - a * c;
+    if(disc < 0.0)
+        return false;
+    t = c / (-b + std::sqrt(disc)); // smaller root, without the cancellation of (-b - sqrt) / a
+    return t <= dt;
+}
+
+inline bool contactBefore(const Contact &p, const Contact &q) {
+    if(p.time != q.time)
+        return p.time < q.time;
+    return p.a != q.a ? p.a < q.a : p.b < q.b;
+}
+
+// Exact test of bodies i and j once their swept spheres overlap; appends the contact.
+void narrowPhase(const double *x, const double *y, const double *z,
+                 const double *vx, const double *vy, const double *vz,
+                 const float *r, double dt, uint32_t i, uint32_t j, std::vector<Contact> &contacts) {
+    if(i > j)
+        std::swap(i, j);
+    const double dp[3] = { x[j] - x[i], y[j] - y[i], z[j] - z[i] };
+    const double dv[3] = { vx[j] - vx[i], vy[j] - vy[i], vz[j] - vz[i] };
+    double t;
+    if(!timeOfImpact(dp, dv, double(r[i]) + r[j], dt, t))
+        return;
+    double nx = dp[0] + dv[0] * t, ny = dp[1] + dv[1] * t, nz = dp[2] + dv[2] * t;
+    const double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+    if(length > 0.0) {
+        nx /= length;
+        ny /= length;
+        nz /= length;
+    } else {
+        nx = 1.0; // same centre, any direction will do
+    }
+    const Contact contact = { i, j, float(t), float(nx), float(ny), float(nz) };
+    contacts.push_back(contact);
+}
+
+} // namespace
+
+// Tests the cells [begin, end), each against itself and its 13 neighbours
+// after it in key order. Those are the next cell in the row and three cells
+// in each of four rows above, and as the cells go up in key order so do
+// those rows: a cursor per row walks forward instead of looking cells up.
+void CollisionDetector::testCells(const size_t begin, const size_t end, const Motion &m, std::vector<Contact> &contacts, uint64_t &tested) const {
+    const uint64_t axisMask = (1ull << kBitsPerAxis) - 1;
+    const int rows[4][2] = { { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 } }; // dz, dy
+
+    // pairs with both ends in [begin0, end0) x [begin1, end1), j > i when it is the same cell
+    const auto testRanges = [&](uint32_t begin0, uint32_t end0, uint32_t begin1, uint32_t end1, bool same) {
+        for(uint32_t p = begin0; p < end0; ++p) {
+            const Sphere a = m_sweptSorted[p];
+            const uint32_t first = same ? p + 1 : begin1;
+            tested += end1 > first ? end1 - first : 0;
+            for(uint32_t q = first; q < end1; ++q) {
+                const Sphere &b = m_sweptSorted[q];
+                const double dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z, sum = b.reach + a.reach;
+                if(dx * dx + dy * dy + dz * dz <= sum * sum)
+                    narrowPhase(m.x, m.y, m.z, m.vx, m.vy, m.vz, m.r, m.dt, m_sorted[p].second, m_sorted[q].second, contacts);
+            }
+        }
+    };
+    const auto byKey = [](const Cell &cell, uint64_t key) { return cell.key < key; };
+
+    size_t cursor[4];
+    bool started[4] = { false, false, false, false };
+    for(size_t c = begin; c < end; ++c) {
+        const Cell &a = m_cells[c];
+        const int64_t ix = int64_t(a.key & axisMask), iy = int64_t(a.key >> kBitsPerAxis & axisMask), iz = int64_t(a.key >> (2 * kBitsPerAxis));
+
+        testRanges(a.begin, a.end, a.begin, a.end, true);
+        if(c + 1 < m_cells.size() && m_cells[c + 1].key == a.key + 1 && ix < int64_t(axisMask))
+            testRanges(a.begin, a.end, m_cells[c + 1].begin, m_cells[c + 1].end, false);
+
+        for(int row = 0; row < 4; ++row) {
+            const int64_t ny = iy + rows[row][1], nz = iz + rows[row][0];
+            if(ny < 0 || ny > int64_t(axisMask) || nz > int64_t(axisMask))
+                continue;
+            const uint64_t base = uint64_t(ny) << kBitsPerAxis | uint64_t(nz) << (2 * kBitsPerAxis);
+            const uint64_t lo = base + uint64_t(std::max<int64_t>(ix - 1, 0));
+            const uint64_t hi = base + uint64_t(std::min<int64_t>(ix + 1, int64_t(axisMask)));
+            size_t &k = cursor[row];
+            if(!started[row]) {
+                k = size_t(std::lower_bound(m_cells.begin() + c, m_cells.end(), lo, byKey) - m_cells.begin());
+                started[row] = true;
+            }
+            while(k < m_cells.size() && m_cells[k].key < lo)
+                ++k;
+            for(size_t n = k; n < m_cells.size() && m_cells[n].key <= hi; ++n)
+                testRanges(a.begin, a.end, m_cells[n].begin, m_cells[n].end, false);
+        }
+    }
+}
+
+void CollisionDetector::detect(const double *x, const double *y, const double *z,
+                               const double *vx, const double *vy, const double *vz,
+                               const float *r, const size_t n, const double dt, std::vector<Contact> &contacts) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    contacts.clear();
+    m_cells.clear();
+    m_large.clear();
+    m_pairsTested = 0;
+    if(n < 2)
+        return;
+    const Motion motion = { x, y, z, vx, vy, vz, r, dt };
+    const double half = 0.5 * dt;
+
+    // swept spheres: centred half way, reaching over the whole path
+    m_swept.resize(n);
+    m_median.resize(n);
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        const Sphere sphere = { x[i] + vx[i] * half, y[i] + vy[i] * half, z[i] + vz[i] * half,
+                                r[i] + std::sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]) * half };
+        m_swept[i] = sphere;
+        m_median[i] = sphere.reach;
+    }, "collisions.reach", 1024);
+
+    // cell edge: the largest swept diameter of the bodies not far above the median
+    std::nth_element(m_median.begin(), m_median.begin() + n / 2, m_median.end());
+    const double median = m_median[n / 2];
+    const double largeReach = median > 0.0 ? kLargeFactor * median : std::numeric_limits<double>::max();
+    double edge = 0.0;
+    double lo[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+    for(size_t i = 0; i < n; ++i) {
+        const Sphere &sphere = m_swept[i];
+        if(sphere.reach > largeReach) {
+            m_large.push_back(uint32_t(i));
+            continue;
+        }
+        edge = std::max(edge, 2.0 * sphere.reach);
+        lo[0] = std::min(lo[0], sphere.x);
+        lo[1] = std::min(lo[1], sphere.y);
+        lo[2] = std::min(lo[2], sphere.z);
+    }
+    if(edge <= 0.0)
+        edge = 1.0; // points standing still, only exact overlaps touch
+    const double scale = 1.0 / edge;
+    const double maxCell = double((1 << kBitsPerAxis) - 1);
+
+    // keys, then the same parallel sort as BarnesHut: chunks in parallel, merged pairwise
+    const size_t smallCount = n - m_large.size();
+    m_sorted.resize(n);
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        const Sphere &sphere = m_swept[i];
+        if(sphere.reach > largeReach) {
+            m_sorted[i] = std::make_pair(kLargeKey, uint32_t(i));
+            return;
+        }
+        // far outliers share the border cells, which costs tests but loses no pair
+        const uint64_t cx = uint64_t(std::min(maxCell, std::floor((sphere.x - lo[0]) * scale)));
+        const uint64_t cy = uint64_t(std::min(maxCell, std::floor((sphere.y - lo[1]) * scale)));
+        const uint64_t cz = uint64_t(std::min(maxCell, std::floor((sphere.z - lo[2]) * scale)));
+        m_sorted[i] = std::make_pair(cx | cy << kBitsPerAxis | cz << (2 * kBitsPerAxis), uint32_t(i));
+    }, "collisions.keys", 1024);
+    const size_t chunks = std::min<size_t>(Parallel::workerCount(), (n + 4095) / 4096);
+    const size_t chunk = (n + chunks - 1) / chunks;
+    Parallel::parallelFor(0, chunks, [&](size_t c) {
+        std::sort(m_sorted.begin() + std::min(n, c * chunk), m_sorted.begin() + std::min(n, (c + 1) * chunk));
+    }, "collisions.sort");
+    for(size_t width = chunk; width < n; width *= 2) {
+        Parallel::parallelFor(0, (n + 2 * width - 1) / (2 * width), [&](size_t m) {
+            const size_t b = m * 2 * width, mid = std::min(n, b + width), e = std::min(n, b + 2 * width);
+            std::inplace_merge(m_sorted.begin() + b, m_sorted.begin() + mid, m_sorted.begin() + e);
+        }, "collisions.merge");
+    }
+
+    // swept spheres in cell order, so a cell's bodies are contiguous
+    m_sweptSorted.resize(smallCount);
+    Parallel::parallelFor(0, smallCount, [&](size_t k) {
+        m_sweptSorted[k] = m_swept[m_sorted[k].second];
+    }, "collisions.gather", 1024);
+
+    for(size_t b = 0; b < smallCount;) {
+        size_t e = b + 1;
+        while(e < smallCount && m_sorted[e].first == m_sorted[b].first)
+            ++e;
+        const Cell cell = { m_sorted[b].first, uint32_t(b), uint32_t(e) };
+        m_cells.push_back(cell);
+        b = e;
+    }
+
+    // cells in parallel, each task with its own list
+    const size_t cellTasks = (m_cells.size() + kCellsPerTask - 1) / kCellsPerTask;
+    const size_t largeTasks = m_large.empty() ? 0 : (smallCount + kBodiesPerTask - 1) / kBodiesPerTask;
+    std::vector<std::vector<Contact> > found(cellTasks + largeTasks);
+    std::vector<uint64_t> tested(cellTasks + largeTasks, 0);
+    Parallel::parallelFor(0, cellTasks, [&](size_t task) {
+        const size_t end = std::min(m_cells.size(), (task + 1) * kCellsPerTask);
+        testCells(task * kCellsPerTask, end, motion, found[task], tested[task]);
+    }, "collisions.cells");
+
+    // the large bodies against all the others
+    Parallel::parallelFor(0, largeTasks, [&](size_t task) {
+        const size_t end = std::min(smallCount, (task + 1) * kBodiesPerTask);
+        for(size_t l = 0; l < m_large.size(); ++l) {
+            const uint32_t i = m_large[l];
+            const Sphere a = m_swept[i];
+            tested[cellTasks + task] += end - task * kBodiesPerTask;
+            for(size_t k = task * kBodiesPerTask; k < end; ++k) {
+                const Sphere &b = m_sweptSorted[k];
+                const double dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z, sum = b.reach + a.reach;
+                if(dx * dx + dy * dy + dz * dz <= sum * sum)
+                    narrowPhase(x, y, z, vx, vy, vz, r, dt, i, m_sorted[k].second, found[cellTasks + task]);
+            }
+        }
+    }, "collisions.large");
+    std::vector<Contact> largePairs;
+    for(size_t p = 0; p < m_large.size(); ++p) {
+        for(size_t q = p + 1; q < m_large.size(); ++q) {
+            const uint32_t i = m_large[p], j = m_large[q];
+            const Sphere &a = m_swept[i], &b = m_swept[j];
+            const double dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z, sum = b.reach + a.reach;
+            ++m_pairsTested;
+            if(dx * dx + dy * dy + dz * dz <= sum * sum)
+                narrowPhase(x, y, z, vx, vy, vz, r, dt, i, j, largePairs);
+        }
+    }
+
+    contacts.swap(largePairs);
+    for(size_t t = 0; t < found.size(); ++t) {
+        contacts.insert(contacts.end(), found[t].begin(), found[t].end());
+        m_pairsTested += tested[t];
+    }
+    std::sort(contacts.begin(), contacts.end(), contactBefore);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_pairsPerSecond = seconds > 0.0 ? double(m_pairsTested) / seconds : 0.0;
+}
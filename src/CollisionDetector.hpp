@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// First touch of two spheres during a step.
+struct Contact {
+    uint32_t a, b;    // a < b
+    float time;       // seconds into the step, 0 when they already overlap
+    float nx, ny, nz; // unit normal from a to b at that time
+};
+
+// Sphere-sphere collisions over one step, for debris and ring particles.
+//
+// Bodies move in straight lines during the step. The broad phase puts every
+// body's swept sphere (the sphere around its whole path) in a uniform grid:
+// cell keys computed and sorted in parallel, which leaves the occupied cells
+// in a sorted list, then each cell is checked against itself and its 13
+// forward neighbours, runs of cells in parallel. The cell edge is the largest swept diameter
+// of the ordinary bodies, so touching ones are always in neighbouring cells;
+// bodies far larger than the median (a planet among pebbles) would blow the
+// cells up and are instead checked against everyone. Pairs whose swept
+// spheres overlap get an exact time of impact in double.
+class CollisionDetector {
+public:
+    // Sphere i starts at (x[i], y[i], z[i]) with velocity (vx[i], vy[i],
+    // vz[i]) and radius r[i]. Fills contacts with every pair that touches
+    // within dt, sorted by time (then by pair, so the order never depends on
+    // the threads).
+    void detect(const double *x, const double *y, const double *z,
+                const double *vx, const double *vy, const double *vz,
+                const float *r, size_t n, double dt, std::vector<Contact> &contacts);
+
+    // Pairs given a swept-sphere test by the last detect(), and per second of its wall time.
+    inline uint64_t pairsTested() const { return m_pairsTested; }
+    inline double pairsPerSecond() const { return m_pairsPerSecond; }
+
+private:
+    static const int kBitsPerAxis = 21;   // 63 bit cell keys
+    static const float kLargeFactor;      // swept radius over the median past which a body is large
+
+    struct Cell {
+        uint64_t key;
+        uint32_t begin, end; // range in sorted order
+    };
+
+    struct Sphere { // swept, 32 bytes
+        double x, y, z, reach;
+    };
+
+    struct Motion {
+        const double *x, *y, *z, *vx, *vy, *vz;
+        const float *r;
+        double dt;
+    };
+
+    void testCells(size_t begin, size_t end, const Motion &motion, std::vector<Contact> &contacts, uint64_t &tested) const;
+
+    std::vector<Sphere> m_swept;                          // per body
+    std::vector<double> m_median;                         // scratch for the median reach
+    std::vector<std::pair<uint64_t, uint32_t> > m_sorted; // cell key, body
+    std::vector<Sphere> m_sweptSorted;                    // small bodies in sorted order
+    std::vector<Cell> m_cells;                            // occupied, by key
+    std::vector<uint32_t> m_large;
+    uint64_t m_pairsTested = 0;
+    double m_pairsPerSecond = 0.0;
+};
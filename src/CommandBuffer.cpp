@@ -0,0 +1,22 @@
+// CommandBuffer.cpp
+#include "CommandBuffer.hpp"
+
+void CommandBuffer::destroy(const Entity entity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    push(Op::Destroy, entity, -1, nullptr, 0);
+}
+
+void CommandBuffer::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_commands.clear();
+    m_bytes.clear();
+    m_created = 0;
+}
+
+void CommandBuffer::push(const Op op, const Entity entity, const int component, const void *value, const size_t size) {
+    const Command command = { op, component, entity, m_bytes.size() };
+    m_commands.push_back(command);
+    const unsigned char *bytes = static_cast<const unsigned char *>(value);
+    if(bytes)
+        m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+}
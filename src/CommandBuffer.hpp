@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "EntityWorld.hpp"
+
+// Structural changes to an EntityWorld (creating and destroying entities,
+// adding and removing components) recorded for EntityWorld::apply(), so
+// systems can ask for them while the chunks are being walked. Recording is
+// thread safe; the order of what different threads record is whatever the
+// lock makes of it.
+//
+// create() hands out a placeholder that later commands of the same buffer can
+// use; it becomes a real entity when the buffer is applied. Commands on one
+// entity in a row are applied together, the entity moved once to where it
+// ends up.
+class CommandBuffer {
+public:
+    template<typename... Cs>
+    Entity create(const Cs &...values) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Entity entity;
+        entity.index = m_created++;
+        entity.generation = kPending;
+        push(Op::Create, entity, -1, nullptr, 0);
+        const int expand[] = { 0, (push(Op::Add, entity, EntityComponents::id<Cs>(), &values, sizeof(Cs)), 0)... };
+        (void)expand;
+        return entity;
+    }
+    void destroy(Entity entity);
+    template<typename T>
+    void add(Entity entity, const T &value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        push(Op::Add, entity, EntityComponents::id<T>(), &value, sizeof(T));
+    }
+    template<typename T>
+    void remove(Entity entity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        push(Op::Remove, entity, EntityComponents::id<T>(), nullptr, 0);
+    }
+
+    inline size_t size() const { return m_commands.size(); }
+    inline bool empty() const { return m_commands.empty(); }
+    void clear();
+
+private:
+    friend class EntityWorld;
+
+    static const uint32_t kPending = ~0u; // generation of the placeholders from create()
+
+    enum class Op : uint8_t { Create, Destroy, Add, Remove };
+
+    struct Command {
+        Op op;
+        int component;
+        Entity entity;
+        size_t bytes; // offset of an Add's value in m_bytes
+    };
+
+    void push(Op op, Entity entity, int component, const void *value, size_t size);
+
+    std::vector<Command> m_commands;
+    std::vector<unsigned char> m_bytes;
+    uint32_t m_created = 0;
+    std::mutex m_mutex;
+};
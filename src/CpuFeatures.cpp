@@ -0,0 +1,79 @@
+// CpuFeatures.cpp
+#include "CpuFeatures.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(SOLAR_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+CpuFeatures detect() {
+    CpuFeatures f;
+#if defined(SOLAR_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    f.sse2 = __builtin_cpu_supports("sse2");
+    f.ssse3 = __builtin_cpu_supports("ssse3");
+    f.sse41 = __builtin_cpu_supports("sse4.1");
+    f.avx2 = __builtin_cpu_supports("avx2");
+    f.fma = __builtin_cpu_supports("fma");
+    f.avx512f = __builtin_cpu_supports("avx512f");
+#elif defined(SOLAR_X86) && defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    const int maxLeaf = r[0];
+    __cpuid(r, 1);
+    f.sse2 = (r[3] & (1 << 26)) != 0;
+    f.ssse3 = (r[2] & (1 << 9)) != 0;
+    f.sse41 = (r[2] & (1 << 19)) != 0;
+    f.fma = (r[2] & (1 << 12)) != 0;
+    const bool osxsave = (r[2] & (1 << 27)) != 0;
+    // the OS must save the wide registers, otherwise AVX is unusable
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool ymmSaved = (xcr0 & 0x6) == 0x6;
+    const bool zmmSaved = (xcr0 & 0xe6) == 0xe6;
+    if(maxLeaf >= 7) {
+        __cpuidex(r, 7, 0);
+        f.avx2 = ymmSaved && (r[1] & (1 << 5)) != 0;
+        f.avx512f = zmmSaved && (r[1] & (1 << 16)) != 0;
+    }
+    f.fma = f.fma && ymmSaved;
+#endif
+    return f;
+}
+
+} // namespace
+
+SimdLevel CpuFeatures::level() const {
+    SimdLevel best = SimdLevel::Scalar;
+    if(sse2 && ssse3 && sse41) best = SimdLevel::SSE;
+    if(best == SimdLevel::SSE && avx2 && fma) best = SimdLevel::AVX2;
+    if(best == SimdLevel::AVX2 && avx512f) best = SimdLevel::AVX512;
+
+    // SOLAR_SIMD=scalar|sse|avx2 caps the level, handy to compare kernels
+    const char *cap = std::getenv("SOLAR_SIMD");
+    if(cap) {
+        SimdLevel limit = best;
+        if(std::strcmp(cap, "scalar") == 0) limit = SimdLevel::Scalar;
+        else if(std::strcmp(cap, "sse") == 0) limit = SimdLevel::SSE;
+        else if(std::strcmp(cap, "avx2") == 0) limit = SimdLevel::AVX2;
+        if(limit < best) best = limit;
+    }
+    return best;
+}
+
+const CpuFeatures &CpuFeatures::get() {
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch(level) {
+    case SimdLevel::SSE: return "SSE4.1";
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::AVX512: return "AVX-512";
+    default: return "scalar";
+    }
+}
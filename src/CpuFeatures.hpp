@@ -0,0 +1,34 @@
+#pragma once
+
+// Runtime CPU feature detection, used to pick the best SIMD kernel at startup.
+// Kernels for wider ISAs are compiled with per-function target attributes so
+// the binary itself only assumes the baseline (SSE2 on x86-64).
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOLAR_X86 1
+#endif
+
+#if defined(SOLAR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SOLAR_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SOLAR_TARGET(isa)
+#endif
+
+enum class SimdLevel { Scalar = 0, SSE = 1, AVX2 = 2, AVX512 = 3 };
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512f = false;
+
+    // Highest kernel level usable on this machine. "SSE" means SSE4.1 (and
+    // everything below), "AVX2" also implies FMA.
+    SimdLevel level() const;
+
+    static const CpuFeatures &get();
+};
+
+const char *simdLevelName(SimdLevel level);
@@ -0,0 +1,73 @@
+// Cubemap.cpp
+#include "Cubemap.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Cubemap {
+
+namespace {
+
+const float PI = 3.14159265359f;
+
+// direction of texel (s, t) in [-1, 1]^2 of a face, as defined by the GL spec
+inline void faceDirection(int face, float s, float t, float &x, float &y, float &z) {
+    switch(face) {
+    case 0: x = 1.f;  y = -t;   z = -s;   break; // +X
+    case 1: x = -1.f; y = -t;   z = s;    break; // -X
+    case 2: x = s;    y = 1.f;  z = t;    break; // +Y
+    case 3: x = s;    y = -1.f; z = -t;   break; // -Y
+    case 4: x = s;    y = -t;   z = 1.f;  break; // +Z
+    default: x = -s;  y = -t;   z = -1.f; break; // -Z
+    }
+}
+
+// bilinear lookup, wrapping in longitude and clamping in latitude
+inline void sampleEquirect(const unsigned char *rgba, int width, int height, float u, float v, unsigned char *out) {
+    const float fx = u * width - 0.5f, fy = v * height - 0.5f;
+    const float x0f = std::floor(fx), y0f = std::floor(fy);
+    const float ax = fx - x0f, ay = fy - y0f;
+    int x0 = int(x0f) % width;
+    if(x0 < 0) x0 += width;
+    const int x1 = (x0 + 1) % width;
+    const int y0 = std::min(std::max(int(y0f), 0), height - 1);
+    const int y1 = std::min(std::max(int(y0f) + 1, 0), height - 1);
+
+    const unsigned char *p00 = rgba + (size_t(y0) * width + x0) * 4;
+    const unsigned char *p10 = rgba + (size_t(y0) * width + x1) * 4;
+    const unsigned char *p01 = rgba + (size_t(y1) * width + x0) * 4;
+    const unsigned char *p11 = rgba + (size_t(y1) * width + x1) * 4;
+    for(int c = 0; c < 4; ++c) {
+        const float top = p00[c] + ax * (p10[c] - p00[c]);
+        const float bottom = p01[c] + ax * (p11[c] - p01[c]);
+        out[c] = (unsigned char)(top + ay * (bottom - top) + 0.5f);
+    }
+}
+
+} // namespace
+
+std::vector<unsigned char> fromEquirect(const unsigned char *rgba, int width, int height, int faceSize) {
+    std::vector<unsigned char> faces(size_t(6) * faceSize * faceSize * 4);
+    unsigned char *dst = faces.data();
+
+    // one task per face row, so all cores are busy even for the six faces
+    Parallel::parallelFor(0, size_t(6) * faceSize, [=](size_t task) {
+        const int face = int(task / faceSize), row = int(task % faceSize);
+        const float t = 2.f * (row + 0.5f) / faceSize - 1.f;
+        unsigned char *out = dst + (size_t(face) * faceSize + row) * faceSize * 4;
+        for(int col = 0; col < faceSize; ++col, out += 4) {
+            const float s = 2.f * (col + 0.5f) / faceSize - 1.f;
+            float x, y, z;
+            faceDirection(face, s, t, x, y, z);
+            const float invLen = 1.f / std::sqrt(x * x + y * y + z * z);
+            float u = std::atan2(z, x) / (2.f * PI);
+            if(u < 0.f) u += 1.f;
+            const float v = 0.5f - std::asin(y * invLen) / PI; // 0 at the north pole (first row)
+            sampleEquirect(rgba, width, height, u, v, out);
+        }
+    }, "cubemap.rows");
+    return faces;
+}
+
+} // namespace Cubemap
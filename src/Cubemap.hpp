@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+
+// Equirectangular (longitude/latitude) to cubemap conversion.
+//
+// The equirectangular layout spends as many texels on the rows next to the
+// poles as on the equator. A cubemap with faces of width/4 texels keeps the
+// same angular resolution on the equator while using 25% fewer texels, and
+// lookups near the poles stay local instead of spanning whole rows.
+namespace Cubemap {
+
+// Face size that preserves the equatorial resolution of an equirectangular image.
+inline int faceSizeForEquirect(int equirectWidth) { return equirectWidth / 4 > 1 ? equirectWidth / 4 : 1; }
+
+// Resamples an RGBA8 equirectangular image (first row is the north pole) into
+// six faceSize x faceSize RGBA8 faces, stored one after the other in the
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order. Rows are converted in parallel.
+//
+// Directions follow Mesh::genSphere: u = atan2(z, x) / 2pi and the north pole
+// is +y, so a sphere sampled by its object-space normal matches the old UVs.
+std::vector<unsigned char> fromEquirect(const unsigned char *rgba, int width, int height, int faceSize);
+
+} // namespace Cubemap
@@ -0,0 +1,26 @@
+// EmbeddedAssets.cpp
+#include "EmbeddedAssets.hpp"
+
+namespace {
+
+struct EmbeddedAsset {
+    const char *name;
+    const unsigned char *data;
+    size_t size;
+};
+
+#include "EmbeddedAssetData.inc"
+
+} // namespace
+
+namespace EmbeddedAssets {
+
+AssetSpan find(const std::string &name) {
+    for(size_t i = 0; i < sizeof(kEmbeddedAssets) / sizeof(kEmbeddedAssets[0]); ++i) {
+        if(name == kEmbeddedAssets[i].name)
+            return AssetSpan(kEmbeddedAssets[i].data, kEmbeddedAssets[i].size);
+    }
+    return AssetSpan();
+}
+
+} // namespace EmbeddedAssets
@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+
+#include "AssetPack.hpp"
+
+// Assets compiled into the executable (the core shaders and small default
+// textures), generated at build time by embedAssets.cmake. They make startup
+// independent of any file on disk.
+namespace EmbeddedAssets {
+
+// Empty span if nothing with this name was embedded.
+AssetSpan find(const std::string &name);
+
+} // namespace EmbeddedAssets
@@ -0,0 +1,280 @@
+// EntityWorld.cpp
+#include "EntityWorld.hpp"
+#include "AlignedAllocator.hpp"
+#include "CommandBuffer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+const size_t kLine = 64; // every array of a chunk starts on a cache line
+
+inline size_t roundUp(size_t bytes, size_t alignment) { return (bytes + alignment - 1) / alignment * alignment; }
+
+std::mutex g_componentMutex;
+std::vector<size_t> &componentSizes() {
+    static std::vector<size_t> sizes;
+    return sizes;
+}
+
+} // namespace
+
+namespace EntityComponents {
+
+int registerComponent(const size_t size, const size_t alignment) {
+    std::lock_guard<std::mutex> lock(g_componentMutex);
+    std::vector<size_t> &sizes = componentSizes();
+    if(sizes.size() >= size_t(kMaxComponents) || alignment > kLine) {
+        std::cerr << "ERROR: EntityWorld takes at most " << kMaxComponents << " component types, aligned to at most "
+                  << kLine << " bytes" << std::endl;
+        std::abort();
+    }
+    sizes.push_back(size);
+    return int(sizes.size() - 1);
+}
+
+size_t componentSize(const int id) {
+    std::lock_guard<std::mutex> lock(g_componentMutex);
+    return componentSizes()[id];
+}
+
+} // namespace EntityComponents
+
+EntityWorld::~EntityWorld() {
+    AlignedAllocator<unsigned char> allocator;
+    for(size_t a = 0; a < m_archetypes.size(); ++a)
+        for(size_t c = 0; c < m_archetypes[a].chunks.size(); ++c)
+            allocator.deallocate(m_archetypes[a].chunks[c].data, kChunkBytes);
+    for(size_t c = 0; c < m_freeChunks.size(); ++c)
+        allocator.deallocate(m_freeChunks[c], kChunkBytes);
+}
+
+uint32_t EntityWorld::archetypeFor(const uint64_t mask) {
+    for(size_t a = 0; a < m_archetypes.size(); ++a)
+        if(m_archetypes[a].mask == mask)
+            return uint32_t(a);
+
+    Archetype archetype;
+    archetype.mask = mask;
+    std::fill(archetype.offsets, archetype.offsets + EntityComponents::kMaxComponents, size_t(0));
+    std::fill(archetype.sizes, archetype.sizes + EntityComponents::kMaxComponents, size_t(0));
+    size_t rowBytes = sizeof(Entity);
+    for(int id = 0; id < EntityComponents::kMaxComponents; ++id) {
+        if(mask & (1ull << id)) {
+            archetype.components.push_back(id);
+            archetype.sizes[id] = EntityComponents::componentSize(id);
+            rowBytes += archetype.sizes[id];
+        }
+    }
+
+    // as many rows as fit once every array is padded to a line
+    const auto layout = [&](size_t rows) {
+        size_t bytes = roundUp(rows * sizeof(Entity), kLine);
+        for(size_t k = 0; k < archetype.components.size(); ++k) {
+            const int id = archetype.components[k];
+            archetype.offsets[id] = bytes;
+            bytes = roundUp(bytes + rows * archetype.sizes[id], kLine);
+        }
+        return bytes;
+    };
+    size_t rows = std::max<size_t>(1, kChunkBytes / rowBytes);
+    while(rows > 1 && layout(rows) > kChunkBytes)
+        --rows;
+    if(layout(rows) > kChunkBytes) {
+        std::cerr << "ERROR: EntityWorld components of " << rowBytes << " bytes don't fit a chunk" << std::endl;
+        std::abort();
+    }
+    archetype.capacity = uint32_t(rows);
+    m_archetypes.push_back(archetype);
+    return uint32_t(m_archetypes.size() - 1);
+}
+
+unsigned char *EntityWorld::allocateChunk() {
+    if(!m_freeChunks.empty()) {
+        unsigned char *data = m_freeChunks.back();
+        m_freeChunks.pop_back();
+        return data;
+    }
+    ++m_chunkCount;
+    return AlignedAllocator<unsigned char>().allocate(kChunkBytes);
+}
+
+// Appends the entity to the archetype, its components zeroed.
+void EntityWorld::place(const Entity entity, const uint32_t archetypeIndex) {
+    Archetype &archetype = m_archetypes[archetypeIndex];
+    if(archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        const Chunk chunk = { allocateChunk(), 0 };
+        archetype.chunks.push_back(chunk);
+    }
+    Chunk &chunk = archetype.chunks.back();
+    const uint32_t row = chunk.count++;
+    reinterpret_cast<Entity *>(chunk.data)[row] = entity;
+    for(size_t k = 0; k < archetype.components.size(); ++k) {
+        const int id = archetype.components[k];
+        const size_t size = archetype.sizes[id];
+        std::memset(chunk.data + archetype.offsets[id] + row * size, 0, size);
+    }
+    Record &record = m_records[entity.index];
+    record.archetype = archetypeIndex;
+    record.chunk = uint32_t(archetype.chunks.size() - 1);
+    record.row = row;
+}
+
+// Takes the row out of its archetype, the last row of the archetype moving into it.
+void EntityWorld::unplace(const Record &record) {
+    Archetype &archetype = m_archetypes[record.archetype];
+    Chunk &last = archetype.chunks.back();
+    const uint32_t lastChunk = uint32_t(archetype.chunks.size() - 1), lastRow = last.count - 1;
+    if(record.chunk != lastChunk || record.row != lastRow) {
+        Chunk &chunk = archetype.chunks[record.chunk];
+        const Entity moved = reinterpret_cast<const Entity *>(last.data)[lastRow];
+        reinterpret_cast<Entity *>(chunk.data)[record.row] = moved;
+        for(size_t k = 0; k < archetype.components.size(); ++k) {
+            const int id = archetype.components[k];
+            const size_t size = archetype.sizes[id], offset = archetype.offsets[id];
+            std::memcpy(chunk.data + offset + record.row * size, last.data + offset + lastRow * size, size);
+        }
+        m_records[moved.index].chunk = record.chunk;
+        m_records[moved.index].row = record.row;
+    }
+    if(--last.count == 0) {
+        m_freeChunks.push_back(last.data);
+        archetype.chunks.pop_back();
+    }
+}
+
+Entity EntityWorld::createWithMask(const uint64_t mask) {
+    Entity entity;
+    if(!m_freeRecords.empty()) {
+        entity.index = m_freeRecords.back();
+        m_freeRecords.pop_back();
+    } else {
+        entity.index = uint32_t(m_records.size());
+        m_records.push_back(Record());
+    }
+    Record &record = m_records[entity.index];
+    record.alive = true;
+    entity.generation = record.generation;
+    place(entity, archetypeFor(mask));
+    ++m_alive;
+    return entity;
+}
+
+void EntityWorld::destroy(const Entity entity) {
+    if(!alive(entity))
+        return;
+    Record &record = m_records[entity.index];
+    unplace(record);
+    record.alive = false;
+    ++record.generation;
+    m_freeRecords.push_back(entity.index);
+    --m_alive;
+}
+
+bool EntityWorld::alive(const Entity entity) const {
+    return entity.index < m_records.size() && m_records[entity.index].alive &&
+           m_records[entity.index].generation == entity.generation;
+}
+
+// To the archetype of `mask`, keeping the components both have.
+void EntityWorld::move(const Entity entity, const uint64_t mask) {
+    const Record from = m_records[entity.index];
+    if(m_archetypes[from.archetype].mask == mask)
+        return;
+    place(entity, archetypeFor(mask));
+
+    const Archetype &source = m_archetypes[from.archetype], &target = m_archetypes[m_records[entity.index].archetype];
+    const Chunk &sourceChunk = source.chunks[from.chunk];
+    const Chunk &targetChunk = target.chunks[m_records[entity.index].chunk];
+    const uint32_t row = m_records[entity.index].row;
+    for(size_t k = 0; k < source.components.size(); ++k) {
+        const int id = source.components[k];
+        if(!(mask & (1ull << id)))
+            continue;
+        const size_t size = source.sizes[id];
+        std::memcpy(targetChunk.data + target.offsets[id] + row * size, sourceChunk.data + source.offsets[id] + from.row * size, size);
+    }
+    unplace(from);
+}
+
+void *EntityWorld::component(const Entity entity, const int id) const {
+    if(!alive(entity))
+        return nullptr;
+    const Record &record = m_records[entity.index];
+    const Archetype &archetype = m_archetypes[record.archetype];
+    if(!(archetype.mask & (1ull << id)))
+        return nullptr;
+    return archetype.chunks[record.chunk].data + archetype.offsets[id] + record.row * archetype.sizes[id];
+}
+
+void EntityWorld::setBytes(const Entity entity, const int id, const void *bytes) {
+    void *destination = component(entity, id);
+    if(destination)
+        std::memcpy(destination, bytes, m_archetypes[m_records[entity.index].archetype].sizes[id]);
+}
+
+void EntityWorld::matchingChunks(const uint64_t mask, std::vector<ChunkRef> &chunks) const {
+    for(size_t a = 0; a < m_archetypes.size(); ++a) {
+        const Archetype &archetype = m_archetypes[a];
+        if((archetype.mask & mask) != mask)
+            continue;
+        for(size_t c = 0; c < archetype.chunks.size(); ++c) {
+            const ChunkRef ref = { &archetype, &archetype.chunks[c] };
+            chunks.push_back(ref);
+        }
+    }
+}
+
+void EntityWorld::apply(CommandBuffer &commands) {
+    typedef CommandBuffer::Op Op;
+    std::lock_guard<std::mutex> lock(commands.m_mutex);
+    const std::vector<CommandBuffer::Command> &list = commands.m_commands;
+    std::vector<Entity> created(commands.m_created); // placeholders, resolved as they are created
+
+    for(size_t begin = 0, end = 0; begin < list.size(); begin = end) {
+        // a run of commands on the same entity: one move to where they leave it
+        const Entity handle = list[begin].entity;
+        end = begin + 1;
+        while(end < list.size() && list[end].entity == handle)
+            ++end;
+
+        const bool create = list[begin].op == Op::Create;
+        Entity entity = handle;
+        if(handle.generation == CommandBuffer::kPending && !create)
+            entity = created[handle.index];
+        if(!create && !alive(entity))
+            continue;
+
+        uint64_t mask = create ? 0 : m_archetypes[m_records[entity.index].archetype].mask;
+        bool destroyed = false;
+        for(size_t c = begin; c < end && !destroyed; ++c) {
+            const uint64_t bit = list[c].component >= 0 ? 1ull << list[c].component : 0;
+            if(list[c].op == Op::Add)
+                mask |= bit;
+            else if(list[c].op == Op::Remove)
+                mask &= ~bit;
+            else if(list[c].op == Op::Destroy)
+                destroyed = true;
+        }
+        if(destroyed) { // anything after it in the run is dropped with it
+            if(!create)
+                destroy(entity);
+            continue;
+        }
+        if(create) {
+            entity = createWithMask(mask);
+            created[handle.index] = entity;
+        } else {
+            move(entity, mask);
+        }
+        for(size_t c = begin; c < end; ++c)
+            if(list[c].op == Op::Add && (mask & (1ull << list[c].component)))
+                setBytes(entity, list[c].component, &commands.m_bytes[list[c].bytes]);
+    }
+    commands.m_commands.clear();
+    commands.m_bytes.clear();
+    commands.m_created = 0;
+}
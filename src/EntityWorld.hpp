@@ -0,0 +1,184 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.hpp"
+
+class CommandBuffer;
+
+// Handle to an entity: the slot and the generation of the slot, so a handle
+// kept past destroy() never reaches whatever reuses the slot.
+struct Entity {
+    uint32_t index = 0, generation = 0;
+    inline bool operator==(const Entity &other) const { return index == other.index && generation == other.generation; }
+    inline bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+// Component types get a small id, and a bit in the archetype masks, the
+// first time they are used. Components are plain data, moved with memcpy.
+namespace EntityComponents {
+
+const int kMaxComponents = 64;
+
+int registerComponent(size_t size, size_t alignment);
+size_t componentSize(int id);
+
+template<typename T>
+inline int id() {
+    static const int value = registerComponent(sizeof(T), alignof(T));
+    return value;
+}
+
+template<typename... Cs>
+inline uint64_t mask() {
+    uint64_t bits = 0;
+    const int expand[] = { 0, (bits |= 1ull << id<Cs>(), 0)... };
+    (void)expand;
+    return bits;
+}
+
+} // namespace EntityComponents
+
+// Archetype entity-component store for the scene objects.
+//
+// Entities with the same set of components (an archetype) live together in
+// fixed size chunks of kChunkBytes, cache line aligned, each holding one
+// array per component plus the entity handles: a system walks plain arrays
+// and hands them to batch kernels as they are. Chunks stay dense, removing a
+// row moves the archetype's last one into it, and chunks emptied that way go
+// back to a free list every archetype draws from, so a new kind of body costs
+// chunks, not a fragmented heap.
+//
+// Adding or removing a component moves the entity to another archetype. That
+// can't happen while chunks are being walked, so systems record structural
+// changes in a CommandBuffer and apply() plays it back afterwards, each
+// entity moved once for all its changes.
+class EntityWorld {
+public:
+    static const size_t kChunkBytes = 16384;
+
+    EntityWorld() = default;
+    ~EntityWorld();
+    EntityWorld(const EntityWorld &) = delete;
+    EntityWorld &operator=(const EntityWorld &) = delete;
+
+    template<typename... Cs>
+    Entity create(const Cs &...values) {
+        const Entity entity = createWithMask(EntityComponents::mask<Cs...>());
+        const int expand[] = { 0, (set(entity, values), 0)... };
+        (void)expand;
+        return entity;
+    }
+    void destroy(Entity entity);
+    bool alive(Entity entity) const;
+    inline size_t size() const { return m_alive; }
+
+    template<typename T>
+    void add(Entity entity, const T &value) {
+        if(!alive(entity))
+            return;
+        const uint64_t bit = 1ull << EntityComponents::id<T>();
+        const uint64_t current = m_archetypes[m_records[entity.index].archetype].mask;
+        if(!(current & bit))
+            move(entity, current | bit);
+        set(entity, value);
+    }
+    template<typename T>
+    void remove(Entity entity) {
+        if(!alive(entity))
+            return;
+        const uint64_t current = m_archetypes[m_records[entity.index].archetype].mask;
+        move(entity, current & ~(1ull << EntityComponents::id<T>()));
+    }
+    template<typename T>
+    inline bool has(Entity entity) const { return get<T>(entity) != nullptr; }
+    // The entity's component, null when it has none (or is gone).
+    template<typename T>
+    inline T *get(Entity entity) const {
+        return static_cast<T *>(component(entity, EntityComponents::id<T>()));
+    }
+
+    // Plays back and clears the buffer.
+    void apply(CommandBuffer &commands);
+
+    // Calls fn(count, entities, Cs *...) for every chunk of every archetype
+    // with at least the components Cs, chunks in parallel. The arrays are
+    // the chunk's own: write components in place, record structural changes.
+    template<typename... Cs, typename Fn>
+    void forEachChunk(const Fn &fn, const char *name = "entities.forEach") const {
+        std::vector<ChunkRef> chunks;
+        matchingChunks(EntityComponents::mask<Cs...>(), chunks);
+        Parallel::parallelFor(0, chunks.size(), [&](size_t c) {
+            visit<Cs...>(chunks[c], fn);
+        }, name);
+    }
+    // Same on the calling thread, in archetype and chunk order (GL calls).
+    template<typename... Cs, typename Fn>
+    void forEachChunkSerial(const Fn &fn) const {
+        std::vector<ChunkRef> chunks;
+        matchingChunks(EntityComponents::mask<Cs...>(), chunks);
+        for(size_t c = 0; c < chunks.size(); ++c)
+            visit<Cs...>(chunks[c], fn);
+    }
+
+    inline size_t archetypeCount() const { return m_archetypes.size(); }
+    inline size_t chunkCount() const { return m_chunkCount - m_freeChunks.size(); }
+
+private:
+    struct Chunk {
+        unsigned char *data;
+        uint32_t count;
+    };
+
+    struct Archetype {
+        uint64_t mask;
+        uint32_t capacity;                 // rows per chunk
+        size_t offsets[EntityComponents::kMaxComponents]; // of each component's array in a chunk
+        size_t sizes[EntityComponents::kMaxComponents];   // of each component, 0 when absent
+        std::vector<int> components;
+        std::vector<Chunk> chunks;         // all full but the last
+    };
+
+    struct Record {
+        uint32_t generation = 1; // a default Entity is never alive
+        uint32_t archetype = 0;
+        uint32_t chunk = 0, row = 0;
+        bool alive = false;
+    };
+
+    struct ChunkRef {
+        const Archetype *archetype;
+        const Chunk *chunk;
+    };
+
+    friend class CommandBuffer;
+
+    Entity createWithMask(uint64_t mask);
+    uint32_t archetypeFor(uint64_t mask);
+    void place(Entity entity, uint32_t archetype);
+    void unplace(const Record &record);
+    void move(Entity entity, uint64_t mask);
+    void *component(Entity entity, int id) const;
+    void setBytes(Entity entity, int id, const void *bytes);
+    unsigned char *allocateChunk();
+    void matchingChunks(uint64_t mask, std::vector<ChunkRef> &chunks) const;
+
+    template<typename T>
+    void set(Entity entity, const T &value) { setBytes(entity, EntityComponents::id<T>(), &value); }
+
+    template<typename... Cs, typename Fn>
+    static void visit(const ChunkRef &ref, const Fn &fn) {
+        unsigned char *data = ref.chunk->data;
+        fn(size_t(ref.chunk->count), reinterpret_cast<const Entity *>(data),
+           reinterpret_cast<Cs *>(data + ref.archetype->offsets[EntityComponents::id<Cs>()])...);
+    }
+
+    std::vector<Archetype> m_archetypes;
+    std::vector<Record> m_records;
+    std::vector<uint32_t> m_freeRecords;
+    std::vector<unsigned char *> m_freeChunks;
+    size_t m_chunkCount = 0;
+    size_t m_alive = 0;
+};
@@ -0,0 +1,416 @@
+// Ephemeris.cpp
+#include "Ephemeris.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t bodyCount;
+    uint32_t reserved;
+};
+
+const char kMagic[4] = { 'S', 'S', 'E', 'P' };
+const size_t kAlignment = 64;
+// Longest segment tried by fit(), in sample spacings.
+const size_t kMaxSegmentSamples = 64;
+
+bool sameName(const char *a, const std::string &b) {
+    size_t i = 0;
+    for(; a[i] && i < b.size(); ++i)
+        if(std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+            return false;
+    return !a[i] && i == b.size();
+}
+
+// "Target body name: Earth (399)    {source: DE441}" -> "Earth"
+std::string horizonsName(const std::string &line) {
+    std::string value = line.substr(line.find(':') + 1);
+    const size_t paren = value.find('(');
+    if(paren != std::string::npos)
+        value.resize(paren);
+    const size_t first = value.find_first_not_of(" \t");
+    const size_t last = value.find_last_not_of(" \t\r");
+    return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+}
+
+// Number right after `key` on the line, e.g. "X =" in " X =-1.77E-01 Y = 9.67E-01".
+bool valueAfter(const std::string &line, const char *key, double &value) {
+    const size_t pos = line.find(key);
+    if(pos == std::string::npos)
+        return false;
+    const char *begin = line.c_str() + pos + std::strlen(key);
+    char *end = nullptr;
+    value = std::strtod(begin, &end);
+    return end != begin;
+}
+
+// Clenshaw recurrence for one axis.
+inline double chebyshev(const double *c, int degree, double tau) {
+    const double tau2 = 2.0 * tau;
+    double b1 = 0.0, b2 = 0.0;
+    for(int k = degree; k > 0; --k) {
+        const double b = (c[k] - b2) + tau2 * b1;
+        b2 = b1;
+        b1 = b;
+    }
+    return (c[0] - b2) + tau * b1;
+}
+
+// Same for the three axes at once, x, y and z coefficients one after the
+// other: the recurrence is latency bound, three chains side by side cost
+// about as much as one. c[k] - b2 does not wait for the multiply.
+inline void chebyshev3(const double *c, int degree, double tau, double &x, double &y, double &z) {
+    const double *cy = c + degree + 1, *cz = cy + degree + 1;
+    const double tau2 = 2.0 * tau;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0, z1 = 0.0, z2 = 0.0;
+    for(int k = degree; k > 0; --k) {
+        const double xb = (c[k] - x2) + tau2 * x1;
+        const double yb = (cy[k] - y2) + tau2 * y1;
+        const double zb = (cz[k] - z2) + tau2 * z1;
+        x2 = x1;
+        x1 = xb;
+        y2 = y1;
+        y1 = yb;
+        z2 = z1;
+        z1 = zb;
+    }
+    x = (c[0] - x2) + tau * x1;
+    y = (cy[0] - y2) + tau * y1;
+    z = (cz[0] - z2) + tau * z1;
+}
+
+// Fits the segments of `count` spacings each, the last one running to the
+// last sample whatever its length; returns the largest residual.
+double fitSegments(const Ephemeris::Samples &s, size_t count, size_t segments, int degree, std::vector<double> &coefficients) {
+    const size_t terms = size_t(degree) + 1;
+    const bool velocities = !s.vx.empty();
+    const size_t lastSample = s.time.size() - 1;
+    coefficients.assign(segments * 3 * terms, 0.0);
+    std::vector<double> errors(segments, 0.0);
+
+    Parallel::parallelFor(0, segments, [&](size_t segment) {
+        // normal equations of the least-squares problem, one right-hand side per axis
+        std::vector<double> m(terms * terms, 0.0), rhs(3 * terms, 0.0), t(terms), d(terms), u(terms + 1);
+        const size_t first = segment * count;
+        const size_t last = segment + 1 == segments ? lastSample : first + count;
+        const double a = s.time[first];
+        const double half = 0.5 * (s.time[last] - a); // dt / dtau
+        const double *position[3] = { s.x.data(), s.y.data(), s.z.data() };
+        const double *velocity[3] = { s.vx.data(), s.vy.data(), s.vz.data() };
+        for(size_t j = first; j <= last; ++j) {
+            const double tau = (s.time[j] - a) / half - 1.0;
+            // T_n and T_n' = n U_{n-1}
+            t[0] = 1.0;
+            u[0] = 1.0;
+            if(terms > 1) {
+                t[1] = tau;
+                u[1] = 2.0 * tau;
+            }
+            for(size_t n = 2; n < terms; ++n) {
+                t[n] = 2.0 * tau * t[n - 1] - t[n - 2];
+                u[n] = 2.0 * tau * u[n - 1] - u[n - 2];
+            }
+            d[0] = 0.0;
+            for(size_t n = 1; n < terms; ++n)
+                d[n] = double(n) * u[n - 1];
+
+            for(size_t r = 0; r < terms; ++r) {
+                for(size_t c = 0; c < terms; ++c)
+                    m[r * terms + c] += t[r] * t[c] + (velocities ? d[r] * d[c] : 0.0);
+                for(int axis = 0; axis < 3; ++axis)
+                    rhs[axis * terms + r] += t[r] * position[axis][j] + (velocities ? d[r] * velocity[axis][j] * half : 0.0);
+            }
+        }
+
+        // Cholesky, the Chebyshev basis keeps it well conditioned
+        for(size_t c = 0; c < terms; ++c) {
+            double diagonal = m[c * terms + c];
+            for(size_t k = 0; k < c; ++k)
+                diagonal -= m[c * terms + k] * m[c * terms + k];
+            diagonal = std::sqrt(std::max(diagonal, 1e-300));
+            m[c * terms + c] = diagonal;
+            for(size_t r = c + 1; r < terms; ++r) {
+                double value = m[r * terms + c];
+                for(size_t k = 0; k < c; ++k)
+                    value -= m[r * terms + k] * m[c * terms + k];
+                m[r * terms + c] = value / diagonal;
+            }
+        }
+        double *out = &coefficients[segment * 3 * terms];
+        for(int axis = 0; axis < 3; ++axis) {
+            double *x = out + axis * terms;
+            const double *b = &rhs[axis * terms];
+            for(size_t r = 0; r < terms; ++r) {
+                double value = b[r];
+                for(size_t k = 0; k < r; ++k)
+                    value -= m[r * terms + k] * x[k];
+                x[r] = value / m[r * terms + r];
+            }
+            for(size_t r = terms; r-- > 0;) {
+                double value = x[r];
+                for(size_t k = r + 1; k < terms; ++k)
+                    value -= m[k * terms + r] * x[k];
+                x[r] = value / m[r * terms + r];
+            }
+        }
+
+        double worst = 0.0;
+        for(size_t j = first; j <= last; ++j) {
+            const double tau = (s.time[j] - a) / half - 1.0;
+            const double dx = chebyshev(out, degree, tau) - s.x[j];
+            const double dy = chebyshev(out + terms, degree, tau) - s.y[j];
+            const double dz = chebyshev(out + 2 * terms, degree, tau) - s.z[j];
+            worst = std::max(worst, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+        errors[segment] = worst;
+    }, "ephemeris.fit");
+    return *std::max_element(errors.begin(), errors.end());
+}
+
+} // namespace
+
+bool Ephemeris::open(const std::string &path) {
+    m_bodies = nullptr;
+    m_bodyCount = 0;
+    if(!m_file.open(path))
+        return false;
+
+    Header header;
+    if(m_file.size() < sizeof(Header)) {
+        m_file.close();
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(Header));
+    if(std::memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion ||
+       sizeof(Header) + size_t(header.bodyCount) * sizeof(Body) > m_file.size()) {
+        std::cerr << "ERROR: " << path << " is not a valid ephemeris" << std::endl;
+        m_file.close();
+        return false;
+    }
+
+    const Body *bodies = reinterpret_cast<const Body *>(m_file.data() + sizeof(Header));
+    for(uint32_t i = 0; i < header.bodyCount; ++i) {
+        const uint64_t bytes = uint64_t(bodies[i].segmentCount) * 3 * (bodies[i].degree + 1) * sizeof(double);
+        if(bodies[i].offset % sizeof(double) != 0 || bodies[i].offset + bytes > m_file.size() ||
+           bodies[i].segmentCount == 0 || !(bodies[i].interval > 0.0) ||
+           !(bodies[i].end > bodies[i].start + bodies[i].interval * (bodies[i].segmentCount - 1))) {
+            std::cerr << "ERROR: " << path << " is truncated" << std::endl;
+            m_file.close();
+            return false;
+        }
+    }
+    m_bodies = bodies;
+    m_bodyCount = header.bodyCount;
+    return true;
+}
+
+int Ephemeris::find(const std::string &bodyName) const {
+    for(uint32_t i = 0; i < m_bodyCount; ++i)
+        if(sameName(m_bodies[i].name, bodyName))
+            return int(i);
+    return -1;
+}
+
+void Ephemeris::position(const int body, const double t, double &x, double &y, double &z) const {
+    const Body &b = m_bodies[body];
+    const uint32_t last = b.segmentCount - 1;
+    const double s = std::max((t - b.start) / b.interval, 0.0);
+    const uint32_t segment = uint32_t(std::min(s, double(last)));
+    double tau = 2.0 * (s - double(segment)) - 1.0;
+    if(segment == last) {
+        // the last one ends with the samples, shorter or longer than the others
+        const double lastStart = b.start + b.interval * last;
+        tau = std::min(std::max(2.0 * (t - lastStart) / (b.end - lastStart) - 1.0, -1.0), 1.0);
+    }
+    const int degree = int(b.degree);
+    const double *c = reinterpret_cast<const double *>(m_file.data() + b.offset) + size_t(segment) * 3 * (degree + 1);
+    chebyshev3(c, degree, tau, x, y, z);
+}
+
+bool Ephemeris::parseHorizons(const char *text, const size_t size, Samples &samples, std::string &error) {
+    samples = Samples();
+    std::istringstream in(std::string(text, size));
+    std::string line;
+    double velocityScale = 1.0; // to distance per day
+    bool inTable = false, sawTable = false;
+    while(std::getline(in, line)) {
+        if(!inTable) {
+            if(line.compare(0, 5, "$$SOE") == 0) {
+                inTable = sawTable = true;
+            } else if(line.find("Target body name") != std::string::npos) {
+                samples.name = horizonsName(line);
+            } else if(line.find("Center body name") != std::string::npos) {
+                samples.center = horizonsName(line);
+            } else if(line.find("Output units") != std::string::npos && line.find("-S") != std::string::npos) {
+                velocityScale = 86400.0; // KM-S
+            }
+            continue;
+        }
+        if(line.compare(0, 5, "$$EOE") == 0)
+            break;
+
+        if(line.find(',') != std::string::npos) {
+            // CSV: JD, calendar date, X, Y, Z[, VX, VY, VZ, ...]
+            std::vector<double> fields;
+            std::istringstream row(line);
+            std::string field;
+            while(std::getline(row, field, ','))
+                fields.push_back(std::strtod(field.c_str(), nullptr));
+            if(fields.size() < 5) {
+                error = "short CSV row: " + line;
+                return false;
+            }
+            samples.time.push_back(fields[0]);
+            samples.x.push_back(fields[2]);
+            samples.y.push_back(fields[3]);
+            samples.z.push_back(fields[4]);
+            if(fields.size() >= 8 && !std::isnan(fields[5])) {
+                samples.vx.push_back(fields[5] * velocityScale);
+                samples.vy.push_back(fields[6] * velocityScale);
+                samples.vz.push_back(fields[7] * velocityScale);
+            }
+            continue;
+        }
+
+        double a, b, c;
+        if(valueAfter(line, "VX=", a)) {
+            if(!valueAfter(line, "VY=", b) || !valueAfter(line, "VZ=", c)) {
+                error = "bad velocity line: " + line;
+                return false;
+            }
+            samples.vx.push_back(a * velocityScale);
+            samples.vy.push_back(b * velocityScale);
+            samples.vz.push_back(c * velocityScale);
+        } else if(valueAfter(line, "X =", a)) {
+            if(!valueAfter(line, "Y =", b) || !valueAfter(line, "Z =", c)) {
+                error = "bad position line: " + line;
+                return false;
+            }
+            samples.x.push_back(a);
+            samples.y.push_back(b);
+            samples.z.push_back(c);
+        } else {
+            const size_t first = line.find_first_not_of(" \t");
+            if(first != std::string::npos && std::isdigit((unsigned char)line[first]))
+                samples.time.push_back(std::strtod(line.c_str() + first, nullptr)); // "2451545.000000000 = A.D. 2000-Jan-01 ..."
+            // light-time and range lines are skipped
+        }
+    }
+
+    if(!sawTable) {
+        error = "no $$SOE marker";
+        return false;
+    }
+    const size_t n = samples.time.size();
+    if(n < 2 || samples.x.size() != n || (!samples.vx.empty() && samples.vx.size() != n)) {
+        error = "incomplete records";
+        return false;
+    }
+    const double spacing = (samples.time[n - 1] - samples.time[0]) / double(n - 1);
+    for(size_t i = 1; i < n; ++i) {
+        if(std::fabs(samples.time[i] - samples.time[i - 1] - spacing) > 1e-6 * spacing || !(spacing > 0.0)) {
+            error = "samples must be evenly spaced in time";
+            return false;
+        }
+    }
+    if(samples.name.empty())
+        samples.name = "unnamed";
+    return true;
+}
+
+Ephemeris::Fit Ephemeris::fit(const Samples &samples, const int degree, const double tolerance) {
+    Fit result;
+    result.name = samples.name;
+    result.center = samples.center;
+    result.degree = uint32_t(degree);
+    result.start = samples.time.front();
+    result.end = samples.time.back();
+
+    const size_t n = samples.time.size();
+    double distance = 0.0;
+    for(size_t i = 0; i < n; ++i)
+        distance += std::sqrt(samples.x[i] * samples.x[i] + samples.y[i] * samples.y[i] + samples.z[i] * samples.z[i]);
+    result.meanDistance = distance / double(n);
+
+    // enough equations for the unknowns: two per sample with velocities
+    const size_t terms = size_t(degree) + 1;
+    const size_t minCount = samples.vx.empty() ? terms : (terms + 1) / 2 + 1;
+    size_t count = 1;
+    while(count * 2 <= std::min(kMaxSegmentSamples, n - 1))
+        count *= 2;
+
+    const double spacing = (samples.time.back() - samples.time.front()) / double(n - 1);
+    std::vector<double> coefficients;
+    for(; count >= std::max<size_t>(minCount, 1); count /= 2) {
+        // samples left after the whole segments get one of their own when
+        // there are enough of them for the fit, else the last one takes them
+        const size_t tail = (n - 1) % count;
+        const size_t segments = (n - 1) / count + (tail >= minCount ? 1 : 0);
+        const double error = fitSegments(samples, count, segments, degree, coefficients) / result.meanDistance;
+        if(result.coefficients.empty() || error <= tolerance || error < result.maxError) {
+            result.coefficients.swap(coefficients);
+            result.maxError = error;
+            result.segmentCount = uint32_t(segments);
+            result.interval = spacing * double(count);
+        }
+        if(error <= tolerance)
+            break;
+    }
+    return result;
+}
+
+bool Ephemeris::write(const std::string &path, const std::vector<Fit> &fits) {
+    Header header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.bodyCount = uint32_t(fits.size());
+    header.reserved = 0;
+
+    std::vector<Body> bodies(fits.size());
+    uint64_t offset = sizeof(Header) + bodies.size() * sizeof(Body);
+    for(size_t i = 0; i < fits.size(); ++i) {
+        if(fits[i].name.size() > kMaxNameLength || fits[i].center.size() > kMaxNameLength) {
+            std::cerr << "ERROR: body name too long: " << fits[i].name << std::endl;
+            return false;
+        }
+        offset = (offset + kAlignment - 1) / kAlignment * kAlignment;
+        std::memset(&bodies[i], 0, sizeof(Body));
+        std::memcpy(bodies[i].name, fits[i].name.c_str(), fits[i].name.size());
+        std::memcpy(bodies[i].center, fits[i].center.c_str(), fits[i].center.size());
+        bodies[i].start = fits[i].start;
+        bodies[i].interval = fits[i].interval;
+        bodies[i].meanDistance = fits[i].meanDistance;
+        bodies[i].end = fits[i].end;
+        bodies[i].segmentCount = fits[i].segmentCount;
+        bodies[i].degree = fits[i].degree;
+        bodies[i].offset = offset;
+        offset += fits[i].coefficients.size() * sizeof(double);
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        std::cerr << "ERROR: Could not write " << path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(bodies.data()), bodies.size() * sizeof(Body));
+    uint64_t written = sizeof(Header) + bodies.size() * sizeof(Body);
+    const char zeros[kAlignment] = {};
+    for(size_t i = 0; i < fits.size(); ++i) {
+        out.write(zeros, std::streamsize(bodies[i].offset - written));
+        out.write(reinterpret_cast<const char *>(fits[i].coefficients.data()), std::streamsize(fits[i].coefficients.size() * sizeof(double)));
+        written = bodies[i].offset + fits[i].coefficients.size() * sizeof(double);
+    }
+    return bool(out);
+}
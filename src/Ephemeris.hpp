@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Piecewise Chebyshev ephemeris in the spirit of the JPL DE files.
+//
+// Each body's position relative to its center is cut into segments, each
+// holding the Chebyshev coefficients of x, y and z over the segment.
+// Segments have a fixed length, except the last, which ends at the last
+// sample. Evaluating is an index lookup plus a Clenshaw recurrence,
+// about 3 * 2 * (degree + 1) multiply-adds, with no trigonometry. The file is
+// mapped, not read: coefficients are used in place.
+//
+// The tables are built offline by the ephemBuild tool from Horizons state
+// vector text files (parseHorizons(), fit(), write()), in the units of the
+// input (usually AU and days, time in Julian days TDB).
+//
+// Layout (little endian):
+//   Header { char magic[4] = "SSEP"; uint32 version; uint32 bodyCount; uint32 reserved; }
+//   Body   { char name[24]; char center[24]; double start, interval, meanDistance, end;
+//            uint32 segmentCount, degree; uint64 offset; } x bodyCount
+//   coefficients, per body and segment x[degree + 1] y[degree + 1] z[degree + 1], 64-byte aligned
+class Ephemeris {
+public:
+    static const uint32_t kVersion = 2;
+    static const size_t kMaxNameLength = 23;
+
+    bool open(const std::string &path);
+    inline bool isOpen() const { return m_file.isOpen(); }
+
+    inline size_t bodyCount() const { return m_bodyCount; }
+    // Index of a body by name, case insensitive; -1 if absent.
+    int find(const std::string &name) const;
+    inline const char *name(int body) const { return m_bodies[body].name; }
+    inline const char *center(int body) const { return m_bodies[body].center; }
+    inline double meanDistance(int body) const { return m_bodies[body].meanDistance; }
+    inline double start(int body) const { return m_bodies[body].start; }
+    inline double end(int body) const { return m_bodies[body].end; }
+
+    // Position relative to the center at time t, clamped to the covered span.
+    void position(int body, double t, double &x, double &y, double &z) const;
+
+    // State vectors of one Horizons table, velocities converted to distance per day.
+    struct Samples {
+        std::string name, center;
+        std::vector<double> time; // Julian days
+        std::vector<double> x, y, z, vx, vy, vz;
+    };
+    // Reads the $$SOE .. $$EOE block of a Horizons vector table, plain or CSV.
+    static bool parseHorizons(const char *text, size_t size, Samples &samples, std::string &error);
+
+    struct Fit {
+        std::string name, center;
+        double start = 0.0, interval = 0.0, meanDistance = 0.0;
+        double end = 0.0; // of the last segment, the last sample
+        uint32_t segmentCount = 0, degree = 0;
+        std::vector<double> coefficients;
+        double maxError = 0.0; // largest position residual over the samples, relative to the mean distance
+    };
+    // Least-squares fit of positions and velocities, segments in parallel. The
+    // segment length is the longest power of two times the sample spacing
+    // that keeps the residual under `tolerance` times the mean distance.
+    static Fit fit(const Samples &samples, int degree, double tolerance);
+
+    static bool write(const std::string &path, const std::vector<Fit> &fits);
+
+private:
+    struct Body {
+        char name[24];
+        char center[24];
+        double start, interval, meanDistance, end;
+        uint32_t segmentCount, degree;
+        uint64_t offset;
+    };
+
+    MappedFile m_file;
+    const Body *m_bodies = nullptr;
+    uint32_t m_bodyCount = 0;
+};
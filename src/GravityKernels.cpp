@@ -0,0 +1,345 @@
+// GravityKernels.cpp
+#include "GravityKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace GravityKernels {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// scalar
+
+void bodiesScalar(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                  const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                  float eps2, float *ax, float *ay, float *az) {
+    for(size_t i = 0; i < targetCount; ++i) {
+        float axi = 0.f, ayi = 0.f, azi = 0.f;
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const float dx = sx[j] - tx[i], dy = sy[j] - ty[i], dz = sz[j] - tz[i];
+            const float inv = 1.f / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+            const float f = mu[j] * inv * inv * inv;
+            axi += dx * f;
+            ayi += dy * f;
+            azi += dz * f;
+        }
+        ax[i] += axi;
+        ay[i] += ayi;
+        az[i] += azi;
+    }
+}
+
+void bodiesRatesScalar(const float *tx, const float *ty, const float *tz, const float *tmu, size_t targetCount,
+                       const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                       float eps2, float *ax, float *ay, float *az, float *rate) {
+    for(size_t i = 0; i < targetCount; ++i) {
+        float axi = 0.f, ayi = 0.f, azi = 0.f, ratei = rate[i];
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const float dx = sx[j] - tx[i], dy = sy[j] - ty[i], dz = sz[j] - tz[i];
+            const float d2 = dx * dx + dy * dy + dz * dz;
+            const float inv = 1.f / std::sqrt(d2 + eps2), inv3 = inv * inv * inv;
+            const float f = mu[j] * inv3;
+            axi += dx * f;
+            ayi += dy * f;
+            azi += dz * f;
+            if(mu[j] > 0.f && d2 > 0.f)
+                ratei = std::max(ratei, (tmu[i] + mu[j]) * inv3);
+        }
+        ax[i] += axi;
+        ay[i] += ayi;
+        az[i] += azi;
+        rate[i] = ratei;
+    }
+}
+
+void multipolesScalar(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                      const Multipoles &n, float eps2, float *ax, float *ay, float *az) {
+    for(size_t i = 0; i < targetCount; ++i) {
+        float axi = 0.f, ayi = 0.f, azi = 0.f;
+        for(size_t j = 0; j < n.count; ++j) {
+            const float dx = n.x[j] - tx[i], dy = n.y[j] - ty[i], dz = n.z[j] - tz[i];
+            const float inv = 1.f / std::sqrt(dx * dx + dy * dy + dz * dz + eps2), inv2 = inv * inv;
+            const float inv3 = inv * inv2, inv5 = inv3 * inv2, inv7 = inv5 * inv2;
+            const float qdx = n.qxx[j] * dx + n.qxy[j] * dy + n.qxz[j] * dz;
+            const float qdy = n.qxy[j] * dx + n.qyy[j] * dy + n.qyz[j] * dz;
+            const float qdz = n.qxz[j] * dx + n.qyz[j] * dy + n.qzz[j] * dz;
+            const float radial = n.mass[j] * inv3 + 2.5f * (dx * qdx + dy * qdy + dz * qdz) * inv7;
+            axi += dx * radial - qdx * inv5;
+            ayi += dy * radial - qdy * inv5;
+            azi += dz * radial - qdz * inv5;
+        }
+        ax[i] += axi;
+        ay[i] += ayi;
+        az[i] += azi;
+    }
+}
+
+#ifdef SOLAR_X86
+
+// ---------------------------------------------------------------------------
+// AVX2: 8 targets per register
+
+SOLAR_TARGET("avx2,fma")
+inline __m256 rsqrtAvx2(__m256 r2) {
+    // ~12 bit estimate, one Newton step brings it to float precision
+    const __m256 inv = _mm256_rsqrt_ps(r2);
+    const __m256 h = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), r2), inv);
+    return _mm256_mul_ps(inv, _mm256_fnmadd_ps(h, inv, _mm256_set1_ps(1.5f)));
+}
+
+SOLAR_TARGET("avx2,fma")
+void bodiesAvx2(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                float eps2, float *ax, float *ay, float *az) {
+    const __m256 soft = _mm256_set1_ps(eps2);
+    for(size_t i = 0; i < targetCount; i += 8) {
+        const __m256 xi = _mm256_loadu_ps(tx + i), yi = _mm256_loadu_ps(ty + i), zi = _mm256_loadu_ps(tz + i);
+        __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(sx + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(sy + j), yi);
+            const __m256 dz = _mm256_sub_ps(_mm256_broadcast_ss(sz + j), zi);
+            const __m256 inv = rsqrtAvx2(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, soft))));
+            const __m256 f = _mm256_mul_ps(_mm256_mul_ps(_mm256_broadcast_ss(mu + j), inv), _mm256_mul_ps(inv, inv));
+            axi = _mm256_fmadd_ps(dx, f, axi);
+            ayi = _mm256_fmadd_ps(dy, f, ayi);
+            azi = _mm256_fmadd_ps(dz, f, azi);
+        }
+        _mm256_storeu_ps(ax + i, _mm256_add_ps(_mm256_loadu_ps(ax + i), axi));
+        _mm256_storeu_ps(ay + i, _mm256_add_ps(_mm256_loadu_ps(ay + i), ayi));
+        _mm256_storeu_ps(az + i, _mm256_add_ps(_mm256_loadu_ps(az + i), azi));
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void bodiesRatesAvx2(const float *tx, const float *ty, const float *tz, const float *tmu, size_t targetCount,
+                     const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                     float eps2, float *ax, float *ay, float *az, float *rate) {
+    const __m256 soft = _mm256_set1_ps(eps2), zero = _mm256_setzero_ps();
+    for(size_t i = 0; i < targetCount; i += 8) {
+        const __m256 xi = _mm256_loadu_ps(tx + i), yi = _mm256_loadu_ps(ty + i), zi = _mm256_loadu_ps(tz + i);
+        const __m256 mui = _mm256_loadu_ps(tmu + i);
+        __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+        __m256 ratei = _mm256_loadu_ps(rate + i);
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(sx + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(sy + j), yi);
+            const __m256 dz = _mm256_sub_ps(_mm256_broadcast_ss(sz + j), zi);
+            const __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+            const __m256 inv = rsqrtAvx2(_mm256_add_ps(d2, soft));
+            const __m256 inv3 = _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv));
+            const __m256 muj = _mm256_broadcast_ss(mu + j);
+            const __m256 f = _mm256_mul_ps(muj, inv3);
+            axi = _mm256_fmadd_ps(dx, f, axi);
+            ayi = _mm256_fmadd_ps(dy, f, ayi);
+            azi = _mm256_fmadd_ps(dz, f, azi);
+            if(mu[j] > 0.f) {
+                const __m256 pair = _mm256_and_ps(_mm256_mul_ps(_mm256_add_ps(mui, muj), inv3), _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+                ratei = _mm256_max_ps(ratei, pair);
+            }
+        }
+        _mm256_storeu_ps(ax + i, _mm256_add_ps(_mm256_loadu_ps(ax + i), axi));
+        _mm256_storeu_ps(ay + i, _mm256_add_ps(_mm256_loadu_ps(ay + i), ayi));
+        _mm256_storeu_ps(az + i, _mm256_add_ps(_mm256_loadu_ps(az + i), azi));
+        _mm256_storeu_ps(rate + i, ratei);
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void multipolesAvx2(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                    const Multipoles &n, float eps2, float *ax, float *ay, float *az) {
+    const __m256 soft = _mm256_set1_ps(eps2), fiveHalves = _mm256_set1_ps(2.5f);
+    for(size_t i = 0; i < targetCount; i += 8) {
+        const __m256 xi = _mm256_loadu_ps(tx + i), yi = _mm256_loadu_ps(ty + i), zi = _mm256_loadu_ps(tz + i);
+        __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+        for(size_t j = 0; j < n.count; ++j) {
+            const __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(n.x + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(n.y + j), yi);
+            const __m256 dz = _mm256_sub_ps(_mm256_broadcast_ss(n.z + j), zi);
+            const __m256 inv = rsqrtAvx2(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, soft))));
+            const __m256 inv2 = _mm256_mul_ps(inv, inv);
+            const __m256 inv3 = _mm256_mul_ps(inv, inv2), inv5 = _mm256_mul_ps(inv3, inv2), inv7 = _mm256_mul_ps(inv5, inv2);
+            const __m256 qxx = _mm256_broadcast_ss(n.qxx + j), qyy = _mm256_broadcast_ss(n.qyy + j), qzz = _mm256_broadcast_ss(n.qzz + j);
+            const __m256 qxy = _mm256_broadcast_ss(n.qxy + j), qxz = _mm256_broadcast_ss(n.qxz + j), qyz = _mm256_broadcast_ss(n.qyz + j);
+            const __m256 qdx = _mm256_fmadd_ps(qxx, dx, _mm256_fmadd_ps(qxy, dy, _mm256_mul_ps(qxz, dz)));
+            const __m256 qdy = _mm256_fmadd_ps(qxy, dx, _mm256_fmadd_ps(qyy, dy, _mm256_mul_ps(qyz, dz)));
+            const __m256 qdz = _mm256_fmadd_ps(qxz, dx, _mm256_fmadd_ps(qyz, dy, _mm256_mul_ps(qzz, dz)));
+            const __m256 dqd = _mm256_fmadd_ps(dx, qdx, _mm256_fmadd_ps(dy, qdy, _mm256_mul_ps(dz, qdz)));
+            const __m256 radial = _mm256_fmadd_ps(_mm256_broadcast_ss(n.mass + j), inv3, _mm256_mul_ps(_mm256_mul_ps(fiveHalves, dqd), inv7));
+            axi = _mm256_add_ps(axi, _mm256_fmsub_ps(dx, radial, _mm256_mul_ps(qdx, inv5)));
+            ayi = _mm256_add_ps(ayi, _mm256_fmsub_ps(dy, radial, _mm256_mul_ps(qdy, inv5)));
+            azi = _mm256_add_ps(azi, _mm256_fmsub_ps(dz, radial, _mm256_mul_ps(qdz, inv5)));
+        }
+        _mm256_storeu_ps(ax + i, _mm256_add_ps(_mm256_loadu_ps(ax + i), axi));
+        _mm256_storeu_ps(ay + i, _mm256_add_ps(_mm256_loadu_ps(ay + i), ayi));
+        _mm256_storeu_ps(az + i, _mm256_add_ps(_mm256_loadu_ps(az + i), azi));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512: 16 targets per register
+
+SOLAR_TARGET("avx512f")
+inline __m512 rsqrtAvx512(__m512 r2) {
+    // 14 bit estimate, one Newton step brings it to float precision. The zero-masked
+    // form with every lane on: GCC's plain one merges into _mm512_undefined_ps(),
+    // which -Wmaybe-uninitialized reports in every caller.
+    const __m512 inv = _mm512_maskz_rsqrt14_ps(__mmask16(0xFFFF), r2);
+    const __m512 h = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), r2), inv);
+    return _mm512_mul_ps(inv, _mm512_fnmadd_ps(h, inv, _mm512_set1_ps(1.5f)));
+}
+
+SOLAR_TARGET("avx512f")
+void bodiesAvx512(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                  const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                  float eps2, float *ax, float *ay, float *az) {
+    const __m512 soft = _mm512_set1_ps(eps2);
+    for(size_t i = 0; i < targetCount; i += 16) {
+        const __m512 xi = _mm512_loadu_ps(tx + i), yi = _mm512_loadu_ps(ty + i), zi = _mm512_loadu_ps(tz + i);
+        __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(sx[j]), xi);
+            const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(sy[j]), yi);
+            const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(sz[j]), zi);
+            const __m512 inv = rsqrtAvx512(_mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dz, dz, soft))));
+            const __m512 f = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(mu[j]), inv), _mm512_mul_ps(inv, inv));
+            axi = _mm512_fmadd_ps(dx, f, axi);
+            ayi = _mm512_fmadd_ps(dy, f, ayi);
+            azi = _mm512_fmadd_ps(dz, f, azi);
+        }
+        _mm512_storeu_ps(ax + i, _mm512_add_ps(_mm512_loadu_ps(ax + i), axi));
+        _mm512_storeu_ps(ay + i, _mm512_add_ps(_mm512_loadu_ps(ay + i), ayi));
+        _mm512_storeu_ps(az + i, _mm512_add_ps(_mm512_loadu_ps(az + i), azi));
+    }
+}
+
+SOLAR_TARGET("avx512f")
+void bodiesRatesAvx512(const float *tx, const float *ty, const float *tz, const float *tmu, size_t targetCount,
+                       const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                       float eps2, float *ax, float *ay, float *az, float *rate) {
+    const __m512 soft = _mm512_set1_ps(eps2), zero = _mm512_setzero_ps();
+    for(size_t i = 0; i < targetCount; i += 16) {
+        const __m512 xi = _mm512_loadu_ps(tx + i), yi = _mm512_loadu_ps(ty + i), zi = _mm512_loadu_ps(tz + i);
+        const __m512 mui = _mm512_loadu_ps(tmu + i);
+        __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+        __m512 ratei = _mm512_loadu_ps(rate + i);
+        for(size_t j = 0; j < sourceCount; ++j) {
+            const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(sx[j]), xi);
+            const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(sy[j]), yi);
+            const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(sz[j]), zi);
+            const __m512 d2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+            const __m512 inv = rsqrtAvx512(_mm512_add_ps(d2, soft));
+            const __m512 inv3 = _mm512_mul_ps(inv, _mm512_mul_ps(inv, inv));
+            const __m512 muj = _mm512_set1_ps(mu[j]);
+            const __m512 f = _mm512_mul_ps(muj, inv3);
+            axi = _mm512_fmadd_ps(dx, f, axi);
+            ayi = _mm512_fmadd_ps(dy, f, ayi);
+            azi = _mm512_fmadd_ps(dz, f, azi);
+            if(mu[j] > 0.f) {
+                const __mmask16 apart = _mm512_cmp_ps_mask(d2, zero, _CMP_GT_OQ);
+                ratei = _mm512_mask_max_ps(ratei, apart, ratei, _mm512_mul_ps(_mm512_add_ps(mui, muj), inv3));
+            }
+        }
+        _mm512_storeu_ps(ax + i, _mm512_add_ps(_mm512_loadu_ps(ax + i), axi));
+        _mm512_storeu_ps(ay + i, _mm512_add_ps(_mm512_loadu_ps(ay + i), ayi));
+        _mm512_storeu_ps(az + i, _mm512_add_ps(_mm512_loadu_ps(az + i), azi));
+        _mm512_storeu_ps(rate + i, ratei);
+    }
+}
+
+SOLAR_TARGET("avx512f")
+void multipolesAvx512(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                      const Multipoles &n, float eps2, float *ax, float *ay, float *az) {
+    const __m512 soft = _mm512_set1_ps(eps2), fiveHalves = _mm512_set1_ps(2.5f);
+    for(size_t i = 0; i < targetCount; i += 16) {
+        const __m512 xi = _mm512_loadu_ps(tx + i), yi = _mm512_loadu_ps(ty + i), zi = _mm512_loadu_ps(tz + i);
+        __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+        for(size_t j = 0; j < n.count; ++j) {
+            const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(n.x[j]), xi);
+            const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(n.y[j]), yi);
+            const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(n.z[j]), zi);
+            const __m512 inv = rsqrtAvx512(_mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dz, dz, soft))));
+            const __m512 inv2 = _mm512_mul_ps(inv, inv);
+            const __m512 inv3 = _mm512_mul_ps(inv, inv2), inv5 = _mm512_mul_ps(inv3, inv2), inv7 = _mm512_mul_ps(inv5, inv2);
+            const __m512 qxx = _mm512_set1_ps(n.qxx[j]), qyy = _mm512_set1_ps(n.qyy[j]), qzz = _mm512_set1_ps(n.qzz[j]);
+            const __m512 qxy = _mm512_set1_ps(n.qxy[j]), qxz = _mm512_set1_ps(n.qxz[j]), qyz = _mm512_set1_ps(n.qyz[j]);
+            const __m512 qdx = _mm512_fmadd_ps(qxx, dx, _mm512_fmadd_ps(qxy, dy, _mm512_mul_ps(qxz, dz)));
+            const __m512 qdy = _mm512_fmadd_ps(qxy, dx, _mm512_fmadd_ps(qyy, dy, _mm512_mul_ps(qyz, dz)));
+            const __m512 qdz = _mm512_fmadd_ps(qxz, dx, _mm512_fmadd_ps(qyz, dy, _mm512_mul_ps(qzz, dz)));
+            const __m512 dqd = _mm512_fmadd_ps(dx, qdx, _mm512_fmadd_ps(dy, qdy, _mm512_mul_ps(dz, qdz)));
+            const __m512 radial = _mm512_fmadd_ps(_mm512_set1_ps(n.mass[j]), inv3, _mm512_mul_ps(_mm512_mul_ps(fiveHalves, dqd), inv7));
+            axi = _mm512_add_ps(axi, _mm512_fmsub_ps(dx, radial, _mm512_mul_ps(qdx, inv5)));
+            ayi = _mm512_add_ps(ayi, _mm512_fmsub_ps(dy, radial, _mm512_mul_ps(qdy, inv5)));
+            azi = _mm512_add_ps(azi, _mm512_fmsub_ps(dz, radial, _mm512_mul_ps(qdz, inv5)));
+        }
+        _mm512_storeu_ps(ax + i, _mm512_add_ps(_mm512_loadu_ps(ax + i), axi));
+        _mm512_storeu_ps(ay + i, _mm512_add_ps(_mm512_loadu_ps(ay + i), ayi));
+        _mm512_storeu_ps(az + i, _mm512_add_ps(_mm512_loadu_ps(az + i), azi));
+    }
+}
+
+#endif // SOLAR_X86
+
+// ---------------------------------------------------------------------------
+// dispatch
+
+struct KernelTable {
+    void (*bodies)(const float *, const float *, const float *, size_t,
+                   const float *, const float *, const float *, const float *, size_t,
+                   float, float *, float *, float *);
+    void (*bodiesRates)(const float *, const float *, const float *, const float *, size_t,
+                        const float *, const float *, const float *, const float *, size_t,
+                        float, float *, float *, float *, float *);
+    void (*multipoles)(const float *, const float *, const float *, size_t,
+                       const Multipoles &, float, float *, float *, float *);
+    SimdLevel level;
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_X86
+    const SimdLevel level = CpuFeatures::get().level();
+    if(level >= SimdLevel::AVX512) {
+        const KernelTable t = { bodiesAvx512, bodiesRatesAvx512, multipolesAvx512, SimdLevel::AVX512 };
+        return t;
+    }
+    if(level >= SimdLevel::AVX2) {
+        const KernelTable t = { bodiesAvx2, bodiesRatesAvx2, multipolesAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+#endif
+    const KernelTable t = { bodiesScalar, bodiesRatesScalar, multipolesScalar, SimdLevel::Scalar };
+    return t;
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+void accumulateBodies(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                      const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                      float eps2, float *ax, float *ay, float *az) {
+    kernels().bodies(tx, ty, tz, targetCount, sx, sy, sz, mu, sourceCount, eps2, ax, ay, az);
+}
+
+void accumulateBodiesAndRates(const float *tx, const float *ty, const float *tz, const float *tmu, size_t targetCount,
+                              const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                              float eps2, float *ax, float *ay, float *az, float *rate) {
+    kernels().bodiesRates(tx, ty, tz, tmu, targetCount, sx, sy, sz, mu, sourceCount, eps2, ax, ay, az, rate);
+}
+
+void accumulateMultipoles(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                          const Multipoles &nodes, float eps2, float *ax, float *ay, float *az) {
+    kernels().multipoles(tx, ty, tz, targetCount, nodes, eps2, ax, ay, az);
+}
+
+SimdLevel activeLevel() { return kernels().level; }
+
+} // namespace GravityKernels
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+#include "CpuFeatures.hpp"
+
+// Inner loops shared by the gravity solvers (NBody, BarnesHut).
+//
+// Both vectorize over targets (16 lanes with AVX-512, 8 with AVX2, scalar
+// otherwise) and broadcast one source at a time, so the caller picks the
+// blocking. Target counts must be padded to a multiple of kTargetPadding;
+// results are *added* to ax/ay/az. Softened with eps2, so a target that is
+// also a source (dx = 0) gets nothing from itself.
+namespace GravityKernels {
+
+const size_t kTargetPadding = 16;
+
+// Point masses: a += mu * d / (|d|^2 + eps2)^1.5 with d = source - target.
+void accumulateBodies(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                      const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                      float eps2, float *ax, float *ay, float *az);
+
+// Same, and also raises rate[i] to the largest (mu_i + mu_j) / r^3 over the
+// massive sources j other than the target itself: the squared angular
+// frequency of the tightest orbit the target is part of, which sets its timestep.
+void accumulateBodiesAndRates(const float *tx, const float *ty, const float *tz, const float *tmu, size_t targetCount,
+                              const float *sx, const float *sy, const float *sz, const float *mu, size_t sourceCount,
+                              float eps2, float *ax, float *ay, float *az, float *rate);
+
+// Multipole expansions (monopole plus traceless quadrupole) of tree nodes.
+struct Multipoles {
+    const float *x, *y, *z, *mass;
+    const float *qxx, *qyy, *qzz, *qxy, *qxz, *qyz;
+    size_t count;
+};
+void accumulateMultipoles(const float *tx, const float *ty, const float *tz, size_t targetCount,
+                          const Multipoles &nodes, float eps2, float *ax, float *ay, float *az);
+
+// Level actually used.
+SimdLevel activeLevel();
+
+} // namespace GravityKernels
@@ -0,0 +1,548 @@
+// ImageKernels.cpp
+#include "ImageKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace ImageKernels {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// lookup tables shared by every implementation
+
+const int kEncodeSize = 16384; // linear -> sRGB table resolution
+
+struct Tables {
+    // [0, 256): sRGB byte -> linear float, [256, 512): alpha byte -> float
+    float decode[512];
+    unsigned char encode[kEncodeSize];
+    // 8-tap Kaiser-windowed sinc for 2x decimation, taps at -3.5 .. 3.5
+    float kaiser[8];
+
+    Tables() {
+        for(int i = 0; i < 256; ++i) {
+            const double c = i / 255.0;
+            decode[i] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            decode[256 + i] = float(c);
+        }
+        for(int i = 0; i < kEncodeSize; ++i) {
+            const double l = double(i) / (kEncodeSize - 1);
+            const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            encode[i] = (unsigned char)std::min(255.0, std::floor(c * 255.0 + 0.5));
+        }
+
+        const double PI = 3.14159265358979323846;
+        const double alpha = 4.0, halfWidth = 4.0;
+        double sum = 0.0, w[8];
+        for(int k = 0; k < 8; ++k) {
+            const double x = k - 3.5;          // distance in source pixels
+            const double s = 0.5 * x;          // cutoff at half the source rate
+            const double sinc = std::sin(PI * s) / (PI * s);
+            const double r = x / halfWidth;
+            w[k] = sinc * besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+            sum += w[k];
+        }
+        for(int k = 0; k < 8; ++k)
+            kaiser[k] = float(w[k] / sum);
+    }
+
+    static double besselI0(double x) {
+        double sum = 1.0, term = 1.0;
+        for(int k = 1; k < 32; ++k) {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+const Tables &tables() {
+    static const Tables t;
+    return t;
+}
+
+inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+inline unsigned char encodeColor(float l) {
+    const float x = l * (kEncodeSize - 1) + 0.5f;
+    return tables().encode[clampi(int(x), 0, kEncodeSize - 1)];
+}
+
+inline unsigned char encodeAlpha(float a) {
+    return (unsigned char)clampi(int(a * 255.f + 0.5f), 0, 255);
+}
+
+// ---------------------------------------------------------------------------
+// scalar implementations
+
+void flipRowsScalar(unsigned char *pixels, size_t rowBytes, int height) {
+    for(int y = 0; y < height / 2; ++y) {
+        unsigned char *a = pixels + y * rowBytes;
+        unsigned char *b = pixels + (height - 1 - y) * rowBytes;
+        for(size_t i = 0; i < rowBytes; ++i)
+            std::swap(a[i], b[i]);
+    }
+}
+
+void rgbToRgbaScalar(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount) {
+    for(size_t i = 0; i < pixelCount; ++i) {
+        rgba[4 * i + 0] = rgb[3 * i + 0];
+        rgba[4 * i + 1] = rgb[3 * i + 1];
+        rgba[4 * i + 2] = rgb[3 * i + 2];
+        rgba[4 * i + 3] = 255;
+    }
+}
+
+void srgbToLinearScalar(const unsigned char *rgba, float *linear, size_t pixelCount) {
+    const float *decode = tables().decode;
+    for(size_t i = 0; i < pixelCount; ++i) {
+        linear[4 * i + 0] = decode[rgba[4 * i + 0]];
+        linear[4 * i + 1] = decode[rgba[4 * i + 1]];
+        linear[4 * i + 2] = decode[rgba[4 * i + 2]];
+        linear[4 * i + 3] = decode[256 + rgba[4 * i + 3]];
+    }
+}
+
+void linearToSrgbScalar(const float *linear, unsigned char *rgba, size_t pixelCount) {
+    for(size_t i = 0; i < pixelCount; ++i) {
+        rgba[4 * i + 0] = encodeColor(linear[4 * i + 0]);
+        rgba[4 * i + 1] = encodeColor(linear[4 * i + 1]);
+        rgba[4 * i + 2] = encodeColor(linear[4 * i + 2]);
+        rgba[4 * i + 3] = encodeAlpha(linear[4 * i + 3]);
+    }
+}
+
+void downsampleBoxScalar(const unsigned char *src, int width, int height, unsigned char *dst) {
+    const float *decode = tables().decode;
+    const int outW = std::max(1, width / 2), outH = std::max(1, height / 2);
+    for(int y = 0; y < outH; ++y) {
+        const unsigned char *r0 = src + size_t(std::min(2 * y, height - 1)) * width * 4;
+        const unsigned char *r1 = src + size_t(std::min(2 * y + 1, height - 1)) * width * 4;
+        for(int x = 0; x < outW; ++x) {
+            const int x0 = std::min(2 * x, width - 1) * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+            unsigned char *out = dst + (size_t(y) * outW + x) * 4;
+            for(int c = 0; c < 4; ++c) {
+                const int o = c == 3 ? 256 : 0;
+                const float s = decode[o + r0[x0 + c]] + decode[o + r0[x1 + c]] + decode[o + r1[x0 + c]] + decode[o + r1[x1 + c]];
+                out[c] = c == 3 ? encodeAlpha(0.25f * s) : encodeColor(0.25f * s);
+            }
+        }
+    }
+}
+
+// one horizontal Kaiser pass over a linear RGBA row: width -> outW pixels
+void kaiserRowScalar(const float *src, int width, float *dst, int outW) {
+    const float *w = tables().kaiser;
+    for(int x = 0; x < outW; ++x) {
+        float acc[4] = { 0.f, 0.f, 0.f, 0.f };
+        for(int k = 0; k < 8; ++k) {
+            const float *p = src + clampi(2 * x - 3 + k, 0, width - 1) * 4;
+            for(int c = 0; c < 4; ++c)
+                acc[c] += w[k] * p[c];
+        }
+        std::memcpy(dst + x * 4, acc, sizeof(acc));
+    }
+}
+
+// vertical pass: weighted sum of 8 rows of `count` floats
+void kaiserColumnScalar(const float *const rows[8], float *dst, size_t count) {
+    const float *w = tables().kaiser;
+    for(size_t i = 0; i < count; ++i) {
+        float acc = 0.f;
+        for(int k = 0; k < 8; ++k)
+            acc += w[k] * rows[k][i];
+        dst[i] = acc;
+    }
+}
+
+#ifdef SOLAR_X86
+// ---------------------------------------------------------------------------
+// SSE implementations (SSE2 + SSSE3 + SSE4.1)
+
+SOLAR_TARGET("sse4.1")
+void flipRowsSse(unsigned char *pixels, size_t rowBytes, int height) {
+    for(int y = 0; y < height / 2; ++y) {
+        unsigned char *a = pixels + y * rowBytes;
+        unsigned char *b = pixels + (height - 1 - y) * rowBytes;
+        size_t i = 0;
+        for(; i + 16 <= rowBytes; i += 16) {
+            const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(a + i), vb);
+            _mm_storeu_si128((__m128i *)(b + i), va);
+        }
+        for(; i < rowBytes; ++i)
+            std::swap(a[i], b[i]);
+    }
+}
+
+SOLAR_TARGET("sse4.1")
+void rgbToRgbaSse(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+    size_t i = 0;
+    // each step consumes 12 bytes but loads 16, so stop before overreading
+    for(; i + 6 <= pixelCount; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(rgb + 3 * i));
+        _mm_storeu_si128((__m128i *)(rgba + 4 * i), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+    }
+    rgbToRgbaScalar(rgb + 3 * i, rgba + 4 * i, pixelCount - i);
+}
+
+SOLAR_TARGET("sse4.1")
+inline __m128 loadLinearPixelSse(const unsigned char *p, const float *decode) {
+    return _mm_setr_ps(decode[p[0]], decode[p[1]], decode[p[2]], decode[256 + p[3]]);
+}
+
+SOLAR_TARGET("sse4.1")
+inline void storeSrgbPixelSse(__m128 l, unsigned char *out) {
+    const __m128 scale = _mm_setr_ps(kEncodeSize - 1, kEncodeSize - 1, kEncodeSize - 1, 255.f);
+    const __m128 hi = _mm_setr_ps(kEncodeSize - 1, kEncodeSize - 1, kEncodeSize - 1, 255.f);
+    __m128 x = _mm_add_ps(_mm_mul_ps(l, scale), _mm_set1_ps(0.5f));
+    x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), hi);
+    alignas(16) int idx[4];
+    _mm_store_si128((__m128i *)idx, _mm_cvttps_epi32(x));
+    const unsigned char *encode = tables().encode;
+    out[0] = encode[idx[0]];
+    out[1] = encode[idx[1]];
+    out[2] = encode[idx[2]];
+    out[3] = (unsigned char)idx[3];
+}
+
+SOLAR_TARGET("sse4.1")
+void srgbToLinearSse(const unsigned char *rgba, float *linear, size_t pixelCount) {
+    const float *decode = tables().decode;
+    for(size_t i = 0; i < pixelCount; ++i)
+        _mm_storeu_ps(linear + 4 * i, loadLinearPixelSse(rgba + 4 * i, decode));
+}
+
+SOLAR_TARGET("sse4.1")
+void linearToSrgbSse(const float *linear, unsigned char *rgba, size_t pixelCount) {
+    for(size_t i = 0; i < pixelCount; ++i)
+        storeSrgbPixelSse(_mm_loadu_ps(linear + 4 * i), rgba + 4 * i);
+}
+
+SOLAR_TARGET("sse4.1")
+void downsampleBoxSse(const unsigned char *src, int width, int height, unsigned char *dst) {
+    const float *decode = tables().decode;
+    const int outW = std::max(1, width / 2), outH = std::max(1, height / 2);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for(int y = 0; y < outH; ++y) {
+        const unsigned char *r0 = src + size_t(std::min(2 * y, height - 1)) * width * 4;
+        const unsigned char *r1 = src + size_t(std::min(2 * y + 1, height - 1)) * width * 4;
+        for(int x = 0; x < outW; ++x) {
+            const int x0 = std::min(2 * x, width - 1) * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+            __m128 s = _mm_add_ps(loadLinearPixelSse(r0 + x0, decode), loadLinearPixelSse(r0 + x1, decode));
+            s = _mm_add_ps(s, _mm_add_ps(loadLinearPixelSse(r1 + x0, decode), loadLinearPixelSse(r1 + x1, decode)));
+            storeSrgbPixelSse(_mm_mul_ps(s, quarter), dst + (size_t(y) * outW + x) * 4);
+        }
+    }
+}
+
+// one output pixel of the horizontal Kaiser pass, clamping taps at the borders
+SOLAR_TARGET("sse4.1")
+inline __m128 kaiserPixelSse(const float *src, int width, int x) {
+    const float *w = tables().kaiser;
+    const int first = 2 * x - 3;
+    __m128 acc = _mm_setzero_ps();
+    if(first >= 0 && first + 7 < width) {
+        for(int k = 0; k < 8; ++k)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(src + (first + k) * 4)));
+    } else {
+        for(int k = 0; k < 8; ++k)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(src + clampi(first + k, 0, width - 1) * 4)));
+    }
+    return acc;
+}
+
+SOLAR_TARGET("sse4.1")
+void kaiserRowSse(const float *src, int width, float *dst, int outW) {
+    for(int x = 0; x < outW; ++x)
+        _mm_storeu_ps(dst + x * 4, kaiserPixelSse(src, width, x));
+}
+
+SOLAR_TARGET("sse4.1")
+void kaiserColumnSse(const float *const rows[8], float *dst, size_t count) {
+    const float *w = tables().kaiser;
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for(int k = 0; k < 8; ++k)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(rows[k] + i)));
+        _mm_storeu_ps(dst + i, acc);
+    }
+    for(; i < count; ++i) {
+        float acc = 0.f;
+        for(int k = 0; k < 8; ++k)
+            acc += w[k] * rows[k][i];
+        dst[i] = acc;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 implementations
+
+SOLAR_TARGET("avx2,fma")
+void flipRowsAvx2(unsigned char *pixels, size_t rowBytes, int height) {
+    for(int y = 0; y < height / 2; ++y) {
+        unsigned char *a = pixels + y * rowBytes;
+        unsigned char *b = pixels + (height - 1 - y) * rowBytes;
+        size_t i = 0;
+        for(; i + 32 <= rowBytes; i += 32) {
+            const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+            const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+            _mm256_storeu_si256((__m256i *)(a + i), vb);
+            _mm256_storeu_si256((__m256i *)(b + i), va);
+        }
+        for(; i < rowBytes; ++i)
+            std::swap(a[i], b[i]);
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void rgbToRgbaAvx2(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+    size_t i = 0;
+    // 8 pixels per step: two 16-byte loads at byte 0 and 12, so 28 bytes must be readable
+    for(; i + 10 <= pixelCount; i += 8) {
+        const unsigned char *p = rgb + 3 * i;
+        const __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+            _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+        _mm256_storeu_si256((__m256i *)(rgba + 4 * i), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+    }
+    rgbToRgbaSse(rgb + 3 * i, rgba + 4 * i, pixelCount - i);
+}
+
+// two RGBA8 pixels -> 8 linear floats, through a gather on the decode table
+SOLAR_TARGET("avx2,fma")
+inline __m256 loadLinear2Avx2(const unsigned char *p, const float *decode) {
+    const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+    const __m256i idx = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p)), alphaOffset);
+    return _mm256_i32gather_ps(decode, idx, 4);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void storeSrgb2Avx2(__m256 l, unsigned char *out) {
+    const __m256 scale = _mm256_setr_ps(kEncodeSize - 1, kEncodeSize - 1, kEncodeSize - 1, 255.f,
+                                        kEncodeSize - 1, kEncodeSize - 1, kEncodeSize - 1, 255.f);
+    __m256 x = _mm256_fmadd_ps(l, scale, _mm256_set1_ps(0.5f));
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), scale);
+    alignas(32) int idx[8];
+    _mm256_store_si256((__m256i *)idx, _mm256_cvttps_epi32(x));
+    const unsigned char *encode = tables().encode;
+    for(int p = 0; p < 8; p += 4) {
+        out[p + 0] = encode[idx[p + 0]];
+        out[p + 1] = encode[idx[p + 1]];
+        out[p + 2] = encode[idx[p + 2]];
+        out[p + 3] = (unsigned char)idx[p + 3];
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void srgbToLinearAvx2(const unsigned char *rgba, float *linear, size_t pixelCount) {
+    const float *decode = tables().decode;
+    size_t i = 0;
+    for(; i + 2 <= pixelCount; i += 2)
+        _mm256_storeu_ps(linear + 4 * i, loadLinear2Avx2(rgba + 4 * i, decode));
+    srgbToLinearScalar(rgba + 4 * i, linear + 4 * i, pixelCount - i);
+}
+
+SOLAR_TARGET("avx2,fma")
+void linearToSrgbAvx2(const float *linear, unsigned char *rgba, size_t pixelCount) {
+    size_t i = 0;
+    for(; i + 2 <= pixelCount; i += 2)
+        storeSrgb2Avx2(_mm256_loadu_ps(linear + 4 * i), rgba + 4 * i);
+    linearToSrgbScalar(linear + 4 * i, rgba + 4 * i, pixelCount - i);
+}
+
+SOLAR_TARGET("avx2,fma")
+void downsampleBoxAvx2(const unsigned char *src, int width, int height, unsigned char *dst) {
+    if(width < 4) {
+        downsampleBoxSse(src, width, height, dst);
+        return;
+    }
+    const float *decode = tables().decode;
+    const int outW = width / 2, outH = std::max(1, height / 2);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    for(int y = 0; y < outH; ++y) {
+        const unsigned char *r0 = src + size_t(std::min(2 * y, height - 1)) * width * 4;
+        const unsigned char *r1 = src + size_t(std::min(2 * y + 1, height - 1)) * width * 4;
+        unsigned char *out = dst + size_t(y) * outW * 4;
+        int x = 0;
+        // two output pixels per step: a 2x2 block is two adjacent source pixel pairs per row
+        for(; x + 2 <= outW; x += 2) {
+            const __m256 a = _mm256_add_ps(loadLinear2Avx2(r0 + 8 * x, decode), loadLinear2Avx2(r1 + 8 * x, decode));
+            const __m256 b = _mm256_add_ps(loadLinear2Avx2(r0 + 8 * x + 8, decode), loadLinear2Avx2(r1 + 8 * x + 8, decode));
+            // a = [p0 | p1] and b = [p2 | p3]; output 0 is p0 + p1, output 1 is p2 + p3
+            const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+            const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+            storeSrgb2Avx2(_mm256_mul_ps(_mm256_add_ps(lo, hi), quarter), out + 4 * x);
+        }
+        for(; x < outW; ++x) {
+            const int x0 = 2 * x * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+            __m128 s = _mm_add_ps(loadLinearPixelSse(r0 + x0, decode), loadLinearPixelSse(r0 + x1, decode));
+            s = _mm_add_ps(s, _mm_add_ps(loadLinearPixelSse(r1 + x0, decode), loadLinearPixelSse(r1 + x1, decode)));
+            storeSrgbPixelSse(_mm_mul_ps(s, _mm_set1_ps(0.25f)), out + 4 * x);
+        }
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void kaiserRowAvx2(const float *src, int width, float *dst, int outW) {
+    const float *w = tables().kaiser;
+    for(int x = 0; x < outW;) {
+        const int first = 2 * x - 3;
+        if(x + 2 <= outW && first >= 0 && first + 9 < width) {
+            // two output pixels per register, their taps are 2 source pixels apart
+            __m256 acc = _mm256_setzero_ps();
+            for(int k = 0; k < 8; ++k) {
+                const __m256 p = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + (first + k) * 4)),
+                                                      _mm_loadu_ps(src + (first + k + 2) * 4), 1);
+                acc = _mm256_fmadd_ps(_mm256_set1_ps(w[k]), p, acc);
+            }
+            _mm256_storeu_ps(dst + x * 4, acc);
+            x += 2;
+        } else {
+            _mm_storeu_ps(dst + x * 4, kaiserPixelSse(src, width, x));
+            ++x;
+        }
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void kaiserColumnAvx2(const float *const rows[8], float *dst, size_t count) {
+    const float *w = tables().kaiser;
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for(int k = 0; k < 8; ++k)
+            acc = _mm256_fmadd_ps(_mm256_set1_ps(w[k]), _mm256_loadu_ps(rows[k] + i), acc);
+        _mm256_storeu_ps(dst + i, acc);
+    }
+    const float *tail[8];
+    for(int k = 0; k < 8; ++k)
+        tail[k] = rows[k] + i;
+    kaiserColumnSse(tail, dst + i, count - i);
+}
+#endif // SOLAR_X86
+
+// ---------------------------------------------------------------------------
+// dispatch
+
+struct KernelTable {
+    void (*flipRows)(unsigned char *, size_t, int);
+    void (*rgbToRgba)(const unsigned char *, unsigned char *, size_t);
+    void (*srgbToLinear)(const unsigned char *, float *, size_t);
+    void (*linearToSrgb)(const float *, unsigned char *, size_t);
+    void (*downsampleBox)(const unsigned char *, int, int, unsigned char *);
+    void (*kaiserRow)(const float *, int, float *, int);
+    void (*kaiserColumn)(const float *const[8], float *, size_t);
+    SimdLevel level;
+};
+
+const KernelTable kScalarTable = {
+    flipRowsScalar, rgbToRgbaScalar, srgbToLinearScalar, linearToSrgbScalar,
+    downsampleBoxScalar, kaiserRowScalar, kaiserColumnScalar, SimdLevel::Scalar
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_X86
+    const SimdLevel level = CpuFeatures::get().level();
+    if(level >= SimdLevel::AVX2) {
+        const KernelTable t = { flipRowsAvx2, rgbToRgbaAvx2, srgbToLinearAvx2, linearToSrgbAvx2,
+                                downsampleBoxAvx2, kaiserRowAvx2, kaiserColumnAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+    if(level >= SimdLevel::SSE) {
+        const KernelTable t = { flipRowsSse, rgbToRgbaSse, srgbToLinearSse, linearToSrgbSse,
+                                downsampleBoxSse, kaiserRowSse, kaiserColumnSse, SimdLevel::SSE };
+        return t;
+    }
+#endif
+    return kScalarTable;
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+void downsampleKaiserWith(const KernelTable &k, const unsigned char *src, int width, int height, unsigned char *dst) {
+    const int outW = std::max(1, width / 2), outH = std::max(1, height / 2);
+
+    // Rows are decoded and filtered horizontally on demand into a ring of 8
+    // half-width rows, which is exactly the footprint of the vertical pass.
+    std::vector<float> linear(size_t(width) * 4);
+    std::vector<float> ring(size_t(outW) * 4 * 8);
+    int ringRow[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+    std::vector<float> row(size_t(outW) * 4);
+    const float *rows[8];
+    for(int y = 0; y < outH; ++y) {
+        for(int t = 0; t < 8; ++t) {
+            const int r = clampi(2 * y - 3 + t, 0, height - 1);
+            const int slot = r & 7;
+            float *half = ring.data() + size_t(slot) * outW * 4;
+            if(ringRow[slot] != r) {
+                k.srgbToLinear(src + size_t(r) * width * 4, linear.data(), width);
+                k.kaiserRow(linear.data(), width, half, outW);
+                ringRow[slot] = r;
+            }
+            rows[t] = half;
+        }
+        k.kaiserColumn(rows, row.data(), row.size());
+        k.linearToSrgb(row.data(), dst + size_t(y) * outW * 4, outW);
+    }
+}
+
+} // namespace
+
+void flipRows(unsigned char *pixels, size_t rowBytes, int height) { kernels().flipRows(pixels, rowBytes, height); }
+void rgbToRgba(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount) { kernels().rgbToRgba(rgb, rgba, pixelCount); }
+void srgbToLinear(const unsigned char *rgba, float *linear, size_t pixelCount) { kernels().srgbToLinear(rgba, linear, pixelCount); }
+void linearToSrgb(const float *linear, unsigned char *rgba, size_t pixelCount) { kernels().linearToSrgb(linear, rgba, pixelCount); }
+void downsampleBox(const unsigned char *src, int width, int height, unsigned char *dst) { kernels().downsampleBox(src, width, height, dst); }
+void downsampleKaiser(const unsigned char *src, int width, int height, unsigned char *dst) { downsampleKaiserWith(kernels(), src, width, height, dst); }
+
+SimdLevel activeLevel() { return kernels().level; }
+
+std::vector<MipLevel> buildMipChain(const unsigned char *rgba, int width, int height, MipFilter filter) {
+    std::vector<MipLevel> levels;
+    const unsigned char *src = rgba;
+    int w = width, h = height;
+    while(w > 1 || h > 1) {
+        MipLevel level;
+        level.width = std::max(1, w / 2);
+        level.height = std::max(1, h / 2);
+        level.pixels.resize(size_t(level.width) * level.height * 4);
+        if(filter == MipFilter::Kaiser)
+            downsampleKaiser(src, w, h, level.pixels.data());
+        else
+            downsampleBox(src, w, h, level.pixels.data());
+        levels.push_back(std::move(level));
+        src = levels.back().pixels.data();
+        w = levels.back().width;
+        h = levels.back().height;
+    }
+    return levels;
+}
+
+namespace reference {
+void flipRows(unsigned char *pixels, size_t rowBytes, int height) { flipRowsScalar(pixels, rowBytes, height); }
+void rgbToRgba(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount) { rgbToRgbaScalar(rgb, rgba, pixelCount); }
+void srgbToLinear(const unsigned char *rgba, float *linear, size_t pixelCount) { srgbToLinearScalar(rgba, linear, pixelCount); }
+void linearToSrgb(const float *linear, unsigned char *rgba, size_t pixelCount) { linearToSrgbScalar(linear, rgba, pixelCount); }
+void downsampleBox(const unsigned char *src, int width, int height, unsigned char *dst) { downsampleBoxScalar(src, width, height, dst); }
+void downsampleKaiser(const unsigned char *src, int width, int height, unsigned char *dst) { downsampleKaiserWith(kScalarTable, src, width, height, dst); }
+} // namespace reference
+
+} // namespace ImageKernels
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "CpuFeatures.hpp"
+
+// 8-bit image preprocessing kernels (row flipping, RGB->RGBA expansion, sRGB
+// conversion, gamma-correct mip generation). Each entry point forwards to the
+// scalar, SSE or AVX2 implementation picked once from the CPU features.
+namespace ImageKernels {
+
+enum class MipFilter { Box, Kaiser };
+
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // tightly packed RGBA8, sRGB encoded
+};
+
+// Swaps rows top to bottom, in place. rowBytes is the size of one row.
+void flipRows(unsigned char *pixels, size_t rowBytes, int height);
+
+// Expands packed RGB8 to RGBA8 with an opaque alpha channel.
+void rgbToRgba(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount);
+
+// RGBA8 (sRGB color, linear alpha) <-> linear float RGBA.
+void srgbToLinear(const unsigned char *rgba, float *linear, size_t pixelCount);
+void linearToSrgb(const float *linear, unsigned char *rgba, size_t pixelCount);
+
+// Halves an RGBA8 image, filtering in linear space. The output is
+// max(1, width/2) x max(1, height/2) and must not alias the input.
+void downsampleBox(const unsigned char *src, int width, int height, unsigned char *dst);
+void downsampleKaiser(const unsigned char *src, int width, int height, unsigned char *dst);
+
+// Builds levels 1..N of the mip chain of an RGBA8 image (level 0 is not copied).
+std::vector<MipLevel> buildMipChain(const unsigned char *rgba, int width, int height, MipFilter filter);
+
+// Level actually used by the dispatcher.
+SimdLevel activeLevel();
+
+// Scalar reference implementations, kept callable to validate and time the SIMD paths.
+namespace reference {
+void flipRows(unsigned char *pixels, size_t rowBytes, int height);
+void rgbToRgba(const unsigned char *rgb, unsigned char *rgba, size_t pixelCount);
+void srgbToLinear(const unsigned char *rgba, float *linear, size_t pixelCount);
+void linearToSrgb(const float *linear, unsigned char *rgba, size_t pixelCount);
+void downsampleBox(const unsigned char *src, int width, int height, unsigned char *dst);
+void downsampleKaiser(const unsigned char *src, int width, int height, unsigned char *dst);
+} // namespace reference
+
+} // namespace ImageKernels
@@ -0,0 +1,258 @@
+// JobSystem.cpp
+#include "JobSystem.hpp"
+
+#include <iostream>
+
+#include "AlignedAllocator.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+// this thread's deque: -1 not claimed yet, -2 none left
+thread_local int t_slot = -1;
+
+// idle rounds over the deques before a worker goes to sleep
+const int kSpinsBeforeSleep = 64;
+
+struct Task {
+    std::function<void()> fn;
+    JobSystem::Job job;
+};
+
+} // namespace
+
+// Gives the deque back when its thread exits; it is empty by then, every
+// parallelFor and wait() has returned.
+struct JobSystem::SlotOwner {
+    JobSystem *system = nullptr;
+    int index = -1;
+    ~SlotOwner() {
+        if(system && index >= 0) {
+            std::lock_guard<std::mutex> lock(system->m_slotMutex);
+            system->m_freeSlots.push_back(index);
+        }
+    }
+};
+
+JobSystem::Deque *JobSystem::Deque::create() {
+    return new(AlignedAllocator<Deque>().allocate(1)) Deque;
+}
+
+void JobSystem::Deque::destroy(Deque *deque) {
+    if(!deque)
+        return;
+    deque->~Deque();
+    AlignedAllocator<Deque>().deallocate(deque, 1);
+}
+
+bool JobSystem::Deque::push(Job *job) {
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_top.load(std::memory_order_acquire);
+    if(bottom - top >= kDequeCapacity)
+        return false;
+    m_jobs[bottom & (kDequeCapacity - 1)].store(job, std::memory_order_relaxed);
+    // release store instead of the paper's release fence + relaxed store, same on x86 and TSan understands it
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job *JobSystem::Deque::pop() {
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+    if(top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job *job = m_jobs[bottom & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+    if(top == bottom) {
+        // last one, race the thieves for it
+        if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job *JobSystem::Deque::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if(top >= bottom)
+        return nullptr;
+    Job *job = m_jobs[top & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+    if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr; // lost to the owner or another thief
+    return job;
+}
+
+JobSystem &JobSystem::get() {
+    static JobSystem system;
+    return system;
+}
+
+JobSystem::JobSystem() {
+    for(int i = 0; i < kMaxThreads; ++i)
+        m_deques[i].store(nullptr, std::memory_order_relaxed);
+    // leave room for the threads that only submit and wait
+    const unsigned workers = std::min<unsigned>(Parallel::workerCount(), kMaxThreads / 2) - 1;
+    m_workers.reserve(workers);
+    for(unsigned w = 0; w < workers; ++w)
+        m_workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for(size_t w = 0; w < m_workers.size(); ++w)
+        m_workers[w].join();
+    for(int i = 0; i < kMaxThreads; ++i)
+        Deque::destroy(m_deques[i].load(std::memory_order_relaxed));
+}
+
+void JobSystem::setProfileHook(ProfileHook hook, void *user) {
+    m_hookUser.store(user, std::memory_order_relaxed);
+    m_hook.store(hook, std::memory_order_relaxed);
+}
+
+int JobSystem::slot() {
+    if(t_slot != -1)
+        return t_slot < 0 ? -1 : t_slot;
+
+    static thread_local SlotOwner owner;
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    if(!m_freeSlots.empty()) {
+        t_slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else if(m_slotCount.load(std::memory_order_relaxed) < kMaxThreads) {
+        t_slot = m_slotCount.load(std::memory_order_relaxed);
+        m_deques[t_slot].store(Deque::create(), std::memory_order_release);
+        m_slotCount.store(t_slot + 1, std::memory_order_release);
+    } else {
+        std::cerr << "WARNING: more than " << kMaxThreads << " threads use the job system, the others run their jobs alone" << std::endl;
+        t_slot = -2;
+        return -1;
+    }
+    owner.system = this;
+    owner.index = t_slot;
+    return t_slot;
+}
+
+void JobSystem::push(int self, Job &job) {
+    if(!m_deques[self].load(std::memory_order_relaxed)->push(&job)) {
+        execute(job); // full, which takes thousands of outstanding jobs; do it now
+        return;
+    }
+    // pairs with the fence in workerLoop: either the worker sees the job or we see it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleeping.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
+}
+
+JobSystem::Job *JobSystem::find(int self) {
+    if(self >= 0) {
+        if(Job *job = m_deques[self].load(std::memory_order_relaxed)->pop())
+            return job;
+    }
+    // start at a different victim each time so thieves spread out
+    static thread_local unsigned next = 0;
+    const int count = m_slotCount.load(std::memory_order_acquire);
+    const int start = int(next++ % unsigned(count ? count : 1));
+    for(int k = 0; k < count; ++k) {
+        const int victim = (start + k) % count;
+        if(victim == self)
+            continue;
+        Deque *deque = m_deques[victim].load(std::memory_order_acquire);
+        if(!deque)
+            continue;
+        if(Job *job = deque->steal())
+            return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Job &job) {
+    // the record belongs to the waiting frame (or the task), don't touch it once the counter drops
+    Counter *counter = job.counter;
+    job.run(job);
+    counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::taskJob(Job &job) {
+    Task *task = static_cast<Task *>(const_cast<void *>(job.context));
+    JobSystem &system = get();
+    const ProfileHook hook = system.m_hook.load(std::memory_order_relaxed);
+    if(!hook) {
+        task->fn();
+    } else {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        task->fn();
+        hook(system.m_hookUser.load(std::memory_order_relaxed), job.name,
+             unsigned(t_slot < 0 ? kMaxThreads : t_slot), start, std::chrono::steady_clock::now());
+    }
+    delete task;
+}
+
+void JobSystem::submit(const char *name, std::function<void()> fn, Counter &counter) {
+    Task *task = new Task;
+    task->fn = std::move(fn);
+    task->job.run = &JobSystem::taskJob;
+    task->job.context = task;
+    task->job.begin = task->job.end = 0;
+    task->job.counter = &counter;
+    task->job.name = name;
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    const int self = slot();
+    if(self < 0 || m_workers.empty())
+        execute(task->job);
+    else
+        push(self, task->job);
+}
+
+void JobSystem::wait(Counter &counter) {
+    const int self = slot();
+    while(!counter.done()) {
+        // anything will do, ours first; what we can't find is running elsewhere
+        if(Job *job = find(self))
+            execute(*job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop() {
+    const int self = slot();
+    int idle = 0;
+    while(!m_quit.load(std::memory_order_relaxed)) {
+        if(Job *job = find(self)) {
+            execute(*job);
+            idle = 0;
+            continue;
+        }
+        if(++idle < kSpinsBeforeSleep) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool queued = false;
+        const int count = m_slotCount.load(std::memory_order_acquire);
+        for(int i = 0; i < count && !queued; ++i) {
+            const Deque *deque = m_deques[i].load(std::memory_order_acquire);
+            queued = deque && !deque->empty();
+        }
+        if(!queued && !m_quit.load(std::memory_order_relaxed))
+            m_wake.wait(lock);
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
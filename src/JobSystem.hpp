@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler shared by the simulation, the per-frame transform
+// updates and asset loading.
+//
+// Every thread taking part owns a Chase-Lev deque. It pushes and pops jobs at
+// the bottom, newest first, so it keeps working on what it just split off
+// while the data is in its cache; idle threads steal from the top, the oldest
+// and biggest pieces. There are workerCount() - 1 worker threads, asleep when
+// there is nothing to steal. Other threads (main, the simulation thread) get a
+// deque the first time they split work and run jobs while they wait, so a
+// parallelFor nested in a job never blocks a worker.
+//
+// parallelFor() halves its range down to the grain, pushing the upper halves
+// for thieves; the job records live on the stack of the frame that waits for
+// them, nothing is allocated. submit() is for coarse tasks (decoding one
+// texture) and allocates one record per task.
+class JobSystem {
+public:
+    // Number of jobs still to run; wait() on it.
+    struct Counter {
+        std::atomic<int> pending{0};
+        inline bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    struct Job {
+        void (*run)(Job &job);
+        const void *context;
+        size_t begin, end;
+        Counter *counter;
+        const char *name;
+    };
+
+    // Called after every job, from the thread that ran it (its deque index),
+    // with the steady clock times around it. For parallelFor a job is one
+    // piece of the range, without the time spent waiting on the others. Jobs
+    // are only timed while a hook is set; set it while no work is in flight.
+    typedef void (*ProfileHook)(void *user, const char *name, unsigned thread,
+                                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    static JobSystem &get();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    ~JobSystem();
+
+    inline unsigned threadCount() const { return unsigned(m_workers.size()) + 1; }
+
+    void setProfileHook(ProfileHook hook, void *user);
+
+    // Calls fn(i) for every i in [begin, end), in parallel, and returns when all
+    // are done. Ranges of at most `grain` indices run in one go; the grain is
+    // raised so that there are about 8 pieces per thread, less only costs
+    // scheduling.
+    template<typename Fn>
+    void parallelFor(size_t begin, size_t end, const Fn &fn, const char *name = "parallelFor", size_t minGrain = 1);
+
+    // Queues fn to run on any thread; counter is bumped now and dropped when fn returns.
+    void submit(const char *name, std::function<void()> fn, Counter &counter);
+
+    // Runs queued jobs until the counter drops to zero.
+    void wait(Counter &counter);
+
+private:
+    static const int kMaxThreads = 64;
+    static const int64_t kDequeCapacity = 4096; // power of two
+
+    // Lock-free deque of Lê, Pop, Cohen and Zappa Nardelli, "Correct and
+    // Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013), fixed size.
+    class Deque {
+    public:
+        // Cache line aligned storage: plain new only guarantees alignof(max_align_t)
+        // before C++17, and the indices would share a line again.
+        static Deque *create();
+        static void destroy(Deque *deque);
+
+        bool push(Job *job); // owner; false when full
+        Job *pop();          // owner
+        Job *steal();        // anyone
+        inline bool empty() const {
+            return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        alignas(64) std::atomic<Job *> m_jobs[kDequeCapacity];
+    };
+
+    template<typename Fn>
+    struct ForContext {
+        const Fn *fn;
+        size_t grain;
+        const char *name;
+    };
+
+    struct SlotOwner;
+
+    JobSystem();
+    int slot(); // this thread's deque, -1 when all are taken
+    void push(int self, Job &job);
+    Job *find(int self);
+    void execute(Job &job);
+    void workerLoop();
+    static void taskJob(Job &job);
+
+    template<typename Fn>
+    void runPiece(const Fn &fn, size_t begin, size_t end, const char *name, int self);
+
+    template<typename Fn>
+    static void forJob(Job &job);
+    template<typename Fn>
+    void splitAndRun(const ForContext<Fn> &context, size_t begin, size_t end);
+
+    std::atomic<Deque *> m_deques[kMaxThreads]; // null until a thread claims it
+    std::atomic<int> m_slotCount{0};
+    std::mutex m_slotMutex;
+    std::vector<int> m_freeSlots; // left behind by threads that exited
+    std::vector<std::thread> m_workers;
+
+    std::atomic<ProfileHook> m_hook{nullptr};
+    std::atomic<void *> m_hookUser{nullptr};
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<int> m_sleeping{0};
+    std::atomic<bool> m_quit{false};
+};
+
+template<typename Fn>
+void JobSystem::forJob(Job &job) {
+    const ForContext<Fn> &context = *static_cast<const ForContext<Fn> *>(job.context);
+    get().splitAndRun(context, job.begin, job.end);
+}
+
+template<typename Fn>
+void JobSystem::splitAndRun(const ForContext<Fn> &context, size_t begin, size_t end) {
+    const int self = slot();
+    if(self < 0) {
+        runPiece(*context.fn, begin, end, context.name, self);
+        return;
+    }
+
+    // at most log2(count / grain) halves, 64 covers any size_t
+    Job jobs[64];
+    Counter counter;
+    int pushed = 0;
+    while(end - begin > context.grain) {
+        const size_t mid = begin + (end - begin) / 2;
+        Job &job = jobs[pushed++];
+        job.run = &JobSystem::forJob<Fn>;
+        job.context = &context;
+        job.begin = mid;
+        job.end = end;
+        job.counter = &counter;
+        job.name = context.name;
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        push(self, job);
+        end = mid;
+    }
+    runPiece(*context.fn, begin, end, context.name, self);
+    if(pushed)
+        wait(counter);
+}
+
+template<typename Fn>
+void JobSystem::runPiece(const Fn &fn, size_t begin, size_t end, const char *name, int self) {
+    const ProfileHook hook = m_hook.load(std::memory_order_relaxed);
+    if(!hook) {
+        for(size_t i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = begin; i < end; ++i)
+        fn(i);
+    hook(m_hookUser.load(std::memory_order_relaxed), name, unsigned(self < 0 ? kMaxThreads : self), start, std::chrono::steady_clock::now());
+}
+
+template<typename Fn>
+void JobSystem::parallelFor(size_t begin, size_t end, const Fn &fn, const char *name, size_t minGrain) {
+    if(end <= begin)
+        return;
+    const size_t count = end - begin;
+    const size_t grain = std::max<size_t>(std::max<size_t>(minGrain, 1), count / (size_t(threadCount()) * 8));
+    if(count <= grain || threadCount() == 1) {
+        runPiece(fn, begin, end, name, m_hook.load(std::memory_order_relaxed) ? slot() : -1);
+        return;
+    }
+    const ForContext<Fn> context = { &fn, grain, name };
+    splitAndRun(context, begin, end);
+}
@@ -0,0 +1,399 @@
+// Kepler.cpp
+#include "Kepler.hpp"
+
+#include <cmath>
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#endif
+
+namespace Kepler {
+
+namespace {
+
+const double kTwoPi = 6.283185307179586476925;
+const double kInvTwoPi = 1.0 / kTwoPi;
+
+// Newton stops once every lane moved by less than this (radians); the step in
+// double that follows squares what is left.
+const float kTolerance = 1e-4f;
+const int kMaxIterations = 10;
+
+// Danby's starter E0 = M + 0.85 e sign(sin M) makes Newton converge for any
+// e < 1, and it is free once M is reduced to [-pi, pi]: sign(sin M) = sign(M).
+const float kDanby = 0.85f;
+
+// The AVX2 kernel skips the convergence test: from Danby's starter, 2 steps
+// leave under 1e-5 rad up to e = 0.3 and 4 steps up to e = 0.9 (worst case
+// over a million random orbits), which the double step takes to 1e-10. Blocks
+// with an orbit past 0.9 still iterate to kTolerance.
+const float kFewStepsUpTo = 0.3f;
+const float kFixedStepsUpTo = 0.9f;
+
+inline int newtonSteps(bool pastFew, bool pastFixed) {
+    return pastFixed ? kMaxIterations : pastFew ? 4 : 2;
+}
+
+// ---------------------------------------------------------------------------
+// scalar
+
+inline double reduceMeanAnomaly(double m0, double n, double time) {
+    const double m = m0 + n * time;
+    return m - kTwoPi * std::floor(m * kInvTwoPi + 0.5);
+}
+
+inline void solveOne(const OrbitArrays &o, size_t i, double meanAnomaly, double &x, double &y, double &z) {
+    const float e = o.eccentricity[i], M = float(meanAnomaly);
+    float E = M + (M < 0.f ? -kDanby : kDanby) * e;
+    for(int it = 0; it < kMaxIterations; ++it) {
+        const float d = (E - e * std::sin(E) - M) / (1.f - e * std::cos(E));
+        E -= d;
+        if(std::fabs(d) < kTolerance)
+            break;
+    }
+    // the last step in double, sin and cos carried along to first order
+    const double ed = e;
+    double s = std::sin(double(E)), c = std::cos(double(E));
+    const double d = (double(E) - ed * s - meanAnomaly) / (1.0 - ed * c);
+    const double sNew = s - c * d;
+    c += s * d;
+    s = sNew;
+    const double u = o.semiMajorAxis[i] * (c - ed), v = o.semiMinorAxis[i] * s;
+    x = u * o.px[i] + v * o.qx[i];
+    y = u * o.py[i] + v * o.qy[i];
+    z = u * o.pz[i] + v * o.qz[i];
+}
+
+void propagateScalar(const OrbitArrays &o, size_t begin, size_t end, double time, double *x, double *y, double *z) {
+    for(size_t i = begin; i < end; ++i)
+        solveOne(o, i, reduceMeanAnomaly(o.meanAnomalyAtEpoch[i], o.meanMotion[i], time), x[i], y[i], z[i]);
+}
+
+// ---------------------------------------------------------------------------
+// SIMD: sin and cos together, Cody-Waite reduction by pi/2 then the Cephes
+// minimax polynomials on [-pi/4, pi/4]. Good to a couple of ulps for the
+// |x| < 5 the solver feeds it.
+
+const float kTwoOverPi = 0.636619772367581343f;
+const float kPio2A = 1.5703125f;
+const float kPio2B = 4.837512969970703125e-4f;
+const float kPio2C = 7.54978995489188216e-8f;
+const float kSin1 = -1.6666654611e-1f, kSin2 = 8.3321608736e-3f, kSin3 = -1.9515295891e-4f;
+const float kCos1 = 4.166664568298827e-2f, kCos2 = -1.388731625493765e-3f, kCos3 = 2.443315711809948e-5f;
+
+// the same in double for the last step: pi/2 in two parts (the first one exact
+// times small integers) and the fdlibm kernel polynomials
+const double kTwoOverPiD = 0.636619772367581343075535;
+const double kPio2Hi = 1.57079632673412561417e+00, kPio2Lo = 6.07710050650619224932e-11;
+const double kSinD[6] = { -1.66666666666666324348e-01, 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+                          2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10 };
+const double kCosD[6] = { 4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+                          -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11 };
+
+#ifdef SOLAR_X86
+
+SOLAR_TARGET("sse4.1")
+inline void sincosSse(__m128 x, __m128 &sinOut, __m128 &cosOut) {
+    const __m128 j = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(kPio2A)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(kPio2B)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(kPio2C)));
+    const __m128 z = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(kSin3)), _mm_set1_ps(kSin2));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(kSin1));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), r), r);
+    __m128 c = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(kCos3)), _mm_set1_ps(kCos2));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(kCos1));
+    c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+    c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(z, _mm_set1_ps(0.5f))), c);
+
+    // quadrant q: odd swaps sin and cos, sin flips for q = 2, 3 and cos for q = 1, 2
+    const __m128i q = _mm_cvtps_epi32(j);
+    const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    sinOut = _mm_xor_ps(_mm_blendv_ps(s, c, swap), sinSign);
+    cosOut = _mm_xor_ps(_mm_blendv_ps(c, s, swap), cosSign);
+}
+
+SOLAR_TARGET("sse4.1")
+inline void sincosSsePd(__m128d x, __m128d &sinOut, __m128d &cosOut) {
+    const __m128d j = _mm_round_pd(_mm_mul_pd(x, _mm_set1_pd(kTwoOverPiD)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(j, _mm_set1_pd(kPio2Hi)));
+    r = _mm_sub_pd(r, _mm_mul_pd(j, _mm_set1_pd(kPio2Lo)));
+    const __m128d z = _mm_mul_pd(r, r);
+
+    __m128d s = _mm_set1_pd(kSinD[5]), c = _mm_set1_pd(kCosD[5]);
+    for(int k = 4; k >= 0; --k) {
+        s = _mm_add_pd(_mm_mul_pd(s, z), _mm_set1_pd(kSinD[k]));
+        c = _mm_add_pd(_mm_mul_pd(c, z), _mm_set1_pd(kCosD[k]));
+    }
+    s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), s));
+    c = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, _mm_set1_pd(0.5))), _mm_mul_pd(_mm_mul_pd(z, z), c));
+
+    const __m128i q = _mm_cvtepi32_epi64(_mm_cvtpd_epi32(j));
+    const __m128d swap = _mm_castsi128_pd(_mm_cmpeq_epi64(_mm_and_si128(q, _mm_set1_epi64x(1)), _mm_set1_epi64x(1)));
+    const __m128d sinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(q, _mm_set1_epi64x(2)), 62));
+    const __m128d cosSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi64(q, _mm_set1_epi64x(1)), _mm_set1_epi64x(2)), 62));
+    sinOut = _mm_xor_pd(_mm_blendv_pd(s, c, swap), sinSign);
+    cosOut = _mm_xor_pd(_mm_blendv_pd(c, s, swap), cosSign);
+}
+
+// mean anomalies of 4 orbits in [-pi, pi], kept in double for the last step
+SOLAR_TARGET("sse4.1")
+inline __m128 reduceMeanAnomalySse(const double *m0, const double *n, __m128d time, __m128d &lo, __m128d &hi) {
+    const __m128d twoPi = _mm_set1_pd(kTwoPi), invTwoPi = _mm_set1_pd(kInvTwoPi);
+    lo = _mm_add_pd(_mm_loadu_pd(m0), _mm_mul_pd(_mm_loadu_pd(n), time));
+    hi = _mm_add_pd(_mm_loadu_pd(m0 + 2), _mm_mul_pd(_mm_loadu_pd(n + 2), time));
+    lo = _mm_sub_pd(lo, _mm_mul_pd(twoPi, _mm_round_pd(_mm_mul_pd(lo, invTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+    hi = _mm_sub_pd(hi, _mm_mul_pd(twoPi, _mm_round_pd(_mm_mul_pd(hi, invTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+    return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+// The last Newton step in double and the position, for the 2 orbits from i
+SOLAR_TARGET("sse4.1")
+inline void finishSse(const OrbitArrays &o, size_t i, __m128 E2, __m128d M, double *x, double *y, double *z) {
+    const __m128d e = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(o.eccentricity + i))));
+    const __m128d E = _mm_cvtps_pd(E2);
+    __m128d s, c;
+    sincosSsePd(E, s, c);
+    const __m128d d = _mm_div_pd(_mm_sub_pd(_mm_sub_pd(E, _mm_mul_pd(e, s)), M), _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(e, c)));
+    const __m128d sNew = _mm_sub_pd(s, _mm_mul_pd(c, d));
+    c = _mm_add_pd(c, _mm_mul_pd(s, d));
+    s = sNew;
+    const __m128d u = _mm_mul_pd(_mm_loadu_pd(o.semiMajorAxis + i), _mm_sub_pd(c, e));
+    const __m128d v = _mm_mul_pd(_mm_loadu_pd(o.semiMinorAxis + i), s);
+    _mm_storeu_pd(x + i, _mm_add_pd(_mm_mul_pd(u, _mm_loadu_pd(o.px + i)), _mm_mul_pd(v, _mm_loadu_pd(o.qx + i))));
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_mul_pd(u, _mm_loadu_pd(o.py + i)), _mm_mul_pd(v, _mm_loadu_pd(o.qy + i))));
+    _mm_storeu_pd(z + i, _mm_add_pd(_mm_mul_pd(u, _mm_loadu_pd(o.pz + i)), _mm_mul_pd(v, _mm_loadu_pd(o.qz + i))));
+}
+
+SOLAR_TARGET("sse4.1")
+void propagateSse(const OrbitArrays &o, size_t begin, size_t end, double time, double *x, double *y, double *z) {
+    const __m128d t = _mm_set1_pd(time);
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    const __m128 one = _mm_set1_ps(1.f), tolerance = _mm_set1_ps(kTolerance);
+    size_t i = begin;
+    for(; i + 4 <= end; i += 4) {
+        __m128d mLo, mHi;
+        const __m128 M = reduceMeanAnomalySse(o.meanAnomalyAtEpoch + i, o.meanMotion + i, t, mLo, mHi);
+        const __m128 e = _mm_loadu_ps(o.eccentricity + i);
+        __m128 E = _mm_add_ps(M, _mm_or_ps(_mm_and_ps(M, signMask), _mm_mul_ps(e, _mm_set1_ps(kDanby))));
+        for(int it = 0; it < kMaxIterations; ++it) {
+            __m128 s, c;
+            sincosSse(E, s, c);
+            const __m128 f = _mm_sub_ps(_mm_sub_ps(E, _mm_mul_ps(e, s)), M);
+            const __m128 d = _mm_div_ps(f, _mm_sub_ps(one, _mm_mul_ps(e, c)));
+            E = _mm_sub_ps(E, d);
+            if(!_mm_movemask_ps(_mm_cmpge_ps(_mm_andnot_ps(signMask, d), tolerance)))
+                break;
+        }
+        finishSse(o, i, E, mLo, x, y, z);
+        finishSse(o, i + 2, _mm_movehl_ps(E, E), mHi, x, y, z);
+    }
+    propagateScalar(o, i, end, time, x, y, z);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void sincosAvx2(__m256 x, __m256 &sinOut, __m256 &cosOut) {
+    const __m256 j = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPio2A), x);
+    r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPio2B), r);
+    r = _mm256_fnmadd_ps(j, _mm256_set1_ps(kPio2C), r);
+    const __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_fmadd_ps(z, _mm256_set1_ps(kSin3), _mm256_set1_ps(kSin2));
+    s = _mm256_fmadd_ps(s, z, _mm256_set1_ps(kSin1));
+    s = _mm256_fmadd_ps(_mm256_mul_ps(s, z), r, r);
+    __m256 c = _mm256_fmadd_ps(z, _mm256_set1_ps(kCos3), _mm256_set1_ps(kCos2));
+    c = _mm256_fmadd_ps(c, z, _mm256_set1_ps(kCos1));
+    c = _mm256_fmadd_ps(_mm256_mul_ps(c, z), z, _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), _mm256_set1_ps(1.f)));
+
+    const __m256i q = _mm256_cvtps_epi32(j);
+    const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+    const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+    sinOut = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign);
+    cosOut = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void sincosAvx2Pd(__m256d x, __m256d &sinOut, __m256d &cosOut) {
+    const __m256d j = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(kTwoOverPiD)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(j, _mm256_set1_pd(kPio2Hi), x);
+    r = _mm256_fnmadd_pd(j, _mm256_set1_pd(kPio2Lo), r);
+    const __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d s = _mm256_set1_pd(kSinD[5]), c = _mm256_set1_pd(kCosD[5]);
+    for(int k = 4; k >= 0; --k) {
+        s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(kSinD[k]));
+        c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(kCosD[k]));
+    }
+    s = _mm256_fmadd_pd(_mm256_mul_pd(r, z), s, r);
+    c = _mm256_fmadd_pd(_mm256_mul_pd(z, z), c, _mm256_fnmadd_pd(z, _mm256_set1_pd(0.5), _mm256_set1_pd(1.0)));
+
+    const __m256i q = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(j));
+    const __m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(1)));
+    const __m256d sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(2)), 62));
+    const __m256d cosSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(q, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(2)), 62));
+    sinOut = _mm256_xor_pd(_mm256_blendv_pd(s, c, swap), sinSign);
+    cosOut = _mm256_xor_pd(_mm256_blendv_pd(c, s, swap), cosSign);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline __m256 reduceMeanAnomalyAvx2(const double *m0, const double *n, __m256d time, __m256d &lo, __m256d &hi) {
+    const __m256d twoPi = _mm256_set1_pd(kTwoPi), invTwoPi = _mm256_set1_pd(kInvTwoPi);
+    lo = _mm256_fmadd_pd(_mm256_loadu_pd(n), time, _mm256_loadu_pd(m0));
+    hi = _mm256_fmadd_pd(_mm256_loadu_pd(n + 4), time, _mm256_loadu_pd(m0 + 4));
+    lo = _mm256_fnmadd_pd(twoPi, _mm256_round_pd(_mm256_mul_pd(lo, invTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), lo);
+    hi = _mm256_fnmadd_pd(twoPi, _mm256_round_pd(_mm256_mul_pd(hi, invTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), hi);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void finishAvx2(const OrbitArrays &o, size_t i, __m128 E4, __m256d M, double *x, double *y, double *z) {
+    const __m256d e = _mm256_cvtps_pd(_mm_loadu_ps(o.eccentricity + i));
+    const __m256d E = _mm256_cvtps_pd(E4);
+    __m256d s, c;
+    sincosAvx2Pd(E, s, c);
+    const __m256d d = _mm256_div_pd(_mm256_sub_pd(_mm256_fnmadd_pd(e, s, E), M), _mm256_fnmadd_pd(e, c, _mm256_set1_pd(1.0)));
+    const __m256d sNew = _mm256_fnmadd_pd(c, d, s);
+    c = _mm256_fmadd_pd(s, d, c);
+    s = sNew;
+    const __m256d u = _mm256_mul_pd(_mm256_loadu_pd(o.semiMajorAxis + i), _mm256_sub_pd(c, e));
+    const __m256d v = _mm256_mul_pd(_mm256_loadu_pd(o.semiMinorAxis + i), s);
+    _mm256_storeu_pd(x + i, _mm256_fmadd_pd(u, _mm256_loadu_pd(o.px + i), _mm256_mul_pd(v, _mm256_loadu_pd(o.qx + i))));
+    _mm256_storeu_pd(y + i, _mm256_fmadd_pd(u, _mm256_loadu_pd(o.py + i), _mm256_mul_pd(v, _mm256_loadu_pd(o.qy + i))));
+    _mm256_storeu_pd(z + i, _mm256_fmadd_pd(u, _mm256_loadu_pd(o.pz + i), _mm256_mul_pd(v, _mm256_loadu_pd(o.qz + i))));
+}
+
+SOLAR_TARGET("avx2,fma")
+inline __m256 newtonStepAvx2(__m256 &E, __m256 e, __m256 M) {
+    __m256 s, c;
+    sincosAvx2(E, s, c);
+    const __m256 f = _mm256_sub_ps(_mm256_fnmadd_ps(e, s, E), M);
+    const __m256 d = _mm256_div_ps(f, _mm256_fnmadd_ps(e, c, _mm256_set1_ps(1.f)));
+    E = _mm256_sub_ps(E, d);
+    return d;
+}
+
+SOLAR_TARGET("avx2,fma")
+void propagateAvx2(const OrbitArrays &o, size_t begin, size_t end, double time, double *x, double *y, double *z) {
+    // three blocks of 8 at a time: one block's sincos -> divide chain is
+    // mostly latency, the other two fill it in
+    const int kBlocks = 3;
+    const __m256d t = _mm256_set1_pd(time);
+    const __m256 signMask = _mm256_set1_ps(-0.f), tolerance = _mm256_set1_ps(kTolerance);
+    size_t i = begin;
+    for(; i + 8 * kBlocks <= end; i += 8 * kBlocks) {
+        __m256d mLo[kBlocks], mHi[kBlocks];
+        __m256 M[kBlocks], e[kBlocks], E[kBlocks];
+        __m256 eMax = _mm256_setzero_ps();
+        for(int b = 0; b < kBlocks; ++b) {
+            M[b] = reduceMeanAnomalyAvx2(o.meanAnomalyAtEpoch + i + 8 * b, o.meanMotion + i + 8 * b, t, mLo[b], mHi[b]);
+            e[b] = _mm256_loadu_ps(o.eccentricity + i + 8 * b);
+            E[b] = _mm256_add_ps(M[b], _mm256_or_ps(_mm256_and_ps(M[b], signMask), _mm256_mul_ps(e[b], _mm256_set1_ps(kDanby))));
+            eMax = _mm256_max_ps(eMax, e[b]);
+        }
+        const int steps = newtonSteps(_mm256_movemask_ps(_mm256_cmp_ps(eMax, _mm256_set1_ps(kFewStepsUpTo), _CMP_GT_OQ)) != 0,
+                                      _mm256_movemask_ps(_mm256_cmp_ps(eMax, _mm256_set1_ps(kFixedStepsUpTo), _CMP_GT_OQ)) != 0);
+        for(int it = 0; it < steps; ++it) {
+            int moving = 0;
+            for(int b = 0; b < kBlocks; ++b) {
+                const __m256 d = newtonStepAvx2(E[b], e[b], M[b]);
+                moving |= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(signMask, d), tolerance, _CMP_GE_OQ));
+            }
+            if(steps == kMaxIterations && !moving)
+                break;
+        }
+        for(int b = 0; b < kBlocks; ++b) {
+            finishAvx2(o, i + 8 * b, _mm256_castps256_ps128(E[b]), mLo[b], x, y, z);
+            finishAvx2(o, i + 8 * b + 4, _mm256_extractf128_ps(E[b], 1), mHi[b], x, y, z);
+        }
+    }
+    // a 4-wide pass before the scalar tail
+    propagateSse(o, i, end, time, x, y, z);
+}
+
+#endif // SOLAR_X86
+
+// ---------------------------------------------------------------------------
+// dispatch
+
+struct KernelTable {
+    void (*propagate)(const OrbitArrays &, size_t, size_t, double, double *, double *, double *);
+    SimdLevel level;
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_X86
+    const SimdLevel level = CpuFeatures::get().level();
+    if(level >= SimdLevel::AVX2) {
+        const KernelTable t = { propagateAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+    if(level >= SimdLevel::SSE) {
+        const KernelTable t = { propagateSse, SimdLevel::SSE };
+        return t;
+    }
+#endif
+    const KernelTable t = { propagateScalar, SimdLevel::Scalar };
+    return t;
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+void perifocalBasis(double inclination, double ascendingNode, double argPeriapsis, double p[3], double q[3]) {
+    const double ci = std::cos(inclination), si = std::sin(inclination);
+    const double cn = std::cos(ascendingNode), sn = std::sin(ascendingNode);
+    const double cw = std::cos(argPeriapsis), sw = std::sin(argPeriapsis);
+    // ecliptic (X, Y, Z north) to scene (x, y up, z) is (X, Z, Y)
+    p[0] = cw * cn - sw * sn * ci;
+    p[1] = sw * si;
+    p[2] = cw * sn + sw * cn * ci;
+    q[0] = -sw * cn - cw * sn * ci;
+    q[1] = cw * si;
+    q[2] = -sw * sn + cw * cn * ci;
+}
+
+void propagate(const OrbitArrays &orbits, size_t count, double time, double *x, double *y, double *z) {
+    kernels().propagate(orbits, 0, count, time, x, y, z);
+}
+
+SimdLevel activeLevel() { return kernels().level; }
+
+namespace reference {
+
+double solve(double meanAnomaly, double eccentricity) {
+    double E = meanAnomaly + (std::sin(meanAnomaly) < 0.0 ? -kDanby : kDanby) * eccentricity;
+    for(int it = 0; it < 64; ++it) {
+        const double d = (E - eccentricity * std::sin(E) - meanAnomaly) / (1.0 - eccentricity * std::cos(E));
+        E -= d;
+        if(std::fabs(d) < 1e-15)
+            break;
+    }
+    return E;
+}
+
+void propagate(const OrbitArrays &o, size_t count, double time, double *x, double *y, double *z) {
+    for(size_t i = 0; i < count; ++i) {
+        const double m = std::fmod(o.meanAnomalyAtEpoch[i] + o.meanMotion[i] * time, kTwoPi);
+        const double e = o.eccentricity[i];
+        const double E = solve(m, e);
+        const double u = o.semiMajorAxis[i] * (std::cos(E) - e);
+        const double v = o.semiMajorAxis[i] * std::sqrt(1.0 - e * e) * std::sin(E);
+        x[i] = u * o.px[i] + v * o.qx[i];
+        y[i] = u * o.py[i] + v * o.qy[i];
+        z[i] = u * o.pz[i] + v * o.qz[i];
+    }
+}
+
+} // namespace reference
+
+} // namespace Kepler
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+
+#include "CpuFeatures.hpp"
+
+// Batched Keplerian orbit propagation.
+//
+// Positions are solved from classical orbital elements with a vectorized
+// Newton-Raphson solve of Kepler's equation E - e sin E = M (8 lanes with
+// AVX2, 4 with SSE4.1, scalar otherwise; picked once from the CPU features).
+// Mean anomalies are reduced in double precision so long time spans keep
+// their phase. Newton runs in single precision; one last step in double
+// (double sin and cos, same lanes) then takes the eccentric anomaly to full
+// precision, and the position is composed in double from there, so offsets
+// at true scale don't move in float-sized steps.
+namespace Kepler {
+
+// Structure-of-arrays view over the orbits to propagate. Angles in radians.
+struct OrbitArrays {
+    const double *meanAnomalyAtEpoch; // M0 at time 0
+    const double *meanMotion;         // n, rad/s
+    const float *eccentricity;        // 0 <= e < 1
+    const double *semiMajorAxis;      // a
+    const double *semiMinorAxis;      // b = a sqrt(1 - e^2)
+    // perifocal basis in scene coordinates (y up): P towards the periapsis, Q 90 degrees ahead
+    const double *px, *py, *pz;
+    const double *qx, *qy, *qz;
+};
+
+// Scene-space perifocal basis of an orbit. The reference plane is the scene's
+// xz plane, so an orbit with zero inclination keeps the historical circles of
+// update(): (a cos M, 0, a sin M) for e = 0.
+void perifocalBasis(double inclination, double ascendingNode, double argPeriapsis, double p[3], double q[3]);
+
+// Writes the position of each orbiting body relative to its focus at `time`.
+void propagate(const OrbitArrays &orbits, size_t count, double time, double *x, double *y, double *z);
+
+// Level actually used by the dispatcher.
+SimdLevel activeLevel();
+
+// Double precision reference, to validate the batched kernels.
+namespace reference {
+double solve(double meanAnomaly, double eccentricity);
+void propagate(const OrbitArrays &orbits, size_t count, double time, double *x, double *y, double *z);
+} // namespace reference
+
+} // namespace Kepler
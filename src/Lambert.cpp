@@ -0,0 +1,204 @@
+// Lambert.cpp
+#include "Lambert.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+inline void cross(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+inline double dot(const double a[3], const double b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+inline double norm(const double a[3]) { return std::sqrt(dot(a, a)); }
+inline void scale(double a[3], const double s) { a[0] *= s; a[1] *= s; a[2] *= s; }
+
+// The time of flight curve of one geometry, non-dimensional (T = sqrt(2 mu / s^3) t).
+struct Curve {
+    double lambda, lambda2, lambda3;
+
+    double hypergeometric(const double z) const {
+        double sum = 1.0, term = 1.0;
+        for(int j = 0; std::fabs(term) > 1e-11 && j < 100; ++j) {
+            term *= (3.0 + j) * (1.0 + j) / (2.5 + j) * z / (j + 1);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Lagrange's expression, in the middle range around the parabola
+    double timeLagrange(const double x, const int revolutions) const {
+        const double a = 1.0 / (1.0 - x * x);
+        if(a > 0.0) { // ellipse
+            const double alpha = 2.0 * std::acos(x);
+            double beta = 2.0 * std::asin(std::sqrt(lambda2 / a));
+            if(lambda < 0.0)
+                beta = -beta;
+            return a * std::sqrt(a) * ((alpha - std::sin(alpha)) - (beta - std::sin(beta)) + 2.0 * kPi * revolutions) / 2.0;
+        }
+        const double alpha = 2.0 * std::acosh(x);
+        double beta = 2.0 * std::asinh(std::sqrt(-lambda2 / a));
+        if(lambda < 0.0)
+            beta = -beta;
+        return -a * std::sqrt(-a) * ((beta - std::sinh(beta)) - (alpha - std::sinh(alpha))) / 2.0;
+    }
+
+    double time(const double x, const int revolutions) const {
+        const double distance = std::fabs(x - 1.0);
+        if(distance < 0.2 && distance > 0.01)
+            return timeLagrange(x, revolutions);
+        const double e = x * x - 1.0, rho = std::fabs(e), z = std::sqrt(1.0 + lambda2 * e);
+        if(distance < 0.01) { // Battin's series right at the parabola
+            const double eta = z - lambda * x;
+            const double s1 = 0.5 * (1.0 - lambda - x * eta);
+            const double q = 4.0 / 3.0 * hypergeometric(s1);
+            return (eta * eta * eta * q + 4.0 * lambda * eta) / 2.0 + revolutions * kPi / std::pow(rho, 1.5);
+        }
+        // Lancaster's
+        const double y = std::sqrt(rho), g = x * z - lambda * e;
+        double d;
+        if(e < 0.0)
+            d = revolutions * kPi + std::acos(g);
+        else
+            d = std::log(y * (z - lambda * x) + g);
+        return (x - lambda * z - d / y) / e;
+    }
+
+    // first three derivatives of T(x)
+    void derivatives(const double x, const double t, double &dt, double &ddt, double &dddt) const {
+        const double umx2 = 1.0 - x * x;
+        const double y = std::sqrt(1.0 - lambda2 * umx2), y2 = y * y, y3 = y2 * y;
+        dt = (3.0 * t * x - 2.0 + 2.0 * lambda3 * x / y) / umx2;
+        ddt = (3.0 * t + 5.0 * x * dt + 2.0 * (1.0 - lambda2) * lambda3 / y3) / umx2;
+        dddt = (7.0 * x * ddt + 8.0 * dt - 6.0 * (1.0 - lambda2) * lambda2 * lambda3 * x / y3 / y2) / umx2;
+    }
+
+    // x with T(x) = target, from x0
+    double householder(const double target, double x, const int revolutions, const double tolerance) const {
+        for(int it = 0; it < 15; ++it) {
+            const double t = time(x, revolutions);
+            double dt, ddt, dddt;
+            derivatives(x, t, dt, ddt, dddt);
+            const double delta = t - target, dt2 = dt * dt;
+            const double next = x - delta * (dt2 - delta * ddt / 2.0) / (dt * (dt2 - delta * ddt) + dddt * delta * delta / 6.0);
+            const bool done = std::fabs(x - next) < tolerance;
+            x = next;
+            if(done)
+                break;
+        }
+        return x;
+    }
+};
+
+} // namespace
+
+namespace Lambert {
+
+size_t solve(const double r1[3], const double r2[3], const double timeOfFlight, const double mu, const double normal[3],
+             const int maxRevolutions, Solution *out) {
+    if(!(timeOfFlight > 0.0) || !(mu > 0.0))
+        return 0;
+    const double c[3] = { r2[0] - r1[0], r2[1] - r1[1], r2[2] - r1[2] };
+    const double chord = norm(c), R1 = norm(r1), R2 = norm(r2);
+    const double s = (chord + R1 + R2) / 2.0;
+
+    double ir1[3] = { r1[0] / R1, r1[1] / R1, r1[2] / R1 };
+    double ir2[3] = { r2[0] / R2, r2[1] / R2, r2[2] / R2 };
+    double ih[3];
+    cross(ir1, ir2, ih);
+    const double hNorm = norm(ih);
+    if(!(hNorm > 1e-12) || !(chord > 0.0))
+        return 0; // collinear: the plane of the transfer is undefined
+    scale(ih, 1.0 / hNorm);
+
+    Curve curve;
+    curve.lambda2 = 1.0 - chord / s;
+    curve.lambda = std::sqrt(std::max(0.0, curve.lambda2));
+    double it1[3], it2[3];
+    if(dot(ih, normal) < 0.0) { // the short way goes clockwise: transfer angle above pi
+        curve.lambda = -curve.lambda;
+        cross(ir1, ih, it1);
+        cross(ir2, ih, it2);
+    } else {
+        cross(ih, ir1, it1);
+        cross(ih, ir2, it2);
+    }
+    scale(it1, 1.0 / norm(it1));
+    scale(it2, 1.0 / norm(it2));
+    curve.lambda3 = curve.lambda * curve.lambda2;
+    const double lambda = curve.lambda, lambda2 = curve.lambda2, lambda3 = curve.lambda3;
+
+    const double T = std::sqrt(2.0 * mu / (s * s * s)) * timeOfFlight;
+
+    // most revolutions the time allows: the minimum of T(x) for Nmax decides the last one
+    int revolutions = int(T / kPi);
+    const double T00 = std::acos(lambda) + lambda * std::sqrt(1.0 - lambda2);
+    if(revolutions > 0 && T < T00 + revolutions * kPi) {
+        double x = 0.0, tMin = T00 + revolutions * kPi;
+        for(int it = 0; it < 12; ++it) {
+            double dt, ddt, dddt;
+            curve.derivatives(x, tMin, dt, ddt, dddt);
+            const double next = dt != 0.0 ? x - dt * ddt / (ddt * ddt - dt * dddt / 2.0) : x;
+            const bool done = std::fabs(x - next) < 1e-13;
+            x = next;
+            tMin = curve.time(x, revolutions);
+            if(done)
+                break;
+        }
+        if(tMin > T)
+            --revolutions;
+    }
+    revolutions = std::min(revolutions, std::max(0, maxRevolutions));
+
+    // x of each arc, from Izzo's initial guesses
+    double xs[64];
+    int ns[64];
+    size_t count = 0;
+    const double T1 = 2.0 / 3.0 * (1.0 - lambda3);
+    double x0;
+    if(T >= T00)
+        x0 = -(T - T00) / (T - T00 + 4.0);
+    else if(T <= T1)
+        x0 = T1 * (T1 - T) / (2.0 / 5.0 * (1.0 - lambda2 * lambda3) * T) + 1.0;
+    else
+        x0 = std::pow(T / T00, 0.69314718055994529 / std::log(T1 / T00)) - 1.0;
+    xs[count] = curve.householder(T, x0, 0, 1e-5);
+    ns[count++] = 0;
+    for(int n = 1; n <= revolutions && count + 2 <= 64; ++n) {
+        double tmp = std::pow((n * kPi + kPi) / (8.0 * T), 2.0 / 3.0);
+        xs[count] = curve.householder(T, (tmp - 1.0) / (tmp + 1.0), n, 1e-8);
+        ns[count++] = n;
+        tmp = std::pow(8.0 * T / (n * kPi), 2.0 / 3.0);
+        xs[count] = curve.householder(T, (tmp - 1.0) / (tmp + 1.0), n, 1e-8);
+        ns[count++] = n;
+    }
+
+    // velocities from x: radial and tangential components at both ends
+    const double gamma = std::sqrt(mu * s / 2.0);
+    const double rho = (R1 - R2) / chord;
+    const double sigma = std::sqrt(std::max(0.0, 1.0 - rho * rho));
+    size_t solved = 0;
+    for(size_t k = 0; k < count; ++k) {
+        const double x = xs[k];
+        const double y = std::sqrt(1.0 - lambda2 + lambda2 * x * x);
+        const double vr1 = gamma * ((lambda * y - x) - rho * (lambda * y + x)) / R1;
+        const double vr2 = -gamma * ((lambda * y - x) + rho * (lambda * y + x)) / R2;
+        const double vt = gamma * sigma * (y + lambda * x);
+        const double vt1 = vt / R1, vt2 = vt / R2;
+        Solution &solution = out[solved];
+        for(int a = 0; a < 3; ++a) {
+            solution.v1[a] = vr1 * ir1[a] + vt1 * it1[a];
+            solution.v2[a] = vr2 * ir2[a] + vt2 * it2[a];
+        }
+        solution.revolutions = ns[k];
+        if(std::isfinite(solution.v1[0] + solution.v1[1] + solution.v1[2] + solution.v2[0] + solution.v2[1] + solution.v2[2]))
+            ++solved;
+    }
+    return solved;
+}
+
+} // namespace Lambert
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+// Lambert's problem: the conic arcs from r1 to r2 in a given time around a
+// central body of gravitational parameter mu.
+//
+// Izzo's formulation ("Revisiting Lambert's problem", 2015): one universal
+// variable x, a Householder (third order) iteration on the time of flight
+// curve T(x) from an initial guess that is already close, with the Battin
+// series near the parabola and Lagrange's or Lancaster's expressions
+// elsewhere, so it converges in two or three iterations for every
+// geometry and every number of revolutions. With N full revolutions there
+// are two arcs (the left and right branches of T(x)) whenever the time of
+// flight is above the N revolution minimum.
+namespace Lambert {
+
+struct Solution {
+    double v1[3], v2[3]; // velocity leaving r1 and arriving at r2
+    int revolutions;
+};
+
+// At most 1 + 2 maxRevolutions solutions, written to `out`; returns how many.
+// The transfer goes around `normal` counterclockwise (prograde for an orbit
+// whose angular momentum is `normal`), so the transfer angle is above pi when
+// r1 x r2 points against it. Nothing for a non positive time of flight or
+// collinear positions.
+size_t solve(const double r1[3], const double r2[3], double timeOfFlight, double mu, const double normal[3],
+             int maxRevolutions, Solution *out);
+
+} // namespace Lambert
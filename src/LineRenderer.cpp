@@ -0,0 +1,52 @@
+// LineRenderer.cpp
+#include "LineRenderer.hpp"
+
+#include <glm/ext.hpp>
+
+void LineRenderer::init(const GLuint program) {
+    m_program = program;
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Layout (location = 0)
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float))); // Layout (location = 1)
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
+
+void LineRenderer::destroy() {
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+    m_vbo = m_vao = 0;
+    m_count = m_capacity = 0;
+}
+
+void LineRenderer::update(const float *vertices, const size_t count) {
+    m_count = count;
+    if(!count)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    if(count > m_capacity) {
+        m_capacity = count + count / 2;
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * 4 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * 4 * sizeof(float), vertices);
+}
+
+void LineRenderer::render(const glm::mat4 &viewProj, const glm::vec3 &color) const {
+    if(m_count < 2)
+        return;
+    glUseProgram(m_program);
+    glUniformMatrix4fv(glGetUniformLocation(m_program, "viewProj"), 1, GL_FALSE, glm::value_ptr(viewProj));
+    glUniform3fv(glGetUniformLocation(m_program, "color"), 1, glm::value_ptr(color));
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(m_vao);
+    glDrawArrays(GL_LINE_STRIP, 0, GLsizei(m_count));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
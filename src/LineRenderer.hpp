@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// One line strip streamed to the GPU, for paths that change every frame.
+// Vertices are x, y, z (camera-relative, as everything drawn) and a fade
+// from 0 to 1 along the line; the buffer only grows, a smaller line goes
+// through glBufferSubData.
+class LineRenderer {
+public:
+    // With a program of lineVertex.glsl and lineFragment.glsl.
+    void init(GLuint program);
+    void destroy();
+    void update(const float *vertices, size_t count);
+    void render(const glm::mat4 &viewProj, const glm::vec3 &color) const;
+    inline size_t size() const { return m_count; }
+
+private:
+    GLuint m_program = 0;
+    GLuint m_vao = 0;
+    GLuint m_vbo = 0;
+    size_t m_count = 0, m_capacity = 0;
+};
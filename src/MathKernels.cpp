@@ -0,0 +1,309 @@
+// MathKernels.cpp
+#include "MathKernels.hpp"
+
+#ifdef SOLAR_X86
+#include <immintrin.h>
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <glm/simd/matrix.h>
+#define SOLAR_GLM_SSE 1
+#endif
+#endif
+
+namespace MathKernels {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// scalar
+
+void transformScalar(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out) {
+    for(size_t i = 0; i < count; ++i)
+        out[i] = m * v[i];
+}
+
+void multiplyScalar(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    for(size_t i = 0; i < count; ++i)
+        out[i] = a * b[i];
+}
+
+void multiplyPairsScalar(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    for(size_t i = 0; i < count; ++i)
+        out[i] = a[i] * b[i];
+}
+
+void multiplyAffineScalar(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out) {
+    for(size_t i = 0; i < count; ++i)
+        out[i] = a * glm::mat4(b[i]);
+}
+
+#ifdef SOLAR_GLM_SSE
+// ---------------------------------------------------------------------------
+// SSE2 (the x86-64 baseline), glm's intrinsics one matrix or vector at a time
+
+inline void loadColumns(const glm::mat4 &m, glm_vec4 c[4]) {
+    for(int k = 0; k < 4; ++k)
+        c[k] = _mm_loadu_ps(&m[k][0]);
+}
+
+inline void storeColumns(const glm_vec4 c[4], glm::mat4 &m) {
+    for(int k = 0; k < 4; ++k)
+        _mm_storeu_ps(&m[k][0], c[k]);
+}
+
+void transformSse(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out) {
+    glm_vec4 mc[4];
+    loadColumns(m, mc);
+    for(size_t i = 0; i < count; ++i)
+        _mm_storeu_ps(&out[i][0], glm_mat4_mul_vec4(mc, _mm_loadu_ps(&v[i][0])));
+}
+
+void multiplySse(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    glm_vec4 ac[4], bc[4], oc[4];
+    loadColumns(a, ac);
+    for(size_t i = 0; i < count; ++i) {
+        loadColumns(b[i], bc);
+        glm_mat4_mul(ac, bc, oc);
+        storeColumns(oc, out[i]);
+    }
+}
+
+void multiplyPairsSse(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    glm_vec4 ac[4], bc[4], oc[4];
+    for(size_t i = 0; i < count; ++i) {
+        loadColumns(a[i], ac);
+        loadColumns(b[i], bc);
+        glm_mat4_mul(ac, bc, oc);
+        storeColumns(oc, out[i]);
+    }
+}
+
+void multiplyAffineSse(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out) {
+    const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128 w = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+    glm_vec4 ac[4], bc[4], oc[4];
+    loadColumns(a, ac);
+    for(size_t i = 0; i < count; ++i) {
+        // 12 floats, every load stays inside them
+        const float *p = &b[i][0][0];
+        bc[0] = _mm_and_ps(_mm_loadu_ps(p), xyz);
+        bc[1] = _mm_and_ps(_mm_loadu_ps(p + 3), xyz);
+        bc[2] = _mm_and_ps(_mm_loadu_ps(p + 6), xyz);
+        const __m128 t = _mm_loadu_ps(p + 8);
+        bc[3] = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 3, 2, 1)), xyz), w);
+        glm_mat4_mul(ac, bc, oc);
+        storeColumns(oc, out[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA, two vectors (or columns) per register
+
+// out lanes = m * x lanes, with m's columns broadcast to both halves in mc
+SOLAR_TARGET("avx2,fma")
+inline __m256 transform2(const __m256 mc[4], __m256 x) {
+    __m256 r = _mm256_mul_ps(mc[0], _mm256_permute_ps(x, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = _mm256_fmadd_ps(mc[1], _mm256_permute_ps(x, _MM_SHUFFLE(1, 1, 1, 1)), r);
+    r = _mm256_fmadd_ps(mc[2], _mm256_permute_ps(x, _MM_SHUFFLE(2, 2, 2, 2)), r);
+    return _mm256_fmadd_ps(mc[3], _mm256_permute_ps(x, _MM_SHUFFLE(3, 3, 3, 3)), r);
+}
+
+SOLAR_TARGET("avx2,fma")
+inline void broadcastColumns2(const glm::mat4 &m, __m256 mc[4]) {
+    for(int k = 0; k < 4; ++k)
+        mc[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&m[k][0]));
+}
+
+SOLAR_TARGET("avx2,fma")
+void transformAvx2(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out) {
+    __m256 mc[4];
+    broadcastColumns2(m, mc);
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2)
+        _mm256_storeu_ps(&out[i][0], transform2(mc, _mm256_loadu_ps(&v[i][0])));
+    if(i < count)
+        transformSse(m, v + i, count - i, out + i);
+}
+
+SOLAR_TARGET("avx2,fma")
+void multiplyAvx2(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    // the columns of a product are the left matrix times the right one's columns
+    transformAvx2(a, reinterpret_cast<const glm::vec4 *>(b), 4 * count, reinterpret_cast<glm::vec4 *>(out));
+}
+
+SOLAR_TARGET("avx2,fma")
+void multiplyPairsAvx2(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    for(size_t i = 0; i < count; ++i) {
+        // broadcasts straight from memory, a loop over an array of them ends up on the stack
+        const __m256 ac[4] = {
+            _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&a[i][0][0])),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&a[i][1][0])),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&a[i][2][0])),
+            _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&a[i][3][0]))
+        };
+        const __m256 lo = _mm256_loadu_ps(&b[i][0][0]), hi = _mm256_loadu_ps(&b[i][2][0]);
+        _mm256_storeu_ps(&out[i][0][0], transform2(ac, lo));
+        _mm256_storeu_ps(&out[i][2][0], transform2(ac, hi));
+    }
+}
+
+SOLAR_TARGET("avx2,fma")
+void multiplyAffineAvx2(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out) {
+    // spread the 3-float columns to one per 128-bit lane, w is never read
+    const __m256i spreadLo = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i spreadHi = _mm256_setr_epi32(2, 3, 4, 0, 5, 6, 7, 0);
+    __m256 ac[4];
+    broadcastColumns2(a, ac);
+    // the translation column picks up a's last column, the others don't
+    const __m256 a3 = _mm256_insertf128_ps(_mm256_setzero_ps(), _mm_loadu_ps(&a[3][0]), 1);
+    for(size_t i = 0; i < count; ++i) {
+        const float *p = &b[i][0][0];
+        const __m256 lo = _mm256_permutevar8x32_ps(_mm256_loadu_ps(p), spreadLo);
+        const __m256 hi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(p + 4), spreadHi);
+        __m256 rl = _mm256_mul_ps(ac[0], _mm256_permute_ps(lo, _MM_SHUFFLE(0, 0, 0, 0)));
+        __m256 rh = _mm256_fmadd_ps(ac[0], _mm256_permute_ps(hi, _MM_SHUFFLE(0, 0, 0, 0)), a3);
+        rl = _mm256_fmadd_ps(ac[1], _mm256_permute_ps(lo, _MM_SHUFFLE(1, 1, 1, 1)), rl);
+        rh = _mm256_fmadd_ps(ac[1], _mm256_permute_ps(hi, _MM_SHUFFLE(1, 1, 1, 1)), rh);
+        rl = _mm256_fmadd_ps(ac[2], _mm256_permute_ps(lo, _MM_SHUFFLE(2, 2, 2, 2)), rl);
+        rh = _mm256_fmadd_ps(ac[2], _mm256_permute_ps(hi, _MM_SHUFFLE(2, 2, 2, 2)), rh);
+        _mm256_storeu_ps(&out[i][0][0], rl);
+        _mm256_storeu_ps(&out[i][2][0], rh);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512, four vectors (a whole matrix) per register.
+// Broadcasts and permutes go through the zero-masked forms with every lane on:
+// GCC's plain ones merge into _mm512_undefined_ps(), which -Wmaybe-uninitialized
+// reports in every caller.
+
+const __mmask16 kAllLanes = 0xFFFF;
+
+// element k of each 128-bit lane of x, across the lane
+template <int k>
+SOLAR_TARGET("avx512f")
+inline __m512 splat(__m512 x) {
+    return _mm512_maskz_permute_ps(kAllLanes, x, _MM_SHUFFLE(k, k, k, k));
+}
+
+// the 4 floats at p in every 128-bit lane
+SOLAR_TARGET("avx512f")
+inline __m512 broadcast4(const float *p) {
+    return _mm512_maskz_broadcast_f32x4(kAllLanes, _mm_loadu_ps(p));
+}
+
+SOLAR_TARGET("avx512f")
+inline __m512 transform4(const __m512 mc[4], __m512 x) {
+    __m512 r = _mm512_mul_ps(mc[0], splat<0>(x));
+    r = _mm512_fmadd_ps(mc[1], splat<1>(x), r);
+    r = _mm512_fmadd_ps(mc[2], splat<2>(x), r);
+    return _mm512_fmadd_ps(mc[3], splat<3>(x), r);
+}
+
+SOLAR_TARGET("avx512f")
+inline void broadcastColumns4(const glm::mat4 &m, __m512 mc[4]) {
+    for(int k = 0; k < 4; ++k)
+        mc[k] = broadcast4(&m[k][0]);
+}
+
+SOLAR_TARGET("avx512f")
+void transformAvx512(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out) {
+    __m512 mc[4];
+    broadcastColumns4(m, mc);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+        _mm512_storeu_ps(&out[i][0], transform4(mc, _mm512_loadu_ps(&v[i][0])));
+    if(i < count) {
+        // masked, the lanes past the end are neither read nor written
+        const __mmask16 mask = __mmask16((1u << (4 * (count - i))) - 1);
+        _mm512_mask_storeu_ps(&out[i][0], mask, transform4(mc, _mm512_maskz_loadu_ps(mask, &v[i][0])));
+    }
+}
+
+SOLAR_TARGET("avx512f")
+void multiplyAvx512(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    transformAvx512(a, reinterpret_cast<const glm::vec4 *>(b), 4 * count, reinterpret_cast<glm::vec4 *>(out));
+}
+
+SOLAR_TARGET("avx512f")
+void multiplyPairsAvx512(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    for(size_t i = 0; i < count; ++i) {
+        const __m512 ac[4] = {
+            broadcast4(&a[i][0][0]),
+            broadcast4(&a[i][1][0]),
+            broadcast4(&a[i][2][0]),
+            broadcast4(&a[i][3][0])
+        };
+        _mm512_storeu_ps(&out[i][0][0], transform4(ac, _mm512_loadu_ps(&b[i][0][0])));
+    }
+}
+
+SOLAR_TARGET("avx512f")
+void multiplyAffineAvx512(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out) {
+    const __m512i spread = _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0, 6, 7, 8, 0, 9, 10, 11, 0);
+    __m512 ac[4];
+    broadcastColumns4(a, ac);
+    const __m512 a3 = _mm512_insertf32x4(_mm512_setzero_ps(), _mm_loadu_ps(&a[3][0]), 3);
+    for(size_t i = 0; i < count; ++i) {
+        const __m512 x = _mm512_maskz_permutexvar_ps(kAllLanes, spread, _mm512_maskz_loadu_ps(0x0fff, &b[i][0][0]));
+        __m512 r = _mm512_fmadd_ps(ac[0], splat<0>(x), a3);
+        r = _mm512_fmadd_ps(ac[1], splat<1>(x), r);
+        r = _mm512_fmadd_ps(ac[2], splat<2>(x), r);
+        _mm512_storeu_ps(&out[i][0][0], r);
+    }
+}
+#endif // SOLAR_GLM_SSE
+
+struct KernelTable {
+    void (*transform)(const glm::mat4 &, const glm::vec4 *, size_t, glm::vec4 *);
+    void (*multiply)(const glm::mat4 &, const glm::mat4 *, size_t, glm::mat4 *);
+    void (*multiplyPairs)(const glm::mat4 *, const glm::mat4 *, size_t, glm::mat4 *);
+    void (*multiplyAffine)(const glm::mat4 &, const glm::mat4x3 *, size_t, glm::mat4 *);
+    SimdLevel level;
+};
+
+KernelTable selectKernels() {
+#ifdef SOLAR_GLM_SSE
+    const SimdLevel level = CpuFeatures::get().level();
+    if(level >= SimdLevel::AVX512) {
+        const KernelTable t = { transformAvx512, multiplyAvx512, multiplyPairsAvx512, multiplyAffineAvx512, SimdLevel::AVX512 };
+        return t;
+    }
+    if(level >= SimdLevel::AVX2) {
+        const KernelTable t = { transformAvx2, multiplyAvx2, multiplyPairsAvx2, multiplyAffineAvx2, SimdLevel::AVX2 };
+        return t;
+    }
+    if(level >= SimdLevel::SSE) {
+        const KernelTable t = { transformSse, multiplySse, multiplyPairsSse, multiplyAffineSse, SimdLevel::SSE };
+        return t;
+    }
+#endif
+    const KernelTable t = { transformScalar, multiplyScalar, multiplyPairsScalar, multiplyAffineScalar, SimdLevel::Scalar };
+    return t;
+}
+
+const KernelTable &kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+void transform(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out) {
+    kernels().transform(m, v, count, out);
+}
+
+void multiply(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    kernels().multiply(a, b, count, out);
+}
+
+void multiplyPairs(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out) {
+    kernels().multiplyPairs(a, b, count, out);
+}
+
+void multiplyAffine(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out) {
+    kernels().multiplyAffine(a, b, count, out);
+}
+
+SimdLevel activeLevel() { return kernels().level; }
+
+} // namespace MathKernels
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "CpuFeatures.hpp"
+
+// Batched mat4 / vec4 math, compiled for several ISA levels and picked at
+// startup from cpuid, so one binary runs the widest kernel each machine has.
+//
+// The SSE2 level is the x86-64 baseline and uses glm's own SSE code
+// (glm/simd/matrix.h, enabled with GLM_FORCE_INTRINSICS). AVX2 + FMA works on
+// two columns per register and AVX-512 on a whole matrix (or four vectors):
+// a column of the result is the left matrix's columns times the broadcast
+// elements of the right one, which needs no transposes.
+//
+// Arrays are glm's usual column-major layout; any alignment works, but data
+// kept in an AlignedVector never has a load split across cache lines. The
+// output may be the right-hand input.
+namespace MathKernels {
+
+// out[i] = m * v[i]
+void transform(const glm::mat4 &m, const glm::vec4 *v, size_t count, glm::vec4 *out);
+
+// out[i] = a * b[i], e.g. a view-projection times each model matrix
+void multiply(const glm::mat4 &a, const glm::mat4 *b, size_t count, glm::mat4 *out);
+
+// out[i] = a[i] * b[i]
+void multiplyPairs(const glm::mat4 *a, const glm::mat4 *b, size_t count, glm::mat4 *out);
+
+// out[i] = a * mat4(b[i]), for 3x4 affine transforms with an implied 0 0 0 1 last row
+void multiplyAffine(const glm::mat4 &a, const glm::mat4x3 *b, size_t count, glm::mat4 *out);
+
+// Level actually used.
+SimdLevel activeLevel();
+
+} // namespace MathKernels
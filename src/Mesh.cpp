@@ -1,6 +1,8 @@
 // Mesh.cpp
 #include "Mesh.hpp"
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
 #include <iostream>
 
@@ -76,10 +78,54 @@ std::shared_ptr<Mesh> Mesh::genSphere(const size_t resolution) {
     return mesh;
 }
 
+namespace {
+const uint32_t kMeshMagic = 0x4853454d; // "MESH"
+}
+
+std::vector<unsigned char> Mesh::serialize() const {
+    const uint32_t header[4] = { kMeshMagic, uint32_t(m_vertexPositions.size() / 3), uint32_t(m_triangleIndices.size()), 0 };
+    std::vector<unsigned char> blob(sizeof(header));
+    std::memcpy(blob.data(), header, sizeof(header));
+    const auto append = [&blob](const void *data, size_t bytes) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        blob.insert(blob.end(), p, p + bytes);
+    };
+    append(m_vertexPositions.data(), m_vertexPositions.size() * sizeof(float));
+    append(m_vertexNormals.data(), m_vertexNormals.size() * sizeof(float));
+    append(m_vertexTexCoords.data(), m_vertexTexCoords.size() * sizeof(float));
+    append(m_triangleIndices.data(), m_triangleIndices.size() * sizeof(unsigned int));
+    return blob;
+}
+
+bool Mesh::initFromBlob(const unsigned char *blob, size_t size) {
+    uint32_t header[4];
+    if(size < sizeof(header))
+        return false;
+    std::memcpy(header, blob, sizeof(header));
+    const size_t vertexCount = header[1], indexCount = header[2];
+    if(header[0] != kMeshMagic || size < sizeof(header) + vertexCount * 8 * sizeof(float) + indexCount * sizeof(unsigned int)) {
+        std::cerr << "ERROR: invalid mesh blob" << std::endl;
+        return false;
+    }
+    // the pack aligns blobs, and every array in the blob is a multiple of 4 bytes
+    const float *positions = reinterpret_cast<const float *>(blob + sizeof(header));
+    const float *normals = positions + vertexCount * 3;
+    const float *texCoords = normals + vertexCount * 3;
+    const unsigned int *indices = reinterpret_cast<const unsigned int *>(texCoords + vertexCount * 2);
+    upload(positions, normals, texCoords, vertexCount, indices, indexCount);
+    return true;
+}
+
 /* after creating vertices and indices we need to upload them to the GPU, using VBO (holds the vertex data) and EBO (index data). These 
 buffers are associated with a VAO (Vertex Array Object), which keeps track of which vertex attributes (positions, normals, 
 texture coordinates, etc.) are stored in which buffers. */
 void Mesh::init() {
+    upload(m_vertexPositions.data(), m_vertexNormals.data(), m_vertexTexCoords.data(), m_vertexPositions.size() / 3,
+           m_triangleIndices.data(), m_triangleIndices.size());
+}
+
+void Mesh::upload(const float *positions, const float *normals, const float *texCoords, size_t vertexCount,
+                  const unsigned int *indices, size_t indexCount) {
     // buffers
     glGenVertexArrays(1, &m_vao);
     glGenBuffers(1, &m_posVbo);
@@ -92,25 +138,26 @@ void Mesh::init() {
 
     // positions
     glBindBuffer(GL_ARRAY_BUFFER, m_posVbo);
-    glBufferData(GL_ARRAY_BUFFER, m_vertexPositions.size() * sizeof(float), m_vertexPositions.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), positions, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); // Layout (location = 0)
     glEnableVertexAttribArray(0);
 
     // normals
     glBindBuffer(GL_ARRAY_BUFFER, m_normalVbo);
-    glBufferData(GL_ARRAY_BUFFER, m_vertexNormals.size() * sizeof(float), m_vertexNormals.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), normals, GL_STATIC_DRAW);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); // Layout (location = 1)
     glEnableVertexAttribArray(1);
 
     // texture coordinates
     glBindBuffer(GL_ARRAY_BUFFER, m_texCoordVbo); // Bind the texture coordinate buffer
-    glBufferData(GL_ARRAY_BUFFER, m_vertexTexCoords.size() * sizeof(float), m_vertexTexCoords.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 2 * sizeof(float), texCoords, GL_STATIC_DRAW);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0); // Layout (location = 2)
     glEnableVertexAttribArray(2);
 
     // Indices
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_triangleIndices.size() * sizeof(unsigned int), m_triangleIndices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    m_indexCount = (GLsizei)indexCount;
 
     // Unbind VAO
     glBindVertexArray(0);
@@ -118,7 +165,6 @@ void Mesh::init() {
 
 void Mesh::render() {
     glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_triangleIndices.size(), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0); 
 }
-
@@ -9,6 +9,12 @@ public:
     void init(); 
     void render(); 
     static std::shared_ptr<Mesh> genSphere(const size_t resolution); 
+
+    // Binary blob used by the asset pack: a 16-byte header {magic, vertex count,
+    // index count, 0} followed by positions, normals, texture coordinates and indices.
+    std::vector<unsigned char> serialize() const;
+    // Uploads a serialized mesh straight from the blob (e.g. the mapped pack), without a CPU copy.
+    bool initFromBlob(const unsigned char *blob, size_t size);
     
 private:
     std::vector<float> m_vertexPositions;
@@ -21,4 +27,8 @@ private:
     GLuint m_normalVbo = 0;
     GLuint m_ibo = 0;
     GLuint m_texCoordVbo = 0;
-};
\ No newline at end of file
+    GLsizei m_indexCount = 0;
+
+    void upload(const float *positions, const float *normals, const float *texCoords, size_t vertexCount,
+                const unsigned int *indices, size_t indexCount);
+};
@@ -0,0 +1,356 @@
+// NBody.cpp
+#include "NBody.hpp"
+#include "BodyTable.hpp"
+#include "GravityKernels.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// Sources are walked in tiles small enough to stay in L1 (4 floats each)
+// while every target group of a block runs over them.
+const size_t kSourceTile = 1024;
+// Targets handed to one task at a time.
+const size_t kTargetBlock = 256;
+// Arrays are padded for the kernels; padding bodies have no mass.
+const size_t kPadding = GravityKernels::kTargetPadding;
+// Auto switches to the tree above this many bodies.
+const size_t kDirectLimit = 8192;
+
+} // namespace
+
+SimdLevel NBody::activeLevel() { return GravityKernels::activeLevel(); }
+
+void NBody::resize(size_t n) {
+    posX.assign(n, 0.0);
+    posY.assign(n, 0.0);
+    posZ.assign(n, 0.0);
+    velX.assign(n, 0.0);
+    velY.assign(n, 0.0);
+    velZ.assign(n, 0.0);
+    accX.assign(n, 0.f);
+    accY.assign(n, 0.f);
+    accZ.assign(n, 0.f);
+    mu.assign(n, 0.f);
+    radius.assign(n, 0.f);
+    level.assign(n, 0);
+    m_rate.assign(n, 0.f);
+    m_time = 0.0;
+}
+
+void NBody::reset(const BodyTable &bodies, double time) {
+    const size_t n = bodies.size();
+    resize(n);
+    m_time = time;
+
+    // relative positions now and a moment around now, for the direction of motion
+    const double h = 1e-3;
+    std::vector<double> x(n), y(n), z(n), xa(n), ya(n), za(n), xb(n), yb(n), zb(n);
+    bodies.offsets(time, x.data(), y.data(), z.data());
+    bodies.offsets(time + h, xa.data(), ya.data(), za.data());
+    bodies.offsets(time - h, xb.data(), yb.data(), zb.data());
+
+    double totalMu = 0.0, px = 0.0, py = 0.0, pz = 0.0;
+    for(size_t i = 0; i < n; ++i) {
+        mu[i] = bodies.mu[i];
+        radius[i] = bodies.radius[i];
+        double vx = (xa[i] - xb[i]) / (2.0 * h), vy = (ya[i] - yb[i]) / (2.0 * h), vz = (za[i] - zb[i]) / (2.0 * h);
+        const int p = bodies.parent[i];
+        if(p >= 0 && bodies.mu[p] > 0.f) {
+            // same path, at the speed these masses give it: v^2 = mu (2/r - 1/a)
+            const double r = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+            const double a = bodies.semiMajorAxis[i];
+            const double speed = std::sqrt(std::max(0.0, (double(bodies.mu[p]) + bodies.mu[i]) * (2.0 / r - 1.0 / a)));
+            const double current = std::sqrt(vx * vx + vy * vy + vz * vz);
+            if(r > 0.0 && current > 0.0) {
+                vx *= speed / current;
+                vy *= speed / current;
+                vz *= speed / current;
+            }
+        }
+        posX[i] = x[i];
+        posY[i] = y[i];
+        posZ[i] = z[i];
+        if(p >= 0) { // parents come first
+            posX[i] += posX[p];
+            posY[i] += posY[p];
+            posZ[i] += posZ[p];
+            vx += velX[p];
+            vy += velY[p];
+            vz += velZ[p];
+        }
+        velX[i] = vx;
+        velY[i] = vy;
+        velZ[i] = vz;
+        totalMu += mu[i];
+        px += mu[i] * vx;
+        py += mu[i] * vy;
+        pz += mu[i] * vz;
+    }
+    if(totalMu > 0.0) {
+        for(size_t i = 0; i < n; ++i) {
+            velX[i] -= px / totalMu;
+            velY[i] -= py / totalMu;
+            velZ[i] -= pz / totalMu;
+        }
+    }
+    computeAccelerations();
+}
+
+void NBody::computeAccelerations() {
+    m_active.resize(size());
+    for(size_t i = 0; i < m_active.size(); ++i)
+        m_active[i] = uint32_t(i);
+    evaluate(m_active);
+}
+
+void NBody::saveState(std::vector<double> &state) const {
+    const size_t n = size();
+    state.resize(6 * n);
+    const std::vector<double> *arrays[6] = { &posX, &posY, &posZ, &velX, &velY, &velZ };
+    for(int a = 0; a < 6; ++a)
+        std::copy(arrays[a]->begin(), arrays[a]->end(), state.begin() + a * n);
+}
+
+void NBody::restoreState(const std::vector<double> &state, const double time) {
+    const size_t n = size();
+    std::vector<double> *arrays[6] = { &posX, &posY, &posZ, &velX, &velY, &velZ };
+    for(int a = 0; a < 6; ++a)
+        std::copy(state.begin() + a * n, state.begin() + (a + 1) * n, arrays[a]->begin());
+    m_time = time;
+    computeAccelerations(); // the same forces the step that reached this state ended with
+}
+
+void NBody::evaluate(const std::vector<uint32_t> &active) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const size_t n = size();
+    const size_t padded = (n + kPadding - 1) / kPadding * kPadding;
+    m_x.assign(padded, 0.f);
+    m_y.assign(padded, 0.f);
+    m_z.assign(padded, 0.f);
+    m_mu.assign(padded, 0.f);
+    for(size_t i = 0; i < n; ++i) {
+        m_x[i] = float(posX[i]);
+        m_y[i] = float(posY[i]);
+        m_z[i] = float(posZ[i]);
+        m_mu[i] = mu[i];
+    }
+    m_rate.resize(n, 0.f);
+
+    double interactions;
+    if(solver == Solver::BarnesHut || (solver == Solver::Auto && n > kDirectLimit)) {
+        // the tree serves every body at once, and has no timestep rates: block steps stay at level 0
+        m_tree.build(m_x.data(), m_y.data(), m_z.data(), m_mu.data(), n);
+        interactions = double(m_tree.accelerations(theta, softening2, accX.data(), accY.data(), accZ.data()));
+    } else {
+        // gather the active bodies as padded targets, every body is a source
+        const size_t targets = (active.size() + kPadding - 1) / kPadding * kPadding;
+        m_tx.assign(targets, 0.f);
+        m_ty.assign(targets, 0.f);
+        m_tz.assign(targets, 0.f);
+        m_tmu.assign(targets, 0.f);
+        m_ax.assign(targets, 0.f);
+        m_ay.assign(targets, 0.f);
+        m_az.assign(targets, 0.f);
+        m_trate.assign(targets, 0.f);
+        for(size_t k = 0; k < active.size(); ++k) {
+            m_tx[k] = m_x[active[k]];
+            m_ty[k] = m_y[active[k]];
+            m_tz[k] = m_z[active[k]];
+            m_tmu[k] = m_mu[active[k]];
+        }
+        const float eps2 = softening2;
+        const bool rates = blockTimesteps;
+        Parallel::parallelFor(0, (targets + kTargetBlock - 1) / kTargetBlock, [&](size_t block) {
+            const size_t begin = block * kTargetBlock, count = std::min(targets, begin + kTargetBlock) - begin;
+            for(size_t tile = 0; tile < padded; tile += kSourceTile) {
+                const size_t tileCount = std::min(padded, tile + kSourceTile) - tile;
+                if(rates)
+                    GravityKernels::accumulateBodiesAndRates(&m_tx[begin], &m_ty[begin], &m_tz[begin], &m_tmu[begin], count,
+                                                             &m_x[tile], &m_y[tile], &m_z[tile], &m_mu[tile], tileCount, eps2,
+                                                             &m_ax[begin], &m_ay[begin], &m_az[begin], &m_trate[begin]);
+                else
+                    GravityKernels::accumulateBodies(&m_tx[begin], &m_ty[begin], &m_tz[begin], count,
+                                                     &m_x[tile], &m_y[tile], &m_z[tile], &m_mu[tile], tileCount, eps2,
+                                                     &m_ax[begin], &m_ay[begin], &m_az[begin]);
+            }
+        }, "nbody.forces");
+        for(size_t k = 0; k < active.size(); ++k) {
+            accX[active[k]] = m_ax[k];
+            accY[active[k]] = m_ay[k];
+            accZ[active[k]] = m_az[k];
+            m_rate[active[k]] = m_trate[k];
+        }
+        interactions = double(active.size()) * double(n);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(seconds > 0.0)
+        m_interactionsPerSecond = interactions / seconds;
+}
+
+int NBody::levelFor(size_t i, double dtMax) const {
+    if(m_rate[i] <= 0.f)
+        return 0;
+    const double dt = eta / std::sqrt(double(m_rate[i]));
+    if(dt >= dtMax)
+        return 0;
+    return std::min(maxLevel, int(std::ceil(std::log2(dtMax / dt))));
+}
+
+void NBody::step(double dt) {
+    if(blockTimesteps) {
+        m_contacts.clear();
+        blockStep(dt);
+        return;
+    }
+    const size_t n = size();
+    const double halfDt = 0.5 * dt;
+    if(collisions) {
+        // the contacts need the velocities of the drift, before it moves anyone
+        for(size_t i = 0; i < n; ++i) {
+            velX[i] += accX[i] * halfDt;
+            velY[i] += accY[i] * halfDt;
+            velZ[i] += accZ[i] * halfDt;
+        }
+        m_collider.detect(posX.data(), posY.data(), posZ.data(), velX.data(), velY.data(), velZ.data(),
+                          radius.data(), n, dt, m_contacts);
+        for(size_t i = 0; i < n; ++i) {
+            posX[i] += velX[i] * dt;
+            posY[i] += velY[i] * dt;
+            posZ[i] += velZ[i] * dt;
+        }
+        bounce(dt);
+    } else {
+        m_contacts.clear();
+        for(size_t i = 0; i < n; ++i) {
+            velX[i] += accX[i] * halfDt;
+            velY[i] += accY[i] * halfDt;
+            velZ[i] += accZ[i] * halfDt;
+            posX[i] += velX[i] * dt;
+            posY[i] += velY[i] * dt;
+            posZ[i] += velZ[i] * dt;
+        }
+    }
+    computeAccelerations();
+    for(size_t i = 0; i < n; ++i) {
+        velX[i] += accX[i] * halfDt;
+        velY[i] += accY[i] * halfDt;
+        velZ[i] += accZ[i] * halfDt;
+    }
+    m_time += dt;
+}
+
+// Impulses of the contacts found for the drift that just ended, earliest
+// first, one per body: a body that bounced has left the path the later
+// contacts were found on. Each one moves on with its new velocity from the
+// time of impact, so the drift is redone from there.
+void NBody::bounce(double dt) {
+    m_bounced.assign(size(), 0);
+    for(size_t c = 0; c < m_contacts.size(); ++c) {
+        const Contact &contact = m_contacts[c];
+        const uint32_t a = contact.a, b = contact.b;
+        if(m_bounced[a] || m_bounced[b])
+            continue;
+        const double nx = contact.nx, ny = contact.ny, nz = contact.nz;
+        const double approach = (velX[b] - velX[a]) * nx + (velY[b] - velY[a]) * ny + (velZ[b] - velZ[a]) * nz;
+        if(approach >= 0.0)
+            continue; // touching but already separating
+        // inverse masses; a massless body against a massive one takes the whole impulse
+        double wa = mu[a] > 0.f ? 1.0 / mu[a] : 0.0, wb = mu[b] > 0.f ? 1.0 / mu[b] : 0.0;
+        if(mu[a] <= 0.f || mu[b] <= 0.f) {
+            wa = mu[a] > 0.f ? 0.0 : 1.0;
+            wb = mu[b] > 0.f ? 0.0 : 1.0;
+        }
+        const double impulse = -(1.0 + restitution) * approach / (wa + wb);
+        const double rest = dt - contact.time;
+        const double da = -impulse * wa, db = impulse * wb;
+        velX[a] += da * nx;
+        velY[a] += da * ny;
+        velZ[a] += da * nz;
+        velX[b] += db * nx;
+        velY[b] += db * ny;
+        velZ[b] += db * nz;
+        posX[a] += da * nx * rest;
+        posY[a] += da * ny * rest;
+        posZ[a] += da * nz * rest;
+        posX[b] += db * nx * rest;
+        posY[b] += db * ny * rest;
+        posZ[b] += db * nz * rest;
+        m_bounced[a] = m_bounced[b] = 1;
+    }
+}
+
+void NBody::blockStep(double dtMax) {
+    const size_t n = size();
+    const int ticks = 1 << maxLevel;
+    const double dtMin = dtMax / ticks;
+    m_rate.resize(n, 0.f);
+    level.resize(n);
+
+    // everyone is in sync here: pick the levels afresh and open the steps
+    for(size_t i = 0; i < n; ++i) {
+        level[i] = uint8_t(levelFor(i, dtMax));
+        const double halfDt = 0.5 * dtMax / (1 << level[i]);
+        velX[i] += accX[i] * halfDt;
+        velY[i] += accY[i] * halfDt;
+        velZ[i] += accZ[i] * halfDt;
+    }
+
+    for(int tick = 1; tick <= ticks; ++tick) {
+        for(size_t i = 0; i < n; ++i) {
+            posX[i] += velX[i] * dtMin;
+            posY[i] += velY[i] * dtMin;
+            posZ[i] += velZ[i] * dtMin;
+        }
+
+        // bodies whose step ends on this tick get forces, a closing kick and, unless the
+        // macro step is over, a new level and the opening kick of their next step
+        m_active.clear();
+        for(size_t i = 0; i < n; ++i)
+            if(tick % (ticks >> level[i]) == 0)
+                m_active.push_back(uint32_t(i));
+        if(m_active.empty())
+            continue;
+        evaluate(m_active);
+        for(size_t k = 0; k < m_active.size(); ++k) {
+            const size_t i = m_active[k];
+            const double closing = 0.5 * dtMax / (1 << level[i]);
+            velX[i] += accX[i] * closing;
+            velY[i] += accY[i] * closing;
+            velZ[i] += accZ[i] * closing;
+            if(tick == ticks)
+                continue;
+            // a longer step has to start on its own grid
+            int next = levelFor(i, dtMax);
+            while(next < level[i] && tick % (ticks >> next) != 0)
+                ++next;
+            level[i] = uint8_t(next);
+            const double opening = 0.5 * dtMax / (1 << next);
+            velX[i] += accX[i] * opening;
+            velY[i] += accY[i] * opening;
+            velZ[i] += accZ[i] * opening;
+        }
+    }
+    m_time += dtMax;
+}
+
+double NBody::energy() const {
+    const size_t n = size();
+    std::vector<double> perBody(n);
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        double e = 0.5 * mu[i] * (velX[i] * velX[i] + velY[i] * velY[i] + velZ[i] * velZ[i]);
+        for(size_t j = i + 1; j < n; ++j) {
+            const double dx = posX[j] - posX[i], dy = posY[j] - posY[i], dz = posZ[j] - posZ[i];
+            e -= double(mu[i]) * mu[j] / std::sqrt(dx * dx + dy * dy + dz * dz + softening2);
+        }
+        perBody[i] = e;
+    }, "nbody.energy");
+    double total = 0.0;
+    for(size_t i = 0; i < n; ++i)
+        total += perBody[i];
+    return total;
+}
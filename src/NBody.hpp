@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BarnesHut.hpp"
+#include "CollisionDetector.hpp"
+#include "CpuFeatures.hpp"
+
+class BodyTable;
+
+// Gravity simulation: every body attracts every other one.
+//
+// State lives in structure-of-arrays form, positions and velocities in double
+// so long runs do not drift. Each force evaluation snapshots the positions to
+// float and runs a SIMD kernel (AVX-512 or AVX2, scalar otherwise) over
+// cache-sized tiles of sources, with the targets split across the worker
+// threads. Large N goes through a Barnes-Hut tree instead. step() is a
+// kick-drift-kick leapfrog, symplectic for a fixed dt.
+//
+// With blockTimesteps, step(dt) is a macro step split into 2^maxLevel ticks:
+// each body advances with dt / 2^level, its level set by the tightest orbit
+// it is part of, and only the bodies whose own step ends on a tick get their
+// forces evaluated there. Every body drifts on every tick.
+//
+// With collisions, bodies that touch during the drift of a step bounce off
+// each other: CollisionDetector finds the contacts, and each body takes the
+// impulse of its first one, along the normal, losing what restitution leaves
+// out of the approach speed. Fixed steps only.
+class NBody {
+public:
+    // Starts from the Keplerian state of the bodies at `time`: positions of
+    // BodyTable::update(), velocities of the same orbits with the speed given
+    // by vis-viva for the masses (mu) of the table. The total momentum is
+    // removed so the system does not drift away.
+    void reset(const BodyTable &bodies, double time);
+
+    // Arbitrary initial conditions: resize(), fill the arrays, then call
+    // computeAccelerations() once before stepping.
+    void resize(size_t n);
+    void computeAccelerations();
+
+    // Positions and velocities packed as [x..., y..., z..., vx..., vy..., vz...],
+    // for checkpoints. Stepping on from a restored state repeats the original run exactly.
+    void saveState(std::vector<double> &state) const;
+    void restoreState(const std::vector<double> &state, double time);
+
+    // One leapfrog step of dt seconds (a macro step with blockTimesteps).
+    void step(double dt);
+
+    // Total energy (kinetic plus softened potential, in units of G), O(N^2).
+    double energy() const;
+
+    inline size_t size() const { return posX.size(); }
+    inline double time() const { return m_time; }
+
+    // Body-body and body-node interactions of the last force evaluation, per second of wall time.
+    inline double interactionsPerSecond() const { return m_interactionsPerSecond; }
+
+    // Contacts of the last step, sorted by time, and the broad phase pairs tested per second.
+    inline const std::vector<Contact> &contacts() const { return m_contacts; }
+    inline double collisionPairsPerSecond() const { return m_collider.pairsPerSecond(); }
+
+    // Plummer softening length squared, keeps close encounters finite.
+    float softening2 = 1e-4f;
+
+    // Direct summation is exact, the tree O(N log N) with an error set by the
+    // opening angle theta; Auto picks the tree past a few thousand bodies.
+    enum class Solver { Auto, Direct, BarnesHut };
+    Solver solver = Solver::Auto;
+    float theta = 0.5f;
+
+    // Hierarchical power-of-two timesteps, with the direct solver: a body's
+    // step is eta / omega, omega^2 = (mu_i + mu_j) / r^3 for its tightest
+    // partner j, so about 2 pi / eta steps per orbit.
+    bool blockTimesteps = false;
+    int maxLevel = 8;
+    float eta = 0.02f;
+
+    // Sphere-sphere collisions of the bodies (radius), with the fraction of
+    // the approach speed kept after a bounce.
+    bool collisions = false;
+    float restitution = 0.5f;
+
+    // per-body arrays
+    std::vector<double> posX, posY, posZ;
+    std::vector<double> velX, velY, velZ;
+    std::vector<float> accX, accY, accZ;
+    std::vector<float> mu;   // G * mass
+    std::vector<float> radius;
+    std::vector<uint8_t> level; // timestep level of the last macro step, dt / 2^level
+
+    // Level actually used by the force kernel.
+    static SimdLevel activeLevel();
+
+private:
+    void evaluate(const std::vector<uint32_t> &active);
+    int levelFor(size_t i, double dtMax) const;
+    void blockStep(double dtMax);
+    void bounce(double dt);
+
+    double m_time = 0.0;
+    double m_interactionsPerSecond = 0.0;
+    // float snapshot of the positions used by the force kernel, padded to the SIMD width
+    std::vector<float> m_x, m_y, m_z, m_mu;
+    // gathered targets of evaluate()
+    std::vector<uint32_t> m_active;
+    std::vector<float> m_tx, m_ty, m_tz, m_tmu, m_ax, m_ay, m_az, m_trate;
+    std::vector<float> m_rate; // per body (mu_i + mu_j) / r^3 of its tightest partner
+    BarnesHut m_tree;
+    CollisionDetector m_collider;
+    std::vector<Contact> m_contacts;
+    std::vector<uint8_t> m_bounced; // per body, took its impulse this step
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <thread>
+
+#include "JobSystem.hpp"
+
+// Fork-join helpers, on top of the work-stealing JobSystem: calls nest and any
+// thread may make them.
+namespace Parallel {
+
+// One per hardware thread; SOLAR_THREADS=<n> overrides it, handy to measure scaling.
+inline unsigned workerCount() {
+    static const unsigned count = []() {
+        const char *env = std::getenv("SOLAR_THREADS");
+        const int requested = env ? std::atoi(env) : 0;
+        if(requested > 0)
+            return unsigned(requested);
+        const unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1u;
+    }();
+    return count;
+}
+
+// Calls fn(i) for every i in [begin, end) on the job system's threads; the
+// name shows up in its profiling hook. minGrain is the smallest run of indices
+// worth a job of its own, raise it when fn(i) is only a few instructions.
+template<typename Fn>
+void parallelFor(size_t begin, size_t end, const Fn &fn, const char *name = "parallelFor", size_t minGrain = 1) {
+    JobSystem::get().parallelFor(begin, end, fn, name, minGrain);
+}
+
+} // namespace Parallel
@@ -0,0 +1,192 @@
+// Porkchop.cpp
+#include "Porkchop.hpp"
+#include "Lambert.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// floor(a / b) for the tile of a cell, negative cells included
+inline long long floorDiv(const long long a, const long long b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+} // namespace
+
+bool Porkchop::start(const BodyTable &bodies, const Settings &settings) {
+    stop();
+    const int n = int(bodies.size());
+    if(settings.from < 0 || settings.from >= n || settings.to < 0 || settings.to >= n || settings.from == settings.to) {
+        std::cerr << "ERROR: Porkchop needs two different bodies" << std::endl;
+        return false;
+    }
+    const int parent = bodies.parent[settings.from];
+    if(parent < 0 || bodies.parent[settings.to] != parent || !(bodies.mu[parent] > 0.f)) {
+        std::cerr << "ERROR: " << bodies.name[settings.from] << " and " << bodies.name[settings.to]
+                  << " don't go around the same body with a mass" << std::endl;
+        return false;
+    }
+    if(!(settings.step > 0.0) || settings.width <= 0 || settings.height <= 0) {
+        std::cerr << "ERROR: Porkchop needs a positive date step and window" << std::endl;
+        return false;
+    }
+    m_bodies = bodies;
+    m_settings = settings;
+    m_mu = bodies.mu[parent];
+    m_tiles.clear();
+    m_uses = 0;
+    m_pending = true;
+    m_stopping = false;
+    m_requestDeparture = m_requestArrival = 0;
+    m_thread = std::thread(&Porkchop::run, this);
+    return true;
+}
+
+void Porkchop::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+void Porkchop::request(const long long departure, const long long arrival) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requestDeparture = departure;
+        m_requestArrival = arrival;
+        m_pending = true;
+    }
+    m_wake.notify_one();
+}
+
+void Porkchop::run() {
+    for(;;) {
+        long long departure, arrival;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_pending || m_stopping; });
+            if(m_stopping)
+                return;
+            m_pending = false;
+            departure = m_requestDeparture;
+            arrival = m_requestArrival;
+        }
+        solve(departure, arrival, m_images.back());
+        m_images.publish();
+    }
+}
+
+void Porkchop::solve(const long long departure, const long long arrival, Image &image) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const int width = m_settings.width, height = m_settings.height;
+
+    // the tiles of the window, the missing ones solved in parallel into fresh cache entries
+    const long long d0 = floorDiv(departure, kTile), d1 = floorDiv(departure + width - 1, kTile);
+    const long long a0 = floorDiv(arrival, kTile), a1 = floorDiv(arrival + height - 1, kTile);
+    std::vector<TileKey> keys, missing;
+    for(long long a = a0; a <= a1; ++a)
+        for(long long d = d0; d <= d1; ++d)
+            keys.push_back(TileKey(d, a));
+    ++m_uses;
+    for(size_t k = 0; k < keys.size(); ++k) {
+        Tile &tile = m_tiles[keys[k]];
+        if(tile.deltaV.empty())
+            missing.push_back(keys[k]);
+        tile.lastUse = m_uses;
+    }
+    std::vector<std::vector<float> *> targets(missing.size());
+    for(size_t k = 0; k < missing.size(); ++k)
+        targets[k] = &m_tiles[missing[k]].deltaV;
+    Parallel::parallelFor(0, missing.size(), [&](size_t k) {
+        solveTile(missing[k], *targets[k]);
+    }, "porkchop.tiles");
+
+    // gather the window
+    image.version = ++m_version;
+    image.departure = departure;
+    image.arrival = arrival;
+    image.width = width;
+    image.height = height;
+    image.deltaV.resize(size_t(width) * height);
+    float lo = std::numeric_limits<float>::infinity(), hi = 0.f;
+    image.bestDeparture = departure;
+    image.bestArrival = arrival;
+    for(int y = 0; y < height; ++y) {
+        const long long a = arrival + y, ta = floorDiv(a, kTile);
+        const int row = int(a - ta * kTile);
+        for(int x = 0; x < width; ++x) {
+            const long long d = departure + x, td = floorDiv(d, kTile);
+            const float v = m_tiles[TileKey(td, ta)].deltaV[size_t(row) * kTile + size_t(d - td * kTile)];
+            image.deltaV[size_t(y) * width + x] = v;
+            if(!std::isfinite(v))
+                continue;
+            if(v < lo) {
+                lo = v;
+                image.bestDeparture = d;
+                image.bestArrival = a;
+            }
+            hi = std::max(hi, v);
+        }
+    }
+    image.minDeltaV = std::isfinite(lo) ? lo : 0.f;
+    image.maxDeltaV = hi;
+    image.tilesSolved = missing.size();
+    image.tilesCached = keys.size() - missing.size();
+    evict(keys);
+    image.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Porkchop::solveTile(const TileKey &key, std::vector<float> &deltaV) const {
+    const int n = kTile;
+    // body states at the tile's dates, relative to the common parent
+    std::vector<double> departures(size_t(n) * 6), arrivals(size_t(n) * 6);
+    for(int k = 0; k < n; ++k) {
+        m_bodies.state(m_settings.from, date(key.first * n + k), &departures[size_t(k) * 6], &departures[size_t(k) * 6 + 3]);
+        m_bodies.state(m_settings.to, date(key.second * n + k), &arrivals[size_t(k) * 6], &arrivals[size_t(k) * 6 + 3]);
+    }
+
+    deltaV.assign(size_t(n) * n, std::numeric_limits<float>::quiet_NaN());
+    std::vector<Lambert::Solution> solutions(size_t(1 + 2 * std::max(0, m_settings.maxRevolutions)));
+    for(int x = 0; x < n; ++x) {
+        const double *r1 = &departures[size_t(x) * 6], *v1 = r1 + 3;
+        // prograde: around the departure body's own angular momentum
+        const double normal[3] = { r1[1] * v1[2] - r1[2] * v1[1], r1[2] * v1[0] - r1[0] * v1[2], r1[0] * v1[1] - r1[1] * v1[0] };
+        for(int y = 0; y < n; ++y) {
+            const long long cells = (key.second * n + y) - (key.first * n + x);
+            if(cells <= 0)
+                continue;
+            const double *r2 = &arrivals[size_t(y) * 6], *v2 = r2 + 3;
+            const size_t count = Lambert::solve(r1, r2, double(cells) * m_settings.step, m_mu, normal,
+                                                m_settings.maxRevolutions, solutions.data());
+            double best = std::numeric_limits<double>::infinity();
+            for(size_t s = 0; s < count; ++s) {
+                const Lambert::Solution &solution = solutions[s];
+                const double dx1 = solution.v1[0] - v1[0], dy1 = solution.v1[1] - v1[1], dz1 = solution.v1[2] - v1[2];
+                const double dx2 = solution.v2[0] - v2[0], dy2 = solution.v2[1] - v2[1], dz2 = solution.v2[2] - v2[2];
+                best = std::min(best, std::sqrt(dx1 * dx1 + dy1 * dy1 + dz1 * dz1) + std::sqrt(dx2 * dx2 + dy2 * dy2 + dz2 * dz2));
+            }
+            if(count)
+                deltaV[size_t(y) * n + x] = float(best);
+        }
+    }
+}
+
+// Least recently used tiles out, never those of the window just solved
+void Porkchop::evict(const std::vector<TileKey> &keep) {
+    const size_t capacity = std::max(m_settings.cacheTiles, keep.size());
+    if(m_tiles.size() <= capacity)
+        return;
+    std::vector<std::pair<uint64_t, TileKey> > byUse;
+    for(std::map<TileKey, Tile>::const_iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        if(it->second.lastUse != m_uses)
+            byUse.push_back(std::make_pair(it->second.lastUse, it->first));
+    std::sort(byUse.begin(), byUse.end());
+    for(size_t k = 0; k < byUse.size() && m_tiles.size() > capacity; ++k)
+        m_tiles.erase(byUse[k].second);
+}
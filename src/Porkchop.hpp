@@ -0,0 +1,100 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BodyTable.hpp"
+#include "TripleBuffer.hpp"
+
+// Transfer delta-v between two bodies of the same parent over a grid of
+// departure and arrival dates: the porkchop plot of mission analysis,
+// computed on its own thread.
+//
+// Dates sit on a fixed lattice, epoch + k step, so a view is a window of it
+// and panning moves that window by whole cells. The lattice is solved in
+// tiles of kTile x kTile cells, one Lambert problem per cell (every
+// revolution count up to maxRevolutions, both branches, the cheapest one
+// kept) with the body states of a tile's 2 kTile dates computed once, and
+// the missing tiles of a window spread over the job system. Solved tiles
+// stay in a cache, least recently used out first, so panning only solves
+// the strip that comes into view.
+//
+// Delta-v is that of a rendezvous, |v1 - v(departure body)| +
+// |v2 - v(arrival body)|; cells where the arrival isn't after the departure
+// are NaN.
+class Porkchop {
+public:
+    static const int kTile = 64;
+
+    struct Settings {
+        int from = -1, to = -1;        // bodies of the table
+        double epoch = 0.0, step = 0.1; // date of lattice cell k: epoch + k step, scene seconds
+        int width = 1000, height = 1000; // window, departures along x, arrivals along y
+        int maxRevolutions = 2;
+        size_t cacheTiles = 1024;
+    };
+
+    // A solved window, row-major by arrival.
+    struct Image {
+        uint64_t version = 0;
+        long long departure = 0, arrival = 0; // lattice cells of the first column and row
+        int width = 0, height = 0;
+        std::vector<float> deltaV;
+        float minDeltaV = 0.f, maxDeltaV = 0.f; // over the finite cells
+        long long bestDeparture = 0, bestArrival = 0;
+        double seconds = 0.0;                 // to solve it
+        size_t tilesSolved = 0, tilesCached = 0;
+    };
+
+    Porkchop() = default;
+    ~Porkchop() { stop(); }
+    Porkchop(const Porkchop &) = delete;
+    Porkchop &operator=(const Porkchop &) = delete;
+
+    // Copies the table and starts the thread on the window at cells (0, 0).
+    // Both bodies must go around the same parent, one with a mass.
+    bool start(const BodyTable &bodies, const Settings &settings);
+    void stop();
+    inline bool running() const { return m_thread.joinable(); }
+    inline const Settings &settings() const { return m_settings; }
+    inline double date(long long cell) const { return m_settings.epoch + double(cell) * m_settings.step; }
+
+    // Asks for the window starting at these lattice cells; the thread takes the latest request.
+    void request(long long departure, long long arrival);
+
+    // Reader side, render thread only: true when a newer image came in.
+    inline bool acquire() { return m_images.acquire(); }
+    inline const Image &latest() const { return m_images.front(); }
+
+    // One window on the calling thread, cache included; what the thread runs.
+    void solve(long long departure, long long arrival, Image &image);
+
+private:
+    struct Tile {
+        std::vector<float> deltaV; // kTile x kTile, row-major by arrival
+        uint64_t lastUse = 0;
+    };
+    typedef std::pair<long long, long long> TileKey; // departure and arrival tile
+
+    void run();
+    void solveTile(const TileKey &key, std::vector<float> &deltaV) const;
+    void evict(const std::vector<TileKey> &keep);
+
+    BodyTable m_bodies;
+    Settings m_settings;
+    double m_mu = 0.0;
+    std::map<TileKey, Tile> m_tiles;
+    uint64_t m_uses = 0, m_version = 0;
+
+    TripleBuffer<Image> m_images;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_pending = false, m_stopping = false;
+    long long m_requestDeparture = 0, m_requestArrival = 0;
+    std::thread m_thread;
+};
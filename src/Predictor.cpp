@@ -0,0 +1,372 @@
+// Predictor.cpp
+#include "Predictor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// The thread publishes and looks for newer inputs this often while it integrates.
+const double kSlice = 0.002;
+
+// Dormand-Prince 5(4) tableau; the fifth order weights are the last row of a, the
+// error ones the difference with the embedded fourth order solution
+const double kA[6][6] = {
+    { 1.0 / 5.0 },
+    { 3.0 / 40.0, 9.0 / 40.0 },
+    { 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+    { 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+    { 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0 },
+    { 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0 }
+};
+const double kE[7] = { 71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0 };
+
+} // namespace
+
+bool Predictor::Path::at(const double t, double position[3]) const {
+    if(points.empty() || t < points.front().t || t > points.back().t)
+        return false;
+    size_t lo = 0, hi = points.size() - 1;
+    while(hi - lo > 1) {
+        const size_t mid = (lo + hi) / 2;
+        if(points[mid].t <= t)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    const Point &a = points[lo], &b = points[hi];
+    const double h = b.t - a.t;
+    if(!(h > 0.0)) {
+        position[0] = a.x;
+        position[1] = a.y;
+        position[2] = a.z;
+        return true;
+    }
+    const double s = (t - a.t) / h, s2 = s * s, s3 = s2 * s;
+    const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0, h10 = (s3 - 2.0 * s2 + s) * h;
+    const double h01 = -2.0 * s3 + 3.0 * s2, h11 = (s3 - s2) * h;
+    position[0] = h00 * a.x + h10 * a.vx + h01 * b.x + h11 * b.vx;
+    position[1] = h00 * a.y + h10 * a.vy + h01 * b.y + h11 * b.vy;
+    position[2] = h00 * a.z + h10 * a.vz + h01 * b.z + h11 * b.vz;
+    return true;
+}
+
+void Predictor::start(const BodyTable &bodies, const Settings &settings) {
+    stop();
+    m_settings = settings;
+    m_tableMu = bodies.mu;
+    m_samples.clear();
+    m_maneuvers.clear();
+    m_newManeuvers.clear();
+    m_target = -1;
+    m_seedPending = m_clearPending = false;
+    m_dirty = m_stopping = false;
+    m_thread = std::thread(&Predictor::run, this);
+}
+
+void Predictor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+uint64_t Predictor::seed(const int body, const double time, const std::vector<double> &x, const std::vector<double> &y,
+                         const std::vector<double> &z, const std::vector<double> &vx, const std::vector<double> &vy,
+                         const std::vector<double> &vz) {
+    // the heaviest bodies pull, the predicted one goes along whatever its mass
+    std::vector<int> index;
+    for(size_t i = 0; i < m_tableMu.size(); ++i)
+        if(m_tableMu[i] > 0.f)
+            index.push_back(int(i));
+    std::stable_sort(index.begin(), index.end(), [this](int a, int b) { return m_tableMu[a] > m_tableMu[b]; });
+    if(index.size() > kMaxSources)
+        index.resize(kMaxSources);
+    if(std::find(index.begin(), index.end(), body) == index.end())
+        index.push_back(body);
+
+    uint64_t number;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_seed.t = time;
+        m_seed.state.resize(index.size() * 6);
+        for(size_t k = 0; k < index.size(); ++k) {
+            double *s = &m_seed.state[k * 6];
+            const int i = index[k];
+            s[0] = x[i];
+            s[1] = y[i];
+            s[2] = z[i];
+            s[3] = vx[i];
+            s[4] = vy[i];
+            s[5] = vz[i];
+        }
+        m_seedIndex.swap(index);
+        m_seedBody = body;
+        m_seedPending = true;
+        m_clearPending = false;
+        m_now = time;
+        m_dirty = true;
+        number = ++m_seeds;
+    }
+    m_wake.notify_one();
+    return number;
+}
+
+void Predictor::clear() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clearPending = true;
+        m_seedPending = false;
+        m_dirty = true;
+    }
+    m_wake.notify_one();
+}
+
+void Predictor::maneuver(const int body, const double time, const double dv[3]) {
+    Maneuver maneuver;
+    maneuver.t = time;
+    maneuver.body = body;
+    maneuver.dv[0] = dv[0];
+    maneuver.dv[1] = dv[1];
+    maneuver.dv[2] = dv[2];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_newManeuvers.push_back(maneuver);
+        m_dirty = true;
+    }
+    m_wake.notify_one();
+}
+
+void Predictor::setNow(const double time) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_now = time;
+        m_dirty = true;
+    }
+    m_wake.notify_one();
+}
+
+void Predictor::run() {
+    for(;;) {
+        bool reseed = false, cleared = false;
+        double now, redoFrom = std::numeric_limits<double>::infinity();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_dirty || m_stopping; });
+            if(m_stopping)
+                return;
+            m_dirty = false;
+            now = m_now;
+            if(m_clearPending) {
+                m_clearPending = false;
+                cleared = true;
+            }
+            if(m_seedPending) {
+                m_seedPending = false;
+                reseed = true;
+                m_samples.clear();
+                m_samples.push_back(m_seed);
+                m_index = m_seedIndex;
+                m_target = int(std::find(m_index.begin(), m_index.end(), m_seedBody) - m_index.begin());
+                m_seedNumber = m_seeds;
+            }
+            for(size_t k = 0; k < m_newManeuvers.size(); ++k) {
+                const Maneuver &maneuver = m_newManeuvers[k];
+                size_t at = m_maneuvers.size();
+                while(at > 0 && m_maneuvers[at - 1].t > maneuver.t)
+                    --at;
+                m_maneuvers.insert(m_maneuvers.begin() + at, maneuver);
+                redoFrom = std::min(redoFrom, maneuver.t);
+            }
+            m_newManeuvers.clear();
+        }
+        if(cleared) {
+            m_samples.clear();
+            m_target = -1;
+            publish(false);
+            continue;
+        }
+        if(m_samples.empty())
+            continue;
+
+        bool changed = reseed;
+        if(reseed) {
+            m_mu.resize(m_index.size());
+            for(size_t k = 0; k < m_index.size(); ++k)
+                m_mu[k] = std::max(0.0, double(m_tableMu[m_index[k]]));
+            const size_t n = m_index.size() * 6;
+            m_k.resize(7 * n);
+            m_stage.resize(n);
+            m_next.resize(n);
+            m_h = m_settings.maxStep / 16.0;
+            m_firstSameAsLast = false;
+            m_steps = m_rejected = 0;
+            m_seconds = 0.0;
+        } else if(redoFrom < std::numeric_limits<double>::infinity()) {
+            // the steps from the new maneuver on no longer hold
+            while(m_samples.size() > 1 && m_samples.back().t >= redoFrom) {
+                m_samples.pop_back();
+                changed = true;
+            }
+            m_firstSameAsLast = false;
+        }
+
+        // what the clock has gone past, keeping a point at or before it
+        while(m_samples.size() > 1 && m_samples[1].t <= now) {
+            m_samples.pop_front();
+            changed = true;
+        }
+        while(!m_maneuvers.empty() && m_maneuvers.front().t <= m_samples.front().t)
+            m_maneuvers.erase(m_maneuvers.begin());
+
+        // on to the horizon, a slice at a time
+        const double end = now + m_settings.horizon;
+        for(;;) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            double elapsed = 0.0;
+            while(m_samples.back().t < end && m_samples.size() < m_settings.maxPoints && elapsed < kSlice) {
+                const double t = m_samples.back().t;
+                size_t next = 0;
+                while(next < m_maneuvers.size() && m_maneuvers[next].t <= t)
+                    ++next;
+                const double stop = next < m_maneuvers.size() ? m_maneuvers[next].t : std::numeric_limits<double>::infinity();
+                if(step(stop) && m_samples.back().t == stop) {
+                    // landed on maneuvers: the velocity changes there
+                    std::vector<double> &state = m_samples.back().state;
+                    for(; next < m_maneuvers.size() && m_maneuvers[next].t == stop; ++next) {
+                        const Maneuver &maneuver = m_maneuvers[next];
+                        const size_t k = std::find(m_index.begin(), m_index.end(), maneuver.body) - m_index.begin();
+                        if(k == m_index.size())
+                            continue; // neither pulls nor is predicted
+                        state[k * 6 + 3] += maneuver.dv[0];
+                        state[k * 6 + 4] += maneuver.dv[1];
+                        state[k * 6 + 5] += maneuver.dv[2];
+                    }
+                    m_firstSameAsLast = false;
+                }
+                changed = true;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            m_seconds += elapsed;
+            const bool complete = m_samples.back().t >= end;
+            if(changed)
+                publish(complete);
+            changed = false;
+            if(complete || m_samples.size() >= m_settings.maxPoints)
+                break;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_dirty || m_stopping)
+                break;
+        }
+    }
+}
+
+// Velocities and accelerations of the integrated bodies
+void Predictor::derivative(const double *state, double *out) const {
+    const size_t n = m_index.size();
+    const double eps2 = m_settings.softening2;
+    for(size_t i = 0; i < n; ++i) {
+        const double *si = state + i * 6;
+        double ax = 0.0, ay = 0.0, az = 0.0;
+        for(size_t j = 0; j < n; ++j) {
+            if(j == i || m_mu[j] == 0.0)
+                continue;
+            const double *sj = state + j * 6;
+            const double dx = sj[0] - si[0], dy = sj[1] - si[1], dz = sj[2] - si[2];
+            const double r2 = dx * dx + dy * dy + dz * dz + eps2;
+            const double f = m_mu[j] / (r2 * std::sqrt(r2));
+            ax += f * dx;
+            ay += f * dy;
+            az += f * dz;
+        }
+        double *o = out + i * 6;
+        o[0] = si[3];
+        o[1] = si[4];
+        o[2] = si[5];
+        o[3] = ax;
+        o[4] = ay;
+        o[5] = az;
+    }
+}
+
+// One step from the last sample, no further than `stop`; false when the error turned it down
+bool Predictor::step(const double stop) {
+    const size_t n = m_samples.back().state.size();
+    const double t0 = m_samples.back().t;
+    const double *y0 = m_samples.back().state.data();
+    double h = std::min(m_h, m_settings.maxStep);
+    const bool toStop = t0 + h >= stop;
+    if(toStop)
+        h = stop - t0;
+
+    double *k[7];
+    for(int s = 0; s < 7; ++s)
+        k[s] = &m_k[size_t(s) * n];
+    if(!m_firstSameAsLast)
+        derivative(y0, k[0]);
+    for(int s = 1; s < 7; ++s) {
+        double *y = s < 6 ? m_stage.data() : m_next.data();
+        for(size_t c = 0; c < n; ++c) {
+            double sum = 0.0;
+            for(int r = 0; r < s; ++r)
+                sum += kA[s - 1][r] * k[r][c];
+            y[c] = y0[c] + h * sum;
+        }
+        derivative(y, k[s]);
+    }
+
+    double error = 0.0;
+    for(size_t c = 0; c < n; ++c) {
+        double e = 0.0;
+        for(int s = 0; s < 7; ++s)
+            e += kE[s] * k[s][c];
+        const double scale = m_settings.tolerance * (1.0 + std::max(std::fabs(y0[c]), std::fabs(m_next[c])));
+        error = std::max(error, std::fabs(h * e) / scale);
+    }
+    const double factor = error > 0.0 ? 0.9 * std::pow(error, -0.2) : 5.0;
+    if(error > 1.0 && h > 1e-9) {
+        m_h = h * std::max(0.2, factor);
+        m_firstSameAsLast = true; // k[0] is still that of y0
+        ++m_rejected;
+        return false;
+    }
+
+    Sample sample;
+    sample.t = toStop ? stop : t0 + h;
+    sample.state = m_next;
+    m_samples.push_back(sample);
+    std::copy(k[6], k[6] + n, k[0]); // the last stage is the next step's first
+    m_firstSameAsLast = true;
+    if(!toStop)
+        m_h = h * std::min(5.0, factor);
+    ++m_steps;
+    return true;
+}
+
+void Predictor::publish(const bool complete) {
+    Path &path = m_paths.back();
+    path.seed = m_seedNumber;
+    path.body = m_target >= 0 ? m_index[m_target] : -1;
+    path.points.resize(m_target >= 0 ? m_samples.size() : 0);
+    for(size_t k = 0; k < path.points.size(); ++k) {
+        const double *s = &m_samples[k].state[size_t(m_target) * 6];
+        Point &point = path.points[k];
+        point.t = m_samples[k].t;
+        point.x = s[0];
+        point.y = s[1];
+        point.z = s[2];
+        point.vx = s[3];
+        point.vy = s[4];
+        point.vz = s[5];
+    }
+    path.complete = complete;
+    path.steps = m_steps;
+    path.rejected = m_rejected;
+    path.seconds = m_seconds;
+    m_paths.publish();
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BodyTable.hpp"
+#include "TripleBuffer.hpp"
+
+// Future path of one body under the gravity of the others, computed on its
+// own thread for as far ahead as `horizon` simulation seconds.
+//
+// The bodies with a mass (the kMaxSources heaviest) and the predicted one
+// are integrated together, direct summation with the softening of NBody, by
+// an adaptive Dormand-Prince 5(4) scheme: each step's size follows the local
+// error, so the path gets its points where it bends. Every accepted step is
+// kept with the full state, which is what lets work be redone only from
+// where it stopped holding:
+// - the clock moving on drops the steps behind it and extends the end;
+// - a new maneuver (a velocity change at some time ahead) keeps the steps
+//   before it and integrates again from there;
+// - seed() starts over from a new state, for a new body or when the real
+//   one left the path (the caller compares it against Path::at()).
+// The thread integrates in short slices, publishes the path after each one
+// through a TripleBuffer and looks for newer inputs in between, so a long
+// prediction shows up piece by piece and never holds anything up.
+class Predictor {
+public:
+    static const size_t kMaxSources = 64;
+
+    struct Settings {
+        double horizon = 30.0;     // seconds ahead of now
+        double tolerance = 1e-9;   // local error per step, relative to the state
+        double maxStep = 0.1;      // also keeps the path smooth where the error would allow more
+        size_t maxPoints = 20000;  // the path stops there, tight orbits or not
+        float softening2 = 1e-4f;  // as NBody's
+    };
+
+    struct Point {
+        double t;
+        double x, y, z, vx, vy, vz;
+    };
+
+    struct Path {
+        uint64_t seed = 0;  // of the seed() call it comes from
+        int body = -1;
+        std::vector<Point> points; // by time, the first at or before now
+        bool complete = false;     // reaches now + horizon
+        size_t steps = 0, rejected = 0; // integrated since the seed
+        double seconds = 0.0;      // of integration since the seed
+
+        // Position at time t, cubic Hermite between the points; false outside of them.
+        bool at(double t, double position[3]) const;
+    };
+
+    Predictor() = default;
+    ~Predictor() { stop(); }
+    Predictor(const Predictor &) = delete;
+    Predictor &operator=(const Predictor &) = delete;
+
+    // Takes the masses of the table and starts the thread, with nothing to predict yet.
+    void start(const BodyTable &bodies, const Settings &settings);
+    void stop();
+    inline bool running() const { return m_thread.joinable(); }
+    inline const Settings &settings() const { return m_settings; }
+
+    // Predicts `body` from the state of the whole table at `time` (world positions and
+    // velocities, per body); returns the number the paths of this seed will carry.
+    uint64_t seed(int body, double time, const std::vector<double> &x, const std::vector<double> &y,
+                  const std::vector<double> &z, const std::vector<double> &vx, const std::vector<double> &vy,
+                  const std::vector<double> &vz);
+    // Nothing to predict any more.
+    void clear();
+    // Adds dv to the velocity of `body` at `time`; the path is redone from there.
+    void maneuver(int body, double time, const double dv[3]);
+    // Simulation time the path starts from; call it as the clock goes.
+    void setNow(double time);
+
+    // Reader side, render thread only: true when a newer path came in.
+    inline bool acquire() { return m_paths.acquire(); }
+    inline const Path &latest() const { return m_paths.front(); }
+
+private:
+    struct Sample {
+        double t;
+        std::vector<double> state; // per integrated body: x, y, z, vx, vy, vz
+    };
+    struct Maneuver {
+        double t;
+        int body; // of the table
+        double dv[3];
+    };
+
+    void run();
+    void derivative(const double *state, double *out) const;
+    bool step(double maneuverTime);
+    void publish(bool complete);
+
+    Settings m_settings;
+    std::vector<float> m_tableMu;
+
+    // thread state
+    std::vector<int> m_index; // table row of each integrated body
+    std::vector<double> m_mu;
+    int m_target = -1;        // in m_index
+    std::deque<Sample> m_samples;
+    std::vector<Maneuver> m_maneuvers; // by time
+    double m_h = 0.0;
+    std::vector<double> m_k; // 7 stages
+    std::vector<double> m_stage, m_next;
+    bool m_firstSameAsLast = false; // m_k[0] already holds the derivative at the last sample
+    uint64_t m_seedNumber = 0;
+    size_t m_steps = 0, m_rejected = 0;
+    double m_seconds = 0.0;
+
+    TripleBuffer<Path> m_paths;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_dirty = false, m_stopping = false;
+    // inputs, under the mutex
+    bool m_seedPending = false, m_clearPending = false;
+    uint64_t m_seeds = 0;
+    int m_seedBody = -1;
+    Sample m_seed;
+    std::vector<int> m_seedIndex;
+    std::vector<Maneuver> m_newManeuvers;
+    double m_now = 0.0;
+    std::thread m_thread;
+};
@@ -0,0 +1,207 @@
+// SessionLog.cpp
+#include "SessionLog.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char kMagic[4] = { 'S', 'S', 'E', 'S' };
+const uint32_t kEphemerisFlag = 1;
+
+} // namespace
+
+double SessionLog::clockAt(const int64_t ticks) const {
+    return m_start.time + double(ticks) * 1e-6;
+}
+
+bool SessionLog::create(const std::string &path, const Start &start) {
+    close(0);
+    m_out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!m_out) {
+        std::cerr << "ERROR: Could not write " << path << std::endl;
+        return false;
+    }
+    m_start = start;
+    m_size = 0;
+    m_ticks = 0;
+    m_frames = 0;
+    m_ended = false;
+
+    Header header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.time = start.time;
+    header.step = start.step;
+    header.width = start.width;
+    header.height = start.height;
+    header.flags = start.ephemeris ? kEphemerisFlag : 0;
+    header.bodiesSize = uint32_t(start.bodies.size());
+    header.clipSize = uint32_t(start.clip.size());
+    header.reserved = 0;
+    put(header);
+    m_out.write(start.bodies.data(), std::streamsize(start.bodies.size()));
+    m_out.write(start.clip.data(), std::streamsize(start.clip.size()));
+    m_size += start.bodies.size() + start.clip.size();
+    return bool(m_out);
+}
+
+double SessionLog::frame(const double clock) {
+    // never backwards, and a frame of more than an hour is cut to 71 minutes
+    const int64_t ticks = std::max<int64_t>(m_ticks, int64_t(std::llround((clock - m_start.time) * 1e6)));
+    const uint32_t delta = uint32_t(std::min<int64_t>(ticks - m_ticks, 0xffffffffll));
+    m_ticks += delta;
+    ++m_frames;
+    put(Type::Frame);
+    put(delta);
+    return clockAt(m_ticks);
+}
+
+void SessionLog::key(const int key, const int scancode, const int action, const int mods) {
+    put(Type::Key);
+    put(int32_t(key));
+    put(int32_t(scancode));
+    put(uint8_t(action));
+    put(uint8_t(mods));
+}
+
+void SessionLog::click(const int button, const int action, const int mods, const double x, const double y) {
+    put(Type::Click);
+    put(uint8_t(button));
+    put(uint8_t(action));
+    put(uint8_t(mods));
+    put(x);
+    put(y);
+}
+
+void SessionLog::resize(const int width, const int height) {
+    put(Type::Resize);
+    put(int32_t(width));
+    put(int32_t(height));
+}
+
+void SessionLog::check(const uint64_t checksum) {
+    put(Type::Check);
+    put(checksum);
+}
+
+void SessionLog::close(const uint64_t checksum) {
+    if(m_out.is_open()) {
+        put(Type::End);
+        put(checksum);
+        m_out.close();
+    }
+    m_file.close();
+}
+
+bool SessionLog::open(const std::string &path) {
+    close(0);
+    if(!m_file.open(path))
+        return false;
+    Header header;
+    if(m_file.size() < sizeof(Header)) {
+        std::cerr << "ERROR: " << path << " is not a session log" << std::endl;
+        m_file.close();
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(Header));
+    if(std::memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion || !(header.step > 0.0) ||
+       sizeof(Header) + size_t(header.bodiesSize) + size_t(header.clipSize) > m_file.size()) {
+        std::cerr << "ERROR: " << path << " is not a valid session log" << std::endl;
+        m_file.close();
+        return false;
+    }
+    m_start.time = header.time;
+    m_start.step = header.step;
+    m_start.width = header.width;
+    m_start.height = header.height;
+    m_start.ephemeris = (header.flags & kEphemerisFlag) != 0;
+    const char *files = reinterpret_cast<const char *>(m_file.data()) + sizeof(Header);
+    m_start.bodies.assign(files, header.bodiesSize);
+    m_start.clip.assign(files + header.bodiesSize, header.clipSize);
+    m_size = m_file.size();
+    m_cursor = sizeof(Header) + header.bodiesSize + header.clipSize;
+    m_ticks = 0;
+    m_frames = 0;
+    m_ended = false;
+    return true;
+}
+
+template<typename T>
+bool SessionLog::get(T &value) {
+    if(m_cursor + sizeof(T) > m_size)
+        return false;
+    std::memcpy(&value, m_file.data() + m_cursor, sizeof(T));
+    m_cursor += sizeof(T);
+    return true;
+}
+
+bool SessionLog::next(Event &event) {
+    if(m_ended || !m_file.isOpen())
+        return false;
+    const size_t at = m_cursor;
+    event = Event();
+    bool ok = get(event.type);
+    if(ok) {
+        uint8_t action = 0, mods = 0, button = 0;
+        int32_t a = 0, b = 0;
+        switch(event.type) {
+        case Type::Frame: {
+            uint32_t delta = 0;
+            ok = get(delta);
+            m_ticks += delta;
+            event.clock = clockAt(m_ticks);
+            ++m_frames;
+            break;
+        }
+        case Type::Key:
+            ok = get(a) && get(b) && get(action) && get(mods);
+            event.key = a;
+            event.scancode = b;
+            break;
+        case Type::Click:
+            ok = get(button) && get(action) && get(mods) && get(event.x) && get(event.y);
+            event.button = button;
+            break;
+        case Type::Resize:
+            ok = get(a) && get(b);
+            event.width = a;
+            event.height = b;
+            break;
+        case Type::Check:
+            ok = get(event.checksum);
+            break;
+        case Type::End:
+            ok = get(event.checksum);
+            m_ended = ok;
+            break;
+        default:
+            ok = false;
+        }
+        event.action = action;
+        event.mods = mods;
+    }
+    if(!ok) {
+        if(at < m_size)
+            std::cerr << "WARNING: session log cut short " << m_size - at << " bytes before its end" << std::endl;
+        m_cursor = m_size;
+        return false;
+    }
+    return true;
+}
+
+uint64_t SessionLog::checksum(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &z) {
+    // FNV-1a over the bits, a word at a time
+    uint64_t hash = 14695981039346656037ull;
+    const std::vector<double> *axes[3] = { &x, &y, &z };
+    for(int a = 0; a < 3; ++a) {
+        for(size_t i = 0; i < axes[a]->size(); ++i) {
+            uint64_t bits;
+            std::memcpy(&bits, &(*axes[a])[i], sizeof(bits));
+            hash = (hash ^ bits) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// A recorded session: what the scene started from and everything that drove
+// it, for replaying a real run exactly, in real time or as fast as it goes,
+// with or without rendering.
+//
+// Recording runs the simulation driven by the frames (see
+// Simulation::startDriven()). Each frame logs the clock it advanced to, in
+// whole microseconds since the previous one so the replay adds up the very
+// same doubles, and the input events in between are logged in the order
+// they came. Played back in that order from the same start, the simulation
+// and the scene go through the same states whatever the frame rate of the
+// replay; a checksum of the body positions, logged every kCheckFrames frames
+// and at the end, tells when they don't. Files the session reads go in the
+// log too: bodies.txt, and scene.clip as it was at the start (key P plays it
+// back), so a replay never depends on what is on disk by then.
+//
+// Layout (little endian), written as it goes and read from the mapping:
+//   Header { char magic[4] = "SSES"; uint32 version; double time, step; int32 width, height;
+//            uint32 flags (1: ephemeris in use); uint32 bodiesSize, clipSize, reserved; }
+//   bodies.txt as it was loaded, bodiesSize bytes
+//   scene.clip as it was at the start, clipSize bytes, none when there was no clip
+//   events, a type byte and its fields:
+//     Frame  { uint32 microseconds since the previous frame, or since time for the first }
+//     Key    { int32 key, scancode; uint8 action, mods; }
+//     Click  { uint8 button, action, mods; double x, y; }
+//     Resize { int32 width, height; }
+//     Check  { uint64 checksum; }
+//     End    { uint64 checksum; }
+class SessionLog {
+public:
+    static const uint32_t kVersion = 2;
+    static const uint64_t kCheckFrames = 240;
+
+    // Where the session started.
+    struct Start {
+        double time = 0.0, step = 1.0 / 240.0; // simulation start time and step
+        int width = 0, height = 0;             // window
+        bool ephemeris = false;
+        std::string bodies;                    // bodies.txt
+        std::string clip;                      // scene.clip, empty without one
+    };
+
+    enum class Type : uint8_t { Frame = 1, Key, Click, Resize, Check, End };
+
+    struct Event {
+        Type type = Type::End;
+        double clock = 0.0;                              // Frame: the clock to advance to
+        int key = 0, scancode = 0, action = 0, mods = 0; // Key, and action and mods of a Click
+        int button = 0;
+        double x = 0.0, y = 0.0;                         // Click: cursor position
+        int width = 0, height = 0;                       // Resize
+        uint64_t checksum = 0;                           // Check, End
+    };
+
+    SessionLog() = default;
+    ~SessionLog() { close(0); }
+    SessionLog(const SessionLog &) = delete;
+    SessionLog &operator=(const SessionLog &) = delete;
+
+    // Recording.
+    bool create(const std::string &path, const Start &start);
+    inline bool recording() const { return m_out.is_open(); }
+    // Logs a frame for `clock` and returns the clock to run it at, rounded to the microsecond.
+    double frame(double clock);
+    void key(int key, int scancode, int action, int mods);
+    void click(int button, int action, int mods, double x, double y);
+    void resize(int width, int height);
+    void check(uint64_t checksum);
+    // Logs the end and closes the file.
+    void close(uint64_t checksum);
+
+    // Replay.
+    bool open(const std::string &path);
+    inline bool replaying() const { return m_file.isOpen(); }
+    inline const Start &start() const { return m_start; }
+    // The next event; false past the end, or where a log cut short (no End) stops.
+    bool next(Event &event);
+    inline bool ended() const { return m_ended; }
+
+    // Frames logged or replayed so far.
+    inline uint64_t frames() const { return m_frames; }
+    inline size_t byteSize() const { return m_size; }
+
+    // Of the body positions, to compare a replay with its recording.
+    static uint64_t checksum(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &z);
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        double time, step;
+        int32_t width, height;
+        uint32_t flags;
+        uint32_t bodiesSize, clipSize, reserved;
+    };
+
+    template<typename T>
+    void put(const T &value) {
+        m_out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        m_size += sizeof(T);
+    }
+    template<typename T>
+    bool get(T &value);
+    double clockAt(int64_t ticks) const;
+
+    Start m_start;
+    std::ofstream m_out;
+    MappedFile m_file;
+    size_t m_size = 0;   // recording: bytes written; replay: of the file
+    size_t m_cursor = 0; // replay: next event
+    int64_t m_ticks = 0; // microseconds since the start time, at the last frame
+    uint64_t m_frames = 0;
+    bool m_ended = false;
+};
@@ -0,0 +1,317 @@
+// Simulation.cpp
+#include "Simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Memory the gravity checkpoints may use, whatever the number of bodies.
+const size_t kCheckpointBytes = 64 << 20;
+// A seek re-integrates in slices this long before looking for a newer request.
+const double kSeekSlice = 0.02;
+
+} // namespace
+
+void Simulation::start(const BodyTable &bodies, const double time, const double step) {
+    stop();
+    reset(bodies, time, step);
+    m_running = true;
+    m_thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::startDriven(const BodyTable &bodies, const double time, const double step) {
+    stop();
+    reset(bodies, time, step);
+    m_driven = true;
+    m_running = true;
+}
+
+void Simulation::reset(const BodyTable &bodies, const double time, const double step) {
+    m_bodies = bodies;
+    m_step = step;
+    m_startTime = time;
+    m_start = std::chrono::steady_clock::now();
+    m_driven = false;
+    m_clock = time;
+    m_time = time;
+    m_lag = 0.0;
+    m_gravity = false;
+    m_gravityRequested = false;
+    m_seeking = false;
+    m_seekPending = false;
+    m_checkpoints.clear();
+    m_burns.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_burnMutex);
+        m_burnRequests.clear();
+    }
+
+    // first state published from here, so a snapshot exists before the thread runs
+    m_bodies.update(m_time);
+    landed();
+}
+
+void Simulation::advanceTo(const double clock) {
+    m_clock = clock;
+    applyMode();
+    applyBurns();
+    if(m_seekPending.exchange(false))
+        beginSeek(m_seekTarget);
+    while(m_seeking)
+        continueSeek();
+    catchUp(clock);
+}
+
+void Simulation::stop() {
+    m_running = false;
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+double Simulation::now() const {
+    if(m_driven)
+        return m_clock;
+    return m_startTime + std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void Simulation::seek(const double t) {
+    m_seekTarget = t;
+    m_seekPending = true;
+}
+
+void Simulation::burn(const int body, const double t, const double dv[3]) {
+    Burn burn;
+    burn.step = 0;
+    burn.time = t;
+    burn.body = body;
+    burn.dv[0] = dv[0];
+    burn.dv[1] = dv[1];
+    burn.dv[2] = dv[2];
+    std::lock_guard<std::mutex> lock(m_burnMutex);
+    m_burnRequests.push_back(burn);
+}
+
+void Simulation::run() {
+    while(m_running) {
+        applyMode();
+        applyBurns();
+        if(m_seekPending.exchange(false))
+            beginSeek(m_seekTarget);
+        if(m_seeking) {
+            continueSeek();
+            continue;
+        }
+
+        catchUp(now());
+
+        // sleep until the next step is due
+        const double wake = m_time + m_step + m_lag - m_startTime;
+        std::this_thread::sleep_until(m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                    std::chrono::duration<double>(wake)));
+    }
+}
+
+void Simulation::catchUp(const double target) {
+    int steps = 0;
+    while(m_time + m_step <= target - m_lag && steps < kMaxStepsPerWake && m_running && !m_seekPending) {
+        advance();
+        ++steps;
+    }
+    if(steps == kMaxStepsPerWake)
+        m_lag = target - m_time; // behind after a stall: let the backlog go
+    // only the newest state of a batch can still be picked up
+    if(steps > 0)
+        publish();
+}
+
+void Simulation::applyMode() {
+    m_nbody.collisions = m_collisionsRequested;
+    const bool gravity = m_gravityRequested;
+    if(gravity == m_gravity)
+        return;
+    m_gravity = gravity;
+    if(gravity) {
+        startGravity(); // take over from the scripted orbits where they are
+    } else {
+        m_seeking = false;
+        m_checkpoints.clear();
+        m_burns.clear();
+    }
+}
+
+void Simulation::applyBurns() {
+    std::vector<Burn> requests;
+    {
+        std::lock_guard<std::mutex> lock(m_burnMutex);
+        requests.swap(m_burnRequests);
+    }
+    for(size_t k = 0; k < requests.size(); ++k) {
+        Burn &burn = requests[k];
+        burn.step = (long long)std::llround((burn.time - m_origin) / m_step);
+        if(!m_gravity || burn.body < 0 || size_t(burn.body) >= m_nbody.size() || burn.step <= m_stepIndex)
+            continue;
+        size_t at = m_burns.size();
+        while(at > 0 && m_burns[at - 1].step > burn.step)
+            --at;
+        m_burns.insert(m_burns.begin() + at, burn);
+        // the checkpoints past it were taken without it
+        while(m_checkpoints.size() > 1 && m_checkpoints.back().step >= burn.step)
+            m_checkpoints.pop_back();
+    }
+}
+
+void Simulation::advance() {
+    // the state before the step becomes the last one, and the step rewrites every position
+    m_lastX.swap(m_bodies.posX);
+    m_lastY.swap(m_bodies.posY);
+    m_lastZ.swap(m_bodies.posZ);
+    m_lastTime = m_time;
+    m_bodies.posX.resize(m_lastX.size());
+    m_bodies.posY.resize(m_lastY.size());
+    m_bodies.posZ.resize(m_lastZ.size());
+    if(m_gravity) {
+        stepGravity();
+        for(size_t i = 0; i < m_bodies.size(); ++i) {
+            m_bodies.posX[i] = m_nbody.posX[i];
+            m_bodies.posY[i] = m_nbody.posY[i];
+            m_bodies.posZ[i] = m_nbody.posZ[i];
+        }
+    } else {
+        m_time += m_step;
+        m_bodies.update(m_time);
+    }
+}
+
+void Simulation::stepGravity() {
+    m_nbody.step(m_step);
+    ++m_stepIndex;
+    m_time = m_origin + double(m_stepIndex) * m_step;
+    for(size_t k = 0; k < m_burns.size() && m_burns[k].step <= m_stepIndex; ++k) {
+        const Burn &burn = m_burns[k];
+        if(burn.step != m_stepIndex)
+            continue;
+        m_nbody.velX[burn.body] += burn.dv[0];
+        m_nbody.velY[burn.body] += burn.dv[1];
+        m_nbody.velZ[burn.body] += burn.dv[2];
+    }
+    recordCheckpoint();
+}
+
+void Simulation::startGravity() {
+    m_nbody.reset(m_bodies, m_time);
+    m_origin = m_time;
+    m_stepIndex = 0;
+    m_checkpoints.clear();
+    m_burns.clear();
+    m_checkpointInterval = std::max(1ll, (long long)std::llround(1.0 / m_step)); // one per second to begin with
+    m_checkpointCapacity = std::max<size_t>(4, std::min<size_t>(256, kCheckpointBytes / (6 * sizeof(double) * std::max<size_t>(1, m_nbody.size()))));
+    recordCheckpoint();
+}
+
+void Simulation::recordCheckpoint() {
+    if(m_stepIndex % m_checkpointInterval != 0)
+        return;
+    if(!m_checkpoints.empty() && m_checkpoints.back().step >= m_stepIndex) {
+        // stepping again over ground already covered (after a seek back): same states, already there
+        return;
+    }
+    if(m_checkpoints.size() == m_checkpointCapacity) {
+        // full: keep every other one and space the grid twice as much
+        m_checkpointInterval *= 2;
+        size_t kept = 0;
+        for(size_t k = 0; k < m_checkpoints.size(); ++k)
+            if(m_checkpoints[k].step % m_checkpointInterval == 0)
+                std::swap(m_checkpoints[kept++], m_checkpoints[k]);
+        m_checkpoints.resize(kept);
+        if(m_stepIndex % m_checkpointInterval != 0)
+            return;
+    }
+    m_checkpoints.push_back(Checkpoint());
+    m_checkpoints.back().step = m_stepIndex;
+    m_nbody.saveState(m_checkpoints.back().state);
+}
+
+void Simulation::beginSeek(const double t) {
+    m_seeking = false;
+    if(!m_gravity || t < m_origin) {
+        // analytic: evaluate the orbits right there; before the gravity run began, it starts over from there
+        m_time = t;
+        m_bodies.update(t);
+        if(m_gravity)
+            startGravity();
+        m_lag = now() - m_time;
+        landed();
+        return;
+    }
+
+    // resume from the last checkpoint before the target when going back, or when it
+    // is further on than we are (the run went there before an earlier seek back);
+    // there is always the one of step 0
+    m_seekStep = (long long)std::floor((t - m_origin) / m_step + 0.5);
+    const Checkpoint *from = &m_checkpoints.front();
+    for(size_t k = 0; k < m_checkpoints.size() && m_checkpoints[k].step <= m_seekStep; ++k)
+        from = &m_checkpoints[k];
+    if(m_seekStep < m_stepIndex || from->step > m_stepIndex) {
+        m_stepIndex = from->step;
+        m_time = m_origin + double(m_stepIndex) * m_step;
+        m_nbody.restoreState(from->state, m_time);
+    }
+    m_seeking = true; // the renderer holds the last snapshot meanwhile
+}
+
+void Simulation::continueSeek() {
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(kSeekSlice));
+    while(m_stepIndex < m_seekStep && m_running && !m_seekPending && (m_driven || std::chrono::steady_clock::now() < deadline))
+        stepGravity();
+    if(m_stepIndex < m_seekStep)
+        return;
+
+    m_seeking = false;
+    for(size_t i = 0; i < m_bodies.size(); ++i) {
+        m_bodies.posX[i] = m_nbody.posX[i];
+        m_bodies.posY[i] = m_nbody.posY[i];
+        m_bodies.posZ[i] = m_nbody.posZ[i];
+    }
+    m_lag = now() - m_time;
+    landed();
+}
+
+void Simulation::landed() {
+    // a jump, nothing to interpolate from
+    m_lastX = m_bodies.posX;
+    m_lastY = m_bodies.posY;
+    m_lastZ = m_bodies.posZ;
+    m_lastTime = m_time;
+    publish();
+}
+
+void Simulation::publish() {
+    SimulationSnapshot &snapshot = m_snapshots.back();
+    snapshot.previousTime = m_lastTime;
+    snapshot.time = m_time;
+    snapshot.lag = m_lag;
+    snapshot.gravity = m_gravity;
+    snapshot.interactionsPerSecond = m_gravity ? m_nbody.interactionsPerSecond() : 0.0;
+    snapshot.collisions = m_gravity && m_nbody.collisions;
+    snapshot.contacts = snapshot.collisions ? m_nbody.contacts().size() : 0;
+    snapshot.collisionPairsPerSecond = snapshot.collisions ? m_nbody.collisionPairsPerSecond() : 0.0;
+    // the last state is only read again after advance() swapped in a fresh one
+    snapshot.previousX.swap(m_lastX);
+    snapshot.previousY.swap(m_lastY);
+    snapshot.previousZ.swap(m_lastZ);
+    snapshot.x = m_bodies.posX;
+    snapshot.y = m_bodies.posY;
+    snapshot.z = m_bodies.posZ;
+    if(m_gravity && m_velocitiesRequested) {
+        snapshot.vx = m_nbody.velX;
+        snapshot.vy = m_nbody.velY;
+        snapshot.vz = m_nbody.velZ;
+    } else {
+        snapshot.vx.clear();
+        snapshot.vy.clear();
+        snapshot.vz.clear();
+    }
+    m_snapshots.publish();
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BodyTable.hpp"
+#include "NBody.hpp"
+#include "TripleBuffer.hpp"
+
+// Body positions at two consecutive simulation steps, for the renderer to
+// interpolate between.
+struct SimulationSnapshot {
+    double previousTime = 0.0, time = 0.0; // simulation time of the two states
+    double lag = 0.0;                      // clock minus simulation time, see Simulation
+    bool gravity = false;
+    double interactionsPerSecond = 0.0;
+    bool collisions = false;
+    size_t contacts = 0;                   // of the last step
+    double collisionPairsPerSecond = 0.0;
+    std::vector<double> previousX, previousY, previousZ; // world positions
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;        // gravity mode with setVelocities(true), empty otherwise
+};
+
+// Runs the scene on its own thread at a fixed step.
+//
+// The thread keeps up with the clock one step at a time, scripted orbits or
+// the gravity simulation (NBody) depending on the mode, and publishes a
+// snapshot of the newest step through a TripleBuffer each time it caught up.
+// The state before a step is kept by swapping buffers, not copying, so a
+// snapshot costs one copy of the positions. Rendering never waits for a step
+// and a slow frame never changes the step. When the simulation falls
+// behind by more than kMaxStepsPerWake steps it drops the backlog instead of
+// spiraling; that and seek() are what the lag accounts for.
+//
+// startDriven() runs it without the thread, for recorded and replayed
+// sessions (see SessionLog): the simulation only moves in advanceTo(), on
+// the caller's thread, up to the clock time it is given, and a seek there
+// lands before it returns. What it goes through is then a function of the
+// clock values and of the requests made between them, not of the machine.
+//
+// seek() jumps to any time. Scripted orbits are evaluated there directly. The
+// gravity simulation restarts from the closest earlier checkpoint (or carries
+// on from where it is) and re-integrates forward on the simulation thread, in
+// slices so a newer seek or stop() cuts in, with the force evaluations spread
+// over the worker threads. Checkpoints are taken on a fixed grid of steps
+// within a memory budget: when the list is full every other one is dropped and
+// the grid spacing doubles, so the whole run stays covered.
+//
+// burn() changes a body's velocity at a step of the gravity run ahead. Burns
+// belong to the run like its initial state: stepping over that step again
+// after a seek back applies them again, and the checkpoints past a new one
+// are dropped since they no longer hold.
+class Simulation {
+public:
+    Simulation() = default;
+    ~Simulation() { stop(); }
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    // Copies the table (the thread works on its own) and starts at `time`, in
+    // seconds on the same clock as now().
+    void start(const BodyTable &bodies, double time, double step = 1.0 / 240.0);
+    void stop();
+
+    // Same without the thread: the clock is whatever advanceTo() last said.
+    void startDriven(const BodyTable &bodies, double time, double step = 1.0 / 240.0);
+    // Applies the requests, lands a pending seek and steps up to `clock`; driven mode only.
+    void advanceTo(double clock);
+    inline bool driven() const { return m_driven; }
+
+    // Seconds since start(), plus the start time; in driven mode the clock of the last advanceTo().
+    double now() const;
+    inline double step() const { return m_step; }
+
+    // Gravity mode takes over from the scripted orbits where they are; applied on the next step.
+    inline void setGravity(bool on) { m_gravityRequested = on; }
+    inline bool gravity() const { return m_gravityRequested; }
+
+    // Bodies bounce off each other in gravity mode (NBody::collisions); applied on the next step.
+    inline void setCollisions(bool on) { m_collisionsRequested = on; }
+    inline bool collisions() const { return m_collisionsRequested; }
+
+    // Adds dv to the velocity of `body` at simulation time t (rounded to a step), gravity
+    // mode only; applied on the next step, ignored when t is already behind.
+    void burn(int body, double t, const double dv[3]);
+
+    // Velocities in the snapshots of the gravity mode, off by default as they cost a copy.
+    inline void setVelocities(bool on) { m_velocitiesRequested = on; }
+
+    // Jumps to simulation time t, ahead or back. Returns at once, the thread does the work.
+    void seek(double t);
+
+    // Reader side, render thread only: picks up the latest snapshot, if any.
+    inline const SimulationSnapshot &latest() {
+        m_snapshots.acquire();
+        return m_snapshots.front();
+    }
+
+private:
+    static const int kMaxStepsPerWake = 64;
+
+    struct Burn {
+        long long step; // of the gravity run, or a time before applyBurns() picks it up
+        double time;
+        int body;
+        double dv[3];
+    };
+
+    struct Checkpoint {
+        long long step; // steps since the gravity simulation started
+        std::vector<double> state; // NBody::saveState()
+    };
+
+    void reset(const BodyTable &bodies, double time, double step);
+    void run();
+    void catchUp(double target);
+    void applyMode();
+    void applyBurns();
+    void advance();
+    void stepGravity();
+    void startGravity();
+    void recordCheckpoint();
+    void beginSeek(double t);
+    void continueSeek();
+    void landed();
+    void publish();
+
+    BodyTable m_bodies;
+    NBody m_nbody;
+    double m_step = 1.0 / 240.0;
+    double m_startTime = 0.0;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_driven = false;
+    double m_clock = 0.0; // driven mode
+
+    // thread state
+    double m_time = 0.0, m_lag = 0.0;
+    bool m_gravity = false;
+    std::vector<double> m_lastX, m_lastY, m_lastZ; // state before the last step, until published
+    double m_lastTime = 0.0;
+
+    // gravity run: m_time = m_origin + m_stepIndex * m_step
+    double m_origin = 0.0;
+    long long m_stepIndex = 0;
+    std::vector<Checkpoint> m_checkpoints; // by step
+    long long m_checkpointInterval = 240;
+    size_t m_checkpointCapacity = 0;
+    bool m_seeking = false;
+    long long m_seekStep = 0;
+    std::vector<Burn> m_burns; // of the gravity run, by step
+
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+    std::atomic<bool> m_gravityRequested{false};
+    std::atomic<bool> m_collisionsRequested{false};
+    std::atomic<bool> m_seekPending{false};
+    std::atomic<double> m_seekTarget{0.0};
+    std::atomic<bool> m_velocitiesRequested{false};
+    std::atomic<bool> m_running{false};
+    std::mutex m_burnMutex;
+    std::vector<Burn> m_burnRequests;
+    std::thread m_thread;
+};
@@ -0,0 +1,266 @@
+// SphereBvh.cpp
+#include "SphereBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Parallel.hpp"
+
+const float SphereBvh::kRebuildRatio = 2.f;
+
+namespace {
+
+// spheres per serial subtree at least, below that a job isn't worth it
+const size_t kMinSubtree = 4096;
+// spheres per job when they are copied into leaf order
+const size_t kScatterBlock = 16384;
+
+inline double area(const float lo[3], const float hi[3]) {
+    const double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+}
+
+// nodes of a subtree over `count` spheres
+inline size_t nodesFor(size_t count, size_t leafSize) {
+    return 2 * ((count + leafSize - 1) / leafSize) - 1;
+}
+
+// Same as glm::intersectRaySphere (the nearest hit in front of the origin, the
+// exit from inside) but with the squared distance from the centre to the ray
+// taken from the perpendicular offset: glm's |d|^2 - t^2 cancels out for a
+// small sphere far along the ray and both misses and invents hits in float.
+inline bool intersectSphere(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec4 &sphere, float &distance) {
+    const glm::vec3 offset = glm::vec3(sphere) - origin;
+    const float along = glm::dot(offset, direction);
+    const glm::vec3 across = offset - along * direction;
+    const float r2 = sphere.w * sphere.w, d2 = glm::dot(across, across);
+    if(d2 > r2)
+        return false;
+    const float half = std::sqrt(r2 - d2);
+    distance = along > half ? along - half : along + half;
+    return distance > 0.f;
+}
+
+} // namespace
+
+void SphereBvh::build(const float *x, const float *y, const float *z, const float *r, const size_t n) {
+    m_nodes.clear();
+    m_subtrees.clear();
+    m_top.clear();
+    m_items.resize(n);
+    m_slots.resize(n);
+    m_spheres.resize(n);
+    if(n == 0)
+        return;
+
+    std::vector<BuildItem> items(n);
+    Parallel::parallelFor(0, n, [&](size_t i) {
+        items[i].c[0] = x[i];
+        items[i].c[1] = y[i];
+        items[i].c[2] = z[i];
+        items[i].index = uint32_t(i);
+    }, "bvh.items", kScatterBlock);
+    m_nodes.resize(nodesFor(n, kLeafSize));
+
+    // split until there are enough subtrees for the workers
+    const size_t grain = std::max(kMinSubtree, n / (8 * Parallel::workerCount()));
+    buildTop(items, n, grain);
+    Parallel::parallelFor(0, m_subtrees.size(), [&](size_t s) {
+        buildNode(items, m_subtrees[s].begin, m_subtrees[s].end, m_subtrees[s].root);
+    }, "bvh.build");
+
+    m_builtCost = 0.0;
+    refit(x, y, z, r);
+}
+
+// Splits [begin, end) in whole leaves at the median of the longest axis and
+// fills in the node; returns where the right half starts.
+size_t SphereBvh::split(std::vector<BuildItem> &items, const size_t begin, const size_t end, const size_t node) {
+    float lo[3], hi[3];
+    for(int a = 0; a < 3; ++a)
+        lo[a] = hi[a] = items[begin].c[a];
+    for(size_t i = begin + 1; i < end; ++i) {
+        for(int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], items[i].c[a]);
+            hi[a] = std::max(hi[a], items[i].c[a]);
+        }
+    }
+    int axis = 0;
+    if(hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+    if(hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+
+    const size_t leftLeaves = (end - begin + kLeafSize - 1) / kLeafSize / 2;
+    const size_t mid = begin + leftLeaves * kLeafSize;
+    std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                     [axis](const BuildItem &a, const BuildItem &b) { return a.c[axis] < b.c[axis]; });
+
+    m_nodes[node].right = uint32_t(node + 2 * leftLeaves); // past the 2 k - 1 nodes of the left half
+    m_nodes[node].count = 0;
+    return mid;
+}
+
+// A level at a time, the nodes of a level split in parallel: only the root is
+// left to one thread, where splitting every level serially took several
+// passes over all the spheres.
+void SphereBvh::buildTop(std::vector<BuildItem> &items, const size_t n, const size_t grain) {
+    std::vector<Subtree> level(1, Subtree{ 0, 0, 0, n, 0.0 }), splitting, next;
+    while(!level.empty()) {
+        splitting.clear();
+        for(size_t k = 0; k < level.size(); ++k) {
+            Subtree &s = level[k];
+            if(s.end - s.begin <= grain) {
+                s.nodeEnd = s.root + nodesFor(s.end - s.begin, kLeafSize);
+                m_subtrees.push_back(s);
+            } else {
+                m_top.push_back(s.root);
+                splitting.push_back(s);
+            }
+        }
+        std::vector<size_t> mids(splitting.size());
+        Parallel::parallelFor(0, splitting.size(), [&](size_t k) {
+            mids[k] = split(items, splitting[k].begin, splitting[k].end, splitting[k].root);
+        }, "bvh.split");
+        next.clear();
+        for(size_t k = 0; k < splitting.size(); ++k) {
+            const Subtree &s = splitting[k];
+            next.push_back(Subtree{ s.root + 1, 0, s.begin, mids[k], 0.0 });
+            next.push_back(Subtree{ m_nodes[s.root].right, 0, mids[k], s.end, 0.0 });
+        }
+        level.swap(next);
+    }
+}
+
+void SphereBvh::buildNode(std::vector<BuildItem> &items, const size_t begin, const size_t end, const size_t node) {
+    if(end - begin <= kLeafSize) {
+        m_nodes[node].right = uint32_t(begin);
+        m_nodes[node].count = uint32_t(end - begin);
+        for(size_t i = begin; i < end; ++i) {
+            m_items[i] = items[i].index;
+            m_slots[items[i].index] = uint32_t(i);
+        }
+        return;
+    }
+    const size_t mid = split(items, begin, end, node);
+    buildNode(items, begin, mid, node + 1);
+    buildNode(items, mid, end, m_nodes[node].right);
+}
+
+// Bounds of one node from its spheres or its children; returns its area.
+double SphereBvh::refitNode(const size_t node) {
+    Node &n = m_nodes[node];
+    if(n.count) {
+        for(int a = 0; a < 3; ++a) {
+            n.lo[a] = std::numeric_limits<float>::max();
+            n.hi[a] = -std::numeric_limits<float>::max();
+        }
+        for(size_t k = n.right; k < n.right + n.count; ++k) {
+            const glm::vec4 &s = m_spheres[k];
+            for(int a = 0; a < 3; ++a) {
+                n.lo[a] = std::min(n.lo[a], s[a] - s.w);
+                n.hi[a] = std::max(n.hi[a], s[a] + s.w);
+            }
+        }
+    } else {
+        const Node &left = m_nodes[node + 1], &right = m_nodes[n.right];
+        for(int a = 0; a < 3; ++a) {
+            n.lo[a] = std::min(left.lo[a], right.lo[a]);
+            n.hi[a] = std::max(left.hi[a], right.hi[a]);
+        }
+    }
+    return area(n.lo, n.hi);
+}
+
+bool SphereBvh::refit(const float *x, const float *y, const float *z, const float *r) {
+    if(m_nodes.empty())
+        return true;
+
+    // read in the callers' order and scattered into the leaves: one random
+    // write per sphere instead of four random reads
+    const size_t n = size();
+    Parallel::parallelFor(0, (n + kScatterBlock - 1) / kScatterBlock, [&](size_t block) {
+        const size_t end = std::min(n, (block + 1) * kScatterBlock);
+        for(size_t i = block * kScatterBlock; i < end; ++i)
+            m_spheres[m_slots[i]] = glm::vec4(x[i], y[i], z[i], r[i]);
+    }, "bvh.scatter");
+
+    // children come after their parent: backwards, they are done first
+    Parallel::parallelFor(0, m_subtrees.size(), [&](size_t s) {
+        double sum = 0.0;
+        for(size_t node = m_subtrees[s].nodeEnd; node-- > m_subtrees[s].root;)
+            sum += refitNode(node);
+        m_subtrees[s].area = sum;
+    }, "bvh.refit");
+    double sum = 0.0;
+    for(size_t s = 0; s < m_subtrees.size(); ++s)
+        sum += m_subtrees[s].area;
+    for(size_t t = m_top.size(); t-- > 0;)
+        sum += refitNode(m_top[t]);
+
+    // relative to the root, so a scene that only grows or moves doesn't count
+    const double root = area(m_nodes[0].lo, m_nodes[0].hi);
+    const double cost = root > 0.0 ? sum / root : 1.0;
+    if(m_builtCost == 0.0)
+        m_builtCost = cost;
+    return cost <= m_builtCost * kRebuildRatio;
+}
+
+int SphereBvh::intersect(const glm::vec3 &origin, const glm::vec3 &direction, float *distance) const {
+    if(m_nodes.empty())
+        return -1;
+
+    const glm::vec3 inverse = 1.f / direction;
+    float best = std::numeric_limits<float>::max();
+    int hit = -1;
+
+    // entry distance of the ray into a node's box, or a miss
+    const auto enter = [&](const Node &n, float &t) {
+        float t0 = 0.f, t1 = best;
+        for(int a = 0; a < 3; ++a) {
+            float near = (n.lo[a] - origin[a]) * inverse[a], far = (n.hi[a] - origin[a]) * inverse[a];
+            if(near > far)
+                std::swap(near, far);
+            // NaN (on a slab plane, parallel to it) fails both and leaves the interval alone
+            if(near > t0) t0 = near;
+            if(far < t1) t1 = far;
+        }
+        t = t0;
+        return t0 <= t1;
+    };
+
+    uint32_t stack[64];
+    int top = 0;
+    float t;
+    if(enter(m_nodes[0], t))
+        stack[top++] = 0;
+    while(top > 0) {
+        const Node &n = m_nodes[stack[--top]];
+        if(!enter(n, t)) // best may have improved since it was pushed
+            continue;
+        if(n.count) {
+            for(size_t k = n.right; k < n.right + n.count; ++k) {
+                float d;
+                if(intersectSphere(origin, direction, m_spheres[k], d) && d < best) {
+                    best = d;
+                    hit = int(m_items[k]);
+                }
+            }
+            continue;
+        }
+        // nearer child on top of the stack
+        const uint32_t left = uint32_t(&n - &m_nodes[0]) + 1, right = n.right;
+        float tl, tr;
+        const bool hitLeft = enter(m_nodes[left], tl), hitRight = enter(m_nodes[right], tr);
+        if(hitLeft && hitRight) {
+            stack[top++] = tl < tr ? right : left;
+            stack[top++] = tl < tr ? left : right;
+        } else if(hitLeft) {
+            stack[top++] = left;
+        } else if(hitRight) {
+            stack[top++] = right;
+        }
+    }
+    if(distance && hit >= 0)
+        *distance = best;
+    return hit;
+}
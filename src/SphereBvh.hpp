@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AlignedAllocator.hpp"
+
+// Bounding volume hierarchy over spheres, for ray picking.
+//
+// build() splits the spheres at the median of the longest axis of their
+// centres, in whole leaves, so a subtree of k leaves always takes 2k - 1
+// nodes: nodes are laid out depth-first, the left child right after its
+// parent, and every subtree owns a range of the array known before it is
+// built. The first levels are split a level at a time, the nodes of each in
+// parallel, and the subtrees below built in parallel, straight into their
+// ranges.
+//
+// refit() keeps the tree: it copies the spheres into leaf order, so the boxes
+// and intersect() only read contiguous memory, and recomputes the boxes
+// bottom-up (the same subtrees in parallel, then the top). The tree
+// degrades as the spheres drift away from where it was built; refit() tells
+// when the summed box areas grew past kRebuildRatio times those of the fresh
+// tree, and the caller builds again.
+class SphereBvh {
+public:
+    // Sphere i is centred on (x[i], y[i], z[i]) with radius r[i].
+    void build(const float *x, const float *y, const float *z, const float *r, size_t n);
+    // Same spheres, moved; returns false when the tree should be rebuilt.
+    bool refit(const float *x, const float *y, const float *z, const float *r);
+
+    // Closest sphere hit by the ray (direction normalized), -1 for none.
+    int intersect(const glm::vec3 &origin, const glm::vec3 &direction, float *distance = nullptr) const;
+
+    inline size_t size() const { return m_items.size(); }
+    inline size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+    static const size_t kLeafSize = 4;
+    static const float kRebuildRatio;
+
+    struct Node { // 32 bytes, two per cache line
+        float lo[3], hi[3];
+        uint32_t right; // internal: right child, the left one is the next node; leaf: first item
+        uint32_t count; // spheres in a leaf, 0 for an internal node
+    };
+
+    struct BuildItem {
+        float c[3];
+        uint32_t index;
+    };
+
+    struct Subtree {
+        size_t root, nodeEnd;
+        size_t begin, end;
+        double area;
+    };
+
+    void buildTop(std::vector<BuildItem> &items, size_t n, size_t grain);
+    void buildNode(std::vector<BuildItem> &items, size_t begin, size_t end, size_t node);
+    size_t split(std::vector<BuildItem> &items, size_t begin, size_t end, size_t node);
+    double refitNode(size_t node);
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_items;         // leaf order -> sphere
+    std::vector<uint32_t> m_slots;         // sphere -> leaf order
+    AlignedVector<glm::vec4> m_spheres;    // centre and radius, in leaf order
+    std::vector<Subtree> m_subtrees;       // built and refit in parallel
+    std::vector<size_t> m_top;             // nodes above them, parents first
+    double m_builtCost = 0.0;
+};
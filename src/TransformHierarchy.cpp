@@ -0,0 +1,151 @@
+// TransformHierarchy.cpp
+#include "TransformHierarchy.hpp"
+
+#include <algorithm>
+
+int TransformHierarchy::add(const int parent) {
+    const int node = int(size());
+    m_parent.push_back(parent);
+    m_firstChild.push_back(-1);
+    m_lastChild.push_back(-1);
+    m_nextSibling.push_back(-1);
+    if(parent >= 0) {
+        // appended, so the children are walked in the order they were added
+        if(m_lastChild[parent] >= 0)
+            m_nextSibling[m_lastChild[parent]] = node;
+        else
+            m_firstChild[parent] = node;
+        m_lastChild[parent] = node;
+    }
+    m_translation.push_back(glm::dvec3(0.0));
+    m_rotation.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+    m_scale.push_back(glm::vec3(1.f));
+    m_worldX.push_back(0.0);
+    m_worldY.push_back(0.0);
+    m_worldZ.push_back(0.0);
+    m_worldLinear.push_back(glm::dmat3(1.0));
+    m_worldIdentity.push_back(1);
+    m_changed.push_back(0);
+    m_dirty.push_back(0);
+    markDirty(node);
+    return node;
+}
+
+void TransformHierarchy::clear() {
+    m_parent.clear();
+    m_firstChild.clear();
+    m_lastChild.clear();
+    m_nextSibling.clear();
+    m_translation.clear();
+    m_rotation.clear();
+    m_scale.clear();
+    m_worldX.clear();
+    m_worldY.clear();
+    m_worldZ.clear();
+    m_worldLinear.clear();
+    m_worldIdentity.clear();
+    m_changed.clear();
+    m_changedList.clear();
+    m_dirty.clear();
+    m_dirtyList.clear();
+}
+
+void TransformHierarchy::markDirty(const int node) {
+    if(!m_dirty[node]) {
+        m_dirty[node] = 1;
+        m_dirtyList.push_back(node);
+    }
+}
+
+void TransformHierarchy::setTranslation(const int node, const glm::dvec3 &translation) {
+    if(m_translation[node] != translation) {
+        m_translation[node] = translation;
+        markDirty(node);
+    }
+}
+
+void TransformHierarchy::setRotation(const int node, const glm::quat &rotation) {
+    if(m_rotation[node] != rotation) {
+        m_rotation[node] = rotation;
+        markDirty(node);
+    }
+}
+
+void TransformHierarchy::setScale(const int node, const glm::vec3 &scale) {
+    if(m_scale[node] != scale) {
+        m_scale[node] = scale;
+        markDirty(node);
+    }
+}
+
+void TransformHierarchy::compute(const int node) {
+    const int p = m_parent[node];
+    const bool local = m_rotation[node] != glm::quat(1.f, 0.f, 0.f, 0.f) || m_scale[node] != glm::vec3(1.f);
+    glm::dvec3 world = m_translation[node];
+    if(p >= 0) {
+        // under plain translations (orbit frames) the offset adds up exactly
+        world = m_worldIdentity[p] ? glm::dvec3(m_worldX[p], m_worldY[p], m_worldZ[p]) + world
+                                   : glm::dvec3(m_worldX[p], m_worldY[p], m_worldZ[p]) + m_worldLinear[p] * world;
+    }
+    m_worldX[node] = world.x;
+    m_worldY[node] = world.y;
+    m_worldZ[node] = world.z;
+
+    const bool parentIdentity = p < 0 || m_worldIdentity[p];
+    m_worldIdentity[node] = !local && parentIdentity;
+    if(!local) {
+        m_worldLinear[node] = parentIdentity ? glm::dmat3(1.0) : m_worldLinear[p];
+    } else {
+        glm::dmat3 linear = glm::dmat3(glm::mat3_cast(m_rotation[node]));
+        linear[0] *= double(m_scale[node].x);
+        linear[1] *= double(m_scale[node].y);
+        linear[2] *= double(m_scale[node].z);
+        m_worldLinear[node] = parentIdentity ? linear : m_worldLinear[p] * linear;
+    }
+    m_changed[node] = m_pass;
+    m_changedList.push_back(node);
+}
+
+size_t TransformHierarchy::propagate() {
+    ++m_pass;
+    m_changedList.clear();
+    if(m_dirtyList.empty())
+        return 0;
+
+    size_t count = 0;
+    if(m_dirtyList.size() * kSweepRatio > size()) {
+        // a good part moved: one forward sweep, parents come first, beats sorting
+        for(size_t node = 0; node < size(); ++node) {
+            const int p = m_parent[node];
+            if(m_dirty[node] || (p >= 0 && m_changed[p] == m_pass)) {
+                m_dirty[node] = 0;
+                compute(int(node));
+                ++count;
+            }
+        }
+        m_dirtyList.clear();
+        return count;
+    }
+
+    // ancestors have lower indices: in index order a dirty node is reached
+    // after any dirty ancestor, whose walk already recomputed it
+    std::sort(m_dirtyList.begin(), m_dirtyList.end());
+    for(size_t d = 0; d < m_dirtyList.size(); ++d) {
+        const int root = m_dirtyList[d];
+        m_dirty[root] = 0;
+        if(m_changed[root] == m_pass)
+            continue;
+
+        m_queue.clear();
+        m_queue.push_back(root);
+        for(size_t q = 0; q < m_queue.size(); ++q) {
+            const int node = m_queue[q];
+            compute(node);
+            ++count;
+            for(int child = m_firstChild[node]; child >= 0; child = m_nextSibling[child])
+                m_queue.push_back(child);
+        }
+    }
+    m_dirtyList.clear();
+    return count;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Parent/child transforms with local translation, rotation and scale per node.
+//
+// Setters only mark a node dirty when the value actually changes; propagate()
+// then recomputes the world transforms of the dirty nodes and everything
+// below them, breadth first, and nothing else. When a good part of the nodes
+// is dirty one sweep in index order does the same without sorting them. A
+// node that did not move (a paused orbit, a body frozen while the simulation
+// catches up) costs a comparison in its setter and no work in propagate().
+//
+// Nodes are added parents first, so a lower index is never below a higher one.
+// World translations are kept in double, split per axis, so they can go
+// through the same SIMD camera-relative pass as the bodies; the world
+// rotation and scale are a double 3x3 matrix, which keeps a child's offset
+// exact under an unrotated parent.
+class TransformHierarchy {
+public:
+    // Returns the new node; parent is an existing node, or -1 for a root.
+    int add(int parent);
+    void clear();
+    inline size_t size() const { return m_parent.size(); }
+    inline int parent(int node) const { return m_parent[node]; }
+
+    void setTranslation(int node, const glm::dvec3 &translation);
+    void setRotation(int node, const glm::quat &rotation);
+    void setScale(int node, const glm::vec3 &scale);
+    inline const glm::dvec3 &translation(int node) const { return m_translation[node]; }
+    inline const glm::quat &rotation(int node) const { return m_rotation[node]; }
+    inline const glm::vec3 &scale(int node) const { return m_scale[node]; }
+
+    // Brings the world transforms up to date; returns the number of nodes recomputed.
+    size_t propagate();
+
+    inline glm::dvec3 worldTranslation(int node) const { return glm::dvec3(m_worldX[node], m_worldY[node], m_worldZ[node]); }
+    inline const double *worldX() const { return m_worldX.data(); }
+    inline const double *worldY() const { return m_worldY.data(); }
+    inline const double *worldZ() const { return m_worldZ.data(); }
+    // world rotation times scale
+    inline const glm::dmat3 &worldLinear(int node) const { return m_worldLinear[node]; }
+    // True when the last propagate() recomputed the node.
+    inline bool changed(int node) const { return m_changed[node] == m_pass; }
+    // The nodes it recomputed, parents first.
+    inline const std::vector<int> &changedNodes() const { return m_changedList; }
+
+private:
+    static const size_t kSweepRatio = 16; // sweep when more than 1 / kSweepRatio of the nodes are dirty
+
+    void markDirty(int node);
+    void compute(int node);
+
+    std::vector<int> m_parent, m_firstChild, m_nextSibling, m_lastChild;
+    // local
+    std::vector<glm::dvec3> m_translation;
+    std::vector<glm::quat> m_rotation;
+    std::vector<glm::vec3> m_scale;
+    // world
+    std::vector<double> m_worldX, m_worldY, m_worldZ;
+    std::vector<glm::dmat3> m_worldLinear;
+    std::vector<uint8_t> m_worldIdentity; // no rotation or scale from the root down
+
+    std::vector<uint8_t> m_dirty;
+    std::vector<int> m_dirtyList;
+    std::vector<uint32_t> m_changed; // pass that last recomputed the node
+    std::vector<int> m_changedList;
+    uint32_t m_pass = 1;
+    std::vector<int> m_queue;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+
+// Lock-free single producer / single consumer handoff of the latest value.
+//
+// Three slots: the writer fills back() and publish()es it, the reader
+// acquire()s the most recent published slot and reads front() for as long as
+// it likes. Neither side ever waits for the other; a value the reader did
+// not pick up in time is simply overwritten by the next one.
+template<typename T>
+class TripleBuffer {
+public:
+    // Writer side.
+    inline T &back() { return m_slots[m_back]; }
+    inline void publish() {
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader side. Returns true when front() changed.
+    inline bool acquire() {
+        if(!(m_middle.load(std::memory_order_relaxed) & kFresh))
+            return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    inline const T &front() const { return m_slots[m_front]; }
+
+private:
+    static const unsigned kIndex = 3, kFresh = 4;
+
+    T m_slots[3];
+    unsigned m_front = 0, m_back = 2; // owned by the reader and the writer
+    std::atomic<unsigned> m_middle{1u}; // slot in transit, plus kFresh when not read yet
+};
@@ -0,0 +1,107 @@
+// benchAffineKernels.cpp
+// AffineKernels against the glm code they replace, one core, from 1k to 10M
+// transforms: composeTrs against glm::translate * glm::mat4_cast * glm::scale
+// into mat4s, and concatenateParents against world[parent] * local in mat4s,
+// on a two-level hierarchy (an eighth of roots, the rest children of random
+// roots). In M transforms per second, with the largest difference to glm.
+// benchAffineKernels [max transforms], 10M by default; SOLAR_SIMD caps the level.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "AffineKernels.hpp"
+#include "Bench.hpp"
+
+namespace {
+
+// largest |a - b| over the 12 floats of each transform against the first three rows of the mat4
+double difference(const std::vector<float> &a, const std::vector<glm::mat4> &b) {
+    double worst = 0.0;
+    for(size_t i = 0; i < b.size(); ++i)
+        for(int c = 0; c < 4; ++c)
+            for(int r = 0; r < 3; ++r)
+                worst = std::max(worst, double(std::fabs(a[AffineKernels::kFloatsPerTransform * i + 3 * c + r] - b[i][c][r])));
+    return worst;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t maxCount = argc > 1 ? size_t(std::atol(argv[1])) : 10000000;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    std::printf("AffineKernels, %s, against glm, M transforms/s, one core\n", simdLevelName(AffineKernels::activeLevel()));
+    std::printf("%10s %10s %10s %9s %10s %10s %10s %9s %10s\n", "transforms", "compose", "glm", "speedup", "max diff",
+                "concat", "glm", "speedup", "max diff");
+    for(size_t n = 1000; n <= maxCount; n *= 10) {
+        const double minSeconds = n >= 1000000 ? 0.0 : 0.2;
+        std::vector<float> local(AffineKernels::kFloatsPerTransform * n);
+        std::vector<glm::mat4> glmLocal(n);
+        {
+            std::vector<float> t[3], q[4], s[3];
+            for(int k = 0; k < 3; ++k) {
+                t[k].resize(n);
+                s[k].resize(n);
+            }
+            for(int k = 0; k < 4; ++k)
+                q[k].resize(n);
+            for(size_t i = 0; i < n; ++i) {
+                const glm::quat r = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+                q[0][i] = r.x;
+                q[1][i] = r.y;
+                q[2][i] = r.z;
+                q[3][i] = r.w;
+                for(int k = 0; k < 3; ++k) {
+                    t[k][i] = 100.f * unit(random);
+                    s[k][i] = 1.5f + unit(random);
+                }
+            }
+            const AffineKernels::TrsArrays trs = {
+                t[0].data(), t[1].data(), t[2].data(),
+                q[0].data(), q[1].data(), q[2].data(), q[3].data(),
+                s[0].data(), s[1].data(), s[2].data()
+            };
+            const double kernel = Bench::seconds([&] {
+                AffineKernels::composeTrs(trs, 0, n, local.data());
+                Bench::keep(local[n / 2]);
+            }, minSeconds);
+            const double reference = Bench::seconds([&] {
+                for(size_t i = 0; i < n; ++i)
+                    glmLocal[i] = glm::translate(glm::mat4(1.f), glm::vec3(t[0][i], t[1][i], t[2][i]))
+                                  * glm::mat4_cast(glm::quat(q[3][i], q[0][i], q[1][i], q[2][i]))
+                                  * glm::scale(glm::mat4(1.f), glm::vec3(s[0][i], s[1][i], s[2][i]));
+                Bench::keep(glmLocal[n / 2][3][0]);
+            }, minSeconds);
+            std::printf("%10zu %10.1f %10.1f %8.2fx %10.2g", n, double(n) / kernel * 1e-6, double(n) / reference * 1e-6,
+                        reference / kernel, difference(local, glmLocal));
+        }
+
+        // roots first, as the kernel wants the parents done before their children
+        const size_t roots = std::max<size_t>(n / 8, 1);
+        std::vector<int> parent(n, -1);
+        for(size_t i = roots; i < n; ++i)
+            parent[i] = int(random() % roots);
+        std::vector<float> world(AffineKernels::kFloatsPerTransform * n);
+        std::vector<glm::mat4> glmWorld(n);
+        const double kernel = Bench::seconds([&] {
+            AffineKernels::concatenateParents(world.data(), parent.data(), local.data(), 0, roots);
+            AffineKernels::concatenateParents(world.data(), parent.data(), local.data(), roots, n);
+            Bench::keep(world[n / 2]);
+        }, minSeconds);
+        const double reference = Bench::seconds([&] {
+            for(size_t i = 0; i < n; ++i)
+                glmWorld[i] = parent[i] < 0 ? glmLocal[i] : glmWorld[parent[i]] * glmLocal[i];
+            Bench::keep(glmWorld[n / 2][3][0]);
+        }, minSeconds);
+        std::printf(" %10.1f %10.1f %8.2fx %10.2g\n", double(n) / kernel * 1e-6, double(n) / reference * 1e-6,
+                    reference / kernel, difference(world, glmWorld));
+    }
+    return EXIT_SUCCESS;
+}
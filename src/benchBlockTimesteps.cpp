@@ -0,0 +1,95 @@
+// benchBlockTimesteps.cpp
+// Block timesteps against fixed ones on a system with a wide range of orbital
+// periods: a star and planets from 0.1 to 10 distance units. Fixed steps as
+// short as the shortest block step are the reference; fixed steps as long as
+// the macro step show what the block scheme saves from. Prints the seconds,
+// the speedup over the short fixed steps, the relative energy error after the
+// run and how the bodies spread over the levels.
+// benchBlockTimesteps [planets [maxLevel]], 1023 and 8 by default.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "NBody.hpp"
+
+namespace {
+
+const double kMacroStep = 0.1;
+const double kSpan = 10.0; // a few hundred inner orbits, a sixth of the outermost one
+
+// Star of mu 1 at rest and planets of mu 1e-9 on circular orbits, radii log-uniform.
+void setUp(NBody &nbody, const size_t planets) {
+    std::mt19937 random(9);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    nbody.resize(planets + 1);
+    nbody.mu[0] = 1.f;
+    for(size_t i = 1; i <= planets; ++i) {
+        const double r = 0.1 * std::pow(100.0, unit(random)), phase = 6.283185307179586 * unit(random);
+        const double speed = std::sqrt(1.0 / r);
+        nbody.posX[i] = r * std::cos(phase);
+        nbody.posZ[i] = r * std::sin(phase);
+        nbody.velX[i] = -speed * std::sin(phase);
+        nbody.velZ[i] = speed * std::cos(phase);
+        nbody.mu[i] = 1e-9f;
+    }
+    nbody.softening2 = 1e-10f;
+    nbody.solver = NBody::Solver::Direct;
+}
+
+struct Result {
+    double seconds, energyError;
+};
+
+// levels, when not null, gets the bodies per level of the last macro step
+Result run(const size_t planets, const bool block, const int maxLevel, const double dt, std::vector<size_t> *levels) {
+    NBody nbody;
+    setUp(nbody, planets);
+    nbody.blockTimesteps = block;
+    nbody.maxLevel = maxLevel;
+    nbody.computeAccelerations();
+    const double e0 = nbody.energy();
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const int steps = int(std::lround(kSpan / dt));
+    for(int s = 0; s < steps; ++s)
+        nbody.step(dt);
+    Result result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.energyError = std::fabs((nbody.energy() - e0) / e0);
+    if(levels) {
+        levels->assign(maxLevel + 1, 0);
+        for(size_t i = 0; i < nbody.size(); ++i)
+            ++(*levels)[nbody.level[i]];
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t planets = argc > 1 ? size_t(std::atol(argv[1])) : 1023;
+    const int maxLevel = argc > 2 ? std::atoi(argv[2]) : 8;
+    const double shortest = kMacroStep / double(1 << maxLevel);
+
+    std::printf("%zu planets around a star, %g time units, macro step %g, shortest step %g\n", planets, kSpan, kMacroStep, shortest);
+    std::printf("%-24s %10s %9s %12s\n", "scheme", "seconds", "speedup", "energy err");
+    std::vector<size_t> levels;
+    const Result fine = run(planets, false, maxLevel, shortest, nullptr);
+    const Result coarse = run(planets, false, maxLevel, kMacroStep, nullptr);
+    const Result block = run(planets, true, maxLevel, kMacroStep, &levels);
+    const struct {
+        const char *name;
+        const Result &result;
+    } rows[] = { { "fixed, shortest step", fine }, { "fixed, macro step", coarse }, { "block, levels 0 to max", block } };
+    for(size_t r = 0; r < 3; ++r)
+        std::printf("%-24s %10.3f %8.1fx %12.3g\n", rows[r].name, rows[r].result.seconds, fine.seconds / rows[r].result.seconds,
+                    rows[r].result.energyError);
+    std::printf("bodies per level:");
+    for(size_t l = 0; l < levels.size(); ++l)
+        std::printf(" %zu", levels[l]);
+    std::printf("\n");
+    return EXIT_SUCCESS;
+}
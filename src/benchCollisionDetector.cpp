@@ -0,0 +1,62 @@
+// benchCollisionDetector.cpp
+// CollisionDetector::detect on a planetary ring, all threads: pebbles on
+// near-circular orbits with a little random motion and a moonlet every 100k,
+// one step of 1/240 s as the viewer takes. The pebbles grow as the count
+// shrinks so every size sees about the same crowding. Prints milliseconds per
+// detect, nanoseconds per body, the pairs tested and the contacts found.
+// benchCollisionDetector [max bodies], 1M by default; SOLAR_THREADS=<n> sets the thread count.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "CollisionDetector.hpp"
+#include "JobSystem.hpp"
+
+namespace {
+
+struct Ring {
+    std::vector<double> x, y, z, vx, vy, vz;
+    std::vector<float> r;
+
+    // radii 100 to 120 around a mu of 1e4, 0.2 thick
+    Ring(const size_t n, std::mt19937 &random) : x(n), y(n), z(n), vx(n), vy(n), vz(n), r(n) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const double pebble = std::sqrt(1e6 / double(n));
+        for(size_t i = 0; i < n; ++i) {
+            const double radius = 100.0 + 20.0 * unit(random), angle = 6.283185307179586 * unit(random);
+            const double speed = std::sqrt(1e4 / radius);
+            x[i] = radius * std::cos(angle);
+            y[i] = 0.2 * (unit(random) - 0.5);
+            z[i] = radius * std::sin(angle);
+            vx[i] = -speed * std::sin(angle) + 0.01 * (unit(random) - 0.5);
+            vy[i] = 0.01 * (unit(random) - 0.5);
+            vz[i] = speed * std::cos(angle) + 0.01 * (unit(random) - 0.5);
+            r[i] = i % 100000 == 7 ? 1.f : float((0.002 + 0.004 * unit(random)) * pebble);
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t maxBodies = argc > 1 ? size_t(std::atol(argv[1])) : 1000000;
+    const double dt = 1.0 / 240.0;
+    std::mt19937 random(3);
+    std::printf("CollisionDetector, ring of pebbles and moonlets, step %.4g s, %u threads\n", dt, JobSystem::get().threadCount());
+    std::printf("%10s %10s %10s %14s %12s %10s\n", "bodies", "ms", "ns/body", "pairs tested", "pairs/s", "contacts");
+    for(size_t n = 10000; n <= maxBodies; n *= 10) {
+        const Ring ring(n, random);
+        CollisionDetector detector;
+        std::vector<Contact> contacts;
+        const double seconds = Bench::seconds([&] {
+            detector.detect(ring.x.data(), ring.y.data(), ring.z.data(), ring.vx.data(), ring.vy.data(), ring.vz.data(),
+                            ring.r.data(), n, dt, contacts);
+        });
+        std::printf("%10zu %10.2f %10.1f %14.4g %12.3g %10zu\n", n, seconds * 1e3, seconds * 1e9 / double(n),
+                    double(detector.pairsTested()), double(detector.pairsTested()) / seconds, contacts.size());
+    }
+    return EXIT_SUCCESS;
+}
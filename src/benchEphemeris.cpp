@@ -0,0 +1,141 @@
+// benchEphemeris.cpp
+// Ephemeris fit and evaluation on synthetic orbits known in closed form: the
+// worst error between the samples (relative to the mean distance, the last
+// segment apart) and positions per second, one core.
+// benchEphemeris [degree [tolerance]], 12 and 1e-10 by default like ephemBuild.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Ephemeris.hpp"
+
+namespace {
+
+// Keplerian ellipse whose size breathes a little, like the moon's evection,
+// with exact velocities so the fit gets what Horizons would give it.
+struct Orbit {
+    const char *name, *center;
+    double a, e, inclination, period; // AU, rad, days
+    double wobble, wobblePeriod;      // relative size change and its period in days
+    double spacing, days;             // sampling
+
+    void state(const double t, double p[3], double v[3]) const {
+        const double n = 6.283185307179586 / period, m = n * t;
+        double E = m;
+        for(int it = 0; it < 30; ++it)
+            E -= (E - e * std::sin(E) - m) / (1.0 - e * std::cos(E));
+        const double s = std::sin(E), c = std::cos(E), rate = n / (1.0 - e * c);
+        const double b = a * std::sqrt(1.0 - e * e);
+        const double u = a * (c - e), w = b * s, du = -a * s * rate, dw = b * c * rate;
+        const double k = 6.283185307179586 / wobblePeriod;
+        const double f = 1.0 + wobble * std::sin(k * t), df = wobble * k * std::cos(k * t);
+        const double ci = std::cos(inclination), si = std::sin(inclination);
+        const double q[3] = { u, w * ci, w * si }, dq[3] = { du, dw * ci, dw * si };
+        for(int i = 0; i < 3; ++i) {
+            p[i] = f * q[i];
+            v[i] = df * q[i] + f * dq[i];
+        }
+    }
+
+    Ephemeris::Samples samples() const {
+        Ephemeris::Samples s;
+        s.name = name;
+        s.center = center;
+        const size_t count = size_t(days / spacing) + 1;
+        for(size_t i = 0; i < count; ++i) {
+            const double t = 2451545.0 + spacing * double(i);
+            double p[3], v[3];
+            state(t - 2451545.0, p, v);
+            s.time.push_back(t);
+            s.x.push_back(p[0]);
+            s.y.push_back(p[1]);
+            s.z.push_back(p[2]);
+            s.vx.push_back(v[0]);
+            s.vy.push_back(v[1]);
+            s.vz.push_back(v[2]);
+        }
+        return s;
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int degree = argc > 1 ? std::atoi(argv[1]) : 12;
+    const double tolerance = argc > 2 ? std::atof(argv[2]) : 1e-10;
+    // ten years, which leaves samples over after the whole segments
+    const Orbit orbits[] = {
+        { "Earth", "Sun", 1.0, 0.0167, 0.0, 365.256, 1e-4, 3000.0, 1.0, 3653.0 },
+        { "Moon", "Earth", 0.00257, 0.0549, 0.089, 27.3217, 0.01, 31.81, 0.25, 3653.0 },
+        { "Mercury", "Sun", 0.387, 0.2056, 0.122, 87.969, 1e-5, 1000.0, 0.5, 3653.0 },
+    };
+    const size_t bodyCount = sizeof(orbits) / sizeof(orbits[0]);
+
+    std::vector<Ephemeris::Fit> fits;
+    for(size_t i = 0; i < bodyCount; ++i)
+        fits.push_back(Ephemeris::fit(orbits[i].samples(), degree, tolerance));
+    const std::string path = "benchEphemeris.bin";
+    Ephemeris ephemeris;
+    if(!Ephemeris::write(path, fits) || !ephemeris.open(path)) {
+        std::fprintf(stderr, "ERROR: Could not write and map %s\n", path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::printf("Ephemeris, degree %d, tolerance %g, errors relative to the mean distance\n", degree, tolerance);
+    std::printf("%-8s %8s %6s %8s %12s %12s %10s %10s %10s\n", "body", "samples", "segs", "days", "first JD", "last JD",
+                "nodes", "between", "last seg");
+    std::mt19937 random(3);
+    for(size_t i = 0; i < bodyCount; ++i) {
+        const Orbit &o = orbits[i];
+        const Ephemeris::Fit &fit = fits[i];
+        const int body = ephemeris.find(o.name);
+        // half-way between samples everywhere, then random times in the last segment
+        const double lastStart = fit.start + fit.interval * (fit.segmentCount - 1);
+        double between = 0.0, tail = 0.0;
+        for(double t = fit.start + 0.5 * o.spacing; t < fit.end; t += o.spacing) {
+            double p[3], v[3], x, y, z;
+            o.state(t - 2451545.0, p, v);
+            ephemeris.position(body, t, x, y, z);
+            const double error = std::sqrt((x - p[0]) * (x - p[0]) + (y - p[1]) * (y - p[1]) + (z - p[2]) * (z - p[2])) / fit.meanDistance;
+            between = std::max(between, error);
+            if(t >= lastStart)
+                tail = std::max(tail, error);
+        }
+        std::uniform_real_distribution<double> inTail(lastStart, fit.end);
+        for(int k = 0; k < 10000; ++k) {
+            const double t = inTail(random);
+            double p[3], v[3], x, y, z;
+            o.state(t - 2451545.0, p, v);
+            ephemeris.position(body, t, x, y, z);
+            tail = std::max(tail, std::sqrt((x - p[0]) * (x - p[0]) + (y - p[1]) * (y - p[1]) + (z - p[2]) * (z - p[2])) / fit.meanDistance);
+        }
+        std::printf("%-8s %8zu %6u %8.3g %12.2f %12.2f %10.2g %10.2g %10.2g\n", o.name, size_t(o.days / o.spacing) + 1,
+                    fit.segmentCount, fit.interval, ephemeris.start(body), ephemeris.end(body), fit.maxError, between, tail);
+    }
+
+    // random bodies and times over the whole spans
+    std::vector<int> bodies(1 << 16);
+    std::vector<double> times(bodies.size());
+    for(size_t k = 0; k < bodies.size(); ++k) {
+        bodies[k] = int(random() % bodyCount);
+        std::uniform_real_distribution<double> span(ephemeris.start(bodies[k]), ephemeris.end(bodies[k]));
+        times[k] = span(random);
+    }
+    const double seconds = Bench::seconds([&] {
+        double sum = 0.0;
+        for(size_t k = 0; k < bodies.size(); ++k) {
+            double x, y, z;
+            ephemeris.position(bodies[k], times[k], x, y, z);
+            sum += x + y + z;
+        }
+        Bench::keep(sum);
+    });
+    std::printf("%.1f M positions/s (%.1f ns each)\n", double(bodies.size()) / seconds * 1e-6, seconds * 1e9 / double(bodies.size()));
+    std::remove(path.c_str());
+    return EXIT_SUCCESS;
+}
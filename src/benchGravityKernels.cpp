@@ -0,0 +1,82 @@
+// benchGravityKernels.cpp
+// Direct-summation force throughput (GravityKernels::accumulateBodies, tiled
+// as NBody does) from 1k to 64k bodies on 1, 2, 4... up to all threads of the
+// job system, in G interactions per second with the parallel efficiency.
+// benchGravityKernels, no arguments; SOLAR_THREADS sets "all", SOLAR_SIMD caps the level.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "GravityKernels.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+const size_t kSourceTile = 1024; // as NBody
+const size_t kTargetBlock = 256;
+
+// One full evaluation with at most `threads` jobs in flight: each takes every
+// threads-th block of targets.
+void evaluate(const std::vector<float> &x, const std::vector<float> &y, const std::vector<float> &z,
+              const std::vector<float> &mu, unsigned threads, std::vector<float> &ax, std::vector<float> &ay,
+              std::vector<float> &az) {
+    const size_t n = x.size(), blocks = (n + kTargetBlock - 1) / kTargetBlock;
+    std::fill(ax.begin(), ax.end(), 0.f);
+    std::fill(ay.begin(), ay.end(), 0.f);
+    std::fill(az.begin(), az.end(), 0.f);
+    Parallel::parallelFor(0, threads, [&](size_t lane) {
+        for(size_t block = lane; block < blocks; block += threads) {
+            const size_t begin = block * kTargetBlock, count = std::min(n, begin + kTargetBlock) - begin;
+            for(size_t tile = 0; tile < n; tile += kSourceTile)
+                GravityKernels::accumulateBodies(&x[begin], &y[begin], &z[begin], count, &x[tile], &y[tile], &z[tile],
+                                                 &mu[tile], std::min(n, tile + kSourceTile) - tile, 1e-4f,
+                                                 &ax[begin], &ay[begin], &az[begin]);
+        }
+    }, "bench.gravity");
+}
+
+} // namespace
+
+int main() {
+    const unsigned all = JobSystem::get().threadCount();
+    std::vector<unsigned> threads;
+    for(unsigned t = 1; t < all; t *= 2)
+        threads.push_back(t);
+    threads.push_back(all);
+
+    std::printf("GravityKernels::accumulateBodies, %s, G interactions/s (parallel efficiency)\n",
+                simdLevelName(GravityKernels::activeLevel()));
+    std::printf("%8s", "bodies");
+    for(size_t t = 0; t < threads.size(); ++t)
+        std::printf(" %10u thr%s", threads[t], threads[t] == 1 ? " " : "s");
+    std::printf("\n");
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    for(size_t n = 1024; n <= 65536; n *= 2) {
+        // sizes are multiples of the kernel padding already
+        std::vector<float> x(n), y(n), z(n), mu(n, 1.f / float(n)), ax(n), ay(n), az(n);
+        for(size_t i = 0; i < n; ++i) {
+            x[i] = unit(random);
+            y[i] = unit(random);
+            z[i] = unit(random);
+        }
+        std::printf("%8zu", n);
+        double single = 0.0;
+        for(size_t t = 0; t < threads.size(); ++t) {
+            const double seconds = Bench::seconds([&] {
+                evaluate(x, y, z, mu, threads[t], ax, ay, az);
+                Bench::keep(ax[n / 2]);
+            });
+            const double rate = double(n) * double(n) / seconds * 1e-9;
+            if(t == 0)
+                single = rate;
+            std::printf(" %7.2f (%3.0f%%)", rate, 100.0 * rate / (single * threads[t]));
+        }
+        std::printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
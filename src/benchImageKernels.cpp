@@ -0,0 +1,84 @@
+// benchImageKernels.cpp
+// Throughput of the image kernels against their scalar references:
+// benchImageKernels [width height], 4096 x 2048 by default. SOLAR_SIMD caps
+// the level of the dispatched column.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "ImageKernels.hpp"
+
+namespace {
+
+template <typename T>
+double maxDifference(const std::vector<T> &a, const std::vector<T> &b) {
+    double worst = 0.0;
+    for(size_t i = 0; i < a.size(); ++i)
+        worst = std::max(worst, std::abs(double(a[i]) - double(b[i])));
+    return worst;
+}
+
+void report(const char *name, const double bytes, const double reference, const double dispatched, const double difference) {
+    std::printf("%-18s %9.2f %9.2f %8.2fx %10g\n", name, bytes / reference * 1e-9, bytes / dispatched * 1e-9,
+                reference / dispatched, difference);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int width = argc > 2 ? std::atoi(argv[1]) : 4096, height = argc > 2 ? std::atoi(argv[2]) : 2048;
+    if(width < 2 || height < 2) {
+        std::fprintf(stderr, "usage: benchImageKernels [width height]\n");
+        return EXIT_FAILURE;
+    }
+    const size_t pixels = size_t(width) * height;
+    std::mt19937 random(1);
+    std::vector<unsigned char> rgb(pixels * 3), rgba(pixels * 4), expected(pixels * 4), actual(pixels * 4);
+    for(size_t i = 0; i < rgb.size(); ++i)
+        rgb[i] = (unsigned char)random();
+    for(size_t i = 0; i < rgba.size(); ++i)
+        rgba[i] = (unsigned char)random();
+    std::vector<float> linearExpected(pixels * 4), linearActual(pixels * 4);
+
+    std::printf("%d x %d RGBA8, dispatched level: %s\n", width, height, simdLevelName(ImageKernels::activeLevel()));
+    std::printf("%-18s %9s %9s %9s %10s\n", "kernel", "scalar", "simd", "speedup", "max diff");
+    std::printf("%-18s %9s %9s\n", "", "GB/s", "GB/s");
+
+    // bytes read plus written per call
+    double reference = Bench::seconds([&] { ImageKernels::reference::rgbToRgba(rgb.data(), expected.data(), pixels); });
+    double dispatched = Bench::seconds([&] { ImageKernels::rgbToRgba(rgb.data(), actual.data(), pixels); });
+    report("rgbToRgba", double(pixels) * 7, reference, dispatched, maxDifference(expected, actual));
+
+    expected = rgba;
+    actual = rgba;
+    reference = Bench::seconds([&] { ImageKernels::reference::flipRows(expected.data(), size_t(width) * 4, height); });
+    dispatched = Bench::seconds([&] { ImageKernels::flipRows(actual.data(), size_t(width) * 4, height); });
+    expected = rgba;
+    actual = rgba;
+    ImageKernels::reference::flipRows(expected.data(), size_t(width) * 4, height);
+    ImageKernels::flipRows(actual.data(), size_t(width) * 4, height);
+    report("flipRows", double(pixels) * 8, reference, dispatched, maxDifference(expected, actual));
+
+    reference = Bench::seconds([&] { ImageKernels::reference::srgbToLinear(rgba.data(), linearExpected.data(), pixels); });
+    dispatched = Bench::seconds([&] { ImageKernels::srgbToLinear(rgba.data(), linearActual.data(), pixels); });
+    report("srgbToLinear", double(pixels) * 20, reference, dispatched, maxDifference(linearExpected, linearActual));
+
+    reference = Bench::seconds([&] { ImageKernels::reference::linearToSrgb(linearExpected.data(), expected.data(), pixels); });
+    dispatched = Bench::seconds([&] { ImageKernels::linearToSrgb(linearExpected.data(), actual.data(), pixels); });
+    report("linearToSrgb", double(pixels) * 20, reference, dispatched, maxDifference(expected, actual));
+
+    const size_t half = size_t(std::max(1, width / 2)) * std::max(1, height / 2) * 4;
+    expected.resize(half);
+    actual.resize(half);
+    reference = Bench::seconds([&] { ImageKernels::reference::downsampleBox(rgba.data(), width, height, expected.data()); });
+    dispatched = Bench::seconds([&] { ImageKernels::downsampleBox(rgba.data(), width, height, actual.data()); });
+    report("downsampleBox", double(pixels) * 4 + double(half), reference, dispatched, maxDifference(expected, actual));
+
+    reference = Bench::seconds([&] { ImageKernels::reference::downsampleKaiser(rgba.data(), width, height, expected.data()); });
+    dispatched = Bench::seconds([&] { ImageKernels::downsampleKaiser(rgba.data(), width, height, actual.data()); });
+    report("downsampleKaiser", double(pixels) * 4 + double(half), reference, dispatched, maxDifference(expected, actual));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+// benchJobSystem.cpp
+// Scheduling overhead of the job system: a fork-join round trip with nothing
+// to do, parallelFor against a plain loop from 256 indices up, and submit() +
+// wait() per task.
+// benchJobSystem [indices], up to 1M by default; SOLAR_THREADS=<n> sets the thread count.
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Bench.hpp"
+#include "JobSystem.hpp"
+#include "Parallel.hpp"
+
+int main(int argc, char **argv) {
+    const size_t count = argc > 1 ? size_t(std::atol(argv[1])) : size_t(1) << 20;
+    JobSystem &jobs = JobSystem::get();
+    const unsigned threads = jobs.threadCount();
+    std::printf("JobSystem, %u threads\n", threads);
+
+    // one piece per thread and no work: the cost of splitting, stealing and joining
+    const double roundTrip = Bench::seconds([&] {
+        Parallel::parallelFor(0, threads, [](size_t i) { Bench::keep(i); }, "bench.empty");
+    });
+    std::printf("empty parallelFor over %u indices: %.2f us\n", threads, roundTrip * 1e6);
+
+    // a few instructions per index: from what size on splitting pays
+    std::printf("%10s %12s %12s %9s\n", "indices", "loop us", "parallel us", "speedup");
+    std::vector<float> data(count, 1.f);
+    for(size_t n = 256; n <= count; n *= 16) {
+        const double serial = Bench::seconds([&] {
+            for(size_t i = 0; i < n; ++i)
+                data[i] = data[i] * 0.999f + 0.001f;
+            Bench::keep(data[n / 2]);
+        });
+        const double parallel = Bench::seconds([&] {
+            Parallel::parallelFor(0, n, [&](size_t i) { data[i] = data[i] * 0.999f + 0.001f; }, "bench.for");
+            Bench::keep(data[n / 2]);
+        });
+        std::printf("%10zu %12.2f %12.2f %8.2fx\n", n, serial * 1e6, parallel * 1e6, serial / parallel);
+    }
+
+    // coarse tasks: one allocation and one push each
+    const int tasks = 10000;
+    const double submitted = Bench::seconds([&] {
+        JobSystem::Counter counter;
+        for(int t = 0; t < tasks; ++t)
+            jobs.submit("bench.task", [t] { Bench::keep(t); }, counter);
+        jobs.wait(counter);
+    });
+    std::printf("submit + wait: %.0f ns per task\n", submitted / tasks * 1e9);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+// benchKepler.cpp
+// Kepler::propagate throughput in solves per second, one core, against the
+// 100M/s goal, with the worst position error against the double reference:
+// benchKepler [count...], 1k, 64k and 1M orbits by default. SOLAR_SIMD caps the level.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Kepler.hpp"
+
+namespace {
+
+struct Orbits {
+    std::vector<double> m0, n;
+    std::vector<float> e;
+    std::vector<double> a, b, px, py, pz, qx, qy, qz;
+
+    Orbits(const size_t count, const float maxEccentricity, std::mt19937 &random) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        m0.resize(count);
+        n.resize(count);
+        e.resize(count);
+        a.resize(count);
+        b.resize(count);
+        px.resize(count);
+        py.resize(count);
+        pz.resize(count);
+        qx.resize(count);
+        qy.resize(count);
+        qz.resize(count);
+        for(size_t i = 0; i < count; ++i) {
+            m0[i] = 6.283185307179586 * unit(random);
+            n[i] = 0.01 + unit(random);
+            e[i] = float(maxEccentricity * unit(random));
+            a[i] = 1.0 + 30.0 * unit(random);
+            b[i] = a[i] * std::sqrt(1.0 - double(e[i]) * e[i]);
+            double p[3], q[3];
+            Kepler::perifocalBasis(0.3 * unit(random), 6.28 * unit(random), 6.28 * unit(random), p, q);
+            px[i] = p[0];
+            py[i] = p[1];
+            pz[i] = p[2];
+            qx[i] = q[0];
+            qy[i] = q[1];
+            qz[i] = q[2];
+        }
+    }
+
+    Kepler::OrbitArrays arrays() const {
+        const Kepler::OrbitArrays o = { m0.data(), n.data(), e.data(), a.data(), b.data(),
+                                        px.data(), py.data(), pz.data(), qx.data(), qy.data(), qz.data() };
+        return o;
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<size_t> counts;
+    for(int i = 1; i < argc; ++i)
+        counts.push_back(size_t(std::atol(argv[i])));
+    if(counts.empty())
+        counts = { 1000, 64000, 1000000 };
+
+    std::printf("Kepler::propagate, level %s, one core (goal: 100 M solves/s)\n", simdLevelName(Kepler::activeLevel()));
+    std::printf("%10s %8s %12s %14s\n", "orbits", "e up to", "M solves/s", "max err / a");
+    std::mt19937 random(7);
+    const float eccentricities[] = { 0.1f, 0.3f, 0.9f };
+    for(size_t c = 0; c < counts.size(); ++c) {
+        for(int k = 0; k < 3; ++k) {
+            const size_t count = counts[c];
+            const Orbits orbits(count, eccentricities[k], random);
+            const Kepler::OrbitArrays o = orbits.arrays();
+            std::vector<double> x(count), y(count), z(count);
+            double time = 0.0;
+            const double seconds = Bench::seconds([&] {
+                time += 0.37;
+                Kepler::propagate(o, count, time, x.data(), y.data(), z.data());
+            });
+
+            // against the double reference, at a late time so the phase reduction counts
+            const double t = 1e5 + 0.5;
+            std::vector<double> rx(count), ry(count), rz(count);
+            Kepler::propagate(o, count, t, x.data(), y.data(), z.data());
+            Kepler::reference::propagate(o, count, t, rx.data(), ry.data(), rz.data());
+            double worst = 0.0;
+            for(size_t i = 0; i < count; ++i) {
+                const double dx = x[i] - rx[i], dy = y[i] - ry[i], dz = z[i] - rz[i];
+                worst = std::max(worst, std::sqrt(dx * dx + dy * dy + dz * dz) / orbits.a[i]);
+            }
+            std::printf("%10zu %8.1f %12.1f %14.3g\n", count, eccentricities[k], double(count) / seconds * 1e-6, worst);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+// benchNBody.cpp
+// Barnes-Hut against direct summation on a Plummer sphere, all threads: the
+// seconds per force evaluation from 10k to 10M bodies, where the tree starts
+// to win, and the acceleration error against the opening angle theta.
+// Direct summation is timed on a sample of targets and scaled to all of them,
+// its cost being exactly linear in the targets; the sample's accelerations
+// are the reference for the errors.
+// benchNBody [max bodies], 10M by default; SOLAR_THREADS=<n> sets the thread count.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "BarnesHut.hpp"
+#include "Bench.hpp"
+#include "GravityKernels.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+const float kSoftening2 = 1e-6f;
+const size_t kSample = 1024;     // targets summed directly, a multiple of the kernel padding
+const size_t kSourceTile = 1024; // sources per kernel call, as NBody tiles them
+const size_t kTargetBlock = 64;  // targets per job
+
+struct Bodies {
+    std::vector<float> x, y, z, mu;
+
+    // Plummer sphere of scale radius 1, equal masses, cut at 20 radii
+    Bodies(const size_t n, std::mt19937 &random) : x(n), y(n), z(n), mu(n, 1.f / float(n)) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for(size_t i = 0; i < n; ++i) {
+            double r;
+            do
+                r = 1.0 / std::sqrt(std::pow(unit(random), -2.0 / 3.0) - 1.0);
+            while(r > 20.0);
+            const double cosTheta = 2.0 * unit(random) - 1.0, phi = 6.283185307179586 * unit(random);
+            const double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            x[i] = float(r * sinTheta * std::cos(phi));
+            y[i] = float(r * sinTheta * std::sin(phi));
+            z[i] = float(r * cosTheta);
+        }
+    }
+    inline size_t size() const { return x.size(); }
+};
+
+// Accelerations of the first kSample bodies from all of them; the bodies are
+// in random order, so these are a fair sample.
+void directSample(const Bodies &b, std::vector<float> &ax, std::vector<float> &ay, std::vector<float> &az) {
+    const size_t n = b.size();
+    ax.assign(kSample, 0.f);
+    ay.assign(kSample, 0.f);
+    az.assign(kSample, 0.f);
+    Parallel::parallelFor(0, kSample / kTargetBlock, [&](size_t block) {
+        const size_t begin = block * kTargetBlock;
+        for(size_t tile = 0; tile < n; tile += kSourceTile)
+            GravityKernels::accumulateBodies(&b.x[begin], &b.y[begin], &b.z[begin], kTargetBlock, &b.x[tile], &b.y[tile],
+                                             &b.z[tile], &b.mu[tile], std::min(n, tile + kSourceTile) - tile,
+                                             kSoftening2, &ax[begin], &ay[begin], &az[begin]);
+    }, "bench.direct");
+}
+
+struct Errors {
+    double rms, max;
+};
+
+// |a_tree - a_direct| / |a_direct| over the sample
+Errors compare(const std::vector<float> &tx, const std::vector<float> &ty, const std::vector<float> &tz,
+               const std::vector<float> &dx, const std::vector<float> &dy, const std::vector<float> &dz, size_t count) {
+    Errors e = { 0.0, 0.0 };
+    for(size_t i = 0; i < count; ++i) {
+        const double ex = double(tx[i]) - dx[i], ey = double(ty[i]) - dy[i], ez = double(tz[i]) - dz[i];
+        const double a2 = double(dx[i]) * dx[i] + double(dy[i]) * dy[i] + double(dz[i]) * dz[i];
+        const double relative = std::sqrt((ex * ex + ey * ey + ez * ez) / a2);
+        e.rms += relative * relative;
+        e.max = std::max(e.max, relative);
+    }
+    e.rms = std::sqrt(e.rms / double(count));
+    return e;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t maxBodies = std::max<size_t>(argc > 1 ? size_t(std::atol(argv[1])) : 10000000, 10000);
+    std::mt19937 random(11);
+    std::printf("Barnes-Hut (theta 0.5) against direct summation, %u threads, %s kernels\n",
+                JobSystem::get().threadCount(), simdLevelName(GravityKernels::activeLevel()));
+    std::printf("%10s %12s %12s %12s %12s %9s %10s\n", "bodies", "direct s", "tree s", "build s", "walk s", "speedup", "rms err");
+
+    // seconds per evaluation for the crossover, fitted as c N^2 and c N log2 N
+    double directPerN2 = 0.0, treePerNLogN = 0.0;
+    size_t treeWinsFrom = 0;
+    std::vector<size_t> sizes;
+    for(size_t n = 1000; n <= maxBodies; n *= 10) {
+        if(n >= 10000)
+            sizes.push_back(n);
+        if(3 * n <= maxBodies && 3 * n >= 10000)
+            sizes.push_back(3 * n);
+    }
+    for(size_t s = 0; s < sizes.size(); ++s) {
+        const size_t n = sizes[s];
+        const Bodies bodies(n, random);
+        const double minSeconds = n >= 1000000 ? 0.0 : 0.2;
+        const int runs = n >= 1000000 ? 1 : 3;
+
+        std::vector<float> dx, dy, dz;
+        const double direct = Bench::seconds([&] { directSample(bodies, dx, dy, dz); }, minSeconds, runs)
+                              * double(n) / double(kSample);
+
+        BarnesHut tree;
+        std::vector<float> ax(n), ay(n), az(n);
+        const double build = Bench::seconds([&] {
+            tree.build(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.mu.data(), n);
+        }, minSeconds, runs);
+        const double walk = Bench::seconds([&] {
+            tree.accelerations(0.5f, kSoftening2, ax.data(), ay.data(), az.data());
+        }, minSeconds, runs);
+        const Errors errors = compare(ax, ay, az, dx, dy, dz, kSample);
+
+        std::printf("%10zu %12.4g %12.4g %12.4g %12.4g %8.1fx %10.2g\n", n, direct, build + walk, build, walk,
+                    direct / (build + walk), errors.rms);
+        if(s == 0) {
+            directPerN2 = direct / (double(n) * double(n));
+            treePerNLogN = (build + walk) / (double(n) * std::log2(double(n)));
+        }
+        if(!treeWinsFrom && build + walk < direct)
+            treeWinsFrom = n;
+    }
+    if(directPerN2 > 0.0) {
+        // c_d N^2 = c_t N log2 N, by fixed point from the sizes' end
+        double crossover = 1e6;
+        for(int it = 0; it < 50; ++it)
+            crossover = std::max(2.0, treePerNLogN / directPerN2 * std::log2(crossover));
+        std::printf("crossover: the tree wins from about %.0f bodies (fitted on %zu), measured faster from %zu\n",
+                    crossover, sizes[0], treeWinsFrom);
+    }
+
+    // error against theta on 100k bodies
+    const size_t n = std::min<size_t>(100000, maxBodies);
+    const Bodies bodies(n, random);
+    std::vector<float> dx, dy, dz;
+    directSample(bodies, dx, dy, dz);
+    BarnesHut tree;
+    tree.build(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.mu.data(), n);
+    std::printf("\n%zu bodies\n%8s %12s %14s %12s %12s\n", n, "theta", "walk s", "interactions", "rms err", "max err");
+    const float thetas[] = { 0.2f, 0.3f, 0.5f, 0.7f, 0.9f, 1.2f };
+    for(size_t k = 0; k < sizeof(thetas) / sizeof(thetas[0]); ++k) {
+        std::vector<float> ax(n), ay(n), az(n);
+        uint64_t interactions = 0;
+        const double walk = Bench::seconds([&] {
+            interactions = tree.accelerations(thetas[k], kSoftening2, ax.data(), ay.data(), az.data());
+        });
+        const Errors errors = compare(ax, ay, az, dx, dy, dz, kSample);
+        std::printf("%8.2f %12.4g %14.4g %12.2g %12.2g\n", thetas[k], walk, double(interactions), errors.rms, errors.max);
+    }
+    return EXIT_SUCCESS;
+}
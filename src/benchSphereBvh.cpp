@@ -0,0 +1,103 @@
+// benchSphereBvh.cpp
+// Picking with SphereBvh, all threads, on a disc of bodies from 1k to 1M
+// (radii 10 to 1000, a thin disc, sizes as the asteroid belts in bodies.txt
+// go): build, refit after the disc turned a little, the copy of the spheres
+// the viewer makes each update for the background refresh, and the pick
+// latency, the mean and worst of intersect() over rays from a camera above
+// the disc, half at bodies and half at random.
+// benchSphereBvh [max bodies], 1M by default; SOLAR_THREADS=<n> sets the thread count.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bench.hpp"
+#include "JobSystem.hpp"
+#include "SphereBvh.hpp"
+
+namespace {
+
+const size_t kRays = 1000;
+
+struct Disc {
+    std::vector<float> x, y, z, r;
+    std::vector<double> radius, angle;
+
+    Disc(const size_t n, std::mt19937 &random) : x(n), y(n), z(n), r(n), radius(n), angle(n) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for(size_t i = 0; i < n; ++i) {
+            radius[i] = 10.0 * std::pow(100.0, unit(random));
+            angle[i] = 6.283185307179586 * unit(random);
+            y[i] = float(0.02 * radius[i] * (unit(random) - 0.5));
+            r[i] = float(0.005 + 0.05 * unit(random));
+        }
+        turn(0.0);
+    }
+
+    // inner bodies faster, as on orbits
+    void turn(const double t) {
+        for(size_t i = 0; i < radius.size(); ++i) {
+            const double a = angle[i] + t * std::pow(radius[i] / 10.0, -1.5);
+            x[i] = float(radius[i] * std::cos(a));
+            z[i] = float(radius[i] * std::sin(a));
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t maxBodies = argc > 1 ? size_t(std::atol(argv[1])) : 1000000;
+    std::mt19937 random(5);
+    std::printf("SphereBvh picking, disc of bodies, %u threads\n", JobSystem::get().threadCount());
+    std::printf("%10s %10s %10s %10s %12s %12s %8s\n", "bodies", "build ms", "refit ms", "copy ms", "pick us", "worst us", "hits");
+    for(size_t n = 1000; n <= maxBodies; n *= 10) {
+        Disc disc(n, random);
+        SphereBvh bvh;
+        const double build = Bench::seconds([&] {
+            bvh.build(disc.x.data(), disc.y.data(), disc.z.data(), disc.r.data(), n);
+        });
+        disc.turn(0.01);
+        const double refit = Bench::seconds([&] {
+            Bench::keep(bvh.refit(disc.x.data(), disc.y.data(), disc.z.data(), disc.r.data()));
+        });
+        std::vector<float> copy[4];
+        const double copying = Bench::seconds([&] {
+            copy[0].assign(disc.x.begin(), disc.x.end());
+            copy[1].assign(disc.y.begin(), disc.y.end());
+            copy[2].assign(disc.z.begin(), disc.z.end());
+            copy[3].assign(disc.r.begin(), disc.r.end());
+            Bench::keep(copy[3][n / 2]);
+        });
+
+        const glm::vec3 camera(0.f, 300.f, -1500.f);
+        std::vector<glm::vec3> directions(kRays);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        for(size_t k = 0; k < kRays; ++k) {
+            const size_t body = random() % n;
+            const glm::vec3 target = k % 2 ? glm::vec3(disc.x[body], disc.y[body], disc.z[body])
+                                           : glm::vec3(1000.f * unit(random), 20.f * unit(random), 1000.f * unit(random));
+            directions[k] = glm::normalize(target - camera);
+        }
+        size_t hits = 0;
+        const double pick = Bench::seconds([&] {
+            hits = 0;
+            for(size_t k = 0; k < kRays; ++k)
+                hits += bvh.intersect(camera, directions[k]) >= 0;
+        }) / double(kRays);
+        double worst = 0.0;
+        for(size_t k = 0; k < kRays; ++k) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Bench::keep(bvh.intersect(camera, directions[k]));
+            worst = std::max(worst, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::printf("%10zu %10.2f %10.2f %10.2f %12.2f %12.2f %8zu\n", n, build * 1e3, refit * 1e3, copying * 1e3, pick * 1e6,
+                    worst * 1e6, hits);
+    }
+    return EXIT_SUCCESS;
+}
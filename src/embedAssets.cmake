@@ -0,0 +1,45 @@
+# ----------------------------------------------------------------------------
+# embedAssets.cmake
+#
+# Description: Turns asset files into constexpr byte arrays compiled into
+# tpOpenGL. Run in script mode:
+#
+#   cmake -DSOURCE_DIR=<dir> -DOUTPUT=<file.inc> -DFILES=<a|b|c> -P embedAssets.cmake
+#
+# FILES is '|'-separated so the list survives add_custom_command.
+# ----------------------------------------------------------------------------
+
+string(REPLACE "|" ";" FILE_LIST "${FILES}")
+
+# CMake regexes have no {n} repetition, so spell out 16 bytes per line
+set(LINE_PATTERN "")
+foreach(I RANGE 15)
+  string(APPEND LINE_PATTERN "0x..,")
+endforeach()
+
+set(ARRAYS "")
+set(TABLE "")
+set(INDEX 0)
+foreach(NAME ${FILE_LIST})
+  file(READ "${SOURCE_DIR}/${NAME}" HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR SIZE "${HEX_LENGTH} / 2")
+  if(SIZE EQUAL 0)
+    message(FATAL_ERROR "embedAssets: ${NAME} is empty")
+  endif()
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+  string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n  " BYTES "${BYTES}")
+  string(APPEND ARRAYS "// ${NAME}\nconstexpr unsigned char kEmbedded${INDEX}[${SIZE}] = {\n  ${BYTES}\n};\n\n")
+  string(APPEND TABLE "  { \"${NAME}\", kEmbedded${INDEX}, ${SIZE} },\n")
+  math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+set(CONTENT "// Generated by embedAssets.cmake, do not edit.\n\n${ARRAYS}const EmbeddedAsset kEmbeddedAssets[] = {\n${TABLE}};\n")
+
+# only touch the output when it changes, to avoid needless rebuilds
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+  file(WRITE "${OUTPUT}" "${CONTENT}")
+endif()
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------
+// ephemBuild.cpp
+//
+// Description: Builds the Chebyshev ephemeris loaded by tpOpenGL at startup.
+//
+//   ephemBuild <output.bin> [--degree N] [--tolerance D] <horizons.txt>...
+//
+// Each input is a JPL Horizons vector table (ephemeris type VECTORS, plain or
+// CSV) saved as text, one body relative to its center, evenly sampled. The
+// tool reports the fit residual of every body, then times evaluations of the
+// written file.
+// ----------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Ephemeris.hpp"
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <output.bin> [--degree N] [--tolerance D] <horizons.txt>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string output = argv[1];
+    int degree = 12;
+    double tolerance = 1e-10; // relative to the mean distance: 15 m for the earth, 4 cm for the moon
+
+    std::vector<Ephemeris::Fit> fits;
+    for(int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--degree" && i + 1 < argc) {
+            degree = std::atoi(argv[++i]);
+            continue;
+        }
+        if(arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+            continue;
+        }
+
+        std::ifstream in(arg.c_str(), std::ios::binary);
+        if(!in) {
+            std::cerr << "ERROR: Could not open " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        Ephemeris::Samples samples;
+        std::string error;
+        if(!Ephemeris::parseHorizons(text.data(), text.size(), samples, error)) {
+            std::cerr << "ERROR: " << arg << ": " << error << std::endl;
+            return EXIT_FAILURE;
+        }
+        fits.push_back(Ephemeris::fit(samples, degree, tolerance));
+        const Ephemeris::Fit &fit = fits.back();
+        std::cout << fit.name << " around " << fit.center << ": " << samples.time.size() << " samples, "
+                  << fit.segmentCount << " segments of " << fit.interval << " days (the last up to the end), covers JD "
+                  << std::fixed << std::setprecision(4) << fit.start << " to " << fit.end << std::defaultfloat
+                  << ", degree " << fit.degree
+                  << ", max relative error " << fit.maxError << (fit.maxError > tolerance ? " (over tolerance)" : "") << std::endl;
+    }
+
+    if(fits.empty()) {
+        std::cerr << "ERROR: no Horizons table given" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if(!Ephemeris::write(output, fits))
+        return EXIT_FAILURE;
+
+    // evaluation throughput of the mapped file, every body over its whole span
+    Ephemeris ephemeris;
+    if(!ephemeris.open(output)) {
+        std::cerr << "ERROR: Could not read back " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+    const int evaluations = 1 << 20;
+    volatile double sink = 0.0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int k = 0; k < evaluations; ++k) {
+        const int body = k % int(ephemeris.bodyCount());
+        const double t = ephemeris.start(body) + (ephemeris.end(body) - ephemeris.start(body)) * ((k * 2654435761u) % 1000003u) / 1000003.0;
+        double x, y, z;
+        ephemeris.position(body, t, x, y, z);
+        sink += x + y + z;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << fits.size() << " bodies to " << output << ", "
+              << seconds * 1e9 / evaluations << " ns per position" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,7 @@
 in vec3 fPosition;  
 in vec3 fNormal;   
 in vec2 fTexCoord;
+in vec3 fDirection; // object-space direction, used to sample the body cubemap
 
 uniform vec3 lightPos;    // Light (Sun) position
 uniform vec3 viewPos;     // Camera position
@@ -11,15 +12,26 @@ uniform vec3 ambientColor; // Ambient light color
 uniform vec3 objectColor; // Object's base color
 uniform float shininess;  // Material shininess
 uniform int isSun;        // Flag to differentiate Sun from other objects
+uniform int hasSurfaceTex; // The Sun has a streamed surface texture
+uniform int isSelected;   // Picked with the mouse, drawn with a glowing rim
 
 struct Material {
-    sampler2D albedoTex;
+    samplerCube albedoCube;
+    sampler2D surfaceTex; // animated surface, sampled with the sphere UVs
 };
 
 uniform Material material;
 
 out vec4 FragColor;
 
+// Rim glow of the selected body, strongest where the surface turns away from the eye
+vec3 highlight(vec3 color, vec3 norm, vec3 viewDir) {
+    if (isSelected == 0)
+        return color;
+    float rim = pow(1.0 - max(dot(norm, viewDir), 0.0), 2.0);
+    return mix(color, vec3(1.0, 0.8, 0.3), 0.25 + 0.6 * rim);
+}
+
 void main() {
     vec3 norm = normalize(fNormal);
     vec3 lightDir = normalize(lightPos - fPosition);
@@ -27,11 +39,14 @@ void main() {
 
     vec3 ambient = ambientColor; 
 
-    vec3 texColor = texture(material.albedoTex, fTexCoord).rgb; 
+    vec3 texColor = texture(material.albedoCube, fDirection).rgb;
 
     // If the object is the Sun, use only its diffuse light
     if (isSun == 1) {
         FragColor = vec4(objectColor, 1.0);  // Just render Sun's base color
+        if (hasSurfaceTex == 1)
+            FragColor = vec4(texture(material.surfaceTex, fTexCoord).rgb, 1.0);
+        FragColor.rgb = highlight(FragColor.rgb, norm, viewDir);
         return;
     }
 
@@ -46,6 +61,6 @@ void main() {
 
     // Final color combination
     vec3 result = ambient + diffuse + specular;
-    FragColor = vec4(texColor * result, 1.0);
+    FragColor = vec4(highlight(texColor * result, norm, viewDir), 1.0);
 
 }
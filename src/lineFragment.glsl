@@ -0,0 +1,11 @@
+#version 330 core
+
+in float fFade;
+
+uniform vec3 color;
+
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(color, mix(1.0, 0.15, fFade));
+}
@@ -0,0 +1,14 @@
+#version 330 core
+
+// Line strips already relative to the camera, like the bodies
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in float aFade;  // 0 at the start of the line, 1 at its end
+
+uniform mat4 viewProj;
+
+out float fFade;
+
+void main() {
+    fFade = aFade;
+    gl_Position = viewProj * vec4(aPosition, 1.0);
+}
@@ -24,6 +24,7 @@
 #include <glm/ext.hpp>
 
 #include <cstdlib>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -31,29 +32,43 @@
 #include <string>
 #include <cmath>
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include "Mesh.hpp"
-
-// constants
-const static float kSizeSun = 1;
-const static float kSizeEarth = 0.5;
-const static float kSizeMoon = 0.25;
-const static float kRadOrbitEarth = 10;
-const static float kRadOrbitMoon = 2;
-// add two planets for final step
-const static float kSizeMars = 0.25; //about half the earth size
-const static float kSizeVenus = 0.49; //slightly smaller than the earth
-const static float kRadOrbitMars = 15; //about 1.5 earth orbit
-const static float kRadOrbitVenus = 7.2; //abot 7.2 earth orbit
+#include "ImageKernels.hpp"
+#include "Cubemap.hpp"
+#include "AssetPack.hpp"
+#include "EmbeddedAssets.hpp"
+#include "AnimatedTexture.hpp"
+#include "BodyTable.hpp"
+#include "Ephemeris.hpp"
+#include "Simulation.hpp"
+#include "JobSystem.hpp"
+#include "MathKernels.hpp"
+#include "SphereBvh.hpp"
+#include "EntityWorld.hpp"
+#include "CommandBuffer.hpp"
+#include "AnimClip.hpp"
+#include "SessionLog.hpp"
+#include "Porkchop.hpp"
+#include "Predictor.hpp"
+#include "LineRenderer.hpp"
 
 // Window parameters
-GLFWwindow *g_window = nullptr;
+GLFWwindow *g_window = nullptr; // none in a headless replay
+int g_windowWidth = 1024, g_windowHeight = 768; // as the camera and picking see it, the recorded one in a replay
 
 // GPU objects
 GLuint g_program = 0; // A GPU program contains at least a vertex shader and a fragment shader
+GLuint g_overlayProgram = 0; // screen-space textured quads
+GLuint g_overlayVao = 0;     // empty, the quad comes from gl_VertexID
 
 // OpenGL identifiers
 GLuint g_vao = 0;
@@ -61,11 +76,10 @@ GLuint g_posVbo = 0;
 GLuint g_ibo = 0;
 GLuint g_colorVbo = 0;
 
-GLuint g_earthTexID;
-GLuint g_moonTexID;
-// add two planets for final step
-GLuint g_marsTexID;
-GLuint g_venusTexID;
+// one cubemap per body material, 0 for untextured materials
+std::vector<GLuint> g_materialTexIDs;
+// optional animated solar surface, streamed from media/sun/000.jpg, 001.jpg, ...
+AnimatedTexture g_sunSurface;
 
 // All vertex positions packed in one array [x0, y0, z0, x1, y1, z1, ...]
 std::vector<float> g_vertexPositions;
@@ -77,14 +91,104 @@ std::vector<float> g_vertexColors;
 // we need to create a vector for the mesh
 std::shared_ptr<Mesh> sphereMesh;
 
-//variables for the planets matrices
-glm::mat4 modelMatrixSun = glm::mat4(1.0f);
-glm::mat4 modelMatrixEarth = glm::mat4(1.0f);
-glm::mat4 modelMatrixMoon = glm::mat4(1.0f);
-// add two planets for final step
-glm::mat4 modelMatrixMars = glm::mat4(1.0f);
-glm::mat4 modelMatrixVenus = glm::mat4(1.0f);
-
+// Shaders, textures and meshes, mapped once from the asset pack next to the executable
+AssetPack g_assets;
+// Directory of the executable; loose asset files are looked up there when the pack is missing
+std::string g_assetDir;
+// Development override (--assets <dir> or SOLAR_ASSET_DIR): files there win over embedded and packed assets
+std::string g_overrideAssetDir;
+
+// every body of the scene (orbits, sizes, materials, world positions and transforms), loaded from bodies.txt
+BodyTable g_bodies;
+std::vector<glm::dvec3> g_bodyOffsets; // this frame's offsets from the parents, see update()
+// picking: the body spheres relative to the camera position of the update they come from, two
+// trees so a click only queries one while the other is refit on a job; see refreshPicking()
+struct PickingTree {
+  SphereBvh bvh;
+  glm::dvec3 origin;
+};
+PickingTree g_picking[2];
+int g_pickingFront = 0;                 // the one pickBody() queries
+JobSystem::Counter g_pickingJob;        // refreshing the other one
+bool g_pickingPending = false;          // a refresh to take in
+std::vector<float> g_pickingX, g_pickingY, g_pickingZ, g_pickingRadius; // its copy of the spheres
+bool g_bodyBvhStale = true; // bodies moved since the last refresh
+
+// Scene objects, one entity per thing drawn; see initScene()
+struct BodyLink { uint32_t body; };            // row in g_bodies it follows
+struct ClipTransform { glm::mat4 matrix; };    // projection * view * model, rebuilt each frame
+struct Drawable {
+  Mesh *mesh;
+  GLuint texture; // cubemap, 0 for none
+  glm::vec3 color;
+  int emissive;
+};
+struct Selected {};                            // picked with the mouse
+EntityWorld g_scene;
+// structural changes asked for during a frame, applied at the start of the next update()
+CommandBuffer g_sceneCommands;
+std::vector<Entity> g_bodyEntities; // per body
+// optional Chebyshev tables (ephemeris.bin next to the executable, see ephemBuild) replacing the Kepler orbits they cover
+Ephemeris g_ephemeris;
+const double kEphemerisEpoch = 2451545.0; // scene time 0 is J2000, in Julian days
+
+// scripted orbits or, in gravity mode (G key), mutual attraction; stepped on its own thread at 240 Hz
+Simulation g_simulation;
+const double kSeekJump = 30.0; // simulation seconds per [ / ] press, ten times that with shift
+
+// baked scripted orbits (B bakes kBakeSeconds from now into scene.clip, P plays it back in a loop)
+AnimClip g_clip;
+bool g_clipPlaying = false;
+double g_clipPlayStart = 0.0;  // clock time playback started
+const double kBakeSeconds = 60.0;
+std::vector<float> g_clipChannels; // evaluate() output, channel-major
+
+// mission analysis (T): transfer delta-v from the earth to Mars (or the selected body) over
+// departure and arrival dates, drawn in a corner; the arrows pan it while it shows
+Porkchop g_porkchop;
+bool g_porkchopShown = false;
+long long g_porkchopDeparture = 0, g_porkchopArrival = 0; // window, in lattice cells
+const long long kPorkchopPan = 100;                      // cells per arrow press, ten times that with shift
+const double kPorkchopCellsPerPeriod = 200.0;            // of the departure body's orbit
+GLuint g_porkchopTexture = 0;
+int g_porkchopTextureWidth = 0, g_porkchopTextureHeight = 0;
+std::vector<unsigned char> g_porkchopPixels;
+
+// future path of the selected body under gravity, see updatePrediction()
+Predictor g_predictor;
+LineRenderer g_pathLine;
+GLuint g_lineProgram = 0;
+int g_predictedBody = -1;          // of the current seed, -1 for none
+bool g_predictedGravity = false;   // mode of the current seed
+uint64_t g_predictionSeed = 0;
+uint64_t g_predictionReported = 0; // seed whose complete path was reported
+NBody g_predictionStates;          // scripted mode: the states gravity mode would start from
+std::vector<float> g_pathVertices;
+const double kPredictionDrift = 0.01; // the body this far off its path seeds it again
+const double kManeuverLead = 2.0;     // M: a burn this many seconds ahead
+const double kManeuverDeltaV = 0.1;   // prograde around the parent, retrograde with shift
+
+// --record <file> logs the session, --replay <file> plays one back, --fast without
+// waiting for the recorded clock and --headless without a window; see SessionLog
+SessionLog g_session;
+std::string g_recordPath;
+bool g_replayFast = false;
+bool g_headless = false;
+
+// per job name: runs and seconds, collected when SOLAR_PROFILE_JOBS is set and printed every 5 s
+struct JobStats {
+  size_t count = 0;
+  double seconds = 0.0;
+};
+std::mutex g_jobStatsMutex;
+std::map<std::string, JobStats> g_jobStats;
+
+void profileJob(void *, const char *name, unsigned, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+  std::lock_guard<std::mutex> lock(g_jobStatsMutex);
+  JobStats &stats = g_jobStats[name];
+  ++stats.count;
+  stats.seconds += std::chrono::duration<double>(end - start).count();
+}
 
 // add variables for camera rotation
 float orbitRadius = 10.0f; 
@@ -101,11 +205,14 @@ public:
   inline void setNear(const float n) { m_near = n; }
   inline float getFar() const { return m_far; }
   inline void setFar(const float n) { m_far = n; }
-  inline void setPosition(const glm::vec3 &p) { m_pos = p; }
-  inline glm::vec3 getPosition() { return m_pos; }
+  // world position, in double like the bodies
+  inline void setPosition(const glm::dvec3 &p) { m_pos = p; }
+  inline glm::dvec3 getPosition() const { return m_pos; }
 
+  // Rotation only: everything is drawn relative to the camera (BodyTable::updateTransforms),
+  // so the eye sits at the origin, looking at the world origin.
   inline glm::mat4 computeViewMatrix() const {
-    return glm::lookAt(m_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    return glm::lookAt(glm::vec3(0.f), glm::vec3(-m_pos), glm::vec3(0, 1, 0));
   }
 
   // Returns the projection matrix stemming from the camera intrinsic parameter.
@@ -114,7 +221,7 @@ public:
   }
 
 private:
-  glm::vec3 m_pos = glm::vec3(0, 0, 0);
+  glm::dvec3 m_pos = glm::dvec3(0, 0, 0);
   float m_fov = 45.f;        // Field of view, in degrees
   float m_aspectRatio = 1.f; // Ratio between the width and the height of the image
   float m_near = 0.1f; // Distance before which geometry is excluded from the rasterization process
@@ -122,48 +229,296 @@ private:
 };
 Camera g_camera;
 
-GLuint loadTextureFromFileToGPU(const std::string &filename) {
-  // flip the axis or we see the planets upside down
-  stbi_set_flip_vertically_on_load(true);
-  // Loading the image in CPU memory using stb_image
-  int width, height, numComponents;
-
-  unsigned char *data = stbi_load(filename.c_str(), &width, &height, &numComponents, 0);
-  GLuint texID; // OpenGL texture identifier
-  glGenTextures(1, &texID); // generate an OpenGL texture container
-  glBindTexture(GL_TEXTURE_2D, texID); // activate the texture
-  // Setup the texture filtering option and repeat mode; check www.opengl.org for details.
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  // Fill the GPU texture with the data stored in the CPU image
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+// Loads the content of an ASCII file in a standard C++ string
+std::string file2String(const std::string &filename) {
+    std::ifstream t(filename.c_str(), std::ios::binary);
+    if (!t.is_open()) {
+        std::cerr << "ERROR: Could not open file " << filename << std::endl;
+        return "";  // Return an empty string if the file could not be opened
+    }
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+    return buffer.str();
+}
+
+// Returns the bytes of an asset, looked up in order in the development override
+// directory, the arrays compiled into the binary, the mapped pack and finally
+// the loose file next to the executable. Files read from disk go into storage.
+AssetSpan readAsset(const std::string &name, std::string &storage) {
+  // the override directory only holds what is being worked on: anything else falls through quietly
+  if(!g_overrideAssetDir.empty() && std::ifstream((g_overrideAssetDir + name).c_str()).good()) {
+    storage = file2String(g_overrideAssetDir + name);
+    if(!storage.empty())
+      return AssetSpan(reinterpret_cast<const unsigned char *>(storage.data()), storage.size());
+  }
+  const AssetSpan embedded = EmbeddedAssets::find(name);
+  if(!embedded.empty())
+    return embedded;
+  const AssetSpan packed = g_assets.find(name);
+  if(!packed.empty())
+    return packed;
+  storage = file2String(g_assetDir + name);
+  return AssetSpan(reinterpret_cast<const unsigned char *>(storage.data()), storage.size());
+}
+
+// True if readAsset would find the asset, without reading it
+bool assetExists(const std::string &name) {
+  if(!g_overrideAssetDir.empty() && std::ifstream((g_overrideAssetDir + name).c_str()).good())
+    return true;
+  if(!EmbeddedAssets::find(name).empty() || !g_assets.find(name).empty())
+    return true;
+  return std::ifstream((g_assetDir + name).c_str()).good();
+}
+
+// Names of an image sequence following a printf pattern with the frame number, e.g. "media/sun/%03d.jpg"
+std::vector<std::string> findImageSequence(const std::string &pattern) {
+  std::vector<std::string> frames;
+  char name[256];
+  for(int i = 0; ; ++i) {
+    std::snprintf(name, sizeof(name), pattern.c_str(), i);
+    if(!assetExists(name))
+      break;
+    frames.push_back(name);
+  }
+  return frames;
+}
+
+// Loads an image asset as tightly packed RGBA8 rows, first row at the top of the image.
+// A missing or broken image is replaced by the embedded checkerboard so it stands out.
+bool loadImageRGBA(const std::string &filename, std::vector<unsigned char> &rgba, int &width, int &height) {
+  std::string storage;
+  AssetSpan file = readAsset(filename, storage);
+  if(file.empty() || !stbi_info_from_memory(file.data, (int)file.size, &width, &height, nullptr)) {
+    std::cerr << "WARNING: using the default texture for " << filename << std::endl;
+    file = EmbeddedAssets::find("media/missing.png");
+  }
+
+  int numComponents;
+  unsigned char *data = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &numComponents, 0);
+  if(data && numComponents != 3 && numComponents != 4) {
+    // grey or grey+alpha images are rare, let stb_image expand them
+    stbi_image_free(data);
+    data = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &numComponents, 4);
+    numComponents = 4;
+  }
+  if(!data) {
+    std::cerr << "ERROR: Could not load texture " << filename << ": " << stbi_failure_reason() << std::endl;
+    return false;
+  }
+
+  // RGBA keeps every row 4-byte aligned for the upload; expand RGB with the SIMD kernel
+  rgba.resize(size_t(width) * height * 4);
+  if(numComponents == 3)
+    ImageKernels::rgbToRgba(data, rgba.data(), size_t(width) * height);
+  else
+    std::copy(data, data + rgba.size(), rgba.begin());
   // Free useless CPU memory
   stbi_image_free(data);
-  glBindTexture(GL_TEXTURE_2D, 0); // unbind the texture
-  
+  return true;
+}
+
+// A body texture resampled into cubemap faces with their mip chains, ready for the GPU
+struct CubemapImage {
+  int faceSize = 0;
+  std::vector<unsigned char> faces;
+  std::vector<ImageKernels::MipLevel> mips[6];
+};
+
+// Decodes an equirectangular body texture and resamples it into a cubemap sampled by direction.
+// CPU only, so the textures are decoded as jobs in parallel.
+bool decodeCubemap(const std::string &filename, CubemapImage &image) {
+  int width, height;
+  std::vector<unsigned char> rgba;
+  if(!loadImageRGBA(filename, rgba, width, height))
+    return false;
+
+  // no flip here: cubemap faces are addressed top row first
+  image.faceSize = Cubemap::faceSizeForEquirect(width);
+  image.faces = Cubemap::fromEquirect(rgba.data(), width, height, image.faceSize);
+  const size_t faceBytes = size_t(image.faceSize) * image.faceSize * 4;
+  for(int face = 0; face < 6; ++face)
+    image.mips[face] = ImageKernels::buildMipChain(image.faces.data() + face * faceBytes, image.faceSize, image.faceSize, ImageKernels::MipFilter::Kaiser);
+  return true;
+}
+
+GLuint uploadCubemapToGPU(const CubemapImage &image) {
+  const int faceSize = image.faceSize;
+  const size_t faceBytes = size_t(faceSize) * faceSize * 4;
+
+  GLuint texID;
+  glGenTextures(1, &texID);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texID);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)image.mips[0].size());
+  for(int face = 0; face < 6; ++face) {
+    const std::vector<ImageKernels::MipLevel> &mips = image.mips[face];
+    const GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+    glTexImage2D(target, 0, GL_RGBA8, faceSize, faceSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.faces.data() + face * faceBytes);
+    for(size_t i = 0; i < mips.size(); ++i)
+      glTexImage2D(target, (GLint)(i + 1), GL_RGBA8, mips[i].width, mips[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mips[i].pixels.data());
+  }
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
   return texID;
 }
 
+void seek(double t);
+void bakeClip();
+void toggleClip();
+void togglePorkchop();
+void panPorkchop(int key, int mods);
+void planManeuver(int mods);
+
+void resizeWindow(int width, int height) {
+  if(width <= 0 || height <= 0)
+    return; // minimized
+  g_windowWidth = width;
+  g_windowHeight = height;
+  g_camera.setAspectRatio(static_cast<float>(width)/static_cast<float>(height));
+}
+
 // Executed each time the window is resized. Adjust the aspect ratio and the rendering viewport to the current window.
 void windowSizeCallback(GLFWwindow* window, int width, int height) {
-  g_camera.setAspectRatio(static_cast<float>(width)/static_cast<float>(height));
   glViewport(0, 0, (GLint)width, (GLint)height); // Dimension of the rendering region in the window
+  if(g_session.replaying())
+    return; // the camera keeps the recorded size
+  if(g_session.recording())
+    g_session.resize(width, height);
+  resizeWindow(width, height);
 }
 
-void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+// Takes in the refreshed picking tree, waiting for it when asked to
+void swapPicking(const bool wait) {
+  if(!g_pickingPending)
+    return;
+  if(!g_pickingJob.done()) {
+    if(!wait)
+      return;
+    JobSystem::get().wait(g_pickingJob);
+  }
+  g_pickingFront = 1 - g_pickingFront;
+  g_pickingPending = false;
+}
+
+// Keeps the picking BVH fresh outside the clicks, once per update: the back tree is refit
+// (built again for a new set of bodies or once refits have spoiled it) on a job, from a
+// copy of the spheres, and becomes the front at the first update that finds it done. A
+// session waits for it instead, so a replay picks from the same tree as the recording;
+// so does a single thread, where nothing else would run the job.
+void refreshPicking(const bool moved) {
+  g_bodyBvhStale = g_bodyBvhStale || moved;
+  const bool session = g_session.recording() || g_session.replaying();
+  swapPicking(session || JobSystem::get().threadCount() == 1);
+  if(g_pickingPending || !g_bodyBvhStale)
+    return;
+  g_bodyBvhStale = false;
+  const size_t n = g_bodies.size();
+  g_pickingX.assign(g_bodies.relX.begin(), g_bodies.relX.begin() + n);
+  g_pickingY.assign(g_bodies.relY.begin(), g_bodies.relY.begin() + n);
+  g_pickingZ.assign(g_bodies.relZ.begin(), g_bodies.relZ.begin() + n);
+  g_pickingRadius.assign(g_bodies.radius.begin(), g_bodies.radius.begin() + n);
+  PickingTree &back = g_picking[1 - g_pickingFront];
+  back.origin = g_bodies.transformOrigin();
+  g_pickingPending = true;
+  JobSystem::get().submit("picking.refresh", [&back]() {
+    const size_t n = g_pickingX.size();
+    const float *x = g_pickingX.data(), *y = g_pickingY.data(), *z = g_pickingZ.data(), *r = g_pickingRadius.data();
+    if(back.bvh.size() == n && back.bvh.refit(x, y, z, r))
+      return;
+    back.bvh.build(x, y, z, r, n);
+  }, g_pickingJob);
+}
+
+// Selects the body under the cursor, or none when it points at empty space
+void pickBody(const double cursorX, const double cursorY) {
+  // only before the first refresh was taken in
+  if(g_picking[g_pickingFront].bvh.size() != g_bodies.size())
+    swapPicking(true);
+  const PickingTree &tree = g_picking[g_pickingFront];
+  const int width = g_windowWidth, height = g_windowHeight;
+
+  // unproject the cursor at the near and far planes; the view matrix is camera-relative
+  const glm::vec2 ndc(float(2.0 * cursorX / width - 1.0), float(1.0 - 2.0 * cursorY / height));
+  const glm::mat4 inverseViewProj = glm::inverse(g_camera.computeProjectionMatrix() * g_camera.computeViewMatrix());
+  glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, -1.f, 1.f);
+  glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 1.f, 1.f);
+  nearPoint /= nearPoint.w;
+  farPoint /= farPoint.w;
+
+  // and the BVH is relative to where the camera was when it was last refit
+  const glm::vec3 origin = glm::vec3(nearPoint) + glm::vec3(g_camera.getPosition() - tree.origin);
+  const glm::vec3 direction = glm::normalize(glm::vec3(farPoint - nearPoint));
+  float distance = 0.f;
+  const int body = tree.bvh.intersect(origin, direction, &distance);
+  g_scene.forEachChunkSerial<Selected>([](size_t count, const Entity *entities, Selected *) {
+    for(size_t k = 0; k < count; ++k)
+      g_sceneCommands.remove<Selected>(entities[k]);
+  });
+  if(body >= 0 && size_t(body) < g_bodyEntities.size()) {
+    g_sceneCommands.add(g_bodyEntities[body], Selected());
+    std::cout << "Selected " << g_bodies.name[body] << " at distance " << distance << std::endl;
+  }
+}
+
+void handleClick(int button, int action, int mods, double x, double y) {
+  if(button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    pickBody(x, y);
+}
+
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+  if(g_session.replaying())
+    return;
+  double x = 0.0, y = 0.0;
+  glfwGetCursorPos(window, &x, &y);
+  if(g_session.recording())
+    g_session.click(button, action, mods, x, y);
+  handleClick(button, action, mods, x, y);
+}
+
+// Keys, from the window or from a replayed session
+void handleKey(int key, int scancode, int action, int mods) {
     static float orbitAngle = 0.1f;    // Horizontal angle of orbit
     static float orbitRadius = 25.0f;  // Default orbit distance (must match initial position)
     static const float angleIncrement = 0.05f;  // Speed of orbit rotation in radians
     static const float radiusIncrement = 0.1f;  // Speed of zooming in/out
 
+    const bool arrow = key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT || key == GLFW_KEY_UP || key == GLFW_KEY_DOWN;
+    if (g_porkchopShown && arrow && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        panPorkchop(key, mods);
+        return;
+    }
+
     if (action == GLFW_PRESS && key == GLFW_KEY_W) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        if (g_window)
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     } else if (action == GLFW_PRESS && key == GLFW_KEY_F) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        if (g_window)
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_G) {
+        g_simulation.setGravity(!g_simulation.gravity());
+        std::cout << "Gravity simulation " << (g_simulation.gravity() ? "on" : "off") << std::endl;
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_C) {
+        g_simulation.setCollisions(!g_simulation.collisions());
+        std::cout << "Collisions " << (g_simulation.collisions() ? "on" : "off") << std::endl;
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_B) {
+        bakeClip();
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_P) {
+        toggleClip();
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_T) {
+        togglePorkchop();
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_M) {
+        planManeuver(mods);
+    } else if (action == GLFW_PRESS && (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET)) {
+        const double jump = (mods & GLFW_MOD_SHIFT) ? 10.0 * kSeekJump : kSeekJump;
+        const double now = g_simulation.now() - g_simulation.latest().lag;
+        seek(key == GLFW_KEY_LEFT_BRACKET ? now - jump : now + jump);
     } else if (action == GLFW_PRESS && (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q)) {
-        glfwSetWindowShouldClose(window, true); // Closes the application if the escape key is pressed
+        if (g_window)
+            glfwSetWindowShouldClose(g_window, true); // Closes the application if the escape key is pressed
     }
 
     // Orbit control (LEFT/RIGHT for angle adjustment, UP/DOWN for radius adjustment)
@@ -191,11 +546,23 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         if (cameraUpdated) {
             float camX = orbitRadius * cos(orbitAngle);
             float camZ = orbitRadius * sin(orbitAngle);
-            g_camera.setPosition(glm::vec3(camX, g_camera.getPosition().y, camZ));
+            g_camera.setPosition(glm::dvec3(camX, g_camera.getPosition().y, camZ));
         }
     }
 }
 
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (g_session.replaying()) {
+        // only quitting, the rest comes from the log
+        if (action == GLFW_PRESS && (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q))
+            glfwSetWindowShouldClose(window, true);
+        return;
+    }
+    if (g_session.recording())
+        g_session.key(key, scancode, action, mods);
+    handleKey(key, scancode, action, mods);
+}
+
 void errorCallback(int error, const char *desc) {
   std::cout <<  "Error " << error << ": " << desc << std::endl;
 }
@@ -231,6 +598,7 @@ void initGLFW() {
   glfwMakeContextCurrent(g_window);
   glfwSetWindowSizeCallback(g_window, windowSizeCallback);
   glfwSetKeyCallback(g_window, keyCallback);
+  glfwSetMouseButtonCallback(g_window, mouseButtonCallback);
 }
 
 void initOpenGL() {
@@ -246,33 +614,25 @@ void initOpenGL() {
   glDepthFunc(GL_LESS);   // Specify the depth test for the z-buffer
   glEnable(GL_DEPTH_TEST);      // Enable the z-buffer test in the rasterization
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // specify the background color, used any time the framebuffer is cleared
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // filter across cubemap face edges
 }
 
-// Loads the content of an ASCII file in a standard C++ string
-std::string file2String(const std::string &filename) {
-    std::ifstream t(filename.c_str());
-    if (!t.is_open()) {
-        std::cerr << "ERROR: Could not open file " << filename << std::endl;
-        return "";  // Return an empty string if the file could not be opened
-    }
-    std::stringstream buffer;
-    buffer << t.rdbuf();
-    return buffer.str();
-}
-
-// Loads and compile a shader, before attaching it to a program
-void loadShader(GLuint program, GLenum type, const std::string &shaderFilename) {
-    GLuint shader = glCreateShader(type); // Create the shader
-    std::string shaderSourceString = file2String(shaderFilename); // Load shader source
+// Loads and compile a shader, before attaching it to a program. Returns false on failure.
+bool loadShader(GLuint program, GLenum type, const std::string &shaderFilename) {
+    std::string storage;
+    const AssetSpan source = readAsset(shaderFilename, storage); // Load shader source, embedded in the binary by default
     
-    if (shaderSourceString.empty()) {
+    if (source.empty()) {
         std::cerr << "ERROR: Shader source for " << shaderFilename << " is empty." << std::endl;
-        return; // Return early if shader source is empty
+        return false; // Return early if shader source is empty
     }
 
-    const GLchar *shaderSource = (const GLchar *)shaderSourceString.c_str(); // C pointer to the source
+    GLuint shader = glCreateShader(type); // Create the shader
 
-    glShaderSource(shader, 1, &shaderSource, NULL); // Load the shader code
+    const GLchar *shaderSource = (const GLchar *)source.data; // C pointer to the source, not null-terminated
+    const GLint shaderLength = (GLint)source.size;
+
+    glShaderSource(shader, 1, &shaderSource, &shaderLength); // Load the shader code
     glCompileShader(shader);
     
     // Check if shader compilation was successful
@@ -282,33 +642,75 @@ void loadShader(GLuint program, GLenum type, const std::string &shaderFilename)
     if (!success) {
         glGetShaderInfoLog(shader, 512, NULL, infoLog);
         std::cerr << "ERROR in compiling " << shaderFilename << "\n\t" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return false;
     }
 
     glAttachShader(program, shader);
     glDeleteShader(shader);
+    return true;
 }
 
 
-void initGPUprogram() {
-  g_program = glCreateProgram(); // Create a GPU program, i.e., two central shaders of the graphics pipeline
-  loadShader(g_program, GL_VERTEX_SHADER, "vertexShader.glsl");
-  loadShader(g_program, GL_FRAGMENT_SHADER, "fragmentShader.glsl");
-  glLinkProgram(g_program); // The main GPU program is ready to be handle streams of polygons
+// Compiles and links a GPU program, exits when it doesn't
+GLuint buildProgram(const std::string &vertexShader, const std::string &fragmentShader) {
+  const GLuint program = glCreateProgram(); // Create a GPU program, i.e., two central shaders of the graphics pipeline
+  if(!loadShader(program, GL_VERTEX_SHADER, vertexShader) ||
+     !loadShader(program, GL_FRAGMENT_SHADER, fragmentShader)) {
+    glfwTerminate();
+    std::exit(EXIT_FAILURE);
+  }
+  glLinkProgram(program); // The GPU program is ready to be handle streams of polygons
 
   // add this code to verify the correct binding
   GLint success;
   GLchar infoLog[512];
-  glGetProgramiv(g_program, GL_LINK_STATUS, &success);
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if(!success) {
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    std::cerr << "ERROR in linking the GPU program " << vertexShader << " + " << fragmentShader << "\n\t" << infoLog << std::endl;
+    glfwTerminate();
+    std::exit(EXIT_FAILURE);
+  }
+  return program;
+}
+
+void initGPUprogram() {
+  g_overlayProgram = buildProgram("overlayVertex.glsl", "overlayFragment.glsl");
+  glGenVertexArrays(1, &g_overlayVao);
 
+  g_lineProgram = buildProgram("lineVertex.glsl", "lineFragment.glsl");
+  g_pathLine.init(g_lineProgram);
+
+  g_program = buildProgram("vertexShader.glsl", "fragmentShader.glsl");
   glUseProgram(g_program);
 
   // TODO: set shader variables, textures, etc.
-  g_earthTexID = loadTextureFromFileToGPU("media/earth.jpg");
-  g_moonTexID = loadTextureFromFileToGPU("media/moon.jpg");
-  // add mars and venus textures
-  g_marsTexID = loadTextureFromFileToGPU("media/mars.jpg");
-  g_venusTexID = loadTextureFromFileToGPU("media/venus.jpg");
-  glUniform1i(glGetUniformLocation(g_program, "material.albedoTex"), 0);
+  // body textures are equirectangular on disk and sampled as cubemaps on the GPU
+  // decoded as jobs, uploaded here: the GL context belongs to this thread
+  const size_t materialCount = g_bodies.materials.size();
+  std::vector<CubemapImage> images(materialCount);
+  std::vector<char> decoded(materialCount, 0);
+  JobSystem::Counter decoding;
+  for(size_t i = 0; i < materialCount; ++i) {
+    if(!g_bodies.materials[i].texture.empty())
+      JobSystem::get().submit("decodeCubemap", [i, &images, &decoded]() {
+        decoded[i] = decodeCubemap(g_bodies.materials[i].texture, images[i]);
+      }, decoding);
+  }
+  JobSystem::get().wait(decoding);
+  g_materialTexIDs.assign(materialCount, 0);
+  for(size_t i = 0; i < materialCount; ++i) {
+    if(decoded[i])
+      g_materialTexIDs[i] = uploadCubemapToGPU(images[i]);
+  }
+  glUniform1i(glGetUniformLocation(g_program, "material.albedoCube"), 0);
+
+  // streamed on a worker thread; without frames the Sun keeps its flat color
+  const std::vector<std::string> sunFrames = findImageSequence("media/sun/%03d.jpg");
+  if(!sunFrames.empty())
+    g_sunSurface.init(sunFrames, 12.f, loadImageRGBA);
+  glUniform1i(glGetUniformLocation(g_program, "material.surfaceTex"), 1);
 }
 
 // Define your mesh(es) in the CPU memory
@@ -390,55 +792,346 @@ void initGPUgeometry() {
 }
 
 void initCamera() {
-  int width, height;
-  glfwGetWindowSize(g_window, &width, &height);
-  g_camera.setAspectRatio(static_cast<float>(width)/static_cast<float>(height));
+  int width = g_windowWidth, height = g_windowHeight;
+  if(g_session.replaying()) {
+    width = g_session.start().width;
+    height = g_session.start().height;
+  } else if(g_window) {
+    glfwGetWindowSize(g_window, &width, &height);
+  }
+  resizeWindow(width, height);
 
   // we adjust the position of the camera so that it's further from the elements (before it was very close to the sun which had size 1)
-  g_camera.setPosition(glm::vec3(0.0, 0.0, 25.0));
+  g_camera.setPosition(glm::dvec3(0.0, 0.0, 25.0));
   g_camera.setNear(0.1);
   g_camera.setFar(80.1); 
 }
 
-void init() {
-  initGLFW();
-  initOpenGL();
+// Maps the asset pack built next to the executable, falling back to loose files
+void initAssets(int argc, char **argv) {
+  g_assetDir = AssetPack::executableDirectory(argc > 0 ? argv[0] : nullptr);
+
+  // development override: edit shaders or textures on disk without rebuilding
+  const char *overrideDir = std::getenv("SOLAR_ASSET_DIR");
+  for(int i = 1; i + 1 < argc; ++i) {
+    if(std::string(argv[i]) == "--assets")
+      overrideDir = argv[i + 1];
+  }
+  if(overrideDir && *overrideDir) {
+    g_overrideAssetDir = overrideDir;
+    const char last = g_overrideAssetDir[g_overrideAssetDir.size() - 1];
+    if(last != '/' && last != '\\')
+      g_overrideAssetDir += '/';
+    std::cout << "Loading assets from " << g_overrideAssetDir << " first" << std::endl;
+  }
+
+  if(!g_assets.open(g_assetDir + "assets.pack"))
+    std::cerr << "WARNING: no asset pack in " << (g_assetDir.empty() ? "." : g_assetDir) << ", loading loose files" << std::endl;
+}
+
+// Loads the body table, the one of the log in a replay; the scene is data, not code
+void initBodies(std::string &loaded) {
+  std::string storage, error;
+  AssetSpan text = readAsset("bodies.txt", storage);
+  if(g_session.replaying())
+    text = AssetSpan(reinterpret_cast<const unsigned char *>(g_session.start().bodies.data()), g_session.start().bodies.size());
+  loaded.assign(reinterpret_cast<const char *>(text.data), text.size);
+  if(text.empty() || !g_bodies.loadFromText(reinterpret_cast<const char *>(text.data), text.size, error)) {
+    std::cerr << "ERROR: Could not load bodies.txt " << error << std::endl;
+    glfwTerminate();
+    std::exit(EXIT_FAILURE);
+  }
 
-  /* uncomment for triangle
-  initCPUgeometry();
-  initGPUgeometry();*/
+  const bool ephemeris = !g_session.replaying() || g_session.start().ephemeris;
+  if(ephemeris && g_ephemeris.open(g_assetDir + "ephemeris.bin")) {
+    // the scene runs a year in 2 pi / n(earth) seconds
+    const int earth = g_bodies.find("earth");
+    const double daysPerSecond = earth >= 0 && g_bodies.meanMotion[earth] > 0.0 ? 365.25 * g_bodies.meanMotion[earth] / (2.0 * M_PI) : 1.0;
+    const size_t count = g_bodies.useEphemeris(&g_ephemeris, kEphemerisEpoch, daysPerSecond);
+    std::cout << "Ephemeris: " << count << " of " << g_bodies.size() << " bodies" << std::endl;
+  } else if(g_session.replaying() && g_session.start().ephemeris) {
+    std::cerr << "WARNING: the session was recorded with ephemeris.bin, the replay will differ" << std::endl;
+  }
+}
 
-  sphereMesh = Mesh::genSphere(32);  
+// Reads --record, --replay, --fast and --headless
+void initSession(int argc, char **argv) {
+  std::string replayPath;
+  for(int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if(arg == "--record" && i + 1 < argc)
+      g_recordPath = argv[++i];
+    else if(arg == "--replay" && i + 1 < argc)
+      replayPath = argv[++i];
+    else if(arg == "--fast")
+      g_replayFast = true;
+    else if(arg == "--headless")
+      g_headless = true;
+  }
+  if(!replayPath.empty()) {
+    if(!g_session.open(replayPath))
+      std::exit(EXIT_FAILURE);
+    g_recordPath.clear();
+    std::cout << "Replaying " << replayPath << (g_replayFast ? " as fast as possible" : " in real time")
+              << (g_headless ? ", headless" : "") << std::endl;
+  } else if(g_headless) {
+    std::cerr << "WARNING: --headless only applies to --replay" << std::endl;
+    g_headless = false;
+  }
+}
+
+// Starts the simulation on its own thread, or driven by the frames when recording or replaying a session.
+// A session plays back the scene.clip it started with (kept in the log), whatever is on disk later.
+void initSimulation(const std::string &bodiesText) {
+  if(g_session.replaying()) {
+    const std::string &clip = g_session.start().clip;
+    if(!clip.empty())
+      g_clip.openFromMemory(clip.data(), clip.size(), "the session's scene.clip");
+    g_simulation.startDriven(g_bodies, g_session.start().time, g_session.start().step);
+    return;
+  }
+  const double time = glfwGetTime();
+  if(!g_recordPath.empty()) {
+    SessionLog::Start start;
+    start.time = time;
+    start.width = g_windowWidth;
+    start.height = g_windowHeight;
+    start.ephemeris = g_ephemeris.isOpen();
+    start.bodies = bodiesText;
+    MappedFile clipFile;
+    if(clipFile.open(g_assetDir + "scene.clip"))
+      start.clip.assign(reinterpret_cast<const char *>(clipFile.data()), clipFile.size());
+    if(g_session.create(g_recordPath, start)) {
+      if(!start.clip.empty())
+        g_clip.openFromMemory(start.clip.data(), start.clip.size(), g_assetDir + "scene.clip");
+      g_simulation.startDriven(g_bodies, time, start.step);
+      std::cout << "Recording the session to " << g_recordPath << std::endl;
+      return;
+    }
+  }
+  g_simulation.start(g_bodies, time);
+}
 
-  sphereMesh->init();
+// One entity per body, drawn with the sphere and its material's texture. Headless, without
+// the Drawable: the selection (and so maneuvers in a replay) still goes through them.
+void initScene() {
+  g_bodyEntities.resize(g_bodies.size());
+  for(size_t i = 0; i < g_bodies.size(); ++i) {
+    const BodyLink link = { uint32_t(i) };
+    if(g_headless) {
+      g_bodyEntities[i] = g_scene.create(link);
+      continue;
+    }
+    const BodyMaterial &material = g_bodies.materials[g_bodies.material[i]];
+    const Drawable drawable = { sphereMesh.get(), g_materialTexIDs[g_bodies.material[i]], material.color, material.emissive ? 1 : 0 };
+    g_bodyEntities[i] = g_scene.create(link, ClipTransform(), drawable);
+  }
+}
 
-  // load and link the shaders
-  initGPUprogram(); 
+void init(int argc, char **argv) {
+  if(std::getenv("SOLAR_PROFILE_JOBS"))
+    JobSystem::get().setProfileHook(profileJob, nullptr);
+  initAssets(argc, argv);
+  initSession(argc, argv);
+  if(!g_headless) {
+    initGLFW();
+    initOpenGL();
+
+    /* uncomment for triangle
+    initCPUgeometry();
+    initGPUgeometry();*/
+
+    // the sphere is pre-built in the pack and uploaded straight from the mapping
+    sphereMesh = std::make_shared<Mesh>();
+    const AssetSpan sphereBlob = g_assets.find("sphere.mesh");
+    if(sphereBlob.empty() || !sphereMesh->initFromBlob(sphereBlob.data, sphereBlob.size)) {
+      sphereMesh = Mesh::genSphere(32);
+      sphereMesh->init();
+    }
+  }
 
+  std::string bodiesText;
+  initBodies(bodiesText);
   initCamera();
+  initSimulation(bodiesText);
+  g_predictor.start(g_bodies, Predictor::Settings());
 
+  if(!g_headless) {
+    // load and link the shaders
+    initGPUprogram(); 
+  }
+  initScene();
+}
+
+// Of the latest simulation state, what a session log checks a replay against
+uint64_t simulationChecksum() {
+  const SimulationSnapshot &snapshot = g_simulation.latest();
+  return SessionLog::checksum(snapshot.x, snapshot.y, snapshot.z);
 }
 
 void clear() {
+  if(g_session.recording()) {
+    const uint64_t frames = g_session.frames();
+    g_session.close(simulationChecksum());
+    std::cout << "Recorded " << frames << " frames in " << g_session.byteSize() << " bytes to " << g_recordPath << std::endl;
+  }
+  JobSystem::get().wait(g_pickingJob);
+  g_simulation.stop();
+  g_porkchop.stop();
+  g_predictor.stop();
+  if(!g_window)
+    return;
+  g_sunSurface.destroy();
+  g_pathLine.destroy();
+  glDeleteProgram(g_lineProgram);
+  glDeleteTextures(1, &g_porkchopTexture);
+  glDeleteVertexArrays(1, &g_overlayVao);
+  glDeleteProgram(g_overlayProgram);
   glDeleteProgram(g_program);
 
   glfwDestroyWindow(g_window);
   glfwTerminate();
 }
 
+// Colors a porkchop window: delta-v on a log scale from the best cell to kRange times it,
+// blue to red with a darker contour every twelfth of the way; no transfer is dimmed
+void colorPorkchop(const Porkchop::Image &image, std::vector<unsigned char> &rgba) {
+  const float kRange = 8.f, kBands = 12.f;
+  const float lo = image.minDeltaV > 0.f ? image.minDeltaV : 1e-6f, scale = 1.f / std::log(kRange);
+  rgba.resize(size_t(image.width) * image.height * 4);
+  Parallel::parallelFor(0, size_t(image.height), [&](size_t y) {
+    for(size_t x = 0; x < size_t(image.width); ++x) {
+      const float v = image.deltaV[y * image.width + x];
+      unsigned char *out = &rgba[(y * image.width + x) * 4];
+      if(!std::isfinite(v)) {
+        out[0] = out[1] = out[2] = 0;
+        out[3] = 140;
+        continue;
+      }
+      const float u = glm::clamp(std::log(std::max(v, lo) / lo) * scale, 0.f, 1.f);
+      // blue, cyan, green, yellow, red
+      glm::vec3 color = glm::clamp(glm::vec3(2.f * u - 0.5f, 1.5f - std::fabs(4.f * u - 2.f), 1.5f - 2.5f * u), 0.f, 1.f);
+      const float band = u * kBands;
+      if(u < 1.f && band - std::floor(band) < 0.08f)
+        color *= 0.45f;
+      out[0] = (unsigned char)(color.r * 255.f);
+      out[1] = (unsigned char)(color.g * 255.f);
+      out[2] = (unsigned char)(color.b * 255.f);
+      out[3] = 230;
+    }
+  }, "porkchop.colors", 16);
+}
+
+// Picks up a newer porkchop and draws the overlay in the lower left corner
+void renderPorkchop() {
+  if(!g_porkchopShown)
+    return;
+  if(g_porkchop.acquire()) {
+    const Porkchop::Image &image = g_porkchop.latest();
+    const Porkchop::Settings &settings = g_porkchop.settings();
+    std::cout << "Porkchop " << g_bodies.name[settings.from] << " -> " << g_bodies.name[settings.to] << ": "
+              << image.width << "x" << image.height << " dates, " << image.tilesSolved << " tiles solved and "
+              << image.tilesCached << " cached in " << image.seconds << " s; best delta-v " << image.minDeltaV
+              << " leaving at t = " << g_porkchop.date(image.bestDeparture) << " s, arriving at t = "
+              << g_porkchop.date(image.bestArrival) << " s" << std::endl;
+    colorPorkchop(image, g_porkchopPixels);
+    if(!g_porkchopTexture) {
+      glGenTextures(1, &g_porkchopTexture);
+      glBindTexture(GL_TEXTURE_2D, g_porkchopTexture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, g_porkchopTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(image.width != g_porkchopTextureWidth || image.height != g_porkchopTextureHeight) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, g_porkchopPixels.data());
+      g_porkchopTextureWidth = image.width;
+      g_porkchopTextureHeight = image.height;
+    } else {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, g_porkchopPixels.data());
+    }
+  }
+  if(!g_porkchopTexture)
+    return; // the first window isn't solved yet
+
+  // a square of 60% of the window height, 16 pixels from the corner
+  const float side = 0.6f * float(g_windowHeight), margin = 16.f;
+  const float x0 = -1.f + 2.f * margin / float(g_windowWidth), y0 = -1.f + 2.f * margin / float(g_windowHeight);
+  const float x1 = x0 + 2.f * side / float(g_windowWidth), y1 = y0 + 2.f * side / float(g_windowHeight);
+  glUseProgram(g_overlayProgram);
+  glUniform4f(glGetUniformLocation(g_overlayProgram, "rect"), x0, y0, x1, y1);
+  glUniform1i(glGetUniformLocation(g_overlayProgram, "image"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g_porkchopTexture);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBindVertexArray(g_overlayVao);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+  glEnable(GL_DEPTH_TEST);
+  glUseProgram(g_program);
+}
+
+// Draws the predicted path of the selected body, fading out towards its end
+void renderPrediction(const glm::mat4 &viewProj) {
+  const Predictor::Path &path = g_predictor.latest();
+  if(g_predictedBody < 0 || path.seed != g_predictionSeed || path.points.size() < 2)
+    return;
+  const glm::dvec3 camera = g_camera.getPosition();
+  const double t0 = path.points.front().t, span = g_predictor.settings().horizon;
+  g_pathVertices.resize(path.points.size() * 4);
+  for(size_t k = 0; k < path.points.size(); ++k) {
+    const Predictor::Point &point = path.points[k];
+    float *v = &g_pathVertices[k * 4];
+    v[0] = float(point.x - camera.x);
+    v[1] = float(point.y - camera.y);
+    v[2] = float(point.z - camera.z);
+    v[3] = float((point.t - t0) / span);
+  }
+  g_pathLine.update(g_pathVertices.data(), path.points.size());
+  g_pathLine.render(viewProj, glm::vec3(0.3f, 0.9f, 1.0f));
+  glUseProgram(g_program);
+}
+
 // The main rendering call
 void render() {
+    // bounded per-frame tile upload, never a full glTexImage2D
+    g_sunSurface.update(static_cast<float>(glfwGetTime()));
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     const glm::mat4 viewMatrix = g_camera.computeViewMatrix();
     const glm::mat4 projMatrix = g_camera.computeProjectionMatrix();
-    const glm::vec3 camPosition = g_camera.getPosition();
 
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "viewMat"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "projMat"), 1, GL_FALSE, glm::value_ptr(projMatrix));
-
-    // we define light and camera position (sun is the source and it's in the origin)
-    glm::vec3 lightPos = glm::vec3(0.0f);
+    // a batch per chunk instead of projMat * viewMat * model in every vertex
+    const glm::mat4 viewProjMatrix = projMatrix * viewMatrix;
+    // straight from the camera-relative model transforms of the body table (BodyTable::updateTransforms),
+    // a run of consecutive bodies at a time: a chunk holds them in order but for the ones that changed archetype
+    g_scene.forEachChunk<BodyLink, ClipTransform>(
+        [&](size_t count, const Entity *, const BodyLink *link, ClipTransform *clip) {
+      for(size_t k = 0; k < count;) {
+        size_t run = 1;
+        while(k + run < count && link[k + run].body == link[k].body + run)
+          ++run;
+        MathKernels::multiplyAffine(viewProjMatrix, &g_bodies.model[link[k].body], run, &clip[k].matrix);
+        k += run;
+      }
+    }, "scene.transforms");
+
+    // lighting happens relative to the camera too: the eye is at the origin and the
+    // light at the first emissive body (the sun), or at the world origin without one
+    glm::vec3 lightPos = glm::vec3(-g_camera.getPosition());
+    for(size_t i = 0; i < g_bodies.size(); ++i) {
+      if(g_bodies.materials[g_bodies.material[i]].emissive) {
+        lightPos = glm::vec3(g_bodies.relX[i], g_bodies.relY[i], g_bodies.relZ[i]);
+        break;
+      }
+    }
+    const glm::vec3 camPosition = glm::vec3(0.0f);
     glUniform3fv(glGetUniformLocation(g_program, "lightPos"), 1, glm::value_ptr(lightPos));
     glUniform3fv(glGetUniformLocation(g_program, "viewPos"), 1, glm::value_ptr(camPosition));
 
@@ -447,103 +1140,368 @@ void render() {
 
     glUniform1f(glGetUniformLocation(g_program, "shininess"), 32.0f);
 
-    // --- Sun ---
-    modelMatrixSun = glm::scale(modelMatrixSun, glm::vec3(kSizeSun));
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrixSun));
-    glUniform3f(glGetUniformLocation(g_program, "objectColor"), 1.0f, 1.0f, 0.0f);
     glUniform3f(glGetUniformLocation(g_program, "lightColor"), 1.0f, 1.0f, 1.0f); 
+    glUniform1i(glGetUniformLocation(g_program, "hasSurfaceTex"), g_sunSurface.isValid() ? 1 : 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, g_sunSurface.texture());
 
-    // isSun is true
-    glUniform1i(glGetUniformLocation(g_program, "isSun"), 1);
-    sphereMesh->render();
-
-    // --- Earth ---
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrixEarth));
-    glUniform3f(glGetUniformLocation(g_program, "objectColor"), 0.0f, 1.0f, 0.0f);  
-    glUniform1i(glGetUniformLocation(g_program, "isSun"), 0); 
-
-    // we also need to activate texture
+    // one draw per entity, with the camera-relative transforms computed by update()
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, g_earthTexID);
-
-    sphereMesh->render();
+    g_scene.forEachChunkSerial<BodyLink, ClipTransform, Drawable>(
+        [](size_t count, const Entity *entities, const BodyLink *link, const ClipTransform *clip, const Drawable *drawable) {
+      for(size_t k = 0; k < count; ++k) {
+        glUniformMatrix4x3fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(g_bodies.model[link[k].body]));
+        glUniformMatrix4fv(glGetUniformLocation(g_program, "mvp"), 1, GL_FALSE, glm::value_ptr(clip[k].matrix));
+        glUniform3fv(glGetUniformLocation(g_program, "objectColor"), 1, glm::value_ptr(drawable[k].color));
+        // emissive bodies (the Sun) only show their own color or surface
+        glUniform1i(glGetUniformLocation(g_program, "isSun"), drawable[k].emissive);
+        glUniform1i(glGetUniformLocation(g_program, "isSelected"), g_scene.has<Selected>(entities[k]) ? 1 : 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, drawable[k].texture);
+
+        drawable[k].mesh->render();
+      }
+    });
+
+    renderPrediction(viewProjMatrix);
+    renderPorkchop();
+}  
 
-    // --- Moon ---
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrixMoon));
-    glUniform3f(glGetUniformLocation(g_program, "objectColor"), 0.0f, 0.0f, 1.0f);
-    glUniform1i(glGetUniformLocation(g_program, "isSun"), 0); 
+// Jumps the simulation to time t; the bodies wait where they are until it gets there
+void seek(const double t) {
+    std::cout << "Seeking to t = " << t << " s" << std::endl;
+    g_simulation.seek(t);
+}
 
-    glActiveTexture(GL_TEXTURE0); 
-    glBindTexture(GL_TEXTURE_2D, g_moonTexID);
+// Bakes the next kBakeSeconds of the scripted orbits from the current scene time into scene.clip
+void bakeClip() {
+    const double now = g_simulation.now() - g_simulation.latest().lag;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if(!g_clip.bake(g_bodies, now, kBakeSeconds, AnimClip::Settings()))
+        return;
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Baked " << kBakeSeconds << " s in " << ms << " ms: " << g_clip.keyCount() << " keys, "
+              << g_clip.bytesPerBodySecond() << " bytes per body-second, max error " << g_clip.maxPositionError()
+              << " (position) " << g_clip.maxRotationError() << " (rotation)" << std::endl;
+    // a replay bakes the very same clip, the recording saved it already
+    if(!g_session.replaying())
+        g_clip.save(g_assetDir + "scene.clip");
+    g_clipPlaying = false;
+    g_bodies.callerSpins = false;
+}
 
-    sphereMesh->render();
+void toggleClip() {
+    if(g_clipPlaying) {
+        g_clipPlaying = false;
+        g_bodies.callerSpins = false;
+        std::cout << "Clip playback off" << std::endl;
+        return;
+    }
+    // a session only has the clip it started with, or baked
+    const bool session = g_session.recording() || g_session.replaying();
+    if(!g_clip.isOpen() && (session || !g_clip.open(g_assetDir + "scene.clip"))) {
+        if(session)
+            std::cerr << "ERROR: No clip in this session, bake one with B" << std::endl;
+        return;
+    }
+    if(!g_clip.matches(g_bodies)) {
+        std::cerr << "ERROR: scene.clip was baked from other bodies" << std::endl;
+        return;
+    }
+    g_clipPlaying = true;
+    g_clipPlayStart = g_simulation.now();
+    g_clipChannels.resize(AnimClip::kChannels * g_bodies.size());
+    std::cout << "Clip playback on (" << g_clip.duration() << " s from t = " << g_clip.start() << ")" << std::endl;
+}
 
-    // mars and venus
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrixMars));
-    glUniform1i(glGetUniformLocation(g_program, "isSun"), 0); 
-    glActiveTexture(GL_TEXTURE0); 
-    glBindTexture(GL_TEXTURE_2D, g_marsTexID);
+// Keeps the prediction on the selected body: seeded again when the selection or the
+// mode changed, after a seek back or when the body left the path; told the time otherwise
+void updatePrediction(const SimulationSnapshot &snapshot) {
+    int body = -1;
+    g_scene.forEachChunkSerial<Selected, BodyLink>([&](size_t count, const Entity *, Selected *, const BodyLink *link) {
+        if(count)
+            body = int(link[0].body);
+    });
+    g_simulation.setVelocities(body >= 0);
+    if(body < 0) {
+        if(g_predictedBody >= 0)
+            g_predictor.clear();
+        g_predictedBody = -1;
+        return;
+    }
 
-    sphereMesh->render();
+    g_predictor.acquire();
+    const Predictor::Path &path = g_predictor.latest();
+    bool reseed = body != g_predictedBody || snapshot.gravity != g_predictedGravity;
+    if(!reseed && path.seed == g_predictionSeed && !path.points.empty()) {
+        double p[3];
+        if(snapshot.time < path.points.front().t)
+            reseed = true;
+        else if(path.at(snapshot.time, p))
+            reseed = glm::length(glm::dvec3(p[0], p[1], p[2]) - glm::dvec3(snapshot.x[body], snapshot.y[body], snapshot.z[body])) > kPredictionDrift;
+        // past the end, the thread is still on its way there
+    }
+    if(!reseed) {
+        g_predictor.setNow(snapshot.time);
+        if(path.complete && path.seed == g_predictionSeed && g_predictionReported != g_predictionSeed) {
+            std::cout << "Predicted " << g_bodies.name[body] << " " << g_predictor.settings().horizon << " s ahead: "
+                      << path.points.size() << " points, " << path.steps << " steps (" << path.rejected << " rejected) in "
+                      << path.seconds * 1e3 << " ms" << std::endl;
+            g_predictionReported = g_predictionSeed;
+        }
+        return;
+    }
 
-    glUniformMatrix4fv(glGetUniformLocation(g_program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrixVenus));
-    glUniform1i(glGetUniformLocation(g_program, "isSun"), 0); 
-    glActiveTexture(GL_TEXTURE0); 
-    glBindTexture(GL_TEXTURE_2D, g_venusTexID);
+    if(snapshot.gravity) {
+        if(snapshot.vx.size() != g_bodies.size())
+            return; // velocities from the next step on
+        g_predictionSeed = g_predictor.seed(body, snapshot.time, snapshot.x, snapshot.y, snapshot.z, snapshot.vx, snapshot.vy, snapshot.vz);
+    } else {
+        // what gravity would do from the orbits as they are now
+        g_predictionStates.reset(g_bodies, snapshot.time);
+        g_predictionSeed = g_predictor.seed(body, snapshot.time, snapshot.x, snapshot.y, snapshot.z, g_predictionStates.velX,
+                                            g_predictionStates.velY, g_predictionStates.velZ);
+    }
+    g_predictedBody = body;
+    g_predictedGravity = snapshot.gravity;
+}
 
-    sphereMesh->render();
-}  
+// A burn kManeuverLead seconds ahead for the predicted body, both in the simulation and its prediction
+void planManeuver(const int mods) {
+    if(g_predictedBody < 0) {
+        std::cerr << "WARNING: select a body to maneuver first" << std::endl;
+        return;
+    }
+    const SimulationSnapshot &snapshot = g_simulation.latest();
+    if(!snapshot.gravity || snapshot.vx.size() != g_bodies.size()) {
+        std::cerr << "WARNING: maneuvers need the gravity simulation (G key)" << std::endl;
+        return;
+    }
+    const int body = g_predictedBody, parent = g_bodies.parent[body];
+    glm::dvec3 v(snapshot.vx[body], snapshot.vy[body], snapshot.vz[body]);
+    if(parent >= 0)
+        v -= glm::dvec3(snapshot.vx[parent], snapshot.vy[parent], snapshot.vz[parent]);
+    if(glm::length(v) == 0.0)
+        return;
+    const bool retrograde = (mods & GLFW_MOD_SHIFT) != 0;
+    const glm::dvec3 dv = glm::normalize(v) * (retrograde ? -kManeuverDeltaV : kManeuverDeltaV);
+    const double direction[3] = { dv.x, dv.y, dv.z };
+    // on a step of the simulation, so both apply it at the same time
+    const double t = snapshot.time + std::round(kManeuverLead / g_simulation.step()) * g_simulation.step();
+    g_simulation.burn(body, t, direction);
+    g_predictor.maneuver(body, t, direction);
+    std::cout << "Maneuver: " << g_bodies.name[body] << " " << (retrograde ? "retrograde" : "prograde") << " by "
+              << kManeuverDeltaV << " at t = " << t << " s" << std::endl;
+}
 
-// Update function to compute the orbital positions and rotations based on time
-void update(const float currentTimeInSec) {
-    // std::cout << currentTimeInSec << std::endl;
+// Shows the porkchop of the earth (departure) and Mars or the selected body (arrival), from the current scene time
+void togglePorkchop() {
+    if(g_porkchopShown) {
+        g_porkchopShown = false;
+        g_porkchop.stop();
+        std::cout << "Mission analysis off" << std::endl;
+        return;
+    }
+    Porkchop::Settings settings;
+    settings.from = g_bodies.find("earth");
+    settings.to = g_bodies.find("mars");
+    g_scene.forEachChunkSerial<Selected, BodyLink>([&](size_t count, const Entity *, Selected *, const BodyLink *link) {
+        if(count && int(link[0].body) != settings.from)
+            settings.to = int(link[0].body);
+    });
+    if(settings.from < 0 || settings.to < 0) {
+        std::cerr << "ERROR: mission analysis needs an earth and a target body" << std::endl;
+        return;
+    }
+    settings.epoch = g_simulation.now() - g_simulation.latest().lag;
+    const double n = g_bodies.meanMotion[settings.from];
+    settings.step = n > 0.0 ? 2.0 * M_PI / n / kPorkchopCellsPerPeriod : 0.1;
+    if(!g_porkchop.start(g_bodies, settings))
+        return;
+    g_porkchopShown = true;
+    g_porkchopDeparture = g_porkchopArrival = 0;
+    std::cout << "Mission analysis " << g_bodies.name[settings.from] << " -> " << g_bodies.name[settings.to]
+              << ", dates every " << settings.step << " s (arrows pan)" << std::endl;
+}
 
-    float earthRotationSpeed = 1.0f;  
-    float earthOrbitSpeed = 0.5f * earthRotationSpeed;  
-    float moonOrbitSpeed = 2.0f * earthRotationSpeed;  
-    float moonRotationSpeed = moonOrbitSpeed; 
+void panPorkchop(const int key, const int mods) {
+    const long long cells = (mods & GLFW_MOD_SHIFT) ? 10 * kPorkchopPan : kPorkchopPan;
+    if(key == GLFW_KEY_LEFT)
+        g_porkchopDeparture -= cells;
+    else if(key == GLFW_KEY_RIGHT)
+        g_porkchopDeparture += cells;
+    else if(key == GLFW_KEY_DOWN)
+        g_porkchopArrival -= cells;
+    else if(key == GLFW_KEY_UP)
+        g_porkchopArrival += cells;
+    g_porkchop.request(g_porkchopDeparture, g_porkchopArrival);
+}
 
-    // mars and Venus orbit speeds relative to Earth's approx
-    float marsOrbitSpeed = 0.32f * earthOrbitSpeed;   // Mars orbits more slowly than Earth (687 days vs. 365)
-    float venusOrbitSpeed = 1.5f * earthOrbitSpeed;   // Venus orbits faster than Earth (225 days vs. 365)
+// Places the bodies from the clip, looping over it; returns the seconds evaluate() took
+double playClip(const double currentTimeInSec) {
+    const size_t n = g_bodies.size();
+    const double t = g_clip.start() + std::fmod(currentTimeInSec - g_clipPlayStart, g_clip.duration());
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    g_clip.evaluate(t, g_clipChannels.data());
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the channels are offsets from the parents already
+    const float *c = g_clipChannels.data();
+    for(size_t i = 0; i < n; ++i) {
+        g_bodies.setOffset(i, glm::dvec3(c[i], c[n + i], c[2 * n + i]));
+        const glm::quat q = glm::normalize(glm::quat(c[6 * n + i], c[3 * n + i], c[4 * n + i], c[5 * n + i]));
+        g_bodies.spinQX[i] = q.x;
+        g_bodies.spinQY[i] = q.y;
+        g_bodies.spinQZ[i] = q.z;
+        g_bodies.spinQW[i] = q.w;
+    }
+    g_bodies.callerSpins = true;
+    const size_t moved = g_bodies.updateTransforms(t, g_camera.getPosition());
+    refreshPicking(moved > 0);
+    return seconds;
+}
 
-    // earth transformations - reset matrix or the transformations could accumulate
-    modelMatrixEarth = glm::mat4(1.0f);
+// Places the bodies for this frame, between the last two states published by the simulation thread
+void update(const double currentTimeInSec) {
+    g_scene.apply(g_sceneCommands);
+
+    if(g_clipPlaying) {
+        static double evaluateSeconds = 0.0, lastClipReport = 0.0;
+        static size_t evaluations = 0;
+        evaluateSeconds += playClip(currentTimeInSec);
+        ++evaluations;
+        if(currentTimeInSec - lastClipReport > 5.0) {
+            std::cout << "Clip: " << evaluateSeconds * 1e9 / double(evaluations) << " ns per evaluate ("
+                      << g_clip.bodyCount() << " bodies)" << std::endl;
+            evaluateSeconds = 0.0;
+            evaluations = 0;
+            lastClipReport = currentTimeInSec;
+        }
+        return;
+    }
 
-    glm::mat4 earthTranslate = glm::translate(glm::mat4(1.0f), glm::vec3(kRadOrbitEarth * cos(0.3f * currentTimeInSec), 0.0f, kRadOrbitEarth * sin(0.3f * currentTimeInSec)));
-    glm::mat4 earthScale = glm::scale(glm::mat4(1.0f), glm::vec3(kSizeEarth));
-    glm::mat4 earthRotate = glm::rotate(glm::mat4(1.0f), 0.6f * currentTimeInSec, glm::vec3(sin(glm::radians(23.5)), cos(glm::radians(23.5)), 0.0f));
-    modelMatrixEarth = earthTranslate * earthScale * earthRotate;
+    const SimulationSnapshot &snapshot = g_simulation.latest();
+    if(snapshot.x.size() != g_bodies.size())
+        return;
+
+    // one step behind the clock, so there is a state on each side to interpolate
+    const double t = currentTimeInSec - snapshot.lag - g_simulation.step();
+    const double span = snapshot.time - snapshot.previousTime;
+    const double alpha = span > 0.0 ? glm::clamp((t - snapshot.previousTime) / span, 0.0, 1.0) : 1.0;
+    // the snapshots hold world positions, the hierarchy wants offsets from the parents
+    const auto at = [&](size_t i) {
+        return glm::dvec3(snapshot.previousX[i] + (snapshot.x[i] - snapshot.previousX[i]) * alpha,
+                          snapshot.previousY[i] + (snapshot.y[i] - snapshot.previousY[i]) * alpha,
+                          snapshot.previousZ[i] + (snapshot.z[i] - snapshot.previousZ[i]) * alpha);
+    };
+    // worked out in parallel, set in order as the setters keep the hierarchy's dirty list
+    g_bodyOffsets.resize(g_bodies.size());
+    Parallel::parallelFor(0, g_bodies.size(), [&](size_t i) {
+        const int p = g_bodies.parent[i];
+        g_bodyOffsets[i] = p < 0 ? at(i) : at(i) - at(size_t(p));
+    }, "bodies.interpolate", 4096);
+    for(size_t i = 0; i < g_bodies.size(); ++i)
+        g_bodies.setOffset(i, g_bodyOffsets[i]);
+    const size_t moved = g_bodies.updateTransforms(snapshot.previousTime + span * alpha, g_camera.getPosition());
+    refreshPicking(moved > 0);
+    updatePrediction(snapshot);
+
+    static double lastReport = 0.0;
+    if(snapshot.gravity && currentTimeInSec - lastReport > 5.0) {
+        std::cout << "N-body (" << simdLevelName(NBody::activeLevel()) << "): "
+                  << snapshot.interactionsPerSecond * 1e-6 << " M interactions/s" << std::endl;
+        if(snapshot.collisions)
+            std::cout << "Collisions: " << snapshot.contacts << " contacts, "
+                      << snapshot.collisionPairsPerSecond * 1e-6 << " M pairs tested/s" << std::endl;
+        lastReport = currentTimeInSec;
+    }
 
-    // moon 
-    modelMatrixMoon = glm::mat4(1.0f); 
-    glm::mat4 moonTranslate = glm::translate(glm::mat4(1.0f), glm::vec3(kRadOrbitMoon * cos(0.6 * currentTimeInSec), 0.0f, kRadOrbitMoon * sin(0.6 * currentTimeInSec)));
-    glm::mat4 moonRotate = glm::rotate(glm::mat4(1.0f), 0.6f * currentTimeInSec, glm::vec3(0, 1, 0.0f));
-    glm::mat4 moonScale = glm::scale(glm::mat4(1.0f), glm::vec3(kSizeMoon));
-    modelMatrixMoon = earthTranslate * moonTranslate * moonRotate * moonScale;
+    static double lastJobReport = 0.0;
+    if(currentTimeInSec - lastJobReport > 5.0) {
+        std::lock_guard<std::mutex> lock(g_jobStatsMutex);
+        for(std::map<std::string, JobStats>::const_iterator it = g_jobStats.begin(); it != g_jobStats.end(); ++it)
+            std::cout << "Jobs " << it->first << ": " << it->second.count << " runs, "
+                      << it->second.seconds * 1e3 << " ms" << std::endl;
+        g_jobStats.clear();
+        lastJobReport = currentTimeInSec;
+    }
+}
 
-    // mars
-    modelMatrixMars = glm::mat4(1.0f);
-    glm::mat4 marsTranslate = glm::translate(glm::mat4(1.0f), glm::vec3(kRadOrbitMars * cos(marsOrbitSpeed * currentTimeInSec), 0.0f, kRadOrbitMars * sin(marsOrbitSpeed * currentTimeInSec)));
-    glm::mat4 marsRotate = glm::rotate(glm::mat4(1.0f), earthRotationSpeed * currentTimeInSec, glm::vec3(0.0f, 1.0f, 0.0f));  // Mars rotating on its axis
-    glm::mat4 marsScale = glm::scale(glm::mat4(1.0f), glm::vec3(kSizeMars));
-    modelMatrixMars = marsTranslate * marsRotate * marsScale;  
 
-    // venus
-    modelMatrixVenus = glm::mat4(1.0f);
-    glm::mat4 venusTranslate = glm::translate(glm::mat4(1.0f), glm::vec3(kRadOrbitVenus * cos(venusOrbitSpeed * currentTimeInSec), 0.0f, kRadOrbitVenus * sin(venusOrbitSpeed * currentTimeInSec)));
-    glm::mat4 venusRotate = glm::rotate(glm::mat4(1.0f), -earthRotationSpeed * currentTimeInSec, glm::vec3(0.0f, 1.0f, 0.0f));  // Venus rotating in the opposite direction (retrograde)
-    glm::mat4 venusScale = glm::scale(glm::mat4(1.0f), glm::vec3(kSizeVenus));
-    modelMatrixVenus = venusTranslate * venusRotate * venusScale; 
+// Plays the session log back: each frame at its recorded clock, after waiting for it
+// unless --fast, and the inputs in between. Fails when the states differ from the recording.
+int replay() {
+  const std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  const double sessionStart = g_session.start().time;
+  double lastClock = sessionStart, frameSeconds = 0.0;
+  size_t checks = 0, mismatches = 0;
+  uint64_t firstMismatch = 0;
+  SessionLog::Event event;
+  while(g_session.next(event) && !(g_window && glfwWindowShouldClose(g_window))) {
+    switch(event.type) {
+    case SessionLog::Type::Frame: {
+      if(!g_replayFast)
+        std::this_thread::sleep_until(wallStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(event.clock - sessionStart)));
+      const std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+      g_simulation.advanceTo(event.clock);
+      update(event.clock);
+      if(g_window) {
+        render();
+        glfwSwapBuffers(g_window);
+        glfwPollEvents();
+      }
+      frameSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+      lastClock = event.clock;
+      break;
+    }
+    case SessionLog::Type::Key:
+      handleKey(event.key, event.scancode, event.action, event.mods);
+      break;
+    case SessionLog::Type::Click:
+      handleClick(event.button, event.action, event.mods, event.x, event.y);
+      break;
+    case SessionLog::Type::Resize:
+      resizeWindow(event.width, event.height);
+      break;
+    case SessionLog::Type::Check:
+    case SessionLog::Type::End:
+      ++checks;
+      if(event.checksum != simulationChecksum() && mismatches++ == 0)
+        firstMismatch = g_session.frames();
+      break;
+    }
+  }
 
+  const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  const uint64_t frames = g_session.frames();
+  std::cout << "Replayed " << frames << " frames, " << lastClock - sessionStart << " s of session in " << wall << " s ("
+            << (wall > 0.0 ? (lastClock - sessionStart) / wall : 0.0) << "x real time), "
+            << (frames ? frameSeconds * 1e3 / double(frames) : 0.0) << " ms per frame" << std::endl;
+  if(!g_session.ended())
+    std::cerr << "WARNING: the session log has no end, the last state was not checked" << std::endl;
+  if(mismatches) {
+    std::cerr << "ERROR: replay diverged from the recording at frame " << firstMismatch << " (" << mismatches << " of "
+              << checks << " checks)" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Replay matches the recording (" << checks << " checks)" << std::endl;
+  return EXIT_SUCCESS;
 }
 
-
 int main(int argc, char ** argv) {
-  init(); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
+  init(argc, argv); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
+  if(g_session.replaying()) {
+    const int status = replay();
+    clear();
+    return status;
+  }
   /*The glfwWindowShouldClose function checks at the start of each loop iteration if GLFW has been instructed to close*/
   while(!glfwWindowShouldClose(g_window)) {
-    update(static_cast<float>(glfwGetTime()));
+    if(g_session.recording())
+      g_simulation.advanceTo(g_session.frame(glfwGetTime())); // the clock rounded as the log keeps it
+    update(g_simulation.now());
+    if(g_session.recording() && g_session.frames() % SessionLog::kCheckFrames == 0)
+      g_session.check(simulationChecksum());
     render();
     /*will swap the color buffer (a large 2D buffer that contains color values for each pixel in GLFW's window) that is 
     used to render to during this render iteration and show it as output to the screen.*/
@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec2 fTexCoord;
+
+uniform sampler2D image; // colored on the CPU, alpha included
+
+out vec4 FragColor;
+
+void main() {
+    FragColor = texture(image, fTexCoord);
+}
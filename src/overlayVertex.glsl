@@ -0,0 +1,12 @@
+#version 330 core
+
+// Screen-space quad from gl_VertexID, drawn as a 4 vertex strip without any vertex buffer
+uniform vec4 rect; // x0 y0 x1 y1, normalized device coordinates
+
+out vec2 fTexCoord;
+
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    fTexCoord = corner;
+    gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+}
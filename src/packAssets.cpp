@@ -0,0 +1,53 @@
+// ----------------------------------------------------------------------------
+// packAssets.cpp
+//
+// Description: Builds the asset pack loaded by tpOpenGL at startup.
+//
+//   packAssets <output.pack> <source dir> <asset>...
+//
+// Each asset is stored under its path relative to the source directory
+// (e.g. "media/earth.jpg"). Generated meshes such as "sphere.mesh" are added
+// by the tool itself.
+// ----------------------------------------------------------------------------
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AssetPack.hpp"
+#include "Mesh.hpp"
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <output.pack> <source dir> <asset>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string output = argv[1];
+    std::string root = argv[2];
+    if(!root.empty() && root[root.size() - 1] != '/' && root[root.size() - 1] != '\\')
+        root += '/';
+
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> assets;
+    for(int i = 3; i < argc; ++i) {
+        const std::string name = argv[i];
+        std::ifstream in((root + name).c_str(), std::ios::binary);
+        if(!in) {
+            std::cerr << "ERROR: Could not open " << root + name << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        assets.push_back(std::make_pair(name, bytes));
+    }
+
+    // the sphere shared by every body, same resolution as the one built at runtime
+    assets.push_back(std::make_pair(std::string("sphere.mesh"), Mesh::genSphere(32)->serialize()));
+
+    if(!AssetPack::write(output, assets))
+        return EXIT_FAILURE;
+    std::cout << "Wrote " << assets.size() << " assets to " << output << std::endl;
+    return EXIT_SUCCESS;
+}
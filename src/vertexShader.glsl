@@ -4,22 +4,23 @@ layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;  
 layout(location = 2) in vec2 aTexCoord;
 
-uniform mat4 model;     
-uniform mat4 viewMat;   
-uniform mat4 projMat;   
+uniform mat4x3 model;   // 3x4 affine, the last row is always 0 0 0 1
+uniform mat4 mvp;       // projection * view * model, batched on the CPU
 
 out vec3 fNormal;      
 out vec3 fPosition;    
 out vec2 fTexCoord;   
+out vec3 fDirection;  
 
 void main() {
-    vec4 worldPosition = model * vec4(aPosition, 1.0);
-    fPosition = vec3(worldPosition); 
+    vec3 worldPosition = model * vec4(aPosition, 1.0);
+    fPosition = worldPosition;
 
-    fNormal = mat3(transpose(inverse(model))) * aNormal;
+    fNormal = transpose(inverse(mat3(model))) * aNormal;
 
     fTexCoord = aTexCoord;
+    fDirection = aNormal; // unit sphere: the normal is the lookup direction
 
-    gl_Position = projMat * viewMat * worldPosition;
+    gl_Position = mvp * vec4(aPosition, 1.0);
 }
 